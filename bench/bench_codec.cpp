@@ -0,0 +1,148 @@
+/*
+ * File:   bench_codec.cpp
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:05
+ *
+ * host/bus_frame_codec.hpp against the C code on the same payloads: encode
+ * (encodeBusFrame against the codec's encode and encodeDense) and decode
+ * (decodeBusFrameSpan against the codec's decode), CPU per payload byte
+ * with the table and bitwise CRC policies, block and dense, from 8 bytes up
+ * to a 4 KB jumbo, best of a few passes. Every decode is checked. Built
+ * against bus_frame_jumbo.
+ *
+ *   bench_codec [frames per length]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../host/bus_frame_codec.hpp"
+extern "C" {
+#include "../test/bus_test.h"
+}
+
+#define CODEC_DEFAULT_FRAMES    2000
+#define CODEC_PASSES            3
+
+using TableCodec = busframe::BusFrameCodec<BUS_FRAME_JUMBO_MAX_BLOCKS, busframe::TableCrc>;
+using BitwiseCodec = busframe::BusFrameCodec<BUS_FRAME_JUMBO_MAX_BLOCKS, busframe::BitwiseCrc>;
+
+typedef struct {
+    double encodeNanosecondsPerByte;
+    double decodeNanosecondsPerByte;
+} tCodecResult;
+
+void keepFastest(tCodecResult *ptrBest, const tCodecResult *ptrResult, unsigned pass);
+void runCEncoding(unsigned char format, unsigned length, unsigned frames, tCodecResult *ptrResult);
+template <class Codec>
+void runCodecEncoding(unsigned char format, unsigned length, unsigned frames, tCodecResult *ptrResult);
+
+unsigned char wire[TableCodec::maxWireSize];
+unsigned char decoded[MAX_JUMBO_UNPACKED_PAYLOAD + 6];
+unsigned char payload[MAX_JUMBO_UNPACKED_PAYLOAD];
+unsigned long bad;
+
+void keepFastest(tCodecResult *ptrBest, const tCodecResult *ptrResult, unsigned pass) {
+    if(pass == 0 || ptrResult->encodeNanosecondsPerByte < ptrBest->encodeNanosecondsPerByte) {
+        ptrBest->encodeNanosecondsPerByte = ptrResult->encodeNanosecondsPerByte;
+    }
+    if(pass == 0 || ptrResult->decodeNanosecondsPerByte < ptrBest->decodeNanosecondsPerByte) {
+        ptrBest->decodeNanosecondsPerByte = ptrResult->decodeNanosecondsPerByte;
+    }
+}
+
+void runCEncoding(unsigned char format, unsigned length, unsigned frames, tCodecResult *ptrResult) {
+    tBusFrameSpanOutput output;
+    unsigned int frameLength;
+    unsigned wireLength = 0;
+    unsigned frame;
+    double start;
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        wireLength = encodeBusFrame(&payload[0], length, format, &wire[0], sizeof(wire));
+    }
+    ptrResult->encodeNanosecondsPerByte = (getBusTestSeconds() - start) / frames / length * 1e9;
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        output.ptrPayload = &decoded[0];
+        output.payloadSize = sizeof(decoded);
+        output.payloadLength = 0;
+        output.ptrFrameLengths = &frameLength;
+        output.maxFrames = 1;
+        output.frameCount = 0;
+        if(decodeBusFrameSpan(&wire[0], wireLength, &output) != wireLength || output.frameCount != 1) {
+            bad++;
+        }
+    }
+    ptrResult->decodeNanosecondsPerByte = (getBusTestSeconds() - start) / frames / length * 1e9;
+    if(memcmp(&decoded[0], &payload[0], length) != 0) {
+        bad++;
+    }
+}
+
+template <class Codec>
+void runCodecEncoding(unsigned char format, unsigned length, unsigned frames, tCodecResult *ptrResult) {
+    bool dense = (format & BUS_FRAME_FORMAT_DENSE) != 0;
+    unsigned wireLength = 0;
+    unsigned decodedLength = 0;
+    unsigned frame;
+    double start;
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        wireLength = dense ? Codec::encodeDense(&payload[0], length, &wire[0]) : Codec::encode(&payload[0], length, &wire[0]);
+    }
+    ptrResult->encodeNanosecondsPerByte = (getBusTestSeconds() - start) / frames / length * 1e9;
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        if(Codec::decode(&wire[0], wireLength, &decoded[0], &decodedLength) != wireLength) {
+            bad++;
+        }
+    }
+    ptrResult->decodeNanosecondsPerByte = (getBusTestSeconds() - start) / frames / length * 1e9;
+    if(decodedLength < length || memcmp(&decoded[0], &payload[0], length) != 0) {
+        bad++;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned frames = argc > 1 ? (unsigned)atoi(argv[1]) : CODEC_DEFAULT_FRAMES;
+    unsigned lengths[] = {8, 90, 512, 4096};
+    unsigned char formats[] = {0, BUS_FRAME_FORMAT_DENSE};
+    tCodecResult result = {};
+    tCodecResult c = {};
+    tCodecResult table = {};
+    tCodecResult bitwise = {};
+    unsigned int seed = 101;
+
+    if(frames == 0) {
+        return 1;
+    }
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+    printf("%u frames per length, ns per payload byte, best of %u\n", frames, CODEC_PASSES);
+    printf("format  length  C encode  C++ table  C++ bitwise  C decode  C++ table  C++ bitwise\n");
+    for(unsigned char format : formats) {
+        for(unsigned length : lengths) {
+            for(unsigned pass = 0; pass < CODEC_PASSES; pass++) {
+                runCEncoding(format, length, frames, &result);
+                keepFastest(&c, &result, pass);
+                runCodecEncoding<TableCodec>(format, length, frames, &result);
+                keepFastest(&table, &result, pass);
+                runCodecEncoding<BitwiseCodec>(format, length, frames, &result);
+                keepFastest(&bitwise, &result, pass);
+            }
+            printf("%-6s  %6u  %8.2f  %9.2f  %11.2f  %8.2f  %9.2f  %11.2f\n", format ? "dense" : "block", length,
+                    c.encodeNanosecondsPerByte, table.encodeNanosecondsPerByte, bitwise.encodeNanosecondsPerByte,
+                    c.decodeNanosecondsPerByte, table.decodeNanosecondsPerByte, bitwise.decodeNanosecondsPerByte);
+        }
+    }
+    if(bad) {
+        printf("%lu bad frames\n", bad);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * File:   bench_compression.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:35
+ *
+ * Delta compression on a run of sensor telemetry (makeBusTestTelemetry):
+ * payload bytes before and after, by message type, and encode and decode
+ * CPU per payload byte for the codec on its own, best of a few passes (the
+ * log text comes out bigger, the writer sends those frames plain). Then
+ * the same run through writeBusFrameCompressed and the handler as block and
+ * as dense frames, wire bytes against the frames sent plain, every payload
+ * checked on the way out. Built against bus_frame_compress.
+ *
+ *   bench_compression [frames] [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../bus_frame_compress.h"
+#include "../test/bus_test.h"
+
+#if !BUS_FRAME_COMPRESSION_ENABLED
+#error bench_compression needs a library built with BUS_FRAME_COMPRESSION_ENABLED
+#endif
+
+#define COMPRESSION_DEFAULT_FRAMES  20000
+#define COMPRESSION_DEFAULT_PASSES  5
+#define COMPRESSION_MAX_LENGTH      32
+#define COMPRESSION_TYPES           256
+
+unsigned long runCompressedFrames(unsigned char format, unsigned int frames, unsigned long *ptrPlainBytes, unsigned long *ptrBad);
+
+tBusTestLink link;
+tBusFrameCompressStream streams[BUS_FRAME_COMPRESSION_STREAMS];
+tBusFrameExpander expander;
+unsigned char *ptrCorpus;
+unsigned int *ptrLengths;
+unsigned char *ptrCompressed;
+unsigned int *ptrCompressedLengths;
+unsigned long typeRaw[COMPRESSION_TYPES];
+unsigned long typeCompressed[COMPRESSION_TYPES];
+
+//Wire bytes for the corpus through the writer and the handler
+unsigned long runCompressedFrames(unsigned char format, unsigned int frames, unsigned long *ptrPlainBytes, unsigned long *ptrBad) {
+    eBusFrameWriterOperationStatus status;
+    unsigned char wire[64];
+    unsigned char decoded[64];
+    unsigned long wireBytes = 0;
+    unsigned int wireLength;
+    unsigned int decodedLength;
+    unsigned int length;
+    unsigned int frame;
+
+    initialiseBusTestLink(&link);
+    *ptrPlainBytes = 0;
+    *ptrBad = 0;
+    for(frame = 0; frame < frames; frame++) {
+        length = ptrLengths[frame];
+        status = BUS_FRAME_WRITER_OPERATION_NONE;
+        writeBusFrameCompressedCtx(&link.writer, &status, ptrCorpus + frame * COMPRESSION_MAX_LENGTH, length, format);
+        sendFramesInBufferCtx(&link.writer, &status);
+        wireLength = collectBusTestWire(&link, &wire[0], sizeof(wire));
+        if(readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1) != 1 ||
+                decodedLength < length || decodedLength > getBusTestPaddedLength(length, format) ||
+                memcmp(&decoded[0], ptrCorpus + frame * COMPRESSION_MAX_LENGTH, length) != 0) {
+            (*ptrBad)++;
+        }
+        wireBytes += wireLength;
+        *ptrPlainBytes += getEncodedBusFrameSize(length, format);
+    }
+    return wireBytes;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : COMPRESSION_DEFAULT_FRAMES;
+    unsigned int passes = argc > 2 ? (unsigned int)atoi(argv[2]) : COMPRESSION_DEFAULT_PASSES;
+    unsigned char expanded[COMPRESSION_MAX_LENGTH];
+    unsigned char *ptrFrame;
+    tBusFrameCompressStream *ptrStream;
+    unsigned long rawBytes = 0;
+    unsigned long compressedBytes = 0;
+    unsigned long expandedBytes = 0;
+    unsigned long compressedFrames = 0;
+    unsigned long bad = 0;
+    unsigned long wireBytes;
+    unsigned long plainBytes;
+    unsigned long wireBad;
+    unsigned int seed = 87;
+    unsigned int frame;
+    unsigned int pass;
+    unsigned int produced;
+    unsigned int i;
+    unsigned int type;
+    unsigned char byte;
+    double start;
+    double encodeSeconds = 0;
+    double decodeSeconds = 0;
+    double seconds;
+
+    if(frames == 0 || passes == 0) {
+        return 1;
+    }
+    ptrCorpus = malloc((size_t)frames * COMPRESSION_MAX_LENGTH);
+    ptrLengths = malloc((size_t)frames * sizeof(unsigned int));
+    ptrCompressed = malloc((size_t)frames * BUS_FRAME_COMPRESS_MAX_OUTPUT);
+    ptrCompressedLengths = malloc((size_t)frames * sizeof(unsigned int));
+    if(ptrCorpus == 0 || ptrLengths == 0 || ptrCompressed == 0 || ptrCompressedLengths == 0) {
+        return 1;
+    }
+    for(frame = 0; frame < frames; frame++) {
+        ptrLengths[frame] = makeBusTestTelemetry(frame, ptrCorpus + frame * COMPRESSION_MAX_LENGTH, &seed);
+        rawBytes += ptrLengths[frame];
+    }
+
+    //The codec on its own, both ends starting from nothing each pass
+    for(pass = 0; pass < passes; pass++) {
+        memset(&streams[0], 0, sizeof(streams));
+        start = getBusTestSeconds();
+        for(frame = 0; frame < frames; frame++) {
+            ptrFrame = ptrCorpus + frame * COMPRESSION_MAX_LENGTH;
+            ptrStream = &streams[ptrFrame[0] % BUS_FRAME_COMPRESSION_STREAMS];
+            ptrCompressedLengths[frame] = compressBusFramePayload(ptrStream, ptrFrame, ptrLengths[frame],
+                    ptrCompressed + frame * BUS_FRAME_COMPRESS_MAX_OUTPUT, BUS_FRAME_COMPRESS_MAX_OUTPUT);
+            if(ptrCompressedLengths[frame]) {
+                commitBusFrameReference(ptrStream, ptrCompressed[frame * BUS_FRAME_COMPRESS_MAX_OUTPUT], ptrFrame, ptrLengths[frame]);
+            }
+        }
+        seconds = getBusTestSeconds() - start;
+        if(pass == 0 || seconds < encodeSeconds) {
+            encodeSeconds = seconds;
+        }
+
+        initialiseBusFrameExpander(&expander);
+        bad = 0;
+        expandedBytes = 0;
+        start = getBusTestSeconds();
+        for(frame = 0; frame < frames; frame++) {
+            if(!ptrCompressedLengths[frame]) {
+                continue;
+            }
+            startBusFrameExpander(&expander);
+            produced = 0;
+            for(i = 0; i < ptrCompressedLengths[frame]; i++) {
+                putCompressedByte(&expander, ptrCompressed[frame * BUS_FRAME_COMPRESS_MAX_OUTPUT + i]);
+                while(takeExpandedByte(&expander, &byte)) {
+                    if(produced < sizeof(expanded)) {
+                        expanded[produced] = byte;
+                    }
+                    produced++;
+                }
+            }
+            if(finishBusFrameExpander(&expander) != BUS_FRAME_EXPAND_OK || produced != ptrLengths[frame] ||
+                    memcmp(&expanded[0], ptrCorpus + frame * COMPRESSION_MAX_LENGTH, produced) != 0) {
+                bad++;
+            }
+            expandedBytes += produced;
+        }
+        seconds = getBusTestSeconds() - start;
+        if(pass == 0 || seconds < decodeSeconds) {
+            decodeSeconds = seconds;
+        }
+    }
+
+    memset(&typeRaw[0], 0, sizeof(typeRaw));
+    memset(&typeCompressed[0], 0, sizeof(typeCompressed));
+    for(frame = 0; frame < frames; frame++) {
+        type = ptrCorpus[frame * COMPRESSION_MAX_LENGTH];
+        typeRaw[type] += ptrLengths[frame];
+        //What didn't compress would go out as it is
+        typeCompressed[type] += ptrCompressedLengths[frame] ? ptrCompressedLengths[frame] : ptrLengths[frame];
+        if(ptrCompressedLengths[frame]) {
+            compressedFrames++;
+        }
+    }
+    for(type = 0; type < COMPRESSION_TYPES; type++) {
+        compressedBytes += typeCompressed[type];
+    }
+    printf("%u frames, %lu compressed, %lu payload bytes -> %lu (%.2fx)\n", frames, compressedFrames, rawBytes, compressedBytes,
+            (double)rawBytes / compressedBytes);
+    printf("type  raw bytes  compressed  ratio\n");
+    for(type = 0; type < COMPRESSION_TYPES; type++) {
+        if(typeRaw[type]) {
+            printf("  %02X  %9lu  %10lu  %4.2fx\n", type, typeRaw[type], typeCompressed[type], (double)typeRaw[type] / typeCompressed[type]);
+        }
+    }
+    printf("encode %.1f ns/byte of payload, decode %.1f ns/byte expanded, best of %u\n", encodeSeconds * 1e9 / rawBytes,
+            expandedBytes ? decodeSeconds * 1e9 / expandedBytes : 0.0, passes);
+
+    printf("format  wire bytes  plain wire  ratio\n");
+    wireBytes = runCompressedFrames(0, frames, &plainBytes, &wireBad);
+    printf("block   %10lu  %10lu  %4.2fx\n", wireBytes, plainBytes, (double)plainBytes / wireBytes);
+    bad += wireBad;
+    wireBytes = runCompressedFrames(BUS_FRAME_FORMAT_DENSE, frames, &plainBytes, &wireBad);
+    printf("dense   %10lu  %10lu  %4.2fx\n", wireBytes, plainBytes, (double)plainBytes / wireBytes);
+    bad += wireBad;
+
+    free(ptrCorpus);
+    free(ptrLengths);
+    free(ptrCompressed);
+    free(ptrCompressedLengths);
+    if(bad) {
+        printf("%lu bad frames\n", bad);
+        return 1;
+    }
+    return 0;
+}
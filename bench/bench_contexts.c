@@ -0,0 +1,104 @@
+/*
+ * File:   bench_contexts.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 00:10
+ *
+ * Scaling across bus contexts: 1..N threads, each with its own writer and
+ * handler context looping frames back to itself, no state shared. Reports
+ * total frames/sec and how close it gets to N times the one-context rate,
+ * which is capped by the cores there are (printed first). Every frame is
+ * checked, so a context leaking into another shows up as bad frames.
+ *
+ *   bench_contexts [max contexts] [frames per context]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../test/bus_test.h"
+
+#define CONTEXTS_DEFAULT_MAX        8
+#define CONTEXTS_DEFAULT_FRAMES     50000
+#define CONTEXTS_MAX_LENGTH         18
+
+typedef struct {
+    tBusTestLink link;
+    pthread_t thread;
+    unsigned int seed;
+    unsigned int frames;
+    unsigned int bad;
+} tContextsBus;
+
+void *runContextsBus(void *ptrArgument);
+
+void *runContextsBus(void *ptrArgument) {
+    tContextsBus *ptrBus = ptrArgument;
+    unsigned char payload[CONTEXTS_MAX_LENGTH];
+    unsigned char wire[MAX_FRAME_SIZE + 8];
+    unsigned char decoded[CONTEXTS_MAX_LENGTH + 6];
+    unsigned int decodedLength = 0;
+    unsigned int wireLength;
+    unsigned int length;
+    unsigned int frame;
+
+    initialiseBusTestLink(&ptrBus->link);
+    for(frame = 0; frame < ptrBus->frames; frame++) {
+        length = 1 + getBusTestRandom(&ptrBus->seed) % CONTEXTS_MAX_LENGTH;
+        fillBusTestPayload(&payload[0], length, &ptrBus->seed);
+        wireLength = writeBusTestFrame(&ptrBus->link, &payload[0], length, 0, &wire[0], sizeof(wire));
+        if(readBusTestFrames(&ptrBus->link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1) != 1 ||
+                decodedLength != getBusTestPaddedLength(length, 0) ||
+                memcmp(&decoded[0], &payload[0], length) != 0) {
+            ptrBus->bad++;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned int maxContexts = argc > 1 ? (unsigned int)atoi(argv[1]) : CONTEXTS_DEFAULT_MAX;
+    unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : CONTEXTS_DEFAULT_FRAMES;
+    tContextsBus *ptrBuses = calloc(maxContexts, sizeof(tContextsBus));
+    unsigned int contexts;
+    unsigned int i;
+    unsigned int bad = 0;
+    double oneRate = 0;
+    double rate;
+    double start;
+    double seconds;
+
+    if(ptrBuses == 0) {
+        return 1;
+    }
+    printf("%ld cores online, %u frames per context\n", sysconf(_SC_NPROCESSORS_ONLN), frames);
+    printf("contexts  frames/s total  frames/s each  vs 1 context x N\n");
+    for(contexts = 1; contexts <= maxContexts; contexts++) {
+        for(i = 0; i < contexts; i++) {
+            ptrBuses[i].seed = i + 1;
+            ptrBuses[i].frames = frames;
+            ptrBuses[i].bad = 0;
+        }
+        start = getBusTestSeconds();
+        for(i = 0; i < contexts; i++) {
+            pthread_create(&ptrBuses[i].thread, 0, runContextsBus, &ptrBuses[i]);
+        }
+        for(i = 0; i < contexts; i++) {
+            pthread_join(ptrBuses[i].thread, 0);
+            bad += ptrBuses[i].bad;
+        }
+        seconds = getBusTestSeconds() - start;
+        rate = (double)contexts * frames / seconds;
+        if(contexts == 1) {
+            oneRate = rate;
+        }
+        printf("%8u  %14.0f  %13.0f  %15.0f%%\n", contexts, rate, rate / contexts, 100.0 * rate / (oneRate * contexts));
+    }
+    if(bad) {
+        printf("%u frames came back wrong\n", bad);
+    }
+    free(ptrBuses);
+    return bad != 0;
+}
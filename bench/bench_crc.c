@@ -0,0 +1,79 @@
+/*
+ * File:   bench_crc.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 00:30
+ *
+ * Blocks/sec for the block CRC engine this build was made with
+ * (BUS_FRAME_CRC_TABLE), one block at a time with calculateBlockCrc and a
+ * frame of 15 blocks in one pass with calculateBlockCrcs and
+ * countGoodBlockCrcs. Built once per engine, bench_crc (bitwise) and
+ * bench_crc_table, so run both to compare.
+ *
+ *   bench_crc [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../test/bus_test.h"
+#include "../bus_frame_crc.h"
+
+#define CRC_DEFAULT_FRAMES  200000
+#define CRC_FRAME_BLOCKS    15
+#define CRC_FRAME_SETS      64      //Different frames cycled through, so it's not one cache line
+#define CRC_BLOCK_SIZE      8
+
+unsigned char blocks[CRC_FRAME_SETS][CRC_FRAME_BLOCKS * CRC_BLOCK_SIZE];
+volatile unsigned int sink;
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : CRC_DEFAULT_FRAMES;
+    unsigned int seed = 5;
+    unsigned int frame;
+    unsigned int block;
+    unsigned int i;
+    unsigned int total = 0;
+    unsigned int good = 0;
+    double start;
+    double seconds;
+    double blockCount = (double)frames * CRC_FRAME_BLOCKS;
+
+    initialiseBusFrameCrc();
+    for(frame = 0; frame < CRC_FRAME_SETS; frame++) {
+        for(i = 0; i < CRC_FRAME_BLOCKS * CRC_BLOCK_SIZE; i++) {
+            blocks[frame][i] = getBusTestRandom(&seed) & 0x7F;
+        }
+    }
+    printf("%s block CRC, %u frames of %u blocks\n", BUS_FRAME_CRC_TABLE ? "table" : "bitwise", frames, CRC_FRAME_BLOCKS);
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        for(block = 0; block < CRC_FRAME_BLOCKS; block++) {
+            total += calculateBlockCrc(&blocks[frame % CRC_FRAME_SETS][block * CRC_BLOCK_SIZE + 2]);
+        }
+    }
+    seconds = getBusTestSeconds() - start;
+    printf("calculateBlockCrc     %12.0f blocks/s  %6.2f ns/block\n", blockCount / seconds, seconds * 1e9 / blockCount);
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        calculateBlockCrcs(&blocks[frame % CRC_FRAME_SETS][0], CRC_FRAME_BLOCKS);
+    }
+    seconds = getBusTestSeconds() - start;
+    printf("calculateBlockCrcs    %12.0f blocks/s  %6.2f ns/block\n", blockCount / seconds, seconds * 1e9 / blockCount);
+
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        good += countGoodBlockCrcs(&blocks[frame % CRC_FRAME_SETS][0], CRC_FRAME_BLOCKS);
+    }
+    seconds = getBusTestSeconds() - start;
+    printf("countGoodBlockCrcs    %12.0f blocks/s  %6.2f ns/block\n", blockCount / seconds, seconds * 1e9 / blockCount);
+
+    sink = total;
+    //Every frame had its CRCs filled in by the pass before, so all of them have to check out
+    if(good != frames * CRC_FRAME_BLOCKS) {
+        printf("%u of %.0f blocks failed their CRC\n", (unsigned int)(frames * CRC_FRAME_BLOCKS - good), blockCount);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * File:   bench_dense.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 03:05
+ *
+ * Dense (7 in 8, frame CRC-16) against block (6 in 8, a CRC per block)
+ * frames of the same payloads: wire bytes, payload efficiency, and CPU per
+ * payload byte through the writer and the handler, from a sensor sized
+ * 8 bytes up to a 4 KB jumbo. Every frame is checked on the way out. Built
+ * against bus_frame_jumbo so the larger frames fit in the writer.
+ *
+ *   bench_dense [frames per length]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../test/bus_test.h"
+
+#define DENSE_DEFAULT_FRAMES    2000
+#define DENSE_WIRE_SIZE         (MAX_JUMBO_UNPACKED_PAYLOAD / 6 * 8 + 16)
+
+typedef struct {
+    unsigned int wireBytes;
+    unsigned long bad;
+    double nanosecondsPerByte;
+} tDenseResult;
+
+void runDenseFrames(unsigned char format, const unsigned char *ptrPayload, unsigned int length, unsigned int frames, tDenseResult *ptrResult);
+
+tBusTestLink link;
+unsigned char wire[DENSE_WIRE_SIZE];
+unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+unsigned char payload[4096];
+
+void runDenseFrames(unsigned char format, const unsigned char *ptrPayload, unsigned int length, unsigned int frames, tDenseResult *ptrResult) {
+    unsigned int frame;
+    unsigned int wireLength = 0;
+    unsigned int decodedLength;
+    double start;
+
+    ptrResult->bad = 0;
+    initialiseBusTestLink(&link);
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        wireLength = writeBusTestFrame(&link, ptrPayload, length, format, &wire[0], sizeof(wire));
+        if(readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1) != 1 ||
+                decodedLength != getBusTestPaddedLength(length, format) ||
+                memcmp(&decoded[0], ptrPayload, length) != 0) {
+            ptrResult->bad++;
+        }
+    }
+    ptrResult->nanosecondsPerByte = (getBusTestSeconds() - start) / frames / length * 1e9;
+    ptrResult->wireBytes = wireLength;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : DENSE_DEFAULT_FRAMES;
+    unsigned int lengths[] = {8, 32, 90, 512, 4096};
+    tDenseResult block;
+    tDenseResult dense;
+    unsigned int seed = 43;
+    unsigned long bad = 0;
+    unsigned int i;
+
+    if(frames == 0) {
+        return 1;
+    }
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+    printf("%u frames per length\n", frames);
+    printf("length  block wire  dense wire  block eff  dense eff  block ns/B  dense ns/B\n");
+    for(i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        runDenseFrames(0, &payload[0], lengths[i], frames, &block);
+        runDenseFrames(BUS_FRAME_FORMAT_DENSE, &payload[0], lengths[i], frames, &dense);
+        printf("%6u  %10u  %10u  %8.1f%%  %8.1f%%  %10.1f  %10.1f\n", lengths[i], block.wireBytes, dense.wireBytes,
+                100.0 * lengths[i] / block.wireBytes, 100.0 * lengths[i] / dense.wireBytes,
+                block.nanosecondsPerByte, dense.nanosecondsPerByte);
+        bad += block.bad + dense.bad;
+    }
+    if(bad) {
+        printf("%lu bad frames\n", bad);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * File:   bench_direct.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:45
+ *
+ * ns per frame and per payload byte for the three ways a frame gets encoded:
+ * queued (open, write, close, send, run until on the wire), writeBusFrameDirect
+ * (straight into the send buffer, then taken off it like a UART would) and
+ * encodeBusFrame (into a caller's span), at a sensor sized 6 bytes, 48 and a
+ * full 90, block and dense. Every frame is compared with the queued one, a
+ * path that goes faster by sending something else counts as bad.
+ *
+ *   bench_direct [frames per length]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "../test/bus_test.h"
+
+#define DIRECT_DEFAULT_FRAMES   100000
+
+unsigned int takeDirectWire(unsigned char *ptrWire, unsigned int wireSize);
+
+tBusTestLink link;
+unsigned char payload[MAX_UNPACKED_PAYLOAD];
+unsigned char queuedWire[MAX_FRAME_SIZE + 8];
+unsigned char wire[MAX_FRAME_SIZE + 8];
+
+//Empties the send buffer without running the writer, there's nothing queued for it to do
+unsigned int takeDirectWire(unsigned char *ptrWire, unsigned int wireSize) {
+    eBufferOperationStatus bufferStatus;
+    unsigned int taken = 0;
+    unsigned char byte;
+    while(1) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&link.sendBuffer, &bufferStatus, &byte);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        if(taken < wireSize) {
+            ptrWire[taken] = byte;
+        }
+        taken++;
+    }
+    return taken;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : DIRECT_DEFAULT_FRAMES;
+    unsigned int lengths[] = {6, 48, MAX_UNPACKED_PAYLOAD};
+    unsigned char formats[] = {0, BUS_FRAME_FORMAT_DENSE};
+    eBusFrameWriterOperationStatus status;
+    unsigned int seed = 13;
+    unsigned int queuedLength;
+    unsigned int wireLength = 0;
+    unsigned int frame;
+    unsigned int bad = 0;
+    unsigned int f;
+    unsigned int l;
+    double queuedSeconds;
+    double directSeconds;
+    double encodeSeconds;
+    double start;
+
+    initialiseBusTestLink(&link);
+    printf("format  length  wire  queued ns/frame  direct ns/frame  encode ns/frame  queued ns/B  direct ns/B  encode ns/B\n");
+    for(f = 0; f < sizeof(formats); f++) {
+        for(l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            fillBusTestPayload(&payload[0], lengths[l], &seed);
+            queuedLength = writeBusTestFrame(&link, &payload[0], lengths[l], formats[f], &queuedWire[0], sizeof(queuedWire));
+
+            start = getBusTestSeconds();
+            for(frame = 0; frame < frames; frame++) {
+                wireLength = writeBusTestFrame(&link, &payload[0], lengths[l], formats[f], &wire[0], sizeof(wire));
+            }
+            queuedSeconds = getBusTestSeconds() - start;
+
+            start = getBusTestSeconds();
+            for(frame = 0; frame < frames; frame++) {
+                status = BUS_FRAME_WRITER_OPERATION_NONE;
+                writeBusFrameDirectCtx(&link.writer, &status, &payload[0], lengths[l], formats[f]);
+                wireLength = takeDirectWire(&wire[0], sizeof(wire));
+                if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+                    bad++;
+                }
+            }
+            directSeconds = getBusTestSeconds() - start;
+            if(wireLength != queuedLength || memcmp(&wire[0], &queuedWire[0], queuedLength) != 0) {
+                bad++;
+            }
+
+            start = getBusTestSeconds();
+            for(frame = 0; frame < frames; frame++) {
+                wireLength = encodeBusFrame(&payload[0], lengths[l], formats[f], &wire[0], sizeof(wire));
+            }
+            encodeSeconds = getBusTestSeconds() - start;
+            if(wireLength != queuedLength || memcmp(&wire[0], &queuedWire[0], queuedLength) != 0) {
+                bad++;
+            }
+
+            printf("%6s  %6u  %4u  %15.1f  %15.1f  %15.1f  %11.2f  %11.2f  %11.2f\n", formats[f] ? "dense" : "block", lengths[l], queuedLength,
+                    queuedSeconds * 1e9 / frames, directSeconds * 1e9 / frames, encodeSeconds * 1e9 / frames,
+                    queuedSeconds * 1e9 / ((double)frames * lengths[l]), directSeconds * 1e9 / ((double)frames * lengths[l]),
+                    encodeSeconds * 1e9 / ((double)frames * lengths[l]));
+        }
+    }
+    if(bad) {
+        printf("%u frames differed from the queued path or were refused\n", bad);
+    }
+    return bad != 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * File:   bench_inbound.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 02:30
+ *
+ * Bytes/sec into the inbound ring from a producer thread, one byte per call
+ * (putByteForHandlingCtx, the old ISR pattern) against batches of 8 up to
+ * the ring size (putBytesForHandlingCtx, DMA or read() sized). "ring" has
+ * the consumer thread just taking bytes back out, "handler" has it running
+ * the handler over real frames, which is what a bus actually pays. Both
+ * threads spin, so with one core online (printed first) it measures the
+ * scheduler as much as the ring.
+ *
+ *   bench_inbound [frames]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../test/bus_test.h"
+#include "../bus_inbound_ring.h"
+
+#define INBOUND_DEFAULT_FRAMES  50000
+#define INBOUND_MAX_LENGTH      60
+#define INBOUND_WIRE_PER_FRAME  (2 + ((INBOUND_MAX_LENGTH + 5) / 6) * 8 + 2)
+
+typedef struct {
+    tBusFrameHandlerCtx *ptrHandler;
+    const unsigned char *ptrWire;
+    unsigned int length;
+    unsigned int batch;
+    volatile unsigned char done;
+} tInboundProducer;
+
+void *produceInbound(void *ptrArgument);
+double runInboundRing(tInboundProducer *ptrProducer);
+double runInboundHandler(tInboundProducer *ptrProducer, unsigned int frames, unsigned int *ptrDecoded);
+
+tBusTestLink inboundLink;
+
+void *produceInbound(void *ptrArgument) {
+    tInboundProducer *ptrProducer = ptrArgument;
+    eBusHandlerOperationStatus status;
+    unsigned int position = 0;
+    unsigned int length;
+    unsigned int accepted;
+
+    while(position < ptrProducer->length) {
+        if(ptrProducer->batch == 1) {
+            putByteForHandlingCtx(ptrProducer->ptrHandler, &status, ptrProducer->ptrWire[position]);
+            accepted = status == BUS_HANDLER_OPERATION_OK;
+        } else {
+            length = ptrProducer->length - position;
+            if(length > ptrProducer->batch) {
+                length = ptrProducer->batch;
+            }
+            putBytesForHandlingCtx(ptrProducer->ptrHandler, &status, ptrProducer->ptrWire + position, length, &accepted);
+        }
+        position += accepted;
+        if(accepted == 0) {
+            sched_yield();
+        }
+    }
+    ptrProducer->done = 1;
+    return 0;
+}
+
+//Consumer only empties the ring
+double runInboundRing(tInboundProducer *ptrProducer) {
+    pthread_t thread;
+    unsigned int taken = 0;
+    unsigned char byte;
+    double start;
+
+    initialiseBusTestLink(&inboundLink);
+    ptrProducer->ptrHandler = &inboundLink.handler;
+    ptrProducer->done = 0;
+    start = getBusTestSeconds();
+    pthread_create(&thread, 0, produceInbound, ptrProducer);
+    while(taken < ptrProducer->length) {
+        if(getBusInboundByte(&inboundLink.handler.busHandleInboundRing, &byte)) {
+            taken++;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, 0);
+    return getBusTestSeconds() - start;
+}
+
+double runInboundHandler(tInboundProducer *ptrProducer, unsigned int frames, unsigned int *ptrDecoded) {
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    eBusHandlerRunStatus runStatus = BUS_HANDLER_RUN_NONE;
+    pthread_t thread;
+    double start;
+
+    initialiseBusTestLink(&inboundLink);
+    ptrProducer->ptrHandler = &inboundLink.handler;
+    ptrProducer->done = 0;
+    *ptrDecoded = 0;
+    start = getBusTestSeconds();
+    pthread_create(&thread, 0, produceInbound, ptrProducer);
+    while(*ptrDecoded < frames) {
+        runBusFrameHandlerBudgetCtx(&inboundLink.handler, &runStatus, 256);
+        if(inboundLink.applicationListener) {
+            drainBusTestApplication(&inboundLink, &decoded[0], sizeof(decoded));
+            inboundLink.applicationListener = 0;
+            (*ptrDecoded)++;
+            continue;
+        }
+        if(runStatus == BUS_HANDLER_RUN_STARVED) {
+            if(ptrProducer->done && isBusInboundRingEmpty(&inboundLink.handler.busHandleInboundRing)) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    pthread_join(thread, 0);
+    return getBusTestSeconds() - start;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : INBOUND_DEFAULT_FRAMES;
+    unsigned int batches[] = {1, 8, 32, HANDLER_INBOUND_RING_SIZE};
+    unsigned char *ptrWire = malloc((size_t)frames * INBOUND_WIRE_PER_FRAME);
+    unsigned char payload[INBOUND_MAX_LENGTH];
+    tInboundProducer producer;
+    unsigned int seed = 31;
+    unsigned int wireLength = 0;
+    unsigned int length;
+    unsigned int frame;
+    unsigned int decoded;
+    unsigned int lost = 0;
+    unsigned int i;
+    double ringSeconds;
+    double handlerSeconds;
+    double singleRate = 0;
+
+    if(ptrWire == 0) {
+        return 1;
+    }
+    for(frame = 0; frame < frames; frame++) {
+        length = 1 + getBusTestRandom(&seed) % INBOUND_MAX_LENGTH;
+        fillBusTestPayload(&payload[0], length, &seed);
+        wireLength += encodeBusFrame(&payload[0], length, 0, ptrWire + wireLength, INBOUND_WIRE_PER_FRAME);
+    }
+    printf("%ld cores online, %u frames, %u wire bytes, ring of %u\n", sysconf(_SC_NPROCESSORS_ONLN), frames, wireLength, HANDLER_INBOUND_RING_SIZE);
+    printf("batch  ring MB/s  handler MB/s  handler vs 1 byte\n");
+    producer.ptrWire = ptrWire;
+    producer.length = wireLength;
+    for(i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+        producer.batch = batches[i];
+        ringSeconds = runInboundRing(&producer);
+        handlerSeconds = runInboundHandler(&producer, frames, &decoded);
+        if(decoded != frames) {
+            lost += frames - decoded;
+        }
+        if(i == 0) {
+            singleRate = wireLength / handlerSeconds;
+        }
+        printf("%5u  %9.1f  %12.1f  %16.2fx\n", batches[i], wireLength / ringSeconds / 1e6, wireLength / handlerSeconds / 1e6,
+                wireLength / handlerSeconds / singleRate);
+    }
+    free(ptrWire);
+    if(lost) {
+        printf("%u frames lost\n", lost);
+        return 1;
+    }
+    return 0;
+}
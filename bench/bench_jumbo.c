@@ -0,0 +1,101 @@
+/*
+ * File:   bench_jumbo.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 02:50
+ *
+ * A 4 KB transfer as legacy frames (90 bytes each, the most a 4 bit block
+ * count carries) against one jumbo frame: wire bytes, time on the wire at
+ * 115200 baud 8N1, and CPU per transfer through the writer and the handler.
+ * Every transfer is checked on the way out. Built against bus_frame_jumbo,
+ * whose FRAME_WRITER_PROCESS_BUFFER_SIZE holds the whole transfer.
+ *
+ *   bench_jumbo [transfers] [transfer bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../test/bus_test.h"
+
+#define JUMBO_DEFAULT_TRANSFERS     500
+#define JUMBO_DEFAULT_BYTES         4096
+#define JUMBO_WIRE_SIZE             (MAX_JUMBO_UNPACKED_PAYLOAD / 6 * 8 + 16)
+#define JUMBO_BAUD_BYTES_PER_SECOND (115200.0 / 10)
+
+typedef struct {
+    unsigned long wireBytes;
+    unsigned long frames;
+    unsigned long bad;
+    double seconds;
+} tJumboResult;
+
+void runJumboTransfers(unsigned char format, unsigned int frameBytes, const unsigned char *ptrPayload, unsigned int length, unsigned int transfers, tJumboResult *ptrResult);
+
+tBusTestLink link;
+unsigned char wire[JUMBO_WIRE_SIZE];
+unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+
+void runJumboTransfers(unsigned char format, unsigned int frameBytes, const unsigned char *ptrPayload, unsigned int length, unsigned int transfers, tJumboResult *ptrResult) {
+    unsigned int transfer;
+    unsigned int position;
+    unsigned int chunk;
+    unsigned int wireLength;
+    unsigned int decodedLength;
+    double start;
+
+    memset(ptrResult, 0, sizeof(tJumboResult));
+    initialiseBusTestLink(&link);
+    start = getBusTestSeconds();
+    for(transfer = 0; transfer < transfers; transfer++) {
+        for(position = 0; position < length; position += chunk) {
+            chunk = length - position < frameBytes ? length - position : frameBytes;
+            wireLength = writeBusTestFrame(&link, ptrPayload + position, chunk, format, &wire[0], sizeof(wire));
+            if(readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1) != 1 ||
+                    decodedLength != getBusTestPaddedLength(chunk, format) ||
+                    memcmp(&decoded[0], ptrPayload + position, chunk) != 0) {
+                ptrResult->bad++;
+            }
+            ptrResult->wireBytes += wireLength;
+            ptrResult->frames++;
+        }
+    }
+    ptrResult->seconds = getBusTestSeconds() - start;
+    ptrResult->wireBytes /= transfers;
+    ptrResult->frames /= transfers;
+}
+
+int main(int argc, char **argv) {
+    unsigned int transfers = argc > 1 ? (unsigned int)atoi(argv[1]) : JUMBO_DEFAULT_TRANSFERS;
+    unsigned int length = argc > 2 ? (unsigned int)atoi(argv[2]) : JUMBO_DEFAULT_BYTES;
+    unsigned char *ptrPayload;
+    tJumboResult legacy;
+    tJumboResult jumbo;
+    unsigned int seed = 41;
+
+    if(length == 0 || length > MAX_JUMBO_UNPACKED_PAYLOAD || transfers == 0) {
+        printf("transfer bytes must be 1 to %u\n", MAX_JUMBO_UNPACKED_PAYLOAD);
+        return 1;
+    }
+    ptrPayload = malloc(length);
+    if(ptrPayload == 0) {
+        return 1;
+    }
+    fillBusTestPayload(ptrPayload, length, &seed);
+
+    runJumboTransfers(0, MAX_UNPACKED_PAYLOAD, ptrPayload, length, transfers, &legacy);
+    runJumboTransfers(BUS_FRAME_FORMAT_JUMBO, length, ptrPayload, length, transfers, &jumbo);
+
+    printf("%u byte transfer, %u times\n", length, transfers);
+    printf("format  frames  wire bytes  efficiency  ms at 115200  us CPU\n");
+    printf("legacy  %6lu  %10lu  %9.1f%%  %12.1f  %6.1f\n", legacy.frames, legacy.wireBytes, 100.0 * length / legacy.wireBytes,
+            legacy.wireBytes / JUMBO_BAUD_BYTES_PER_SECOND * 1e3, legacy.seconds / transfers * 1e6);
+    printf("jumbo   %6lu  %10lu  %9.1f%%  %12.1f  %6.1f\n", jumbo.frames, jumbo.wireBytes, 100.0 * length / jumbo.wireBytes,
+            jumbo.wireBytes / JUMBO_BAUD_BYTES_PER_SECOND * 1e3, jumbo.seconds / transfers * 1e6);
+    free(ptrPayload);
+    if(legacy.bad || jumbo.bad) {
+        printf("bad frames: legacy %lu, jumbo %lu\n", legacy.bad, jumbo.bad);
+        return 1;
+    }
+    return 0;
+}
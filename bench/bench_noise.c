@@ -0,0 +1,183 @@
+/*
+ * File:   bench_noise.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 01:20
+ *
+ * Noisy line: a share of the frames get hit by one of a byte overwritten, a
+ * bit flipped, the frame cut short or a burst of junk inserted, then the
+ * whole stream goes through the handler. Reports how many of the untouched
+ * frames came out (all of them, or the resync is broken, which fails the
+ * run), how many damaged ones still made it, and bytes the handler threw
+ * away per error it raised. The span decoder gets the same stream.
+ *
+ *   bench_noise [frames] [share damaged, 0..1] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../test/bus_test.h"
+
+#define NOISE_DEFAULT_FRAMES    20000
+#define NOISE_MAX_FRAMES        50000
+#define NOISE_MAX_LENGTH        60
+#define NOISE_MAX_BURST         8
+#define NOISE_FRAME_SIZE        (MAX_FRAME_SIZE + NOISE_MAX_BURST)
+
+typedef enum {
+    NOISE_NONE = 0,
+    NOISE_OVERWRITE,
+    NOISE_BIT_FLIP,
+    NOISE_TRUNCATE,
+    NOISE_BURST,
+    NOISE_KINDS
+} eNoiseKind;
+
+unsigned int countRecovered(const unsigned char *ptrPayload, const unsigned int *ptrLengths, unsigned int frames, unsigned int *ptrDamagedIntact, unsigned int *ptrWrong);
+
+tBusTestLink link;
+unsigned char expected[NOISE_MAX_FRAMES][NOISE_MAX_LENGTH];
+unsigned char expectedLength[NOISE_MAX_FRAMES];
+unsigned char damage[NOISE_MAX_FRAMES];
+unsigned char stream[NOISE_MAX_FRAMES * NOISE_FRAME_SIZE];
+unsigned char decoded[NOISE_MAX_FRAMES * (NOISE_MAX_LENGTH + 6)];
+unsigned int decodedLengths[NOISE_MAX_FRAMES * 2];
+unsigned int totalFrames;
+unsigned char seen[NOISE_MAX_FRAMES];
+
+//Untouched frames that came out intact, also counting damaged frames that still did and frames that match nothing sent
+unsigned int countRecovered(const unsigned char *ptrPayload, const unsigned int *ptrLengths, unsigned int frames, unsigned int *ptrDamagedIntact, unsigned int *ptrWrong) {
+    unsigned int recovered = 0;
+    unsigned int offset = 0;
+    unsigned int frame;
+    unsigned int id;
+
+    *ptrDamagedIntact = 0;
+    *ptrWrong = 0;
+    memset(&seen[0], 0, sizeof(seen));
+    for(frame = 0; frame < frames; frame++) {
+        id = ptrLengths[frame] >= 2 ? (unsigned int)(ptrPayload[offset] | (ptrPayload[offset + 1] << 8)) : totalFrames;
+        //A second copy is a damaged frame that happens to decode as an earlier one (mask bits aren't under the CRC)
+        if(id < totalFrames && !seen[id] && ptrLengths[frame] == getBusTestPaddedLength(expectedLength[id], 0) &&
+                memcmp(&ptrPayload[offset], &expected[id][0], expectedLength[id]) == 0) {
+            seen[id] = 1;
+            if(damage[id] == NOISE_NONE) {
+                recovered++;
+            } else {
+                (*ptrDamagedIntact)++;
+            }
+        } else {
+            (*ptrWrong)++;
+        }
+        offset += ptrLengths[frame];
+    }
+    return recovered;
+}
+
+int main(int argc, char **argv) {
+    double share = argc > 2 ? atof(argv[2]) : 0.1;
+    unsigned int seed = argc > 3 ? (unsigned int)atoi(argv[3]) : 1;
+    unsigned char wire[NOISE_FRAME_SIZE];
+    unsigned int streamLength = 0;
+    unsigned int clean = 0;
+    unsigned int wireLength;
+    unsigned int length;
+    unsigned int frame;
+    unsigned int cut;
+    unsigned int burst;
+    unsigned int i;
+    unsigned int handlerFrames;
+    unsigned int handlerRecovered;
+    unsigned int handlerIntact;
+    unsigned int handlerWrong;
+    unsigned int spanRecovered;
+    unsigned int spanIntact;
+    unsigned int spanWrong;
+    unsigned long errors = 0;
+    tBusFrameHandlerStats stats;
+    tBusFrameSpanOutput output;
+    double start;
+    double seconds;
+
+    totalFrames = argc > 1 ? (unsigned int)atoi(argv[1]) : NOISE_DEFAULT_FRAMES;
+    if(totalFrames > NOISE_MAX_FRAMES) {
+        totalFrames = NOISE_MAX_FRAMES;
+    }
+    for(frame = 0; frame < totalFrames; frame++) {
+        length = 2 + getBusTestRandom(&seed) % (NOISE_MAX_LENGTH - 1);
+        expected[frame][0] = frame & 0xFF;
+        expected[frame][1] = frame >> 8;
+        fillBusTestPayload(&expected[frame][2], length - 2, &seed);
+        expectedLength[frame] = length;
+        wireLength = encodeBusFrame(&expected[frame][0], length, 0, &wire[0], sizeof(wire));
+        damage[frame] = NOISE_NONE;
+        if((getBusTestRandom(&seed) % 1000000) < share * 1000000) {
+            damage[frame] = 1 + getBusTestRandom(&seed) % (NOISE_KINDS - 1);
+        }
+        cut = getBusTestRandom(&seed) % wireLength;
+        switch(damage[frame]) {
+            case NOISE_OVERWRITE:
+                wire[cut] = (unsigned char)getBusTestRandom(&seed);
+                break;
+            case NOISE_BIT_FLIP:
+                wire[cut] ^= 1 << (getBusTestRandom(&seed) % 8);
+                break;
+            case NOISE_TRUNCATE:
+                wireLength = cut;
+                break;
+            case NOISE_BURST:
+                burst = 1 + getBusTestRandom(&seed) % NOISE_MAX_BURST;
+                memmove(&wire[cut + burst], &wire[cut], wireLength - cut);
+                for(i = 0; i < burst; i++) {
+                    wire[cut + i] = (unsigned char)getBusTestRandom(&seed);
+                }
+                wireLength += burst;
+                break;
+            default:
+                clean++;
+                break;
+        }
+        memcpy(&stream[streamLength], &wire[0], wireLength);
+        streamLength += wireLength;
+    }
+
+    initialiseBusTestLink(&link);
+    start = getBusTestSeconds();
+    handlerFrames = readBusTestFrames(&link, &stream[0], streamLength, &decoded[0], sizeof(decoded), &decodedLengths[0], NOISE_MAX_FRAMES * 2);
+    seconds = getBusTestSeconds() - start;
+    handlerRecovered = countRecovered(&decoded[0], &decodedLengths[0], handlerFrames, &handlerIntact, &handlerWrong);
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    for(i = 0; i < BHE_ERROR_KINDS; i++) {
+        errors += stats.errorCounts[i];
+    }
+
+    output.ptrPayload = &decoded[0];
+    output.payloadSize = sizeof(decoded);
+    output.payloadLength = 0;
+    output.maxFrames = 255;
+    spanRecovered = 0;
+    spanIntact = 0;
+    spanWrong = 0;
+    for(i = 0, frame = 0; i < streamLength; ) {
+        output.ptrFrameLengths = &decodedLengths[frame];
+        output.frameCount = 0;
+        cut = decodeBusFrameSpan(&stream[i], streamLength - i, &output);
+        frame += output.frameCount;
+        if(cut == 0 || output.frameCount == 0) {
+            break;
+        }
+        i += cut;
+    }
+    spanRecovered = countRecovered(&decoded[0], &decodedLengths[0], frame, &spanIntact, &spanWrong);
+
+    printf("%u frames, %u damaged (%.1f%%), %u wire bytes\n", totalFrames, totalFrames - clean, 100.0 * (totalFrames - clean) / totalFrames, streamLength);
+    printf("handler: untouched frames out %u/%u (%.2f%%), damaged frames still intact %u, wrong payloads accepted %u\n",
+            handlerRecovered, clean, clean ? 100.0 * handlerRecovered / clean : 100.0, handlerIntact, handlerWrong);
+    printf("handler: %lu errors, %lu CRC failures, %lu bytes discarded resynchronising, %.1f per error, %.1f per damaged frame, %.0f ns/wire byte\n",
+            errors, stats.crcFailures, stats.resyncBytesDiscarded, errors ? (double)stats.resyncBytesDiscarded / errors : 0.0,
+            totalFrames > clean ? (double)stats.resyncBytesDiscarded / (totalFrames - clean) : 0.0, seconds * 1e9 / streamLength);
+    printf("span:    untouched frames out %u/%u, damaged frames still intact %u, wrong payloads accepted %u\n",
+            spanRecovered, clean, spanIntact, spanWrong);
+    return handlerRecovered != clean || spanRecovered != clean;
+}
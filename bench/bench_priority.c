@@ -0,0 +1,177 @@
+/*
+ * File:   bench_priority.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:45
+ *
+ * Control frame latency with the bulk lane saturated: 90 byte bulk frames
+ * kept queued to a set depth, a UART taking one byte per tick out of the
+ * send buffer (the listener cleared once it's empty, like a driver), and
+ * an 8 byte control frame queued every so often, timed from closeBusFrame
+ * to the handler handing it over. Sent on the control lane, then through
+ * the bulk lane behind everything else for comparison. Average, 99th
+ * percentile and worst in byte times and ms at 115200 baud 8N1; the control
+ * lane's worst has to stay within a bulk frame plus the control frame.
+ * Built against bus_frame_priority.
+ *
+ *   bench_priority [control frames] [bulk depth]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "../test/bus_test.h"
+
+#if !FRAME_WRITER_PRIORITY_ENABLED
+#error bench_priority needs a library built with FRAME_WRITER_PRIORITY_ENABLED
+#endif
+
+#define PRIORITY_DEFAULT_CONTROLS   2000
+#define PRIORITY_DEFAULT_DEPTH      8
+#define PRIORITY_BULK_LENGTH        90
+#define PRIORITY_CONTROL_LENGTH     8
+#define PRIORITY_BULK_TYPE          0x44
+#define PRIORITY_CONTROL_TYPE       0x55
+#define PRIORITY_CONTROL_GAP        300     //Ticks between control frames, on average
+#define PRIORITY_BAUD_BYTES_PER_MS  (115200.0 / 10 / 1000)
+
+typedef struct {
+    unsigned long average;
+    unsigned long percentile99;
+    unsigned long worst;
+    unsigned long bulkFrames;
+    unsigned long bad;
+    unsigned long ticks;
+} tPriorityResult;
+
+int compareLatency(const void *ptrLeft, const void *ptrRight);
+void runPriorityLatency(eBusFramePriority controlPriority, unsigned int controls, unsigned int depth, tPriorityResult *ptrResult);
+
+tBusTestLink link;
+unsigned long *ptrLatencies;
+
+int compareLatency(const void *ptrLeft, const void *ptrRight) {
+    unsigned long left = *(const unsigned long *)ptrLeft;
+    unsigned long right = *(const unsigned long *)ptrRight;
+    return left < right ? -1 : left > right;
+}
+
+void runPriorityLatency(eBusFramePriority controlPriority, unsigned int controls, unsigned int depth, tPriorityResult *ptrResult) {
+    eBusFrameWriterOperationStatus status;
+    eBusFrameWriterRunStatus writerStatus;
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus handlerStatus;
+    eBufferOperationStatus bufferStatus;
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    unsigned char byte;
+    unsigned int seed = 91;
+    unsigned int done = 0;
+    unsigned int accepted;
+    unsigned int decodedLength;
+    unsigned int i;
+    unsigned long tick;
+    unsigned long queuedAt = 0;
+    unsigned long total = 0;
+    unsigned char outstanding = 0;
+
+    memset(ptrResult, 0, sizeof(tPriorityResult));
+    initialiseBusTestLink(&link);
+    for(tick = 0; done < controls && tick < (unsigned long)controls * PRIORITY_CONTROL_GAP * 20; tick++) {
+        while(getQueuedFrameCountByPriorityCtx(&link.writer, BUS_FRAME_PRIORITY_BULK) < depth) {
+            openBusFrameCtx(&link.writer, &status);
+            if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+                break;
+            }
+            writeToBusFrameCtx(&link.writer, &status, PRIORITY_BULK_TYPE);
+            for(i = 1; i < PRIORITY_BULK_LENGTH; i++) {
+                writeToBusFrameCtx(&link.writer, &status, (unsigned char)i);
+            }
+            closeBusFrameCtx(&link.writer, &status);
+            sendFramesInBufferCtx(&link.writer, &status);
+        }
+        if(!outstanding && getBusTestRandom(&seed) % PRIORITY_CONTROL_GAP == 0) {
+            openBusFrameWithPriorityCtx(&link.writer, &status, 0, controlPriority);
+            if(status == BUS_FRAME_WRITER_OPERATION_OK) {
+                writeToBusFrameCtx(&link.writer, &status, PRIORITY_CONTROL_TYPE);
+                for(i = 1; i < PRIORITY_CONTROL_LENGTH; i++) {
+                    writeToBusFrameCtx(&link.writer, &status, (unsigned char)(done + i));
+                }
+                closeBusFrameCtx(&link.writer, &status);
+                sendFramesInBufferCtx(&link.writer, &status);
+                queuedAt = tick;
+                outstanding = 1;
+            }
+        }
+        runBusFrameWriterBudgetCtx(&link.writer, &writerStatus, 64);
+
+        //The UART
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&link.sendBuffer, &bufferStatus, &byte);
+        if(bufferStatus == BUFFER_OPERATION_OK) {
+            accepted = 0;
+            putBytesForHandlingCtx(&link.handler, &putStatus, &byte, 1, &accepted);
+        } else {
+            link.sendListener = 0;
+        }
+        runBusFrameHandlerBudgetCtx(&link.handler, &handlerStatus, 256);
+        if(link.applicationListener) {
+            decodedLength = drainBusTestApplication(&link, &decoded[0], sizeof(decoded));
+            link.applicationListener = 0;
+            if(decodedLength && decoded[0] == PRIORITY_CONTROL_TYPE && outstanding) {
+                ptrLatencies[done++] = tick - queuedAt;
+                total += tick - queuedAt;
+                outstanding = 0;
+            } else if(decodedLength == getBusTestPaddedLength(PRIORITY_BULK_LENGTH, 0) && decoded[0] == PRIORITY_BULK_TYPE) {
+                ptrResult->bulkFrames++;
+            } else {
+                ptrResult->bad++;
+            }
+        }
+    }
+    ptrResult->ticks = tick;
+    if(done < controls) {
+        ptrResult->bad += controls - done;
+    }
+    if(done) {
+        qsort(ptrLatencies, done, sizeof(unsigned long), compareLatency);
+        ptrResult->average = total / done;
+        ptrResult->percentile99 = ptrLatencies[(done * 99) / 100];
+        ptrResult->worst = ptrLatencies[done - 1];
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned int controls = argc > 1 ? (unsigned int)atoi(argv[1]) : PRIORITY_DEFAULT_CONTROLS;
+    unsigned int depth = argc > 2 ? (unsigned int)atoi(argv[2]) : PRIORITY_DEFAULT_DEPTH;
+    unsigned int bound = getEncodedBusFrameSize(PRIORITY_BULK_LENGTH, 0) + getEncodedBusFrameSize(PRIORITY_CONTROL_LENGTH, 0);
+    tPriorityResult control;
+    tPriorityResult bulk;
+
+    if(controls == 0 || depth == 0 || depth * PRIORITY_BULK_LENGTH > FRAME_WRITER_PROCESS_BUFFER_SIZE || depth >= FRAME_WRITER_MAX_QUEUED_FRAMES) {
+        printf("bulk depth must be 1 to %u frames\n", FRAME_WRITER_PROCESS_BUFFER_SIZE / PRIORITY_BULK_LENGTH);
+        return 1;
+    }
+    ptrLatencies = malloc((size_t)controls * sizeof(unsigned long));
+    if(ptrLatencies == 0) {
+        return 1;
+    }
+    runPriorityLatency(BUS_FRAME_PRIORITY_CONTROL, controls, depth, &control);
+    runPriorityLatency(BUS_FRAME_PRIORITY_BULK, controls, depth, &bulk);
+
+    printf("%u control frames against %u bulk frames queued, latency in byte times (ms at 115200)\n", controls, depth);
+    printf("lane     average        p99             worst            bulk frames  link busy\n");
+    printf("control  %4lu (%5.1f)  %4lu (%5.1f)  %4lu (%5.1f)  %11lu  %8.1f%%\n", control.average, control.average / PRIORITY_BAUD_BYTES_PER_MS,
+            control.percentile99, control.percentile99 / PRIORITY_BAUD_BYTES_PER_MS, control.worst, control.worst / PRIORITY_BAUD_BYTES_PER_MS,
+            control.bulkFrames, 100.0 * (control.bulkFrames * getEncodedBusFrameSize(PRIORITY_BULK_LENGTH, 0) + controls * getEncodedBusFrameSize(PRIORITY_CONTROL_LENGTH, 0)) / control.ticks);
+    printf("bulk     %4lu (%5.1f)  %4lu (%5.1f)  %4lu (%5.1f)  %11lu  %8.1f%%\n", bulk.average, bulk.average / PRIORITY_BAUD_BYTES_PER_MS,
+            bulk.percentile99, bulk.percentile99 / PRIORITY_BAUD_BYTES_PER_MS, bulk.worst, bulk.worst / PRIORITY_BAUD_BYTES_PER_MS,
+            bulk.bulkFrames, 100.0 * (bulk.bulkFrames * getEncodedBusFrameSize(PRIORITY_BULK_LENGTH, 0) + controls * getEncodedBusFrameSize(PRIORITY_CONTROL_LENGTH, 0)) / bulk.ticks);
+    printf("control lane bound: %u byte times, a bulk frame and the control frame\n", bound);
+    free(ptrLatencies);
+    if(control.bad || bulk.bad) {
+        printf("bad frames: control run %lu, bulk run %lu\n", control.bad, bulk.bad);
+        return 1;
+    }
+    return control.worst > bound;
+}
@@ -0,0 +1,203 @@
+/*
+ * File:   bench_repair.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:15
+ *
+ * Selective repeat against whole frame resends over a line flipping each
+ * bit with a fixed probability, both ways. Two links stand in for the two
+ * ends, the sender's wire going to the receiver's handler and the
+ * receiver's feedback coming back. A frame the receiver didn't get is sent
+ * again from scratch in either mode, standing in for whatever end to end
+ * check the application has; in repair mode the writer first gets its
+ * BUS_FRAME_REPAIR_MAX_ROUNDS tries at patching the bad blocks. Reports
+ * sends, wire bytes each way and CPU per delivered frame, and payloads that
+ * came out wrong (mask bits aren't under the block CRC, so some flips get
+ * through in either mode). Built against bus_frame_repair.
+ *
+ *   bench_repair [frames per bit error rate] [bit error rate]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "../test/bus_test.h"
+
+#if !BUS_FRAME_REPAIR_ENABLED
+#error bench_repair needs a library built with BUS_FRAME_REPAIR_ENABLED
+#endif
+
+#define REPAIR_DEFAULT_FRAMES   2000
+#define REPAIR_LENGTH           90      //15 blocks, the most a repairable frame holds
+#define REPAIR_MAX_SENDS        50      //Per frame before it counts as lost
+#define REPAIR_MAX_ROUNDS       256     //Per send, a round steps both writers and carries both ways
+#define REPAIR_ROUND_STEPS      16
+
+typedef struct {
+    unsigned long sends;
+    unsigned long lost;
+    unsigned long wrong;
+    unsigned long forwardBytes;
+    unsigned long backBytes;
+    double seconds;
+} tRepairResult;
+
+unsigned int carryRepairWire(tBusTestLink *ptrFrom, tBusTestLink *ptrTo, double ber);
+void runRepairFrames(unsigned char repair, double ber, unsigned int frames, tRepairResult *ptrResult);
+
+tBusTestLink sender;
+tBusTestLink receiver;
+unsigned char payload[REPAIR_LENGTH];
+unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+unsigned int noiseSeed;
+unsigned int arrived;
+unsigned int arrivedWrong;
+
+//Moves what ptrFrom sent to ptrTo's handler, flipping bits on the way, and checks whatever comes out. Returns the wire bytes carried
+unsigned int carryRepairWire(tBusTestLink *ptrFrom, tBusTestLink *ptrTo, double ber) {
+    unsigned char wire[BUS_TEST_SEND_BUFFER_SIZE];
+    eBufferOperationStatus bufferStatus;
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus = BUS_HANDLER_RUN_NONE;
+    unsigned int threshold = (unsigned int)(ber * 4294967295.0);
+    unsigned int length = 0;
+    unsigned int position = 0;
+    unsigned int accepted;
+    unsigned int decodedLength;
+    unsigned int bit;
+
+    while(length < sizeof(wire)) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&ptrFrom->sendBuffer, &bufferStatus, &wire[length]);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        if(threshold) {
+            for(bit = 0; bit < 8; bit++) {
+                if(getBusTestRandom(&noiseSeed) < threshold) {
+                    wire[length] ^= 1 << bit;
+                }
+            }
+        }
+        length++;
+    }
+    ptrFrom->sendListener = 0;
+    while(1) {
+        if(position < length) {
+            accepted = 0;
+            putBytesForHandlingCtx(&ptrTo->handler, &putStatus, &wire[position], length - position, &accepted);
+            position += accepted;
+        }
+        runBusFrameHandlerBudgetCtx(&ptrTo->handler, &runStatus, 256);
+        if(ptrTo->applicationListener) {
+            decodedLength = drainBusTestApplication(ptrTo, &decoded[0], sizeof(decoded));
+            ptrTo->applicationListener = 0;
+            //Only the receiver has frames coming, anything the sender's handler hands up is noise that got through
+            if(ptrTo != &receiver || decodedLength != REPAIR_LENGTH || memcmp(&decoded[0], &payload[0], REPAIR_LENGTH) != 0) {
+                arrivedWrong++;
+            } else {
+                arrived++;
+            }
+            continue;
+        }
+        if(position >= length && runStatus == BUS_HANDLER_RUN_STARVED) {
+            break;
+        }
+    }
+    return length;
+}
+
+void runRepairFrames(unsigned char repair, double ber, unsigned int frames, tRepairResult *ptrResult) {
+    eBusFrameWriterOperationStatus status;
+    eBusFrameWriterRunStatus senderStatus;
+    eBusFrameWriterRunStatus receiverStatus;
+    unsigned int seed = 71;
+    unsigned int frame;
+    unsigned int sends;
+    unsigned int round;
+    unsigned int carried;
+    unsigned int i;
+    double start;
+
+    memset(ptrResult, 0, sizeof(tRepairResult));
+    initialiseBusTestLink(&sender);
+    initialiseBusTestLink(&receiver);
+    registerBusFrameRepairWriterCtx(&sender.handler, &sender.writer);
+    registerBusFrameRepairWriterCtx(&receiver.handler, &receiver.writer);
+    setBusFrameRepairModeCtx(&sender.writer, repair);
+    setBusFrameRepairModeCtx(&receiver.writer, repair);
+    noiseSeed = 73;
+    arrivedWrong = 0;
+    start = getBusTestSeconds();
+    for(frame = 0; frame < frames; frame++) {
+        fillBusTestPayload(&payload[0], REPAIR_LENGTH, &seed);
+        arrived = 0;
+        for(sends = 0; sends < REPAIR_MAX_SENDS && !arrived; sends++) {
+            status = BUS_FRAME_WRITER_OPERATION_NONE;
+            openBusFrameCtx(&sender.writer, &status);
+            for(i = 0; i < REPAIR_LENGTH; i++) {
+                writeToBusFrameCtx(&sender.writer, &status, payload[i]);
+            }
+            closeBusFrameCtx(&sender.writer, &status);
+            sendFramesInBufferCtx(&sender.writer, &status);
+            //Until both ends have nothing left to say: the frame, its feedback, repairs, or the wait for feedback running out
+            for(round = 0; round < REPAIR_MAX_ROUNDS; round++) {
+                runBusFrameWriterBudgetCtx(&sender.writer, &senderStatus, REPAIR_ROUND_STEPS);
+                carried = carryRepairWire(&sender, &receiver, ber);
+                ptrResult->forwardBytes += carried;
+                runBusFrameWriterBudgetCtx(&receiver.writer, &receiverStatus, REPAIR_ROUND_STEPS);
+                ptrResult->backBytes += carryRepairWire(&receiver, &sender, ber);
+                if(senderStatus == BUS_FRAME_WRITER_RUN_IDLE && receiverStatus == BUS_FRAME_WRITER_RUN_IDLE && carried == 0) {
+                    break;
+                }
+            }
+        }
+        ptrResult->sends += sends;
+        if(!arrived) {
+            ptrResult->lost++;
+        }
+    }
+    ptrResult->seconds = getBusTestSeconds() - start;
+    ptrResult->wrong = arrivedWrong;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : REPAIR_DEFAULT_FRAMES;
+    double rates[] = {0, 1e-4, 1e-3, 3e-3};
+    unsigned int rateCount = sizeof(rates) / sizeof(rates[0]);
+    tRepairResult results[2];
+    tRepairResult *ptrResult;
+    unsigned long delivered;
+    unsigned int failed = 0;
+    unsigned int r;
+    unsigned int mode;
+
+    if(frames == 0) {
+        return 1;
+    }
+    if(argc > 2) {
+        rates[0] = atof(argv[2]);
+        rateCount = 1;
+    }
+    printf("%u frames of %u bytes per bit error rate, %u sends at most\n", frames, REPAIR_LENGTH, REPAIR_MAX_SENDS);
+    printf("ber     mode    sends/frame  wire out/frame  wire back/frame  efficiency  us/frame  lost  wrong\n");
+    for(r = 0; r < rateCount; r++) {
+        for(mode = 0; mode < 2; mode++) {
+            ptrResult = &results[mode];
+            runRepairFrames((unsigned char)mode, rates[r], frames, ptrResult);
+            delivered = frames - ptrResult->lost;
+            printf("%-7.0e %-7s %11.2f  %14.1f  %15.1f  %9.1f%%  %8.1f  %4lu  %5lu\n", rates[r], mode ? "repair" : "resend",
+                    delivered ? (double)ptrResult->sends / delivered : 0.0,
+                    delivered ? (double)ptrResult->forwardBytes / delivered : 0.0,
+                    delivered ? (double)ptrResult->backBytes / delivered : 0.0,
+                    ptrResult->forwardBytes + ptrResult->backBytes ? 100.0 * delivered * REPAIR_LENGTH / (ptrResult->forwardBytes + ptrResult->backBytes) : 0.0,
+                    ptrResult->seconds / frames * 1e6, ptrResult->lost, ptrResult->wrong);
+            //A clean line has to get every frame through first time
+            if(rates[r] == 0 && (ptrResult->sends != frames || ptrResult->lost || ptrResult->wrong)) {
+                failed++;
+            }
+        }
+    }
+    return failed != 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * File:   bench_throughput.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 23:55
+ *
+ * Frames/sec and ns per payload byte for every payload length 1..90, writer
+ * encoding (open, write, close, send, run until on the wire) and handler
+ * decoding (put the wire bytes, run until the listener, read the payload)
+ * measured separately, plus ns per payload byte for decodeBusFrameSpan over
+ * a span of back to back frames.
+ *
+ *   bench_throughput [frames per length]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../test/bus_test.h"
+
+#define THROUGHPUT_DEFAULT_FRAMES   20000
+#define THROUGHPUT_SPAN_FRAMES      64
+
+tBusTestLink link;
+unsigned char wire[MAX_FRAME_SIZE + 8];
+unsigned char payload[MAX_UNPACKED_PAYLOAD];
+unsigned char decoded[MAX_UNPACKED_PAYLOAD + 6];
+unsigned char span[THROUGHPUT_SPAN_FRAMES * (MAX_FRAME_SIZE + 8)];
+unsigned char spanPayload[THROUGHPUT_SPAN_FRAMES * (MAX_UNPACKED_PAYLOAD + 6)];
+unsigned int spanLengths[THROUGHPUT_SPAN_FRAMES];
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : THROUGHPUT_DEFAULT_FRAMES;
+    unsigned int seed = 1;
+    unsigned int length;
+    unsigned int wireLength = 0;
+    unsigned int decodedLength;
+    unsigned int frame;
+    unsigned int bad = 0;
+    double writerSeconds;
+    double handlerSeconds;
+    double spanSeconds;
+    tBusFrameSpanOutput output;
+    unsigned int spanLength;
+    unsigned int rounds;
+    double start;
+
+    initialiseBusTestLink(&link);
+    printf("length  wire  writer frames/s  writer ns/B  handler frames/s  handler ns/B  span ns/B\n");
+    for(length = 1; length <= MAX_UNPACKED_PAYLOAD; length++) {
+        fillBusTestPayload(&payload[0], length, &seed);
+
+        start = getBusTestSeconds();
+        for(frame = 0; frame < frames; frame++) {
+            payload[0] = (unsigned char)frame;
+            wireLength = writeBusTestFrame(&link, &payload[0], length, 0, &wire[0], sizeof(wire));
+        }
+        writerSeconds = getBusTestSeconds() - start;
+
+        start = getBusTestSeconds();
+        for(frame = 0; frame < frames; frame++) {
+            if(readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1) != 1) {
+                bad++;
+            }
+        }
+        handlerSeconds = getBusTestSeconds() - start;
+
+        for(spanLength = 0; spanLength < THROUGHPUT_SPAN_FRAMES * wireLength; spanLength++) {
+            span[spanLength] = wire[spanLength % wireLength];
+        }
+        rounds = (frames + THROUGHPUT_SPAN_FRAMES - 1) / THROUGHPUT_SPAN_FRAMES;
+        start = getBusTestSeconds();
+        for(frame = 0; frame < rounds; frame++) {
+            output.ptrPayload = &spanPayload[0];
+            output.payloadSize = sizeof(spanPayload);
+            output.payloadLength = 0;
+            output.ptrFrameLengths = &spanLengths[0];
+            output.maxFrames = THROUGHPUT_SPAN_FRAMES;
+            output.frameCount = 0;
+            decodeBusFrameSpan(&span[0], spanLength, &output);
+            if(output.frameCount != THROUGHPUT_SPAN_FRAMES) {
+                bad++;
+            }
+        }
+        spanSeconds = getBusTestSeconds() - start;
+
+        printf("%6u  %4u  %15.0f  %11.2f  %16.0f  %12.2f  %9.2f\n", length, wireLength,
+                frames / writerSeconds, writerSeconds * 1e9 / ((double)frames * length),
+                frames / handlerSeconds, handlerSeconds * 1e9 / ((double)frames * length),
+                spanSeconds * 1e9 / ((double)rounds * THROUGHPUT_SPAN_FRAMES * length));
+    }
+    if(bad) {
+        printf("%u frames didn't decode\n", bad);
+    }
+    return bad != 0;
+}
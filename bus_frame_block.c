@@ -0,0 +1,138 @@
+/*
+ * File:   bus_frame_block.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 11:40
+ */
+
+#include "../global.h"
+#include "bus_frame_details.h"
+#include "bus_frame_crc.h"
+#include "bus_frame_block.h"
+
+#define BLOCK_DATA_BYTES    6
+#define BLOCK_SIZE          8
+#define BLOCK_MASK_MARKER   0b10000000
+
+unsigned char maskBlockBytes(unsigned char *ptrData);
+void demaskBlockBytes(unsigned char *ptrData, unsigned char mask);
+unsigned int encodeBusFrameBlocks(const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrBlocks);
+unsigned int decodeBusFrameBlocks(unsigned char *ptrBlocks, unsigned int blockCount, unsigned char *ptrPayload);
+unsigned char packDenseGroup(unsigned char *ptrData, unsigned char length);
+void unpackDenseGroup(unsigned char *ptrData, unsigned char length, unsigned char highBits);
+
+#if BUS_FRAME_BLOCK_SWAR
+#define SWAR_HIGH_BITS      0x0000808080808080ULL
+#define SWAR_LOW_BITS       0x0000010101010101ULL
+#define SWAR_GATHER         0x0102040810204080ULL   //Bit 0 of byte i lands on bit 56 + i
+#define SWAR_SPREAD         0x0000040810204080ULL   //Bit i lands on bit 7 of byte i
+
+unsigned long long loadBlockWord(unsigned char *ptrData) {
+    return (unsigned long long)ptrData[0] |
+            ((unsigned long long)ptrData[1] << 8) |
+            ((unsigned long long)ptrData[2] << 16) |
+            ((unsigned long long)ptrData[3] << 24) |
+            ((unsigned long long)ptrData[4] << 32) |
+            ((unsigned long long)ptrData[5] << 40);
+}
+
+void storeBlockWord(unsigned char *ptrData, unsigned long long word) {
+    unsigned char i;
+    for(i = 0; i < BLOCK_DATA_BYTES; i++) {
+        ptrData[i] = (unsigned char)(word >> (i * 8));
+    }
+}
+
+//Strips bit 7 off the 6 data bytes, returning which ones had it set
+unsigned char maskBlockBytes(unsigned char *ptrData) {
+    unsigned long long word = loadBlockWord(ptrData);
+    unsigned char mask = (unsigned char)((((word >> 7) & SWAR_LOW_BITS) * SWAR_GATHER) >> 56);
+    storeBlockWord(ptrData, word & ~SWAR_HIGH_BITS);
+    return mask;
+}
+
+//Puts bit 7 back on the data bytes flagged in the mask
+void demaskBlockBytes(unsigned char *ptrData, unsigned char mask) {
+    unsigned long long word = loadBlockWord(ptrData);
+    word ^= ((unsigned long long)(mask & 0b00111111) * SWAR_SPREAD) & SWAR_HIGH_BITS;
+    storeBlockWord(ptrData, word);
+}
+#else
+//Strips bit 7 off the 6 data bytes, returning which ones had it set
+unsigned char maskBlockBytes(unsigned char *ptrData) {
+    unsigned char mask = 0;
+    unsigned char i;
+    for(i = 0; i < BLOCK_DATA_BYTES; i++) {
+        if(ptrData[i] & 0b10000000) {
+            ptrData[i] = ptrData[i] & 0b01111111;
+            mask = mask | (1 << i);
+        }
+    }
+    return mask;
+}
+
+//Puts bit 7 back on the data bytes flagged in the mask
+void demaskBlockBytes(unsigned char *ptrData, unsigned char mask) {
+    unsigned char i;
+    for(i = 0; i < BLOCK_DATA_BYTES; i++) {
+        if(mask & (1 << i)) {
+            ptrData[i] += 0b10000000;
+        }
+    }
+}
+#endif
+
+//Dense format: strips bit 7 off up to 7 bytes, returning them gathered into the byte that follows the group
+unsigned char packDenseGroup(unsigned char *ptrData, unsigned char length) {
+    unsigned char highBits = 0;
+    unsigned char i;
+    for(i = 0; i < length; i++) {
+        highBits |= (ptrData[i] >> 7) << i;
+        ptrData[i] &= 0b01111111;
+    }
+    return highBits;
+}
+
+void unpackDenseGroup(unsigned char *ptrData, unsigned char length, unsigned char highBits) {
+    unsigned char i;
+    for(i = 0; i < length; i++) {
+        ptrData[i] |= ((highBits >> i) & 1) << 7;
+    }
+}
+
+//Encodes a whole payload into 8 byte wire blocks (0xFF padded), returns the block count
+unsigned int encodeBusFrameBlocks(const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrBlocks) {
+    unsigned char *ptrBlock = ptrBlocks;
+    unsigned int blockCount = 0;
+    unsigned char take;
+    unsigned char i;
+    while(length > 0) {
+        take = length < BLOCK_DATA_BYTES ? length : BLOCK_DATA_BYTES;
+        for(i = 0; i < BLOCK_DATA_BYTES; i++) {
+            ptrBlock[2 + i] = i < take ? ptrPayload[i] : 0xFF;
+        }
+        ptrBlock[0] = BLOCK_MASK_MARKER | maskBlockBytes(&ptrBlock[2]);
+        ptrBlock += BLOCK_SIZE;
+        ptrPayload += take;
+        length -= take;
+        blockCount++;
+    }
+    calculateBlockCrcs(ptrBlocks, blockCount);
+    return blockCount;
+}
+
+//Checks and demasks wire blocks into ptrPayload, returns how many passed before the first bad CRC
+unsigned int decodeBusFrameBlocks(unsigned char *ptrBlocks, unsigned int blockCount, unsigned char *ptrPayload) {
+    unsigned int decoded = countGoodBlockCrcs(ptrBlocks, blockCount);
+    unsigned int block;
+    unsigned char i;
+    for(block = 0; block < decoded; block++) {
+        for(i = 0; i < BLOCK_DATA_BYTES; i++) {
+            ptrPayload[i] = ptrBlocks[2 + i];
+        }
+        demaskBlockBytes(ptrPayload, ptrBlocks[0]);
+        ptrPayload += BLOCK_DATA_BYTES;
+        ptrBlocks += BLOCK_SIZE;
+    }
+    return decoded;
+}
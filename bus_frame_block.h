@@ -0,0 +1,11 @@
+#ifndef BUS_FRAME_BLOCK_H
+#define	BUS_FRAME_BLOCK_H
+
+extern unsigned char maskBlockBytes(unsigned char *ptrData);
+extern void demaskBlockBytes(unsigned char *ptrData, unsigned char mask);
+extern unsigned int encodeBusFrameBlocks(const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrBlocks);
+extern unsigned int decodeBusFrameBlocks(unsigned char *ptrBlocks, unsigned int blockCount, unsigned char *ptrPayload);
+extern unsigned char packDenseGroup(unsigned char *ptrData, unsigned char length);
+extern void unpackDenseGroup(unsigned char *ptrData, unsigned char length, unsigned char highBits);
+
+#endif	/* BUS_FRAME_BLOCK_H */
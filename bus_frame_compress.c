@@ -0,0 +1,218 @@
+/*
+ * File:   bus_frame_compress.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 20:40
+ */
+
+#include "../global.h"
+#include "bus_frame_details.h"
+#include "bus_frame_compress.h"
+
+unsigned int compressBusFramePayload(tBusFrameCompressStream *ptrStream, const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrOutput, unsigned int outputSize);
+void commitBusFrameReference(tBusFrameCompressStream *ptrStream, unsigned char control, const unsigned char *ptrPayload, unsigned int length);
+void initialiseBusFrameExpander(tBusFrameExpander *ptrExpander);
+void startBusFrameExpander(tBusFrameExpander *ptrExpander);
+eBusFrameExpandStatus putCompressedByte(tBusFrameExpander *ptrExpander, unsigned char byte);
+unsigned char takeExpandedByte(tBusFrameExpander *ptrExpander, unsigned char *ptrByte);
+eBusFrameExpandStatus finishBusFrameExpander(tBusFrameExpander *ptrExpander);
+eBusFrameExpandStatus beginExpandedFrame(tBusFrameExpander *ptrExpander);
+eBusFrameExpandStatus putCompressedToken(tBusFrameExpander *ptrExpander, unsigned char byte);
+
+//Compressed form of a payload against the stream's last frame, which is left alone until commitBusFrameReference. Returns its length, 0 if it won't fit in outputSize
+unsigned int compressBusFramePayload(tBusFrameCompressStream *ptrStream, const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrOutput, unsigned int outputSize) {
+    unsigned int written = 0;
+    unsigned int literalPosition = 0;
+    unsigned int i = 1;
+    unsigned int run;
+    unsigned char delta;
+    unsigned char value;
+
+    if(length == 0 || length > BUS_FRAME_COMPRESSION_MAX_REFERENCE || outputSize < 4) {
+        return 0;
+    }
+    delta = ptrStream->valid && ptrStream->type == ptrPayload[0] && ptrStream->length == length && ptrStream->framesSinceKey + 1 < BUS_FRAME_COMPRESSION_KEY_INTERVAL;
+    ptrOutput[written++] = (delta ? BUS_FRAME_COMPRESS_DELTA : 0) | (ptrStream->valid ? (ptrStream->sequence + 1) & 0x7F : 0);
+    ptrOutput[written++] = ptrPayload[0];
+    if(length < 0x80) {
+        ptrOutput[written++] = length;
+    } else {
+        ptrOutput[written++] = 0x80 | (length >> 8);
+        ptrOutput[written++] = length & 0xFF;
+    }
+    while(i < length) {
+        value = ptrPayload[i] ^ (delta ? ptrStream->bytes[i] : 0);
+        run = 1;
+        while(i + run < length && run < (value ? BUS_FRAME_COMPRESS_MAX_REPEAT : BUS_FRAME_COMPRESS_MAX_ZEROS) &&
+                (ptrPayload[i + run] ^ (delta ? ptrStream->bytes[i + run] : 0)) == value) {
+            run++;
+        }
+        if(written + 2 > outputSize) {
+            return 0;
+        }
+        if(value == 0 && run >= 2) {
+            ptrOutput[written++] = BUS_FRAME_COMPRESS_ZERO_RUN | (run - 1);
+            literalPosition = 0;
+            i += run;
+        } else if(run >= 3) {
+            ptrOutput[written++] = BUS_FRAME_COMPRESS_REPEAT_RUN | (run - 2);
+            ptrOutput[written++] = value;
+            literalPosition = 0;
+            i += run;
+        } else {
+            //Odd bytes between runs share one literal token, a byte at a time so a run starting next is still spotted
+            if(literalPosition && ptrOutput[literalPosition] < BUS_FRAME_COMPRESS_MAX_LITERAL - 1) {
+                ptrOutput[literalPosition]++;
+            } else {
+                literalPosition = written;
+                ptrOutput[written++] = 0;
+            }
+            ptrOutput[written++] = value;
+            i++;
+        }
+    }
+    return written;
+}
+
+//Once the frame compressBusFramePayload made is queued. The receiver does the same when it's decoded, so the two copies stay in step
+void commitBusFrameReference(tBusFrameCompressStream *ptrStream, unsigned char control, const unsigned char *ptrPayload, unsigned int length) {
+    unsigned int i;
+    ptrStream->framesSinceKey = (control & BUS_FRAME_COMPRESS_DELTA) ? ptrStream->framesSinceKey + 1 : 0;
+    ptrStream->sequence = control & 0x7F;
+    ptrStream->type = ptrPayload[0];
+    ptrStream->length = length;
+    for(i = 0; i < length; i++) {
+        ptrStream->bytes[i] = ptrPayload[i];
+    }
+    ptrStream->valid = 1;
+}
+
+void initialiseBusFrameExpander(tBusFrameExpander *ptrExpander) {
+    unsigned char i;
+    for(i = 0; i < BUS_FRAME_COMPRESSION_STREAMS; i++) {
+        ptrExpander->streams[i].valid = 0;
+    }
+    startBusFrameExpander(ptrExpander);
+}
+
+//At the format header of every compressed frame, whatever happened to the last one
+void startBusFrameExpander(tBusFrameExpander *ptrExpander) {
+    ptrExpander->ptrStream = 0;
+    ptrExpander->status = BUS_FRAME_EXPAND_OK;
+    ptrExpander->headerPosition = 0;
+    ptrExpander->length = 0;
+    ptrExpander->produced = 0;
+    ptrExpander->literalRemaining = 0;
+    ptrExpander->repeatCount = 0;
+    ptrExpander->pendingCount = 0;
+}
+
+//Next byte of the compressed payload. Whatever it expands to has to be taken with takeExpandedByte before the next one goes in. A problem is only reported the once
+eBusFrameExpandStatus putCompressedByte(tBusFrameExpander *ptrExpander, unsigned char byte) {
+    if(ptrExpander->status != BUS_FRAME_EXPAND_OK) {
+        return BUS_FRAME_EXPAND_OK;
+    }
+    switch(ptrExpander->headerPosition) {
+        case 0:
+            ptrExpander->control = byte;
+            ptrExpander->headerPosition = 1;
+            return BUS_FRAME_EXPAND_OK;
+        case 1:
+            ptrExpander->type = byte;
+            ptrExpander->headerPosition = 2;
+            return BUS_FRAME_EXPAND_OK;
+        case 2:
+            if(byte & 0x80) {
+                ptrExpander->length = (unsigned int)(byte & 0x7F) << 8;
+                ptrExpander->headerPosition = 3;
+                return BUS_FRAME_EXPAND_OK;
+            }
+            ptrExpander->length = byte;
+            break;
+        case 3:
+            ptrExpander->length |= byte;
+            break;
+        default:
+            ptrExpander->status = putCompressedToken(ptrExpander, byte);
+            return ptrExpander->status;
+    }
+    ptrExpander->headerPosition = 4;
+    ptrExpander->status = beginExpandedFrame(ptrExpander);
+    return ptrExpander->status;
+}
+
+unsigned char takeExpandedByte(tBusFrameExpander *ptrExpander, unsigned char *ptrByte) {
+    unsigned char value;
+    if(ptrExpander->pendingCount == 0) {
+        return 0;
+    }
+    value = ptrExpander->pendingValue;
+    if((ptrExpander->control & BUS_FRAME_COMPRESS_DELTA) && ptrExpander->produced) {
+        value ^= ptrExpander->ptrStream->bytes[ptrExpander->produced];
+    }
+    ptrExpander->staging[ptrExpander->produced++] = value;
+    ptrExpander->pendingCount--;
+    *ptrByte = value;
+    return 1;
+}
+
+//At the end of the frame, after its CRCs have passed. A whole payload becomes the stream's new reference, otherwise it's what went wrong
+eBusFrameExpandStatus finishBusFrameExpander(tBusFrameExpander *ptrExpander) {
+    if(ptrExpander->status != BUS_FRAME_EXPAND_OK) {
+        return ptrExpander->status;
+    }
+    if(ptrExpander->headerPosition < 4 || ptrExpander->produced != ptrExpander->length || ptrExpander->literalRemaining || ptrExpander->repeatCount) {
+        return BUS_FRAME_EXPAND_INVALID;
+    }
+    commitBusFrameReference(ptrExpander->ptrStream, ptrExpander->control, &ptrExpander->staging[0], ptrExpander->length);
+    return BUS_FRAME_EXPAND_OK;
+}
+
+//Header's in: check a delta has the frame it was made against, then the message type is the first byte out
+eBusFrameExpandStatus beginExpandedFrame(tBusFrameExpander *ptrExpander) {
+    tBusFrameCompressStream *ptrStream;
+    if(ptrExpander->length == 0 || ptrExpander->length > BUS_FRAME_COMPRESSION_MAX_REFERENCE) {
+        return BUS_FRAME_EXPAND_INVALID;
+    }
+    ptrStream = &ptrExpander->streams[ptrExpander->type % BUS_FRAME_COMPRESSION_STREAMS];
+    if((ptrExpander->control & BUS_FRAME_COMPRESS_DELTA) &&
+            (!ptrStream->valid || ptrStream->type != ptrExpander->type || ptrStream->length != ptrExpander->length ||
+            (ptrExpander->control & 0x7F) != ((ptrStream->sequence + 1) & 0x7F))) {
+        //A frame of this stream went missing, every delta is useless until the next whole one
+        ptrStream->valid = 0;
+        return BUS_FRAME_EXPAND_REFERENCE;
+    }
+    ptrExpander->ptrStream = ptrStream;
+    ptrExpander->pendingValue = ptrExpander->type;
+    ptrExpander->pendingCount = 1;
+    return BUS_FRAME_EXPAND_OK;
+}
+
+eBusFrameExpandStatus putCompressedToken(tBusFrameExpander *ptrExpander, unsigned char byte) {
+    if(ptrExpander->produced >= ptrExpander->length) {
+        return BUS_FRAME_EXPAND_OK; //Block padding
+    }
+    if(ptrExpander->repeatCount) {
+        ptrExpander->pendingValue = byte;
+        ptrExpander->pendingCount = ptrExpander->repeatCount;
+        ptrExpander->repeatCount = 0;
+    } else if(ptrExpander->literalRemaining) {
+        ptrExpander->pendingValue = byte;
+        ptrExpander->pendingCount = 1;
+        ptrExpander->literalRemaining--;
+    } else if(byte < BUS_FRAME_COMPRESS_ZERO_RUN) {
+        ptrExpander->literalRemaining = byte + 1;
+        return BUS_FRAME_EXPAND_OK;
+    } else if(byte < BUS_FRAME_COMPRESS_REPEAT_RUN) {
+        ptrExpander->pendingValue = 0;
+        ptrExpander->pendingCount = (byte & 0x3F) + 1;
+    } else {
+        ptrExpander->repeatCount = (byte & 0x3F) + 2;
+        return BUS_FRAME_EXPAND_OK;
+    }
+    if(ptrExpander->produced + ptrExpander->pendingCount > ptrExpander->length) {
+        ptrExpander->pendingCount = 0;
+        return BUS_FRAME_EXPAND_INVALID;
+    }
+    return BUS_FRAME_EXPAND_OK;
+}
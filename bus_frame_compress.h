@@ -0,0 +1,14 @@
+#ifndef BUS_FRAME_COMPRESS_H
+#define	BUS_FRAME_COMPRESS_H
+
+#include "bus_frame_compress_types.h"
+
+extern unsigned int compressBusFramePayload(tBusFrameCompressStream *ptrStream, const unsigned char *ptrPayload, unsigned int length, unsigned char *ptrOutput, unsigned int outputSize);
+extern void commitBusFrameReference(tBusFrameCompressStream *ptrStream, unsigned char control, const unsigned char *ptrPayload, unsigned int length);
+extern void initialiseBusFrameExpander(tBusFrameExpander *ptrExpander);
+extern void startBusFrameExpander(tBusFrameExpander *ptrExpander);
+extern eBusFrameExpandStatus putCompressedByte(tBusFrameExpander *ptrExpander, unsigned char byte);
+extern unsigned char takeExpandedByte(tBusFrameExpander *ptrExpander, unsigned char *ptrByte);
+extern eBusFrameExpandStatus finishBusFrameExpander(tBusFrameExpander *ptrExpander);
+
+#endif	/* BUS_FRAME_COMPRESS_H */
@@ -0,0 +1,48 @@
+#ifndef BUS_FRAME_COMPRESS_TYPES_H
+#define	BUS_FRAME_COMPRESS_TYPES_H
+
+#include "bus_frame_details.h"
+
+#define BUS_FRAME_COMPRESS_DELTA        0x80 //Control byte, the low 7 bits are the stream sequence
+#define BUS_FRAME_COMPRESS_ZERO_RUN     0x80 //Tokens: 0x00-0x7F literal of t+1 bytes, 0x80-0xBF t-0x7F zeros, 0xC0-0xFF value byte follows, repeated t-0xBE times
+#define BUS_FRAME_COMPRESS_REPEAT_RUN   0xC0
+#define BUS_FRAME_COMPRESS_MAX_LITERAL  128
+#define BUS_FRAME_COMPRESS_MAX_ZEROS    64
+#define BUS_FRAME_COMPRESS_MAX_REPEAT   65
+//Worst case, a payload with no runs at all: 4 header bytes and a literal token per 128 bytes
+#define BUS_FRAME_COMPRESS_MAX_OUTPUT   (BUS_FRAME_COMPRESSION_MAX_REFERENCE + 4 + (BUS_FRAME_COMPRESSION_MAX_REFERENCE / BUS_FRAME_COMPRESS_MAX_LITERAL) + 1)
+
+typedef enum {
+    BUS_FRAME_EXPAND_OK = 0,
+    BUS_FRAME_EXPAND_REFERENCE, //Delta against a frame this end never got
+    BUS_FRAME_EXPAND_INVALID
+} eBusFrameExpandStatus;
+
+//Last compressed frame of one message type, both ends keep the same copy
+typedef struct {
+    unsigned char valid;
+    unsigned char type;
+    unsigned char sequence;
+    unsigned char framesSinceKey;
+    unsigned int length;
+    unsigned char bytes[BUS_FRAME_COMPRESSION_MAX_REFERENCE];
+} tBusFrameCompressStream;
+
+//Receive side, fed the compressed payload a byte at a time as blocks are demasked
+typedef struct {
+    tBusFrameCompressStream streams[BUS_FRAME_COMPRESSION_STREAMS];
+    tBusFrameCompressStream *ptrStream;
+    unsigned char staging[BUS_FRAME_COMPRESSION_MAX_REFERENCE];
+    eBusFrameExpandStatus status; //First thing that went wrong with this frame, the rest of it is ignored
+    unsigned char headerPosition;
+    unsigned char control;
+    unsigned char type;
+    unsigned int length;
+    unsigned int produced;
+    unsigned char literalRemaining;
+    unsigned char repeatCount;
+    unsigned char pendingCount;
+    unsigned char pendingValue;
+} tBusFrameExpander;
+
+#endif	/* BUS_FRAME_COMPRESS_TYPES_H */
@@ -0,0 +1,178 @@
+/*
+ * File:   bus_frame_crc.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 10:02
+ */
+
+#include "../global.h"
+#include "../crc.h"
+#include "bus_frame_details.h"
+#include "bus_frame_crc.h"
+
+#define BLOCK_DATA_BYTES    6
+#define BLOCK_SIZE          8
+#define BLOCK_DATA_OFFSET   2
+#define FRAME_CRC_POLY      0x1021 //CRC-16/CCITT, seeded with BUS_FRAME_CRC16_INIT
+
+void initialiseBusFrameCrc(void);
+unsigned char calculateBlockCrc(unsigned char *ptrData);
+void calculateBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount);
+unsigned int countGoodBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount);
+unsigned int updateFrameCrc(unsigned int crc, unsigned char byte);
+
+#if BUS_FRAME_CRC_TABLE
+/*
+ * The tables are built once, by whichever caller gets there first: every
+ * function here checks they're ready, so the stateless encode and span
+ * paths work without a context ever being initialised. With C11 atomics
+ * (hosts, where contexts start on several threads) the first caller claims
+ * the build and the rest wait for it to publish; without them (the PIC, one
+ * thread) a plain flag does.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__) && !defined(__XC8)
+#include <stdatomic.h>
+#define CRC_TABLE_ATOMIC 1
+#else
+#define CRC_TABLE_ATOMIC 0
+#endif
+
+#define CRC_TABLE_EMPTY     0
+#define CRC_TABLE_BUILDING  1
+#define CRC_TABLE_READY     2
+
+/*
+ * Any CRC (whatever its polynomial, init, reflection or final xor) is affine
+ * over GF(2) for a fixed message length, so the CRC of a 6 byte block is the
+ * CRC of an all-zero block xor'd with one contribution per byte position.
+ * The contributions are worked out from calculateCrc itself, so the tables
+ * always agree with whatever ../crc.h implements.
+ */
+unsigned char blockCrcTable[BLOCK_DATA_BYTES][256];
+unsigned char blockCrcZero;
+unsigned int frameCrcTable[256];
+#if CRC_TABLE_ATOMIC
+atomic_uchar blockCrcTableState = CRC_TABLE_EMPTY;
+#define CRC_TABLE_IS_READY()    (atomic_load_explicit(&blockCrcTableState, memory_order_acquire) == CRC_TABLE_READY)
+#else
+volatile unsigned char blockCrcTableState = CRC_TABLE_EMPTY;
+#define CRC_TABLE_IS_READY()    (blockCrcTableState == CRC_TABLE_READY)
+#endif
+
+#define LOOKUP_BLOCK_CRC(ptrData) (blockCrcZero ^ \
+        blockCrcTable[0][(ptrData)[0]] ^ \
+        blockCrcTable[1][(ptrData)[1]] ^ \
+        blockCrcTable[2][(ptrData)[2]] ^ \
+        blockCrcTable[3][(ptrData)[3]] ^ \
+        blockCrcTable[4][(ptrData)[4]] ^ \
+        blockCrcTable[5][(ptrData)[5]])
+
+void buildBusFrameCrcTables(void);
+
+void buildBusFrameCrcTables(void) {
+    unsigned char probe[BLOCK_DATA_BYTES];
+    unsigned char position;
+    unsigned char bit;
+    unsigned int value;
+    unsigned int crc;
+
+    for(value = 0; value < 256; value++) {
+        crc = value << 8;
+        for(bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ FRAME_CRC_POLY : crc << 1;
+        }
+        frameCrcTable[value] = crc & 0xFFFF;
+    }
+    for(position = 0; position < BLOCK_DATA_BYTES; position++) {
+        probe[position] = 0;
+    }
+    blockCrcZero = calculateCrc(&probe[0], BLOCK_DATA_BYTES);
+    for(position = 0; position < BLOCK_DATA_BYTES; position++) {
+        blockCrcTable[position][0] = 0;
+        for(bit = 0; bit < 8; bit++) {
+            probe[position] = 1 << bit;
+            blockCrcTable[position][1 << bit] = calculateCrc(&probe[0], BLOCK_DATA_BYTES) ^ blockCrcZero;
+        }
+        probe[position] = 0;
+        for(value = 3; value < 256; value++) {
+            //Lowest set bit xor the rest, both of which are already filled in
+            blockCrcTable[position][value] = blockCrcTable[position][value & (value - 1)] ^ blockCrcTable[position][value & (0 - value)];
+        }
+    }
+}
+
+void initialiseBusFrameCrc(void) {
+#if CRC_TABLE_ATOMIC
+    unsigned char expected = CRC_TABLE_EMPTY;
+#endif
+
+    if(CRC_TABLE_IS_READY()) {
+        return;
+    }
+#if CRC_TABLE_ATOMIC
+    if(atomic_compare_exchange_strong_explicit(&blockCrcTableState, &expected, CRC_TABLE_BUILDING, memory_order_acquire, memory_order_acquire)) {
+        buildBusFrameCrcTables();
+        atomic_store_explicit(&blockCrcTableState, CRC_TABLE_READY, memory_order_release);
+    }
+    //Another thread got in first, it's a few microseconds of work
+    while(!CRC_TABLE_IS_READY()) {
+    }
+#else
+    buildBusFrameCrcTables();
+    blockCrcTableState = CRC_TABLE_READY;
+#endif
+}
+
+unsigned char calculateBlockCrc(unsigned char *ptrData) {
+    if(!CRC_TABLE_IS_READY()) {
+        initialiseBusFrameCrc();
+    }
+    return LOOKUP_BLOCK_CRC(ptrData);
+}
+
+unsigned int updateFrameCrc(unsigned int crc, unsigned char byte) {
+    if(!CRC_TABLE_IS_READY()) {
+        initialiseBusFrameCrc();
+    }
+    return ((crc << 8) ^ frameCrcTable[((crc >> 8) ^ byte) & 0xFF]) & 0xFFFF;
+}
+#else
+#define LOOKUP_BLOCK_CRC(ptrData) calculateCrc((ptrData), BLOCK_DATA_BYTES)
+
+void initialiseBusFrameCrc(void) {
+}
+
+unsigned char calculateBlockCrc(unsigned char *ptrData) {
+    return calculateCrc(ptrData, BLOCK_DATA_BYTES);
+}
+
+unsigned int updateFrameCrc(unsigned int crc, unsigned char byte) {
+    unsigned char bit;
+    crc ^= (unsigned int)byte << 8;
+    for(bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ FRAME_CRC_POLY : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
+#endif
+
+//ptrBlocks is a run of 8 byte wire blocks (mask, crc, 6 masked data bytes), fills in the crc byte of each
+void calculateBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount) {
+    initialiseBusFrameCrc();
+    while(blockCount > 0) {
+        ptrBlocks[1] = LOOKUP_BLOCK_CRC(ptrBlocks + BLOCK_DATA_OFFSET);
+        ptrBlocks += BLOCK_SIZE;
+        blockCount--;
+    }
+}
+
+//Blocks at the start of the run whose crc byte checks out
+unsigned int countGoodBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount) {
+    unsigned int good = 0;
+    initialiseBusFrameCrc();
+    while(good < blockCount && LOOKUP_BLOCK_CRC(ptrBlocks + BLOCK_DATA_OFFSET) == ptrBlocks[1]) {
+        ptrBlocks += BLOCK_SIZE;
+        good++;
+    }
+    return good;
+}
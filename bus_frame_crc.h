@@ -0,0 +1,10 @@
+#ifndef BUS_FRAME_CRC_H
+#define	BUS_FRAME_CRC_H
+
+extern void initialiseBusFrameCrc(void);
+extern unsigned char calculateBlockCrc(unsigned char *ptrData);
+extern void calculateBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount);
+extern unsigned int countGoodBlockCrcs(unsigned char *ptrBlocks, unsigned int blockCount);
+extern unsigned int updateFrameCrc(unsigned int crc, unsigned char byte);
+
+#endif	/* BUS_FRAME_CRC_H */
@@ -1,15 +1,149 @@
 #ifndef BUS_FRAME_DETAILS_H
 #define	BUS_FRAME_DETAILS_H
 
-#define MAX_FRAME_SIZE 4 + MAX_PAYLOAD
-#define MAX_PAYLOAD 15 * 8
-#define MAX_UNPACKED_PAYLOAD 15 * 6
+#define MAX_FRAME_SIZE (4 + MAX_PAYLOAD)
+#define MAX_PAYLOAD (15 * 8)
+#define MAX_UNPACKED_PAYLOAD (15 * 6)
 
+//Jumbo frames: SC1/SC2 carry a block count of 0 and are followed by a format byte and a 14 bit block count (two 7 bit bytes)
+#define BUS_FRAME_FORMAT_JUMBO 0x01
+//Dense frames (always jumbo): the count is the payload length, packed 7 bytes + their gathered top bits per group, then a 16 bit frame CRC as 2+7+7 bits
+#define BUS_FRAME_FORMAT_DENSE 0x02
+#define BUS_FRAME_FORMAT_KNOWN (BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_DENSE)
+#define BUS_FRAME_DENSE_GROUP_BYTES 7
+#define BUS_FRAME_CRC16_INIT 0xFFFF
+#ifndef BUS_FRAME_JUMBO_MAX_BLOCKS
+#define BUS_FRAME_JUMBO_MAX_BLOCKS 1024 //Up to 0x3FFF, frames longer than this are refused by both ends
+#endif
+#define MAX_JUMBO_UNPACKED_PAYLOAD (BUS_FRAME_JUMBO_MAX_BLOCKS * 6)
+#define MAX_JUMBO_FRAME_SIZE (4 + 3 + BUS_FRAME_JUMBO_MAX_BLOCKS * 8)
+//1 = the writer takes payloads past MAX_UNPACKED_PAYLOAD and sends them as jumbo frames, 0 = it refuses them like a legacy writer, so a default receiver never gets a frame it has no room for
+#ifndef BUS_FRAME_JUMBO_ENABLED
+#define BUS_FRAME_JUMBO_ENABLED 0
+#endif
+
+//Selective repeat: block frames go out jumbo with a 7 bit sequence byte after the count, the receiver ACKs/NACKs by block index and only bad blocks are resent
+#define BUS_FRAME_FORMAT_ACK_REQUEST 0x04
+//Repair frame: replacement blocks for the NACKed indexes of the held frame, lowest index first
+#define BUS_FRAME_FORMAT_REPAIR 0x08
+//Feedback frame: count of bad block indexes (0 = ACK) and the sequence, the indexes as 7+7 bits, then a frame CRC like dense
+#define BUS_FRAME_FORMAT_FEEDBACK 0x10
+#define BUS_FRAME_FORMAT_REPAIR_FLAGS (BUS_FRAME_FORMAT_ACK_REQUEST | BUS_FRAME_FORMAT_REPAIR | BUS_FRAME_FORMAT_FEEDBACK)
+#ifndef BUS_FRAME_REPAIR_ENABLED
+#define BUS_FRAME_REPAIR_ENABLED 0
+#endif
+#ifndef BUS_FRAME_REPAIR_MAX_BLOCKS
+#define BUS_FRAME_REPAIR_MAX_BLOCKS 15 //Both ends keep a copy this big, longer frames go out unacknowledged
+#endif
+#define BUS_FRAME_REPAIR_BITMAP_BYTES ((BUS_FRAME_REPAIR_MAX_BLOCKS + 7) / 8)
+#define BUS_FRAME_REPAIR_BIT(ptrBitmap, index) ((ptrBitmap)[(index) >> 3] & (1 << ((index) & 7)))
+#ifndef BUS_FRAME_REPAIR_MAX_ROUNDS
+#define BUS_FRAME_REPAIR_MAX_ROUNDS 3
+#endif
+#ifndef BUS_FRAME_REPAIR_WAIT_STEPS
+#define BUS_FRAME_REPAIR_WAIT_STEPS 50000 //Writer steps to wait for feedback before leaving the frame to the application
+#endif
+#ifndef BUS_FRAME_REPAIR_WAIT_TICKS
+#define BUS_FRAME_REPAIR_WAIT_TICKS 0 //Non-zero = with a writer clock, wait this many ticks instead of steps, so a loop that sleeps between steps still gives up
+#endif
+
+//Compressed frame (always jumbo, blocks or dense): control byte (delta bit + 7 bit stream sequence), message type, payload length, then zero/repeat/literal tokens over the rest of the payload, XORed with the last frame of that type for delta frames
+#define BUS_FRAME_FORMAT_COMPRESSED 0x20
+#ifndef BUS_FRAME_COMPRESSION_ENABLED
+#define BUS_FRAME_COMPRESSION_ENABLED 0
+#endif
+#ifndef BUS_FRAME_COMPRESSION_STREAMS
+#define BUS_FRAME_COMPRESSION_STREAMS 4 //Reference frames kept by each end, message type % this picks the slot
+#endif
+#ifndef BUS_FRAME_COMPRESSION_MAX_REFERENCE
+#define BUS_FRAME_COMPRESSION_MAX_REFERENCE 32 //Longest payload that's compressed, longer frames go out as they are
+#endif
+#ifndef BUS_FRAME_COMPRESSION_KEY_INTERVAL
+#define BUS_FRAME_COMPRESSION_KEY_INTERVAL 16 //Every this many frames of a stream is sent whole, so a lost frame only costs the deltas up to the next one
+#endif
+
+#if BUS_FRAME_JUMBO_ENABLED
+#define FRAME_WRITER_MAX_PAYLOAD MAX_JUMBO_UNPACKED_PAYLOAD
+#define APPLICATION_BUFFER_SIZE MAX_JUMBO_UNPACKED_PAYLOAD
+#define SEND_BUFFER_SIZE MAX_JUMBO_FRAME_SIZE
+#else
+#define FRAME_WRITER_MAX_PAYLOAD MAX_UNPACKED_PAYLOAD
 #define APPLICATION_BUFFER_SIZE MAX_UNPACKED_PAYLOAD
 #define SEND_BUFFER_SIZE MAX_FRAME_SIZE
+#endif
 #define UART_BUFFER_SIZE 64
 #define BUS_TX_BUFFER_SIZE MAX_FRAME_SIZE
 #define HANDLER_INBOUND_BUFFER_SIZE MAX_FRAME_SIZE
+#ifndef HANDLER_INBOUND_RING_SIZE
+#define HANDLER_INBOUND_RING_SIZE 128 //Power of two, at least HANDLER_INBOUND_BUFFER_SIZE
+#endif
+//Raise to queue jumbo frames (BUS_FRAME_JUMBO_ENABLED), the whole payload sits here until it's sent
+#ifndef FRAME_WRITER_PROCESS_BUFFER_SIZE
 #define FRAME_WRITER_PROCESS_BUFFER_SIZE MAX_FRAME_SIZE
+#endif
+//0 = handler waits for the application listener after every frame, otherwise finished frames queue up as descriptors for popDecodedFrame
+#ifndef HANDLER_DECODED_QUEUE_SIZE
+#define HANDLER_DECODED_QUEUE_SIZE 0
+#endif
+//1 = decoded frames can be routed by their first payload byte to registered callbacks (256 entry table per bus)
+#ifndef HANDLER_DISPATCH_ENABLED
+#define HANDLER_DISPATCH_ENABLED 0
+#endif
+#ifndef HANDLER_DISPATCH_STAGING_SIZE
+#define HANDLER_DISPATCH_STAGING_SIZE MAX_UNPACKED_PAYLOAD //Bigger frames of a subscribed type go to the application buffer instead
+#endif
+#ifndef FRAME_WRITER_MAX_QUEUED_FRAMES
+#define FRAME_WRITER_MAX_QUEUED_FRAMES 16 //Per priority lane
+#endif
+//1 = the writer gets a control lane next to the bulk one, its frames go out at the next frame boundary ahead of queued bulk frames
+#ifndef FRAME_WRITER_PRIORITY_ENABLED
+#define FRAME_WRITER_PRIORITY_ENABLED 0
+#endif
+#ifndef FRAME_WRITER_CONTROL_BUFFER_SIZE
+#define FRAME_WRITER_CONTROL_BUFFER_SIZE MAX_FRAME_SIZE //Control lane's process buffer, the bulk lane has FRAME_WRITER_PROCESS_BUFFER_SIZE
+#endif
+
+//1 = per-position lookup tables for block CRCs (1.5KB RAM), 0 = bitwise calculateCrc
+#ifndef BUS_FRAME_CRC_TABLE
+#define BUS_FRAME_CRC_TABLE 0
+#endif
+
+//1 = mask/demask blocks 6 bytes at a time in a 64 bit word (hosts), 0 = byte loop
+#ifndef BUS_FRAME_BLOCK_SWAR
+#define BUS_FRAME_BLOCK_SWAR 0
+#endif
+
+//1 = keep per-bus frame/error/byte counters on the hot path, 0 = compiled out
+#ifndef BUS_FRAME_STATS_ENABLED
+#define BUS_FRAME_STATS_ENABLED 0
+#endif
+
+//1 = putBytesForHandling hands every accepted chunk to a registered capture hook before decoding
+#ifndef BUS_FRAME_CAPTURE_ENABLED
+#define BUS_FRAME_CAPTURE_ENABLED 0
+#endif
+
+//1 = handler/writer state transitions go into a registered trace ring (bus_frame_trace.h), 0 = compiled out
+#ifndef BUS_FRAME_TRACE_ENABLED
+#define BUS_FRAME_TRACE_ENABLED 0
+#endif
+#ifndef BUS_FRAME_TRACE_SIZE
+#define BUS_FRAME_TRACE_SIZE 32 //Events, about 12 bytes each on the PIC
+#endif
+#ifndef BUS_FRAME_TRACE_BYTES
+#define BUS_FRAME_TRACE_BYTES 0 //1 = also trace the handler's per-byte WAIT_FOR_BYTES/GET_BYTES/HANDLE_BLOCK churn
+#endif
+
+//1 = handler/writer call a registered wake hook whenever something outside a step unblocks them, so a host loop can sleep between steps
+#ifndef BUS_FRAME_WAKE_HOOKS_ENABLED
+#define BUS_FRAME_WAKE_HOOKS_ENABLED 0
+#endif
+
+//Breakpoint spots on the PIC, nothing on a host build
+#ifdef __XC8
+#define BUS_FRAME_NOP() asm("nop")
+#else
+#define BUS_FRAME_NOP()
+#endif
 
 #endif	/* BUS_FRAME_DETAILS_H */
@@ -11,6 +11,14 @@
 #include "../ring-buffer/ring_buffer.h"
 #include "bus_frame_details.h"
 #include "bus_frame_handler_status.h"
+#include "bus_frame_handler.h"
+#include "bus_frame_writer.h"
+#include "bus_frame_crc.h"
+#include "bus_frame_block.h"
+#include "bus_frame_stats.h"
+#include "bus_inbound_ring.h"
+#include "bus_frame_trace.h"
+#include "bus_frame_compress.h"
 
 #define WRITE_OUT_MAX_RETRIES   8
 
@@ -20,16 +28,19 @@
 #define MARKERS_IN_PREFINISH    7
 #define MARKERS_FINISHED        15
 
-typedef enum {
-    BUS_HANDLER_NONE = 0,
-    BUS_HANDLER_WAIT_FOR_BYTES,
-    BUS_HANDLER_GET_BYTES,
-    BUS_HANDLER_HANDLE_BLOCK,
-    BUS_HANDLER_CHECK_FINAL,
-    BUS_HANDLER_WAIT_PROCESSED,
-    BUS_HANDLER_COMPLETE_RESET,
-    BUS_HANDLER_PROCESS_ERROR
-} eBusHandlerStates;
+#define SPAN_RUN_BLOCKS         15 //Whole blocks the span decoder checks and demasks in one go
+
+#if BUS_FRAME_REPAIR_ENABLED
+#define FORMAT_FLAGS_REPAIR     BUS_FRAME_FORMAT_REPAIR_FLAGS
+#else
+#define FORMAT_FLAGS_REPAIR     0
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+#define FORMAT_FLAGS_COMPRESSION BUS_FRAME_FORMAT_COMPRESSED
+#else
+#define FORMAT_FLAGS_COMPRESSION 0
+#endif
+#define FORMAT_FLAGS_ACCEPTED   (BUS_FRAME_FORMAT_KNOWN | FORMAT_FLAGS_REPAIR | FORMAT_FLAGS_COMPRESSION)
 
 typedef enum {
     BUS_HANDLE_NONE = 0,
@@ -37,212 +48,434 @@ typedef enum {
     BUS_HANDLE_OPERATION_OK
 } eBusHandleOperationStatus;
 
-typedef struct {
-    unsigned char mask;
-    unsigned char crc;
-    unsigned char payloadBytes[6];
-} tBlock;
-
-typedef union {
-    tBlock block;
-    unsigned char bytes[8];
-} tBrokenOutBlock;
-
-typedef union {
-    struct {
-        unsigned preStart:1;
-        unsigned started:1;
-        unsigned preFinish:1;
-        unsigned finished:1;
-    };
-    unsigned char markerByte;
-} tBusHandlerMarkerFlags;
-
-typedef enum {
-    BHE_NONE,
-    BHE_LISTENER_NOT_REGISTERED,
-    BHE_WRITE_OUT_FAILED,
-    BHE_GET_FOR_WRITE_OUT_FAILED,
-    BHE_OUT_OF_BOUNDS_BLOCK,
-    BHE_TOO_MANY_STUFF,
-    BHE_SC1_WITHOUT_SC2,
-    BHE_ALREADY_IN_BLOCK,
-    BHE_I_SHOULDNT_BE_HERE,
-    BHE_INVALID_B2F_IN_EC2,
-    BHE_INVALID_B2F_IN_EC1,
-    BHE_INVALID_B2F_IN_SC2,
-    BHE_OUT_OF_POS_SC2,
-    BHE_GOALPOST_OR_MASK_NOT_RECEIVED,
-    BHE_GOALPOST_NOT_RECEIVED,
-    BHE_MASK_NOT_RECEIVED
-} eBusFrameHandlerError;
-
-typedef enum {
-    BLOCK_PHASE_NONE,
-    BLOCK_BEGIN_BLOCK,
-    BLOCK_CHECK_CRC,
-    BLOCK_DEMASK,
-    BLOCK_WAIT_ACKNOWLEDGE,
-    BLOCK_FAIL_CRC_RESET,
-} eBlockPhase;
-
-eBlockPhase blockPhase;
-tBrokenOutBlock workingBlock;
-eBusFrameHandlerError busHandlerError;
-tBusHandlerMarkerFlags busHandlerMarkerFlags;
-tBuffer *ptrApplicationBuffer;
-eBusHandlerStates busHandlerState;
-eBufferOperationStatus bufferOpStatus;
-tBuffer busHandleInboundBuffer;
-
-extern unsigned int uartTotal;
-unsigned char *ptrApplicationListener;
-unsigned char bhErrorCtx = 0x00;
-unsigned char tempBytes[20];
-unsigned char cc;
-unsigned char frameBytes;
-unsigned char expectedFrameBytes;
-unsigned char recount;
-unsigned char blockCount;
-unsigned char expectedBlocksToFollow;
-unsigned char blockPosition;
-unsigned int outputByteCount;
-unsigned int success;
-unsigned char dummyListener;
-unsigned char dataReady;
-unsigned char dataRequest;
-unsigned char busHandleInboundBufferArray[HANDLER_INBOUND_BUFFER_SIZE]; //(15 blocks * 8 bytes) + (SC1,SC2,EC1,EC2) + (4 spare)
-unsigned char blockProceed;
-unsigned char handlingComplete;
-unsigned char handleByte;
-
-unsigned char frameByte[29];
+tBusFrameHandlerCtx defaultBusFrameHandler;
+extern tBusFrameWriterCtx defaultBusFrameWriter;
+#if BUS_FRAME_TRACE_ENABLED
+extern tBusFrameTrace defaultBusFrameTrace;
+#endif
 
 void initialiseBusFrameHandler(void);
 void runBusFrameHandler(void);
+unsigned int runBusFrameHandlerBudget(eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget);
 void registerApplicationBuffer(tBuffer *ptrAppBuffer);
 void registerApplicationListener(unsigned char *ptrListener);
 void putByteForHandling(eBusHandlerOperationStatus *ptrStatus, unsigned char byte);
+void putBytesForHandling(eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted);
+void initialiseBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx);
+void runBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx);
+unsigned int runBusFrameHandlerBudgetCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget);
+void registerApplicationBufferCtx(tBusFrameHandlerCtx *ptrCtx, tBuffer *ptrAppBuffer);
+void registerApplicationListenerCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char *ptrListener);
+void putByteForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, unsigned char byte);
+void putBytesForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted);
+unsigned int decodeBusFrameSpan(const unsigned char *ptrBytes, unsigned int length, tBusFrameSpanOutput *ptrOutput);
+unsigned int countSpanBlocks(const unsigned char *ptrBytes, unsigned int length, unsigned int maxBlocks);
+unsigned char popDecodedFrame(tBusDecodedFrame *ptrFrame);
+unsigned char getDecodedFrameCount(void);
+void registerBusFrameDispatch(unsigned char messageType, tBusFrameDispatchHandler handler);
+void setBusFrameEarlyDrop(unsigned char enabled);
+void registerBusFrameDispatchCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char messageType, tBusFrameDispatchHandler handler);
+void setBusFrameEarlyDropCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char enabled);
+unsigned char popDecodedFrameCtx(tBusFrameHandlerCtx *ptrCtx, tBusDecodedFrame *ptrFrame);
+unsigned char getDecodedFrameCountCtx(tBusFrameHandlerCtx *ptrCtx);
+void registerBusFrameRepairWriter(void);
+void registerBusFrameRepairWriterCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWriterCtx *ptrWriter);
+void registerBusFrameCaptureHook(tBusFrameCaptureHook hook);
+void registerBusFrameCaptureHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameCaptureHook hook);
+void registerBusFrameTrace(void);
+void registerBusFrameTraceCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus);
+eBusHandlerWaitReason getBusFrameHandlerWait(void);
+void registerBusFrameHandlerWakeHook(tBusFrameWakeHook hook, void *ptrArgument);
+eBusHandlerWaitReason getBusFrameHandlerWaitCtx(tBusFrameHandlerCtx *ptrCtx);
+void registerBusFrameHandlerWakeHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument);
 
-void handleBlockData(unsigned char handleByte);
-void handleByteSpecial(unsigned char handleByte);
-unsigned char isStarvedOfData(void);
+void handleBlockData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte);
+void handleByteSpecial(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte);
+void handleFormatHeader(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte);
+void handleDenseData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte);
+void handleRepairSequence(tBusFrameHandlerCtx *ptrCtx, unsigned char sequence);
+void handleFeedbackData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte);
+unsigned int getRepairBlockIndex(tBusFrameHandlerCtx *ptrCtx);
+void markRepairBlockMissing(tBusFrameHandlerCtx *ptrCtx);
+void stageRepairBlock(tBusFrameHandlerCtx *ptrCtx);
+unsigned char finishRepairFrame(tBusFrameHandlerCtx *ptrCtx);
+unsigned char isStarvedOfData(tBusFrameHandlerCtx *ptrCtx);
+unsigned char isWaitingForInput(tBusFrameHandlerCtx *ptrCtx);
+unsigned char isDecodedQueueFull(tBusFrameHandlerCtx *ptrCtx);
+void wakeBusFrameHandler(tBusFrameHandlerCtx *ptrCtx);
+unsigned char emitPayloadByte(tBusFrameHandlerCtx *ptrCtx, unsigned char byte);
+unsigned char writePayloadByte(tBusFrameHandlerCtx *ptrCtx, unsigned char byte);
+unsigned int getExpectedPayloadLength(tBusFrameHandlerCtx *ptrCtx);
+void traceHandlerTransitions(tBusFrameHandlerCtx *ptrCtx);
+unsigned char isByteLoopState(eBusHandlerStates state);
 
 unsigned char areMarkersValid(tBusHandlerMarkerFlags flags);
+void raiseBusHandlerError(tBusFrameHandlerCtx *ptrCtx, eBusFrameHandlerError error);
+void snapshotBusFrameHandlerStats(tBusFrameHandlerStats *ptrStats);
+void resetBusFrameHandlerStats(void);
+void snapshotBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameHandlerStats *ptrStats);
+void resetBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx);
 unsigned char calculateCrc(unsigned char *ptrData , unsigned char length);
 
 void initialiseBusFrameHandler(void) {
-    busHandlerState = BUS_HANDLER_NONE;
-    busHandlerError = BHE_NONE;
+    initialiseBusFrameHandlerCtx(&defaultBusFrameHandler);
+}
+
+void runBusFrameHandler(void) {
+    runBusFrameHandlerCtx(&defaultBusFrameHandler);
+}
+
+unsigned int runBusFrameHandlerBudget(eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget) {
+    return runBusFrameHandlerBudgetCtx(&defaultBusFrameHandler, ptrStatus, stepBudget);
+}
+
+void initialiseBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx) {
+#if HANDLER_DISPATCH_ENABLED
+    unsigned int i;
+#endif
+    ptrCtx->busHandlerState = BUS_HANDLER_NONE;
+    ptrCtx->busHandlerError = BHE_NONE;
+    ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+    ptrCtx->busHandlerMarkerFlags.markerByte = MARKERS_NONE;
+    ptrCtx->bhErrorCtx = 0x00;
+    ptrCtx->blockCount = 0;
+    ptrCtx->expectedBlocksToFollow = 0;
+    ptrCtx->frameFormat = 0;
+    ptrCtx->formatHeaderPosition = 0;
+    ptrCtx->blockPosition = 0;
+    ptrCtx->dataReady = 0;
+    ptrCtx->dataRequest = 0;
+    ptrCtx->blockProceed = 0;
+    ptrCtx->reversibleWriteOpen = 0;
+#if HANDLER_DISPATCH_ENABLED
+    for(i = 0; i < 256; i++) {
+        ptrCtx->dispatchTable[i] = 0;
+    }
+    ptrCtx->earlyDrop = 0;
+    ptrCtx->frameRoute = BUS_FRAME_ROUTE_APPLICATION;
+#endif
+#if BUS_FRAME_REPAIR_ENABLED
+    ptrCtx->ptrRepairWriter = 0;
+    ptrCtx->repairHeld = 0;
+#endif
+#if BUS_FRAME_CAPTURE_ENABLED
+    ptrCtx->captureHook = 0;
+#endif
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    ptrCtx->wakeHook = 0;
+    ptrCtx->ptrWakeArgument = 0;
+#endif
+#if BUS_FRAME_TRACE_ENABLED
+    ptrCtx->ptrTrace = 0;
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+    initialiseBusFrameExpander(&ptrCtx->expander);
+#endif
+#if HANDLER_DECODED_QUEUE_SIZE
+    ptrCtx->decodedQueueHead = 0;
+    ptrCtx->decodedQueueTail = 0;
+    ptrCtx->decodedQueueCount = 0;
+    ptrCtx->committedByteCount = 0;
+    ptrCtx->frameSequence = 0;
+#endif
+    resetBusFrameHandlerStatsCtx(ptrCtx);
     //busHandlerFlags.byte = 0;
     
-    ptrApplicationListener = &dummyListener; //Avoid fuckery involving pointers off into space
+    ptrCtx->ptrApplicationListener = &ptrCtx->dummyListener; //Avoid fuckery involving pointers off into space
     
-    initialiseBuffer(&busHandleInboundBuffer, &busHandleInboundBufferArray[0], HANDLER_INBOUND_BUFFER_SIZE);
+    initialiseBusFrameCrc();
+    initialiseBusInboundRing(&ptrCtx->busHandleInboundRing);
 }
 
-void runBusFrameHandler(void) {
-    switch (busHandlerState) {
+void runBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_COMPRESSION_ENABLED
+    eBusFrameExpandStatus expandStatus;
+#endif
+    switch (ptrCtx->busHandlerState) {
         case BUS_HANDLER_NONE:
             //busHandlerFlags.byte = 0;
-            expectedBlocksToFollow = 0;
-            expectedFrameBytes = 0;
-            frameBytes = 0;
-            outputByteCount = 0;
-            handlingComplete = 0;
-            busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;
+            ptrCtx->frameBytes = 0;
+            ptrCtx->outputByteCount = 0;
+            ptrCtx->handlingComplete = 0;
+            ptrCtx->busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;
             break;
             
         case BUS_HANDLER_WAIT_FOR_BYTES:
-            if(!isEmpty(&busHandleInboundBuffer)) {  
-                busHandlerState = BUS_HANDLER_GET_BYTES;  
+            if(!isBusInboundRingEmpty(&ptrCtx->busHandleInboundRing)) {  
+                ptrCtx->busHandlerState = BUS_HANDLER_GET_BYTES;  
             }
             break;
             
         case BUS_HANDLER_GET_BYTES:
-            if(dataReady == 0) {
-                bufferOpStatus = BUFFER_OPERATION_NONE;
-                getByte(&busHandleInboundBuffer, &bufferOpStatus, &handleByte);
-            }
-            if(bufferOpStatus == BUFFER_OPERATION_OK) {
-                dataReady = 1;
-                handleByteSpecial(handleByte);
-                if(dataReady) {
-                    if(busHandlerMarkerFlags.markerByte == MARKERS_STARTED) {
-                        busHandlerState = BUS_HANDLER_HANDLE_BLOCK;  
+            if(ptrCtx->dataReady == 0) {
+                ptrCtx->bufferOpStatus = getBusInboundByte(&ptrCtx->busHandleInboundRing, &ptrCtx->handleByte) ? BUFFER_OPERATION_OK : BUFFER_OPERATION_NONE;
+            }
+            if(ptrCtx->bufferOpStatus == BUFFER_OPERATION_OK) {
+                ptrCtx->dataReady = 1;
+                handleByteSpecial(ptrCtx, ptrCtx->handleByte);
+                if(ptrCtx->dataReady) {
+                    if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_STARTED) {
+                        ptrCtx->busHandlerState = BUS_HANDLER_HANDLE_BLOCK;  
                     } else {
-                        dataReady = 0;
+                        ptrCtx->dataReady = 0;
                     }
                 } else {
-                    if(blockProceed == 0 && busHandlerMarkerFlags.markerByte == MARKERS_FINISHED) {
-                        busHandlerState = BUS_HANDLER_CHECK_FINAL; 
+                    if(ptrCtx->blockProceed == 0 && ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_FINISHED) {
+                        ptrCtx->busHandlerState = BUS_HANDLER_CHECK_FINAL; 
+                    } else if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_FINISHED) {
+                        //Frame ended part way through a block, it can never complete
+                        raiseBusHandlerError(ptrCtx, BHE_ALREADY_IN_BLOCK);
+                    } else if(!areMarkersValid(ptrCtx->busHandlerMarkerFlags)) {
+                        raiseBusHandlerError(ptrCtx, BHE_GOALPOST_NOT_RECEIVED);
                     }
                 }
+                if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_NONE) {
+                    //Not in a frame, nothing to do with this byte but skip ahead to the next SC1
+                    ptrCtx->dataReady = 0;
+                    BUS_STAT_INC(ptrCtx, resyncBytesDiscarded);
+                    ptrCtx->busHandlerState = BUS_HANDLER_RESYNC;
+                }
             }
             break;
             
         case BUS_HANDLER_HANDLE_BLOCK:
-            if(busHandlerMarkerFlags.markerByte == MARKERS_IN_PRESTART) {
-                if(isEmpty(&busHandleInboundBuffer)) {  
-                    busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
+            if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_IN_PRESTART) {
+                if(isBusInboundRingEmpty(&ptrCtx->busHandleInboundRing)) {  
+                    ptrCtx->busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
                 } else {
-                    busHandlerState = BUS_HANDLER_GET_BYTES; 
+                    ptrCtx->busHandlerState = BUS_HANDLER_GET_BYTES; 
                 }
             }
-            if (blockProceed == 2) {
-                blockProceed = 3;
-                busHandlerState = BUS_HANDLER_CHECK_FINAL;  
+            if (ptrCtx->blockProceed == 2) {
+                ptrCtx->blockProceed = 3;
+                ptrCtx->busHandlerState = BUS_HANDLER_CHECK_FINAL;  
             }
-            handleBlockData(handleByte);
+            handleBlockData(ptrCtx, ptrCtx->handleByte);
                     
-            if (dataRequest && !dataReady) {
-                dataRequest = 0;
-                if(isEmpty(&busHandleInboundBuffer)) {  
-                    busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
+            if (ptrCtx->dataRequest && !ptrCtx->dataReady) {
+                ptrCtx->dataRequest = 0;
+                if(isBusInboundRingEmpty(&ptrCtx->busHandleInboundRing)) {  
+                    ptrCtx->busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
                 } else {
-                    busHandlerState = BUS_HANDLER_GET_BYTES; 
+                    ptrCtx->busHandlerState = BUS_HANDLER_GET_BYTES; 
                 }
             }
             break;
             
         case BUS_HANDLER_CHECK_FINAL:
-            if(handlingComplete == 0) {
-                busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
+            if(ptrCtx->handlingComplete == 0) {
+                ptrCtx->busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;  
             }
-            if(busHandlerMarkerFlags.markerByte == MARKERS_FINISHED) {
-                handlingComplete = 1;
-                *ptrApplicationListener = 1;
-                completeReversibleWrite(ptrApplicationBuffer);
-                busHandlerState = BUS_HANDLER_WAIT_PROCESSED; 
+            if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_FINISHED && ptrCtx->blockCount != ptrCtx->expectedBlocksToFollow) {
+                raiseBusHandlerError(ptrCtx, BHE_OUT_OF_BOUNDS_BLOCK);
+                break;
             }
-            if(!areMarkersValid(busHandlerMarkerFlags)) {
-                handlingComplete = 2; //ERROR!!
-                busHandlerState = BUS_HANDLER_PROCESS_ERROR;
+            if(ptrCtx->busHandlerMarkerFlags.markerByte == MARKERS_FINISHED) {
+#if BUS_FRAME_REPAIR_ENABLED
+                if((ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR_FLAGS) && !finishRepairFrame(ptrCtx)) {
+                    break;
+                }
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+                if((ptrCtx->frameFormat & BUS_FRAME_FORMAT_COMPRESSED) && (expandStatus = finishBusFrameExpander(&ptrCtx->expander)) != BUS_FRAME_EXPAND_OK) {
+                    raiseBusHandlerError(ptrCtx, expandStatus == BUS_FRAME_EXPAND_REFERENCE ? BHE_COMPRESSION_REFERENCE : BHE_COMPRESSION_INVALID);
+                    break;
+                }
+#endif
+                ptrCtx->handlingComplete = 1;
+                completeReversibleWrite(ptrCtx->ptrApplicationBuffer);
+                ptrCtx->reversibleWriteOpen = 0;
+                BUS_STAT_INC(ptrCtx, framesDecoded);
+                BUS_STAT_ADD(ptrCtx, bytesOut, ptrCtx->outputByteCount);
+#if HANDLER_DISPATCH_ENABLED
+                if(ptrCtx->frameRoute != BUS_FRAME_ROUTE_APPLICATION) {
+                    //Never went near the application buffer, nothing for the application to wait on
+                    if(ptrCtx->frameRoute == BUS_FRAME_ROUTE_DISPATCH) {
+                        ptrCtx->dispatchTable[ptrCtx->dispatchStaging[0]](ptrCtx->dispatchStaging[0], &ptrCtx->dispatchStaging[0], ptrCtx->outputByteCount);
+                    }
+                    ptrCtx->busHandlerState = BUS_HANDLER_COMPLETE_RESET;
+                    break;
+                }
+#endif
+#if HANDLER_DECODED_QUEUE_SIZE
+                ptrCtx->busHandlerState = BUS_HANDLER_QUEUE_FRAME;
+#else
+                *ptrCtx->ptrApplicationListener = 1;
+                wakeBusFrameHandler(ptrCtx);
+                ptrCtx->busHandlerState = BUS_HANDLER_WAIT_PROCESSED; 
+#endif
+            }
+            if(!areMarkersValid(ptrCtx->busHandlerMarkerFlags)) {
+                ptrCtx->handlingComplete = 2; //ERROR!!
+                raiseBusHandlerError(ptrCtx, BHE_GOALPOST_NOT_RECEIVED);
             }
             break;
             
         case BUS_HANDLER_WAIT_PROCESSED:
-            if(!*ptrApplicationListener) {
-                busHandlerState = BUS_HANDLER_COMPLETE_RESET;
+            if(!*ptrCtx->ptrApplicationListener) {
+                ptrCtx->busHandlerState = BUS_HANDLER_COMPLETE_RESET;
             }
             break;
             
+        case BUS_HANDLER_QUEUE_FRAME:
+            //Hand the frame over as a descriptor and get straight on with the next one, only waits if the queue is full
+#if HANDLER_DECODED_QUEUE_SIZE
+            if(ptrCtx->decodedQueueCount < HANDLER_DECODED_QUEUE_SIZE) {
+                ptrCtx->decodedQueue[ptrCtx->decodedQueueTail].offset = ptrCtx->committedByteCount;
+                ptrCtx->decodedQueue[ptrCtx->decodedQueueTail].length = ptrCtx->outputByteCount;
+                ptrCtx->decodedQueue[ptrCtx->decodedQueueTail].sequence = ptrCtx->frameSequence++;
+                ptrCtx->committedByteCount += ptrCtx->outputByteCount;
+                ptrCtx->decodedQueueTail = (ptrCtx->decodedQueueTail + 1) % HANDLER_DECODED_QUEUE_SIZE;
+                ptrCtx->decodedQueueCount++;
+                *ptrCtx->ptrApplicationListener = 1;
+                wakeBusFrameHandler(ptrCtx);
+                ptrCtx->busHandlerState = BUS_HANDLER_COMPLETE_RESET;
+            }
+#endif
+            break;
+
         case BUS_HANDLER_COMPLETE_RESET:
-            busHandlerMarkerFlags.markerByte = 0;
-            busHandlerState = BUS_HANDLER_NONE;
+            ptrCtx->busHandlerMarkerFlags.markerByte = 0;
+            ptrCtx->busHandlerState = BUS_HANDLER_NONE;
             break;
             
         case BUS_HANDLER_PROCESS_ERROR:
-            reverseWrite(ptrApplicationBuffer);
-            asm("nop");
-            asm("nop");
-            busHandlerState = BUS_HANDLER_COMPLETE_RESET;
+            if(ptrCtx->reversibleWriteOpen) {
+                reverseWrite(ptrCtx->ptrApplicationBuffer);
+                ptrCtx->reversibleWriteOpen = 0;
+                BUS_STAT_INC(ptrCtx, framesDropped);
+            }
+            BUS_FRAME_NOP();
+            BUS_FRAME_NOP();
+            ptrCtx->busHandlerMarkerFlags.markerByte = MARKERS_NONE;
+            ptrCtx->busHandlerState = BUS_HANDLER_RESYNC;
             break;
+
+        case BUS_HANDLER_RESYNC:
+            //Only marker bytes have both top bits set, so drop everything up to the next SC1 in one go
+            ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+            ptrCtx->blockProceed = 0;
+            ptrCtx->dataReady = 0;
+            ptrCtx->dataRequest = 0;
+            do {
+                ptrCtx->bufferOpStatus = getBusInboundByte(&ptrCtx->busHandleInboundRing, &ptrCtx->handleByte) ? BUFFER_OPERATION_OK : BUFFER_OPERATION_NONE;
+                if(ptrCtx->bufferOpStatus != BUFFER_OPERATION_OK) {
+                    break;
+                }
+                if((ptrCtx->handleByte & 0xF0) == 0xC0) {
+                    ptrCtx->frameBytes = 0;
+                    ptrCtx->outputByteCount = 0;
+                    ptrCtx->handlingComplete = 0;
+                    handleByteSpecial(ptrCtx, ptrCtx->handleByte);
+                    ptrCtx->busHandlerState = BUS_HANDLER_WAIT_FOR_BYTES;
+                    break;
+                }
+                BUS_STAT_INC(ptrCtx, resyncBytesDiscarded);
+            } while(1);
+            break;
+    }
+#if BUS_FRAME_TRACE_ENABLED
+    traceHandlerTransitions(ptrCtx);
+#endif
+}
+
+//Keeps stepping until the input runs dry, a decoded frame is waiting on the application or stepBudget runs out. Returns the steps taken
+unsigned int runBusFrameHandlerBudgetCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget) {
+    unsigned int steps = 0;
+    *ptrStatus = BUS_HANDLER_RUN_BUDGET_SPENT;
+    while(steps < stepBudget) {
+        runBusFrameHandlerCtx(ptrCtx);
+        steps++;
+        switch(getBusFrameHandlerWaitCtx(ptrCtx)) {
+            case BUS_HANDLER_BLOCKED_APPLICATION:
+                *ptrStatus = BUS_HANDLER_RUN_WAITING_APPLICATION;
+                return steps;
+            case BUS_HANDLER_BLOCKED_INPUT:
+                *ptrStatus = BUS_HANDLER_RUN_STARVED;
+                return steps;
+            default:
+                break;
+        }
+    }
+    return steps;
+}
+
+//What another step would be waiting on. Anything but BLOCKED_NONE, the loop can sleep until the wake hook fires (or the application clears its listener)
+eBusHandlerWaitReason getBusFrameHandlerWaitCtx(tBusFrameHandlerCtx *ptrCtx) {
+    if((ptrCtx->busHandlerState == BUS_HANDLER_WAIT_PROCESSED && *ptrCtx->ptrApplicationListener) ||
+            (ptrCtx->busHandlerState == BUS_HANDLER_QUEUE_FRAME && isDecodedQueueFull(ptrCtx))) {
+        return BUS_HANDLER_BLOCKED_APPLICATION;
+    }
+    if(isWaitingForInput(ptrCtx)) {
+        return BUS_HANDLER_BLOCKED_INPUT;
+    }
+    return BUS_HANDLER_BLOCKED_NONE;
+}
+
+void raiseBusHandlerError(tBusFrameHandlerCtx *ptrCtx, eBusFrameHandlerError error) {
+    ptrCtx->busHandlerError = error;
+    BUS_STAT_INC(ptrCtx, errorCounts[error]);
+    ptrCtx->busHandlerState = BUS_HANDLER_PROCESS_ERROR;
+}
+
+//Once per step, so each transition is stamped as the step that made it ends
+void traceHandlerTransitions(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_TRACE_ENABLED
+    if(ptrCtx->ptrTrace == 0) {
+        return;
+    }
+    if(ptrCtx->busHandlerMarkerFlags.markerByte != ptrCtx->tracedMarkers) {
+        recordBusFrameTrace(ptrCtx->ptrTrace, BUS_TRACE_MARKERS, ptrCtx->traceBus, ptrCtx->tracedMarkers, ptrCtx->busHandlerMarkerFlags.markerByte, BHE_NONE);
+        ptrCtx->tracedMarkers = ptrCtx->busHandlerMarkerFlags.markerByte;
+    }
+    if(ptrCtx->blockPhase != ptrCtx->tracedPhase) {
+        recordBusFrameTrace(ptrCtx->ptrTrace, BUS_TRACE_BLOCK_PHASE, ptrCtx->traceBus, ptrCtx->tracedPhase, ptrCtx->blockPhase, BHE_NONE);
+        ptrCtx->tracedPhase = ptrCtx->blockPhase;
     }
+    if(ptrCtx->busHandlerState != ptrCtx->tracedState) {
+        if(BUS_FRAME_TRACE_BYTES || !isByteLoopState(ptrCtx->tracedState) || !isByteLoopState(ptrCtx->busHandlerState)) {
+            recordBusFrameTrace(ptrCtx->ptrTrace, BUS_TRACE_HANDLER_STATE, ptrCtx->traceBus, ptrCtx->tracedState, ptrCtx->busHandlerState,
+                    ptrCtx->busHandlerState == BUS_HANDLER_PROCESS_ERROR ? ptrCtx->busHandlerError : BHE_NONE);
+        }
+        ptrCtx->tracedState = ptrCtx->busHandlerState;
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//The states every byte of a frame passes through, tracing them would fill the ring a byte at a time
+unsigned char isByteLoopState(eBusHandlerStates state) {
+    return state == BUS_HANDLER_WAIT_FOR_BYTES || state == BUS_HANDLER_GET_BYTES || state == BUS_HANDLER_HANDLE_BLOCK;
+}
+
+unsigned char isStarvedOfData(tBusFrameHandlerCtx *ptrCtx) {
+    return isBusInboundRingEmpty(&ptrCtx->busHandleInboundRing) && ptrCtx->blockPhase == BLOCK_PHASE_NONE;
+}
+
+unsigned char isDecodedQueueFull(tBusFrameHandlerCtx *ptrCtx) {
+#if HANDLER_DECODED_QUEUE_SIZE
+    return ptrCtx->decodedQueueCount >= HANDLER_DECODED_QUEUE_SIZE;
+#else
+    (void)ptrCtx;
+    return 0;
+#endif
 }
 
-unsigned char isStarvedOfData(void) {
-    return isEmpty(&busHandleInboundBuffer) && blockPhase == BLOCK_PHASE_NONE;
+//True when another step can't get anywhere until more bytes arrive
+unsigned char isWaitingForInput(tBusFrameHandlerCtx *ptrCtx) {
+    if(!isBusInboundRingEmpty(&ptrCtx->busHandleInboundRing)) {
+        return 0;
+    }
+    switch(ptrCtx->busHandlerState) {
+        case BUS_HANDLER_WAIT_FOR_BYTES:
+        case BUS_HANDLER_RESYNC:
+            return 1;
+        case BUS_HANDLER_GET_BYTES:
+            return ptrCtx->dataReady == 0;
+        default:
+            return 0;
+    }
 }
 
 unsigned char areMarkersValid(tBusHandlerMarkerFlags flags) {
@@ -257,121 +490,947 @@ unsigned char areMarkersValid(tBusHandlerMarkerFlags flags) {
     }
 }
 
-void handleByteSpecial(unsigned char handleByte) { 
+void handleByteSpecial(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte) { 
     unsigned char nibbleHi = (handleByte & 0xF0) >> 4;
     unsigned char nibbleLo = handleByte & 0x0F;
     switch(nibbleHi) {
         case 0x0C:
             //StartCode1
-            busHandlerMarkerFlags.markerByte = MARKERS_IN_PRESTART;
-            dataReady = 0;
+            if(ptrCtx->reversibleWriteOpen) {
+                //Previous frame was cut short, don't let its blocks leak into this one
+                reverseWrite(ptrCtx->ptrApplicationBuffer);
+                ptrCtx->reversibleWriteOpen = 0;
+                BUS_STAT_INC(ptrCtx, framesDropped);
+            }
+            ptrCtx->busHandlerMarkerFlags.markerByte = MARKERS_IN_PRESTART;
+            ptrCtx->expectedBlocksToFollow = nibbleLo;
+            ptrCtx->dataReady = 0;
             break;
 
         case 0x0D:
-            busHandlerMarkerFlags.started = 1;
-            startReversibleWrite(ptrApplicationBuffer);
-            blockPhase = BLOCK_PHASE_NONE;
-            blockPosition = 0;
-            dataReady = 0;
+            ptrCtx->dataReady = 0;
+            if(ptrCtx->busHandlerMarkerFlags.markerByte != MARKERS_IN_PRESTART) {
+                raiseBusHandlerError(ptrCtx, BHE_OUT_OF_POS_SC2);
+                break;
+            }
+            ptrCtx->busHandlerMarkerFlags.started = 1;
+            if(ptrCtx->reversibleWriteOpen) {
+                reverseWrite(ptrCtx->ptrApplicationBuffer);
+            }
+            startReversibleWrite(ptrCtx->ptrApplicationBuffer);
+            ptrCtx->reversibleWriteOpen = 1;
+            ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+            ptrCtx->blockPosition = 0;
+            ptrCtx->blockProceed = 0;
+            ptrCtx->blockCount = 0;
+            ptrCtx->frameFormat = 0;
+            //A count of 0 is either an empty frame (EC1 next) or a jumbo frame (format header next)
+            ptrCtx->formatHeaderPosition = nibbleLo == 0 ? 1 : 0;
+#if HANDLER_DISPATCH_ENABLED
+            ptrCtx->frameRoute = BUS_FRAME_ROUTE_APPLICATION;
+#endif
             break;
 
         case 0x0E:
-            busHandlerMarkerFlags.preFinish = 1;
-            dataReady = 0;
+            ptrCtx->busHandlerMarkerFlags.preFinish = 1;
+            ptrCtx->dataReady = 0;
             break;
 
         case 0x0F:
-            busHandlerMarkerFlags.finished = 1;
-            dataReady = 0;
+            ptrCtx->busHandlerMarkerFlags.finished = 1;
+            ptrCtx->dataReady = 0;
             break;
     }
 }
 
-void handleBlockData(unsigned char handleByte) {
+void handleBlockData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte) {
     unsigned char calculatedCrc;
     unsigned char j;
-    switch(blockPhase) {
+    switch(ptrCtx->blockPhase) {
         case BLOCK_PHASE_NONE:
-            blockPhase = BLOCK_BEGIN_BLOCK;
+            ptrCtx->blockPhase = BLOCK_BEGIN_BLOCK;
             break;
         case BLOCK_BEGIN_BLOCK:
-            if(dataReady) {
-                blockProceed = 1;
+            if(ptrCtx->dataReady && ptrCtx->formatHeaderPosition) {
+                handleFormatHeader(ptrCtx, handleByte);
+                break;
+            }
+            if(ptrCtx->dataReady) {
+                if((handleByte & 0b11000000) == 0b10000000 && ptrCtx->blockProceed == 1) {
+                    //New mask before the last block filled, a byte has gone missing
+                    ptrCtx->dataReady = 0;
+                    raiseBusHandlerError(ptrCtx, BHE_GOALPOST_OR_MASK_NOT_RECEIVED);
+                    break;
+                }
+                ptrCtx->blockProceed = 1;
                 if((handleByte & 0b11000000) == 0b10000000) {
-                    blockPosition = 0; //MASK POS RESET
-                    blockCount++;
+                    ptrCtx->blockPosition = 0; //MASK POS RESET
+                    ptrCtx->blockCount++;
                 }
-                workingBlock.bytes[blockPosition] = handleByte;
+                ptrCtx->workingBlock.bytes[ptrCtx->blockPosition] = handleByte;
 
 
-                frameByte[frameBytes++] = handleByte;
-                dataReady = 0;
+                ptrCtx->frameBytes++;
+                ptrCtx->dataReady = 0;
 
-                if(blockPosition == 7) {
-                    blockPhase = BLOCK_CHECK_CRC;
+                if(ptrCtx->blockPosition == 7) {
+                    ptrCtx->blockPhase = BLOCK_CHECK_CRC;
                 } else {
-                    dataRequest = 1;
-                    blockPosition++;
+                    ptrCtx->dataRequest = 1;
+                    ptrCtx->blockPosition++;
                 }
             }
             break;
             
         case BLOCK_CHECK_CRC:
-            calculatedCrc=calculateCrc(&workingBlock.block.payloadBytes[0], 6);
-            if(calculatedCrc == workingBlock.block.crc) {
-                blockPhase = BLOCK_DEMASK;
+            calculatedCrc=calculateBlockCrc(&ptrCtx->workingBlock.block.payloadBytes[0]);
+            if(calculatedCrc == ptrCtx->workingBlock.block.crc) {
+                ptrCtx->blockPhase = BLOCK_DEMASK;
+            } else if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) {
+                //Leave a hole for the sender to fill rather than losing the whole frame
+                BUS_STAT_INC(ptrCtx, crcFailures);
+                markRepairBlockMissing(ptrCtx);
+                ptrCtx->blockProceed = 2;
+                ptrCtx->blockPhase = BLOCK_WAIT_ACKNOWLEDGE;
             } else {
-                blockPhase = BLOCK_FAIL_CRC_RESET;
+                ptrCtx->blockPhase = BLOCK_FAIL_CRC_RESET;
             }
             break;
 
         case BLOCK_DEMASK:
-            for(j = 0; j < 6; j++) {
-                if(workingBlock.block.mask & (1 << j)) {
-                    workingBlock.block.payloadBytes[j] += 0b10000000;
-                }
-                outputByteCount++;
-                bufferOpStatus = BUFFER_OPERATION_NONE;
-                putByte(ptrApplicationBuffer, &bufferOpStatus, workingBlock.block.payloadBytes[j]);
-                if(bufferOpStatus != BUFFER_OPERATION_OK) {
-                    bhErrorCtx = 0x02;
-                    busHandlerState = BUS_HANDLER_PROCESS_ERROR;
-                    break;
+            demaskBlockBytes(&ptrCtx->workingBlock.block.payloadBytes[0], ptrCtx->workingBlock.block.mask);
+            if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) {
+                //Held back until every block is in, repairs land out of order
+                stageRepairBlock(ptrCtx);
+            } else {
+                for(j = 0; j < 6; j++) {
+                    if(!emitPayloadByte(ptrCtx, ptrCtx->workingBlock.block.payloadBytes[j])) {
+                        break;
+                    }
                 }
             }
-            blockProceed = 2;
-            blockPhase = BLOCK_WAIT_ACKNOWLEDGE;
+            ptrCtx->blockProceed = 2;
+            ptrCtx->blockPhase = BLOCK_WAIT_ACKNOWLEDGE;
             break;
             
         case BLOCK_WAIT_ACKNOWLEDGE:
-            if(blockProceed == 3) {
-                blockProceed = 0;
-                blockPhase = BLOCK_BEGIN_BLOCK;
+            if(ptrCtx->blockProceed == 3) {
+                ptrCtx->blockProceed = 0;
+                ptrCtx->blockPhase = BLOCK_BEGIN_BLOCK;
+            }
+            break;
+
+        case BLOCK_DENSE_DATA:
+            if(ptrCtx->dataReady) {
+                handleDenseData(ptrCtx, handleByte);
+            }
+            break;
+
+        case BLOCK_FEEDBACK_DATA:
+            if(ptrCtx->dataReady) {
+                handleFeedbackData(ptrCtx, handleByte);
             }
             break;
 
         case BLOCK_FAIL_CRC_RESET:
-            bhErrorCtx = 0x03;
-            blockPhase = BLOCK_PHASE_NONE;
-            busHandlerState = BUS_HANDLER_PROCESS_ERROR;
+            BUS_STAT_INC(ptrCtx, crcFailures);
+            ptrCtx->bhErrorCtx = 0x03;
+            ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+            raiseBusHandlerError(ptrCtx, BHE_CRC_FAILED);
             break;
     }
 }
 
+//Format byte then block count high and low 7 bits (and a sequence byte in acknowledged mode), straight after SC2 of a 0 count frame
+void handleFormatHeader(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte) {
+    ptrCtx->dataReady = 0;
+    ptrCtx->frameBytes++;
+    if(handleByte & 0b10000000) {
+        raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+        return;
+    }
+    switch(ptrCtx->formatHeaderPosition) {
+        case 1:
+            if(!(handleByte & BUS_FRAME_FORMAT_JUMBO) || (handleByte & ~FORMAT_FLAGS_ACCEPTED)) {
+                raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+                return;
+            }
+            if((handleByte & BUS_FRAME_FORMAT_REPAIR_FLAGS) &&
+                    handleByte != (BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_ACK_REQUEST) &&
+                    handleByte != (BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_ACK_REQUEST | BUS_FRAME_FORMAT_REPAIR) &&
+                    handleByte != (BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_FEEDBACK)) {
+                raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+                return;
+            }
+            ptrCtx->frameFormat = handleByte;
+            ptrCtx->frameCrc = BUS_FRAME_CRC16_INIT;
+#if BUS_FRAME_COMPRESSION_ENABLED
+            if(handleByte & BUS_FRAME_FORMAT_COMPRESSED) {
+                startBusFrameExpander(&ptrCtx->expander);
+            }
+#endif
+            break;
+        case 2:
+            ptrCtx->expectedBlocksToFollow = (unsigned int)handleByte << 7;
+            break;
+        case 3:
+            ptrCtx->expectedBlocksToFollow |= handleByte;
+            if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR_FLAGS) {
+                //Feedback counts block indexes rather than blocks, either way it can't be more than a repairable frame holds
+                if(ptrCtx->expectedBlocksToFollow > BUS_FRAME_REPAIR_MAX_BLOCKS ||
+                        (ptrCtx->expectedBlocksToFollow == 0 && (ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST))) {
+                    raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+                    return;
+                }
+            } else if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_DENSE) {
+                //Count is the payload length, no blocks follow. blockProceed holds EC2 off until the frame CRC is in
+                ptrCtx->densePayloadRemaining = ptrCtx->expectedBlocksToFollow;
+                ptrCtx->expectedBlocksToFollow = 0;
+                ptrCtx->frameCrc = BUS_FRAME_CRC16_INIT;
+                ptrCtx->receivedFrameCrc = 0;
+                ptrCtx->blockPosition = 0;
+                ptrCtx->blockProceed = 1;
+                ptrCtx->blockPhase = BLOCK_DENSE_DATA;
+                if(ptrCtx->densePayloadRemaining > MAX_JUMBO_UNPACKED_PAYLOAD) {
+                    raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+                    return;
+                }
+            } else if(ptrCtx->expectedBlocksToFollow > BUS_FRAME_JUMBO_MAX_BLOCKS) {
+                raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+                return;
+            }
+            break;
+        case 4:
+            handleRepairSequence(ptrCtx, handleByte);
+            if(ptrCtx->busHandlerState == BUS_HANDLER_PROCESS_ERROR) {
+                return;
+            }
+            break;
+    }
+    if((ptrCtx->frameFormat & BUS_FRAME_FORMAT_FEEDBACK) && ptrCtx->formatHeaderPosition > 1) {
+        ptrCtx->frameCrc = updateFrameCrc(ptrCtx->frameCrc, handleByte);
+    }
+    ptrCtx->formatHeaderPosition = ptrCtx->formatHeaderPosition < ((ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR_FLAGS) ? 4 : 3) ? ptrCtx->formatHeaderPosition + 1 : 0;
+    ptrCtx->dataRequest = 1;
+}
+
+//Groups of up to 7 bytes followed by their top bits, then the 3 byte frame CRC
+void handleDenseData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte) {
+    unsigned char groupLength;
+    unsigned char j;
+    ptrCtx->dataReady = 0;
+    ptrCtx->frameBytes++;
+    ptrCtx->dataRequest = 1;
+    if(handleByte & 0b10000000) {
+        raiseBusHandlerError(ptrCtx, BHE_DENSE_BYTE_INVALID);
+        return;
+    }
+    if(ptrCtx->densePayloadRemaining == 0) {
+        ptrCtx->receivedFrameCrc = (ptrCtx->receivedFrameCrc << 7) | handleByte;
+        if(++ptrCtx->blockPosition == 3) {
+            if((ptrCtx->receivedFrameCrc & 0xFFFF) == ptrCtx->frameCrc) {
+                ptrCtx->blockProceed = 0;
+                ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+            } else {
+                //Next step fails the frame, before EC1 can arrive and report it as cut short
+                ptrCtx->dataRequest = 0;
+                ptrCtx->blockPhase = BLOCK_FAIL_CRC_RESET;
+            }
+        }
+        return;
+    }
+    groupLength = ptrCtx->densePayloadRemaining < BUS_FRAME_DENSE_GROUP_BYTES ? ptrCtx->densePayloadRemaining : BUS_FRAME_DENSE_GROUP_BYTES;
+    if(ptrCtx->blockPosition < groupLength) {
+        ptrCtx->workingBlock.bytes[ptrCtx->blockPosition++] = handleByte;
+        return;
+    }
+    unpackDenseGroup(&ptrCtx->workingBlock.bytes[0], groupLength, handleByte);
+    for(j = 0; j < groupLength; j++) {
+        ptrCtx->frameCrc = updateFrameCrc(ptrCtx->frameCrc, ptrCtx->workingBlock.bytes[j]);
+        if(!emitPayloadByte(ptrCtx, ptrCtx->workingBlock.bytes[j])) {
+            return;
+        }
+    }
+    ptrCtx->densePayloadRemaining -= groupLength;
+    ptrCtx->blockPosition = 0;
+}
+
+//Last header byte in acknowledged mode: a new frame, a repair for the held one, or feedback for this end's writer
+void handleRepairSequence(tBusFrameHandlerCtx *ptrCtx, unsigned char sequence) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned char i;
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_FEEDBACK) {
+        ptrCtx->feedbackSequence = sequence;
+        ptrCtx->feedbackRemaining = ptrCtx->expectedBlocksToFollow;
+        ptrCtx->expectedBlocksToFollow = 0;
+        for(i = 0; i < BUS_FRAME_REPAIR_BITMAP_BYTES; i++) {
+            ptrCtx->feedbackMissing[i] = 0;
+        }
+        //Like dense, blockProceed holds EC2 off until the frame CRC is in
+        ptrCtx->receivedFrameCrc = 0;
+        ptrCtx->blockPosition = 0;
+        ptrCtx->blockProceed = 1;
+        ptrCtx->blockPhase = BLOCK_FEEDBACK_DATA;
+        return;
+    }
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR) {
+        if(!ptrCtx->repairHeld || sequence != ptrCtx->repairSequence || ptrCtx->expectedBlocksToFollow != ptrCtx->repairMissingCount) {
+            raiseBusHandlerError(ptrCtx, BHE_REPAIR_UNEXPECTED);
+            return;
+        }
+        ptrCtx->repairCursor = 0;
+        return;
+    }
+    if(ptrCtx->repairHeld) {
+        //Sender has moved on, the held frame is never getting its blocks
+        ptrCtx->repairHeld = 0;
+        BUS_STAT_INC(ptrCtx, framesDropped);
+    }
+    ptrCtx->repairSequence = sequence;
+    ptrCtx->repairBlockCount = ptrCtx->expectedBlocksToFollow;
+    ptrCtx->repairMissingCount = 0;
+    for(i = 0; i < BUS_FRAME_REPAIR_BITMAP_BYTES; i++) {
+        ptrCtx->repairMissing[i] = 0;
+    }
+#else
+    (void)sequence;
+    raiseBusHandlerError(ptrCtx, BHE_INVALID_FORMAT_HEADER);
+#endif
+}
+
+//Bad block indexes as 7+7 bits, then the 3 byte frame CRC over everything after the format byte
+void handleFeedbackData(tBusFrameHandlerCtx *ptrCtx, unsigned char handleByte) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int index;
+    ptrCtx->dataReady = 0;
+    ptrCtx->frameBytes++;
+    ptrCtx->dataRequest = 1;
+    if(handleByte & 0b10000000) {
+        raiseBusHandlerError(ptrCtx, BHE_FEEDBACK_INVALID);
+        return;
+    }
+    if(ptrCtx->feedbackRemaining == 0) {
+        ptrCtx->receivedFrameCrc = (ptrCtx->receivedFrameCrc << 7) | handleByte;
+        if(++ptrCtx->blockPosition == 3) {
+            if((ptrCtx->receivedFrameCrc & 0xFFFF) == ptrCtx->frameCrc) {
+                ptrCtx->blockProceed = 0;
+                ptrCtx->blockPhase = BLOCK_PHASE_NONE;
+            } else {
+                //Next step fails the frame, before EC1 can arrive and report it as cut short
+                ptrCtx->dataRequest = 0;
+                ptrCtx->blockPhase = BLOCK_FAIL_CRC_RESET;
+            }
+        }
+        return;
+    }
+    ptrCtx->frameCrc = updateFrameCrc(ptrCtx->frameCrc, handleByte);
+    if(ptrCtx->blockPosition == 0) {
+        ptrCtx->workingBlock.bytes[0] = handleByte;
+        ptrCtx->blockPosition = 1;
+        return;
+    }
+    index = ((unsigned int)ptrCtx->workingBlock.bytes[0] << 7) | handleByte;
+    if(index >= BUS_FRAME_REPAIR_MAX_BLOCKS) {
+        raiseBusHandlerError(ptrCtx, BHE_FEEDBACK_INVALID);
+        return;
+    }
+    ptrCtx->feedbackMissing[index >> 3] |= 1 << (index & 7);
+    ptrCtx->feedbackRemaining--;
+    ptrCtx->blockPosition = 0;
+#else
+    (void)ptrCtx;
+    (void)handleByte;
+#endif
+}
+
+//Where the block just received belongs: its own position, or in a repair frame the next index still missing
+unsigned int getRepairBlockIndex(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int index;
+    if(!(ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR)) {
+        return ptrCtx->blockCount - 1;
+    }
+    for(index = ptrCtx->repairCursor; index < ptrCtx->repairBlockCount; index++) {
+        if(BUS_FRAME_REPAIR_BIT(ptrCtx->repairMissing, index)) {
+            ptrCtx->repairCursor = index + 1;
+            return index;
+        }
+    }
+#else
+    (void)ptrCtx;
+#endif
+    return BUS_FRAME_REPAIR_MAX_BLOCKS; //More blocks than holes, CHECK_FINAL throws the frame out
+}
+
+void markRepairBlockMissing(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int index = getRepairBlockIndex(ptrCtx);
+    //A repair block failing again leaves its hole as it was
+    if(!(ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR) && index < ptrCtx->repairBlockCount) {
+        ptrCtx->repairMissing[index >> 3] |= 1 << (index & 7);
+        ptrCtx->repairMissingCount++;
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+void stageRepairBlock(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int index = getRepairBlockIndex(ptrCtx);
+    unsigned char j;
+    if(index >= ptrCtx->repairBlockCount) {
+        return;
+    }
+    for(j = 0; j < 6; j++) {
+        ptrCtx->repairStaging[(index * 6) + j] = ptrCtx->workingBlock.block.payloadBytes[j];
+    }
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_REPAIR) {
+        ptrCtx->repairMissing[index >> 3] &= ~(1 << (index & 7));
+        ptrCtx->repairMissingCount--;
+        BUS_STAT_INC(ptrCtx, blocksRepaired);
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//End of a frame in acknowledged mode. Returns 1 once the whole payload has gone out like any other frame, otherwise sets the next state itself
+unsigned char finishRepairFrame(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int i;
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_FEEDBACK) {
+        if(ptrCtx->ptrRepairWriter) {
+            applyBusFrameFeedbackCtx(ptrCtx->ptrRepairWriter, ptrCtx->feedbackSequence, &ptrCtx->feedbackMissing[0]);
+        }
+    } else {
+        if(ptrCtx->ptrRepairWriter) {
+            queueBusFrameFeedbackCtx(ptrCtx->ptrRepairWriter, ptrCtx->repairSequence, &ptrCtx->repairMissing[0]);
+        }
+        if(ptrCtx->repairMissingCount == 0) {
+            ptrCtx->repairHeld = 0;
+            ptrCtx->expectedBlocksToFollow = ptrCtx->repairBlockCount;
+            for(i = 0; i < ptrCtx->repairBlockCount * 6; i++) {
+                if(!emitPayloadByte(ptrCtx, ptrCtx->repairStaging[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        ptrCtx->repairHeld = 1;
+        BUS_STAT_INC(ptrCtx, repairRequests);
+    }
+    //Nothing for the application yet
+    reverseWrite(ptrCtx->ptrApplicationBuffer);
+    ptrCtx->reversibleWriteOpen = 0;
+    ptrCtx->busHandlerState = BUS_HANDLER_COMPLETE_RESET;
+    return 0;
+#else
+    (void)ptrCtx;
+    return 1;
+#endif
+}
+
+//Every CRC checked payload byte comes through here, compressed frames are expanded on the way. 0 = the frame is done for, the error is already raised
+unsigned char emitPayloadByte(tBusFrameHandlerCtx *ptrCtx, unsigned char byte) {
+#if BUS_FRAME_COMPRESSION_ENABLED
+    eBusFrameExpandStatus expandStatus;
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_COMPRESSED) {
+        expandStatus = putCompressedByte(&ptrCtx->expander, byte);
+        if(expandStatus != BUS_FRAME_EXPAND_OK) {
+            raiseBusHandlerError(ptrCtx, expandStatus == BUS_FRAME_EXPAND_REFERENCE ? BHE_COMPRESSION_REFERENCE : BHE_COMPRESSION_INVALID);
+            return 0;
+        }
+        while(takeExpandedByte(&ptrCtx->expander, &byte)) {
+            if(!writePayloadByte(ptrCtx, byte)) {
+                ptrCtx->bhErrorCtx = 0x02;
+                raiseBusHandlerError(ptrCtx, BHE_WRITE_OUT_FAILED);
+                return 0;
+            }
+        }
+        return 1;
+    }
+#endif
+    if(!writePayloadByte(ptrCtx, byte)) {
+        ptrCtx->bhErrorCtx = 0x02;
+        raiseBusHandlerError(ptrCtx, BHE_WRITE_OUT_FAILED);
+        return 0;
+    }
+    return 1;
+}
+
+//The first payload byte is the message type and picks where the rest of the frame goes
+unsigned char writePayloadByte(tBusFrameHandlerCtx *ptrCtx, unsigned char byte) {
+#if HANDLER_DISPATCH_ENABLED
+    if(ptrCtx->outputByteCount == 0) {
+        if(ptrCtx->dispatchTable[byte] && getExpectedPayloadLength(ptrCtx) <= HANDLER_DISPATCH_STAGING_SIZE) {
+            ptrCtx->frameRoute = BUS_FRAME_ROUTE_DISPATCH;
+        } else if(!ptrCtx->dispatchTable[byte] && ptrCtx->earlyDrop) {
+            ptrCtx->frameRoute = BUS_FRAME_ROUTE_DROP;
+        } else {
+            ptrCtx->frameRoute = BUS_FRAME_ROUTE_APPLICATION;
+        }
+    }
+    if(ptrCtx->frameRoute == BUS_FRAME_ROUTE_DISPATCH) {
+        ptrCtx->dispatchStaging[ptrCtx->outputByteCount++] = byte;
+        return 1;
+    }
+    if(ptrCtx->frameRoute == BUS_FRAME_ROUTE_DROP) {
+        ptrCtx->outputByteCount++;
+        return 1;
+    }
+#endif
+    ptrCtx->outputByteCount++;
+    ptrCtx->bufferOpStatus = BUFFER_OPERATION_NONE;
+    putByte(ptrCtx->ptrApplicationBuffer, &ptrCtx->bufferOpStatus, byte);
+    return ptrCtx->bufferOpStatus == BUFFER_OPERATION_OK;
+}
+
+//Payload bytes the whole frame will produce, block frames include their 0xFF padding, compressed ones go by the length in their own header
+unsigned int getExpectedPayloadLength(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_COMPRESSION_ENABLED
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_COMPRESSED) {
+        return ptrCtx->expander.length;
+    }
+#endif
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_DENSE) {
+        return ptrCtx->densePayloadRemaining;
+    }
+    return ptrCtx->expectedBlocksToFollow * 6;
+}
+
 void registerApplicationBuffer(tBuffer *ptrAppBuffer) {
-    ptrApplicationBuffer = ptrAppBuffer;
+    registerApplicationBufferCtx(&defaultBusFrameHandler, ptrAppBuffer);
 }
 
 void registerApplicationListener(unsigned char *ptrListener) {
-    ptrApplicationListener = ptrListener;
+    registerApplicationListenerCtx(&defaultBusFrameHandler, ptrListener);
 }
 
 void putByteForHandling(eBusHandlerOperationStatus *ptrStatus, unsigned char byte) {
-    eBufferOperationStatus bufferExtOpStatus = BUFFER_OPERATION_NONE;
-    putByte(&busHandleInboundBuffer,&bufferExtOpStatus,byte);
-    *ptrStatus = bufferExtOpStatus == BUFFER_OPERATION_OK ? BUS_HANDLER_OPERATION_OK : BUS_HANDLER_CANT_WRITE;
-    if(*ptrStatus != BUFFER_OPERATION_OK) {
-        asm("nop");
-        asm("nop");
-    }
-}
\ No newline at end of file
+    putByteForHandlingCtx(&defaultBusFrameHandler, ptrStatus, byte);
+}
+
+void putBytesForHandling(eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted) {
+    putBytesForHandlingCtx(&defaultBusFrameHandler, ptrStatus, ptrBytes, length, ptrAccepted);
+}
+
+void registerBusFrameDispatch(unsigned char messageType, tBusFrameDispatchHandler handler) {
+    registerBusFrameDispatchCtx(&defaultBusFrameHandler, messageType, handler);
+}
+
+void setBusFrameEarlyDrop(unsigned char enabled) {
+    setBusFrameEarlyDropCtx(&defaultBusFrameHandler, enabled);
+}
+
+void registerBusFrameRepairWriter(void) {
+    registerBusFrameRepairWriterCtx(&defaultBusFrameHandler, &defaultBusFrameWriter);
+}
+
+void registerBusFrameCaptureHook(tBusFrameCaptureHook hook) {
+    registerBusFrameCaptureHookCtx(&defaultBusFrameHandler, hook);
+}
+
+void registerBusFrameTrace(void) {
+#if BUS_FRAME_TRACE_ENABLED
+    registerBusFrameTraceCtx(&defaultBusFrameHandler, &defaultBusFrameTrace, 0);
+#endif
+}
+
+eBusHandlerWaitReason getBusFrameHandlerWait(void) {
+    return getBusFrameHandlerWaitCtx(&defaultBusFrameHandler);
+}
+
+void registerBusFrameHandlerWakeHook(tBusFrameWakeHook hook, void *ptrArgument) {
+    registerBusFrameHandlerWakeHookCtx(&defaultBusFrameHandler, hook, ptrArgument);
+}
+
+unsigned char popDecodedFrame(tBusDecodedFrame *ptrFrame) {
+    return popDecodedFrameCtx(&defaultBusFrameHandler, ptrFrame);
+}
+
+unsigned char getDecodedFrameCount(void) {
+    return getDecodedFrameCountCtx(&defaultBusFrameHandler);
+}
+
+void snapshotBusFrameHandlerStats(tBusFrameHandlerStats *ptrStats) {
+    snapshotBusFrameHandlerStatsCtx(&defaultBusFrameHandler, ptrStats);
+}
+
+void resetBusFrameHandlerStats(void) {
+    resetBusFrameHandlerStatsCtx(&defaultBusFrameHandler);
+}
+
+void registerApplicationBufferCtx(tBusFrameHandlerCtx *ptrCtx, tBuffer *ptrAppBuffer) {
+    ptrCtx->ptrApplicationBuffer = ptrAppBuffer;
+}
+
+void registerApplicationListenerCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char *ptrListener) {
+    ptrCtx->ptrApplicationListener = ptrListener;
+}
+
+void putByteForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, unsigned char byte) {
+    unsigned int accepted;
+    putBytesForHandlingCtx(ptrCtx, ptrStatus, &byte, 1, &accepted);
+}
+
+//Safe to call from the UART ISR / DMA completion / reader thread while runBusFrameHandler runs elsewhere
+void putBytesForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted) {
+    *ptrAccepted = putBusInboundBytes(&ptrCtx->busHandleInboundRing, ptrBytes, length);
+#if BUS_FRAME_CAPTURE_ENABLED
+    if(ptrCtx->captureHook && *ptrAccepted) {
+        ptrCtx->captureHook(ptrBytes, *ptrAccepted);
+    }
+#endif
+    *ptrStatus = *ptrAccepted == length ? BUS_HANDLER_OPERATION_OK : BUS_HANDLER_CANT_WRITE;
+    BUS_STAT_ADD(ptrCtx, bytesIn, *ptrAccepted);
+    if(*ptrAccepted) {
+        wakeBusFrameHandler(ptrCtx);
+    }
+    if(*ptrStatus != BUS_HANDLER_OPERATION_OK) {
+        BUS_STAT_ADD(ptrCtx, bufferFullRejections, length - *ptrAccepted);
+        BUS_FRAME_NOP();
+        BUS_FRAME_NOP();
+    }
+}
+
+//Called with the staged payload as soon as CHECK_FINAL accepts a frame of this type, which then skips the application buffer. 0 unregisters
+void registerBusFrameDispatchCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char messageType, tBusFrameDispatchHandler handler) {
+#if HANDLER_DISPATCH_ENABLED
+    ptrCtx->dispatchTable[messageType] = handler;
+#else
+    (void)ptrCtx;
+    (void)messageType;
+    (void)handler;
+#endif
+}
+
+//1 = frames of a type with no handler are still CRC checked but never copied anywhere
+void setBusFrameEarlyDropCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char enabled) {
+#if HANDLER_DISPATCH_ENABLED
+    ptrCtx->earlyDrop = enabled;
+#else
+    (void)ptrCtx;
+    (void)enabled;
+#endif
+}
+
+//The writer sending the other way on this bus: carries our ACK/NACKs and takes the far end's
+void registerBusFrameRepairWriterCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWriterCtx *ptrWriter) {
+#if BUS_FRAME_REPAIR_ENABLED
+    ptrCtx->ptrRepairWriter = ptrWriter;
+#else
+    (void)ptrCtx;
+    (void)ptrWriter;
+#endif
+}
+
+//Sees only what the ring accepted, so a replay of the capture decodes exactly as this bus did. 0 unregisters
+void registerBusFrameCaptureHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameCaptureHook hook) {
+#if BUS_FRAME_CAPTURE_ENABLED
+    ptrCtx->captureHook = hook;
+#else
+    (void)ptrCtx;
+    (void)hook;
+#endif
+}
+
+//Handler transitions go into ptrTrace tagged with bus, so a writer on the same ring can share the number. 0 stops tracing
+void registerBusFrameTraceCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus) {
+#if BUS_FRAME_TRACE_ENABLED
+    ptrCtx->ptrTrace = ptrTrace;
+    ptrCtx->traceBus = bus;
+    ptrCtx->tracedState = ptrCtx->busHandlerState;
+    ptrCtx->tracedPhase = ptrCtx->blockPhase;
+    ptrCtx->tracedMarkers = ptrCtx->busHandlerMarkerFlags.markerByte;
+#else
+    (void)ptrCtx;
+    (void)ptrTrace;
+    (void)bus;
+#endif
+}
+
+//Called with ptrArgument when bytes go into the inbound ring and when a frame is handed to the application. 0 unregisters
+void registerBusFrameHandlerWakeHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument) {
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    ptrCtx->ptrWakeArgument = ptrArgument;
+    ptrCtx->wakeHook = hook;
+#else
+    (void)ptrCtx;
+    (void)hook;
+    (void)ptrArgument;
+#endif
+}
+
+void wakeBusFrameHandler(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    if(ptrCtx->wakeHook) {
+        ptrCtx->wakeHook(ptrCtx->ptrWakeArgument);
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//Oldest finished frame, its length bytes are next out of the application buffer. Returns 0 if there isn't one. Same thread as runBusFrameHandler
+unsigned char popDecodedFrameCtx(tBusFrameHandlerCtx *ptrCtx, tBusDecodedFrame *ptrFrame) {
+#if HANDLER_DECODED_QUEUE_SIZE
+    if(ptrCtx->decodedQueueCount == 0) {
+        return 0;
+    }
+    *ptrFrame = ptrCtx->decodedQueue[ptrCtx->decodedQueueHead];
+    ptrCtx->decodedQueueHead = (ptrCtx->decodedQueueHead + 1) % HANDLER_DECODED_QUEUE_SIZE;
+    ptrCtx->decodedQueueCount--;
+    if(ptrCtx->decodedQueueCount == 0) {
+        *ptrCtx->ptrApplicationListener = 0;
+    }
+    return 1;
+#else
+    (void)ptrCtx;
+    (void)ptrFrame;
+    return 0;
+#endif
+}
+
+unsigned char getDecodedFrameCountCtx(tBusFrameHandlerCtx *ptrCtx) {
+#if HANDLER_DECODED_QUEUE_SIZE
+    return ptrCtx->decodedQueueCount;
+#else
+    (void)ptrCtx;
+    return 0;
+#endif
+}
+
+//Call from whichever thread runs this bus, counters aren't updated atomically
+void snapshotBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameHandlerStats *ptrStats) {
+#if BUS_FRAME_STATS_ENABLED
+    *ptrStats = ptrCtx->stats;
+#else
+    tBusFrameHandlerStats emptyStats = {0};
+    (void)ptrCtx;
+    *ptrStats = emptyStats;
+#endif
+}
+
+void resetBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx) {
+#if BUS_FRAME_STATS_ENABLED
+    tBusFrameHandlerStats emptyStats = {0};
+    ptrCtx->stats = emptyStats;
+#else
+    (void)ptrCtx;
+#endif
+}
+
+/*
+ * Decodes as many complete frames as possible from a span of raw bus bytes,
+ * following the same marker and block rules as runBusFrameHandler. Payload of
+ * each accepted frame is appended to ptrOutput->ptrPayload and its length to
+ * ptrOutput->ptrFrameLengths. Returns the number of bytes consumed; a frame
+ * that is still incomplete at the end of the span (or doesn't fit in the
+ * output) is left unconsumed, starting at its SC1, so the caller can carry it
+ * over into the next call.
+ */
+unsigned int decodeBusFrameSpan(const unsigned char *ptrBytes, unsigned int length, tBusFrameSpanOutput *ptrOutput) {
+    tBrokenOutBlock spanBlock;
+    tBusHandlerMarkerFlags spanMarkers;
+    unsigned int position;
+    unsigned int consumed = 0;
+    unsigned int outputPosition = ptrOutput->payloadLength;
+    unsigned char spanBlockPosition = 0;
+    unsigned char spanBlockOpen = 0;
+    unsigned int spanBlockCount = 0;
+    unsigned int spanExpectedBlocks = 0;
+    unsigned char spanHeaderPosition = 0;
+    unsigned char spanFormat = 0;
+    unsigned int spanDenseRemaining = 0;
+    unsigned int spanFrameCrc = 0;
+    unsigned int spanReceivedCrc = 0;
+    unsigned char spanRun[SPAN_RUN_BLOCKS * 8];
+    unsigned int run;
+    unsigned int decoded;
+    unsigned char groupLength;
+    unsigned char byte;
+    unsigned char j;
+
+    spanMarkers.markerByte = MARKERS_NONE;
+    for(position = 0; position < length; position++) {
+        byte = ptrBytes[position];
+        if((byte & 0b11000000) == 0b11000000) {
+            switch(byte & 0xF0) {
+                case 0xC0:
+                    spanMarkers.markerByte = MARKERS_IN_PRESTART;
+                    spanExpectedBlocks = byte & 0x0F;
+                    consumed = position;
+                    break;
+
+                case 0xD0:
+                    if(spanMarkers.markerByte != MARKERS_IN_PRESTART) {
+                        spanMarkers.markerByte = MARKERS_NONE; //SC2 out of position
+                        break;
+                    }
+                    spanMarkers.started = 1;
+                    outputPosition = ptrOutput->payloadLength;
+                    spanBlockPosition = 0;
+                    spanBlockOpen = 0;
+                    spanBlockCount = 0;
+                    spanHeaderPosition = spanExpectedBlocks == 0 ? 1 : 0;
+                    spanFormat = 0;
+                    spanDenseRemaining = 0;
+                    break;
+
+                case 0xE0:
+                    spanMarkers.preFinish = 1;
+                    break;
+
+                case 0xF0:
+                    spanMarkers.finished = 1;
+                    break;
+            }
+            if(spanMarkers.markerByte == MARKERS_FINISHED && !spanBlockOpen && spanBlockCount == spanExpectedBlocks) {
+                if(ptrOutput->frameCount >= ptrOutput->maxFrames) {
+                    return consumed;
+                }
+                ptrOutput->ptrFrameLengths[ptrOutput->frameCount++] = outputPosition - ptrOutput->payloadLength;
+                ptrOutput->payloadLength = outputPosition;
+                spanMarkers.markerByte = MARKERS_NONE;
+            } else if(spanMarkers.markerByte == MARKERS_FINISHED || !areMarkersValid(spanMarkers)) {
+                spanMarkers.markerByte = MARKERS_NONE; //Frame can't complete, drop it and wait for the next SC1
+            }
+        } else if(spanMarkers.markerByte == MARKERS_STARTED && spanHeaderPosition) {
+            if((byte & 0b10000000) ||
+                    (spanHeaderPosition == 1 && (!(byte & BUS_FRAME_FORMAT_JUMBO) || (byte & ~BUS_FRAME_FORMAT_KNOWN)))) {
+                spanMarkers.markerByte = MARKERS_NONE; //Bad format header
+                consumed = position + 1;
+                continue;
+            }
+            if(spanHeaderPosition == 1) {
+                spanFormat = byte;
+            } else if(spanHeaderPosition == 2) {
+                spanExpectedBlocks = (unsigned int)byte << 7;
+            } else if(spanHeaderPosition == 3) {
+                spanExpectedBlocks |= byte;
+                if(spanFormat & BUS_FRAME_FORMAT_DENSE) {
+                    spanDenseRemaining = spanExpectedBlocks;
+                    spanExpectedBlocks = 0;
+                    spanFrameCrc = BUS_FRAME_CRC16_INIT;
+                    spanReceivedCrc = 0;
+                    spanBlockPosition = 0;
+                    spanBlockOpen = 1; //Until the frame CRC checks out
+                }
+                if(spanExpectedBlocks > BUS_FRAME_JUMBO_MAX_BLOCKS || spanDenseRemaining > MAX_JUMBO_UNPACKED_PAYLOAD) {
+                    spanMarkers.markerByte = MARKERS_NONE;
+                    consumed = position + 1;
+                    continue;
+                }
+            }
+            spanHeaderPosition = spanHeaderPosition < 3 ? spanHeaderPosition + 1 : 0;
+        } else if(spanMarkers.markerByte == MARKERS_STARTED && (spanFormat & BUS_FRAME_FORMAT_DENSE)) {
+            if((byte & 0b10000000) || !spanBlockOpen) {
+                spanMarkers.markerByte = MARKERS_NONE;
+                consumed = position + 1;
+                continue;
+            }
+            if(spanDenseRemaining == 0) {
+                spanReceivedCrc = (spanReceivedCrc << 7) | byte;
+                if(++spanBlockPosition == 3) {
+                    if((spanReceivedCrc & 0xFFFF) != spanFrameCrc) {
+                        spanMarkers.markerByte = MARKERS_NONE;
+                        consumed = position + 1;
+                        continue;
+                    }
+                    spanBlockOpen = 0;
+                }
+                continue;
+            }
+            groupLength = spanDenseRemaining < BUS_FRAME_DENSE_GROUP_BYTES ? spanDenseRemaining : BUS_FRAME_DENSE_GROUP_BYTES;
+            if(spanBlockPosition < groupLength) {
+                spanBlock.bytes[spanBlockPosition++] = byte;
+                continue;
+            }
+            if(outputPosition + groupLength > ptrOutput->payloadSize) {
+                return consumed;
+            }
+            unpackDenseGroup(&spanBlock.bytes[0], groupLength, byte);
+            for(j = 0; j < groupLength; j++) {
+                spanFrameCrc = updateFrameCrc(spanFrameCrc, spanBlock.bytes[j]);
+                ptrOutput->ptrPayload[outputPosition++] = spanBlock.bytes[j];
+            }
+            spanDenseRemaining -= groupLength;
+            spanBlockPosition = 0;
+        } else if(spanMarkers.markerByte == MARKERS_STARTED) {
+            if((byte & 0b11000000) == 0b10000000) {
+                if(spanBlockOpen) {
+                    spanMarkers.markerByte = MARKERS_NONE; //Block cut short
+                    consumed = position + 1;
+                    continue;
+                }
+                //Whole blocks back to back in the span skip the byte loop, checked and demasked a run at a time
+                run = countSpanBlocks(ptrBytes + position, length - position, spanExpectedBlocks > spanBlockCount ? spanExpectedBlocks - spanBlockCount : 0);
+                if(run > (ptrOutput->payloadSize - outputPosition) / 6) {
+                    run = (ptrOutput->payloadSize - outputPosition) / 6;
+                }
+                if(run > 0) {
+                    for(decoded = 0; decoded < run * 8; decoded++) {
+                        spanRun[decoded] = ptrBytes[position + decoded];
+                    }
+                    decoded = decodeBusFrameBlocks(&spanRun[0], run, &ptrOutput->ptrPayload[outputPosition]);
+                    if(decoded < run) {
+                        spanMarkers.markerByte = MARKERS_NONE; //Bad CRC, same as the byte loop finding it
+                        position += decoded * 8 + 7;
+                        consumed = position + 1;
+                        continue;
+                    }
+                    spanBlockCount += run;
+                    outputPosition += run * 6;
+                    position += run * 8 - 1;
+                    continue;
+                }
+                spanBlockPosition = 0; //MASK POS RESET
+                spanBlockCount++;
+            }
+            spanBlockOpen = 1;
+            spanBlock.bytes[spanBlockPosition] = byte;
+            if(spanBlockPosition < 7) {
+                spanBlockPosition++;
+                continue;
+            }
+            if(outputPosition + 6 > ptrOutput->payloadSize) {
+                return consumed;
+            }
+            if(decodeBusFrameBlocks(&spanBlock.bytes[0], 1, &ptrOutput->ptrPayload[outputPosition]) == 0) {
+                spanMarkers.markerByte = MARKERS_NONE;
+                consumed = position + 1;
+                continue;
+            }
+            outputPosition += 6;
+            spanBlockOpen = 0;
+        }
+        if(spanMarkers.markerByte == MARKERS_NONE) {
+            consumed = position + 1;
+        }
+    }
+    return consumed;
+}
+
+//Whole, well formed 8 byte blocks (mask byte then 7 bytes under 0x80) at the start of ptrBytes, up to maxBlocks and SPAN_RUN_BLOCKS
+unsigned int countSpanBlocks(const unsigned char *ptrBytes, unsigned int length, unsigned int maxBlocks) {
+    unsigned int blocks = 0;
+    unsigned char i;
+    if(maxBlocks > SPAN_RUN_BLOCKS) {
+        maxBlocks = SPAN_RUN_BLOCKS;
+    }
+    while(blocks < maxBlocks && length >= 8) {
+        if((ptrBytes[0] & 0b11000000) != 0b10000000) {
+            break;
+        }
+        for(i = 1; i < 8 && !(ptrBytes[i] & 0b10000000); i++) {
+        }
+        if(i < 8) {
+            break;
+        }
+        ptrBytes += 8;
+        length -= 8;
+        blocks++;
+    }
+    return blocks;
+}
@@ -3,12 +3,54 @@
 
 #include "../ring-buffer/ring_buffer_types.h"
 #include "bus_frame_handler_status.h"
+#include "bus_frame_handler_types.h"
+
+typedef struct {
+    unsigned char *ptrPayload;
+    unsigned int payloadSize;
+    unsigned int payloadLength;
+    unsigned int *ptrFrameLengths;
+    unsigned char maxFrames;
+    unsigned char frameCount;
+} tBusFrameSpanOutput;
 
 extern void initialiseBusFrameHandler(void);
 extern void runBusFrameHandler(void);
+extern unsigned int runBusFrameHandlerBudget(eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget);
 extern void registerApplicationBuffer(tBuffer *ptrAppBuffer);
 extern void registerApplicationListener(unsigned char *ptrListener);
 extern void putByteForHandling(eBusHandlerOperationStatus *ptrStatus, unsigned char byte);
+extern void putBytesForHandling(eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted);
+extern void initialiseBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx);
+extern void runBusFrameHandlerCtx(tBusFrameHandlerCtx *ptrCtx);
+extern unsigned int runBusFrameHandlerBudgetCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerRunStatus *ptrStatus, unsigned int stepBudget);
+extern void registerApplicationBufferCtx(tBusFrameHandlerCtx *ptrCtx, tBuffer *ptrAppBuffer);
+extern void registerApplicationListenerCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char *ptrListener);
+extern void putByteForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, unsigned char byte);
+extern void putBytesForHandlingCtx(tBusFrameHandlerCtx *ptrCtx, eBusHandlerOperationStatus *ptrStatus, const unsigned char *ptrBytes, unsigned int length, unsigned int *ptrAccepted);
+extern void registerBusFrameDispatch(unsigned char messageType, tBusFrameDispatchHandler handler);
+extern void setBusFrameEarlyDrop(unsigned char enabled);
+extern void registerBusFrameDispatchCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char messageType, tBusFrameDispatchHandler handler);
+extern void setBusFrameEarlyDropCtx(tBusFrameHandlerCtx *ptrCtx, unsigned char enabled);
+extern void registerBusFrameRepairWriter(void);
+extern void registerBusFrameRepairWriterCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWriterCtx *ptrWriter);
+extern void registerBusFrameCaptureHook(tBusFrameCaptureHook hook);
+extern void registerBusFrameCaptureHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameCaptureHook hook);
+extern void registerBusFrameTrace(void);
+extern void registerBusFrameTraceCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus);
+extern eBusHandlerWaitReason getBusFrameHandlerWait(void);
+extern void registerBusFrameHandlerWakeHook(tBusFrameWakeHook hook, void *ptrArgument);
+extern eBusHandlerWaitReason getBusFrameHandlerWaitCtx(tBusFrameHandlerCtx *ptrCtx);
+extern void registerBusFrameHandlerWakeHookCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument);
+extern unsigned char popDecodedFrame(tBusDecodedFrame *ptrFrame);
+extern unsigned char getDecodedFrameCount(void);
+extern unsigned char popDecodedFrameCtx(tBusFrameHandlerCtx *ptrCtx, tBusDecodedFrame *ptrFrame);
+extern unsigned char getDecodedFrameCountCtx(tBusFrameHandlerCtx *ptrCtx);
+extern void snapshotBusFrameHandlerStats(tBusFrameHandlerStats *ptrStats);
+extern void resetBusFrameHandlerStats(void);
+extern void snapshotBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx, tBusFrameHandlerStats *ptrStats);
+extern void resetBusFrameHandlerStatsCtx(tBusFrameHandlerCtx *ptrCtx);
+extern unsigned int decodeBusFrameSpan(const unsigned char *ptrBytes, unsigned int length, tBusFrameSpanOutput *ptrOutput);
 
 #endif	/* BUS_FRAME_HANDLER_H */
 
@@ -7,5 +7,18 @@ typedef enum {
     BUS_HANDLER_CANT_WRITE,
 } eBusHandlerOperationStatus;
 
+typedef enum {
+    BUS_HANDLER_RUN_NONE = 0,
+    BUS_HANDLER_RUN_STARVED,
+    BUS_HANDLER_RUN_WAITING_APPLICATION,
+    BUS_HANDLER_RUN_BUDGET_SPENT,
+} eBusHandlerRunStatus;
+
+typedef enum {
+    BUS_HANDLER_BLOCKED_NONE = 0, //Another step has work to do
+    BUS_HANDLER_BLOCKED_INPUT, //Inbound ring is dry, nothing moves until putBytesForHandling
+    BUS_HANDLER_BLOCKED_APPLICATION, //A frame is waiting on the application listener or a slot in the decoded queue
+} eBusHandlerWaitReason;
+
 #endif	/* BUS_FRAME_HANDLER_STATUS_H */
 
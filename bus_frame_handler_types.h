@@ -0,0 +1,192 @@
+#ifndef BUS_FRAME_HANDLER_TYPES_H
+#define	BUS_FRAME_HANDLER_TYPES_H
+
+#include "../ring-buffer/ring_buffer_types.h"
+#include "bus_frame_details.h"
+#include "bus_inbound_ring.h"
+#include "bus_frame_writer_types.h"
+#include "bus_frame_trace_types.h"
+#include "bus_frame_compress_types.h"
+
+typedef enum {
+    BUS_HANDLER_NONE = 0,
+    BUS_HANDLER_WAIT_FOR_BYTES,
+    BUS_HANDLER_GET_BYTES,
+    BUS_HANDLER_HANDLE_BLOCK,
+    BUS_HANDLER_CHECK_FINAL,
+    BUS_HANDLER_WAIT_PROCESSED,
+    BUS_HANDLER_COMPLETE_RESET,
+    BUS_HANDLER_PROCESS_ERROR,
+    BUS_HANDLER_RESYNC,
+    BUS_HANDLER_QUEUE_FRAME
+} eBusHandlerStates;
+
+typedef struct {
+    unsigned char mask;
+    unsigned char crc;
+    unsigned char payloadBytes[6];
+} tBlock;
+
+typedef union {
+    tBlock block;
+    unsigned char bytes[8];
+} tBrokenOutBlock;
+
+typedef union {
+    struct {
+        unsigned preStart:1;
+        unsigned started:1;
+        unsigned preFinish:1;
+        unsigned finished:1;
+    };
+    unsigned char markerByte;
+} tBusHandlerMarkerFlags;
+
+typedef enum {
+    BHE_NONE,
+    BHE_LISTENER_NOT_REGISTERED,
+    BHE_WRITE_OUT_FAILED,
+    BHE_GET_FOR_WRITE_OUT_FAILED,
+    BHE_OUT_OF_BOUNDS_BLOCK,
+    BHE_TOO_MANY_STUFF,
+    BHE_SC1_WITHOUT_SC2,
+    BHE_ALREADY_IN_BLOCK,
+    BHE_I_SHOULDNT_BE_HERE,
+    BHE_INVALID_B2F_IN_EC2,
+    BHE_INVALID_B2F_IN_EC1,
+    BHE_INVALID_B2F_IN_SC2,
+    BHE_OUT_OF_POS_SC2,
+    BHE_GOALPOST_OR_MASK_NOT_RECEIVED,
+    BHE_GOALPOST_NOT_RECEIVED,
+    BHE_MASK_NOT_RECEIVED,
+    BHE_INVALID_FORMAT_HEADER,
+    BHE_DENSE_BYTE_INVALID,
+    BHE_REPAIR_UNEXPECTED,
+    BHE_FEEDBACK_INVALID,
+    BHE_COMPRESSION_REFERENCE,
+    BHE_COMPRESSION_INVALID,
+    BHE_CRC_FAILED,
+    BHE_ERROR_KINDS
+} eBusFrameHandlerError;
+
+typedef enum {
+    BLOCK_PHASE_NONE,
+    BLOCK_BEGIN_BLOCK,
+    BLOCK_CHECK_CRC,
+    BLOCK_DEMASK,
+    BLOCK_WAIT_ACKNOWLEDGE,
+    BLOCK_FAIL_CRC_RESET,
+    BLOCK_DENSE_DATA,
+    BLOCK_FEEDBACK_DATA,
+} eBlockPhase;
+
+typedef void (*tBusFrameDispatchHandler)(unsigned char messageType, const unsigned char *ptrPayload, unsigned int length);
+
+//Raw inbound bytes exactly as they reached the handler, may be called from the UART ISR / reader thread
+typedef void (*tBusFrameCaptureHook)(const unsigned char *ptrBytes, unsigned int length);
+
+typedef enum {
+    BUS_FRAME_ROUTE_APPLICATION = 0,
+    BUS_FRAME_ROUTE_DISPATCH,
+    BUS_FRAME_ROUTE_DROP
+} eBusFrameRoute;
+
+//A finished frame waiting in the application buffer, offset counts every byte ever committed to it
+typedef struct {
+    unsigned int offset;
+    unsigned int length;
+    unsigned int sequence;
+} tBusDecodedFrame;
+
+typedef struct {
+    unsigned long framesDecoded;
+    unsigned long framesDropped;
+    unsigned long crcFailures;
+    unsigned long bytesIn;
+    unsigned long bytesOut;
+    unsigned long bufferFullRejections;
+    unsigned long resyncBytesDiscarded;
+    unsigned long blocksRepaired;
+    unsigned long repairRequests;
+    unsigned long errorCounts[BHE_ERROR_KINDS];
+} tBusFrameHandlerStats;
+
+//Everything one bus needs, so several handlers can run side by side
+typedef struct {
+    eBusHandlerStates busHandlerState;
+    eBlockPhase blockPhase;
+    eBusFrameHandlerError busHandlerError;
+    tBusHandlerMarkerFlags busHandlerMarkerFlags;
+    tBrokenOutBlock workingBlock;
+    tBuffer *ptrApplicationBuffer;
+    unsigned char *ptrApplicationListener;
+    eBufferOperationStatus bufferOpStatus;
+    tBusInboundRing busHandleInboundRing;
+    unsigned char bhErrorCtx;
+    unsigned int frameBytes;
+    unsigned int blockCount;
+    unsigned int expectedBlocksToFollow;
+    unsigned char frameFormat;
+    unsigned char formatHeaderPosition;
+    unsigned int densePayloadRemaining;
+    unsigned int frameCrc;
+    unsigned int receivedFrameCrc;
+    unsigned char blockPosition;
+    unsigned int outputByteCount;
+    unsigned char dummyListener;
+    unsigned char dataReady;
+    unsigned char dataRequest;
+    unsigned char blockProceed;
+    unsigned char handlingComplete;
+    unsigned char handleByte;
+    unsigned char reversibleWriteOpen;
+#if HANDLER_DECODED_QUEUE_SIZE
+    tBusDecodedFrame decodedQueue[HANDLER_DECODED_QUEUE_SIZE];
+    unsigned char decodedQueueHead;
+    unsigned char decodedQueueTail;
+    unsigned char decodedQueueCount;
+    unsigned int committedByteCount;
+    unsigned int frameSequence;
+#endif
+#if HANDLER_DISPATCH_ENABLED
+    tBusFrameDispatchHandler dispatchTable[256];
+    unsigned char dispatchStaging[HANDLER_DISPATCH_STAGING_SIZE];
+    unsigned char earlyDrop;
+    eBusFrameRoute frameRoute;
+#endif
+#if BUS_FRAME_REPAIR_ENABLED
+    tBusFrameWriterCtx *ptrRepairWriter;
+    unsigned char repairStaging[BUS_FRAME_REPAIR_MAX_BLOCKS * 6];
+    unsigned char repairMissing[BUS_FRAME_REPAIR_BITMAP_BYTES];
+    unsigned int repairMissingCount;
+    unsigned int repairBlockCount;
+    unsigned int repairCursor;
+    unsigned char repairSequence;
+    unsigned char repairHeld;
+    unsigned char feedbackMissing[BUS_FRAME_REPAIR_BITMAP_BYTES];
+    unsigned int feedbackRemaining;
+    unsigned char feedbackSequence;
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+    tBusFrameExpander expander;
+#endif
+#if BUS_FRAME_CAPTURE_ENABLED
+    tBusFrameCaptureHook captureHook;
+#endif
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    tBusFrameWakeHook wakeHook;
+    void *ptrWakeArgument;
+#endif
+#if BUS_FRAME_TRACE_ENABLED
+    tBusFrameTrace *ptrTrace;
+    unsigned char traceBus;
+    eBusHandlerStates tracedState;
+    eBlockPhase tracedPhase;
+    unsigned char tracedMarkers;
+#endif
+#if BUS_FRAME_STATS_ENABLED
+    tBusFrameHandlerStats stats;
+#endif
+} tBusFrameHandlerCtx;
+
+#endif	/* BUS_FRAME_HANDLER_TYPES_H */
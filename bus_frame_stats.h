@@ -0,0 +1,14 @@
+#ifndef BUS_FRAME_STATS_H
+#define	BUS_FRAME_STATS_H
+
+#include "bus_frame_details.h"
+
+#if BUS_FRAME_STATS_ENABLED
+#define BUS_STAT_INC(ptrCtx, counter)           ((ptrCtx)->stats.counter++)
+#define BUS_STAT_ADD(ptrCtx, counter, amount)   ((ptrCtx)->stats.counter += (amount))
+#else
+#define BUS_STAT_INC(ptrCtx, counter)
+#define BUS_STAT_ADD(ptrCtx, counter, amount)
+#endif
+
+#endif	/* BUS_FRAME_STATS_H */
@@ -0,0 +1,70 @@
+/*
+ * File:   bus_frame_trace.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 19:30
+ */
+
+#include "../global.h"
+#include "bus_frame_details.h"
+#include "bus_frame_trace.h"
+
+#if BUS_FRAME_TRACE_ENABLED
+tBusFrameTrace defaultBusFrameTrace;
+#endif
+
+void initialiseBusFrameTrace(tBusFrameClock clock);
+unsigned int readBusFrameTrace(unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents);
+void initialiseBusFrameTraceCtx(tBusFrameTrace *ptrTrace, tBusFrameClock clock);
+unsigned int readBusFrameTraceCtx(tBusFrameTrace *ptrTrace, unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents);
+void recordBusFrameTrace(tBusFrameTrace *ptrTrace, eBusFrameTraceComponent component, unsigned char bus, unsigned int oldState, unsigned int newState, unsigned char error);
+
+//The ring registerBusFrameTrace and registerBusFrameWriterTrace share, nothing to read when tracing is compiled out
+void initialiseBusFrameTrace(tBusFrameClock clock) {
+#if BUS_FRAME_TRACE_ENABLED
+    initialiseBusFrameTraceCtx(&defaultBusFrameTrace, clock);
+#else
+    (void)clock;
+#endif
+}
+
+unsigned int readBusFrameTrace(unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents) {
+#if BUS_FRAME_TRACE_ENABLED
+    return readBusFrameTraceCtx(&defaultBusFrameTrace, ptrCursor, ptrEvents, maxEvents);
+#else
+    (void)ptrCursor;
+    (void)ptrEvents;
+    (void)maxEvents;
+    return 0;
+#endif
+}
+
+//No clock means events are stamped with their own sequence number, order is all you get
+void initialiseBusFrameTraceCtx(tBusFrameTrace *ptrTrace, tBusFrameClock clock) {
+    ptrTrace->recorded = 0;
+    ptrTrace->ptrClock = clock;
+}
+
+void recordBusFrameTrace(tBusFrameTrace *ptrTrace, eBusFrameTraceComponent component, unsigned char bus, unsigned int oldState, unsigned int newState, unsigned char error) {
+    tBusFrameTraceEvent *ptrEvent = &ptrTrace->events[ptrTrace->recorded % BUS_FRAME_TRACE_SIZE];
+    ptrEvent->timestamp = ptrTrace->ptrClock ? ptrTrace->ptrClock() : ptrTrace->recorded;
+    ptrEvent->oldState = oldState;
+    ptrEvent->newState = newState;
+    ptrEvent->component = (unsigned char)component;
+    ptrEvent->bus = bus;
+    ptrEvent->error = error;
+    ptrTrace->recorded++;
+}
+
+//Copies out, oldest first, what's been recorded since *ptrCursor (start it at 0) and moves the cursor on. Events overwritten before they were read are skipped, the cursor jumping by more than was returned shows how many
+unsigned int readBusFrameTraceCtx(tBusFrameTrace *ptrTrace, unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents) {
+    unsigned int count = 0;
+    if(ptrTrace->recorded - *ptrCursor > BUS_FRAME_TRACE_SIZE) {
+        *ptrCursor = ptrTrace->recorded - BUS_FRAME_TRACE_SIZE;
+    }
+    while(count < maxEvents && *ptrCursor != ptrTrace->recorded) {
+        ptrEvents[count++] = ptrTrace->events[*ptrCursor % BUS_FRAME_TRACE_SIZE];
+        (*ptrCursor)++;
+    }
+    return count;
+}
@@ -0,0 +1,12 @@
+#ifndef BUS_FRAME_TRACE_H
+#define	BUS_FRAME_TRACE_H
+
+#include "bus_frame_trace_types.h"
+
+extern void initialiseBusFrameTrace(tBusFrameClock clock);
+extern unsigned int readBusFrameTrace(unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents);
+extern void initialiseBusFrameTraceCtx(tBusFrameTrace *ptrTrace, tBusFrameClock clock);
+extern unsigned int readBusFrameTraceCtx(tBusFrameTrace *ptrTrace, unsigned long *ptrCursor, tBusFrameTraceEvent *ptrEvents, unsigned int maxEvents);
+extern void recordBusFrameTrace(tBusFrameTrace *ptrTrace, eBusFrameTraceComponent component, unsigned char bus, unsigned int oldState, unsigned int newState, unsigned char error);
+
+#endif	/* BUS_FRAME_TRACE_H */
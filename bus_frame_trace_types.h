@@ -0,0 +1,32 @@
+#ifndef BUS_FRAME_TRACE_TYPES_H
+#define	BUS_FRAME_TRACE_TYPES_H
+
+#include "bus_frame_details.h"
+
+//Free running tick source, any rate, wraps however it likes as long as it's unsigned
+typedef unsigned long (*tBusFrameClock)(void);
+
+typedef enum {
+    BUS_TRACE_HANDLER_STATE = 0,
+    BUS_TRACE_BLOCK_PHASE,
+    BUS_TRACE_MARKERS,  //0 -> 1 is SC1 arriving
+    BUS_TRACE_WRITER_STATE
+} eBusFrameTraceComponent;
+
+typedef struct {
+    unsigned long timestamp;
+    unsigned int oldState;
+    unsigned int newState;
+    unsigned char component;
+    unsigned char bus;
+    unsigned char error;
+} tBusFrameTraceEvent;
+
+//Shared by every handler and writer registered on it, all of which must run on the same thread
+typedef struct {
+    tBusFrameTraceEvent events[BUS_FRAME_TRACE_SIZE];
+    unsigned long recorded; //Ever, events[recorded % BUS_FRAME_TRACE_SIZE] is the next one overwritten
+    tBusFrameClock ptrClock;
+} tBusFrameTrace;
+
+#endif	/* BUS_FRAME_TRACE_TYPES_H */
@@ -11,270 +11,1253 @@
 #include "bus_frame_details.h"
 
 #include "bus_frame_writer_status.h"
+#include "bus_frame_writer.h"
+#include "bus_frame_crc.h"
+#include "bus_frame_block.h"
+#include "bus_frame_stats.h"
+#include "bus_frame_trace.h"
+#include "bus_frame_compress.h"
 
-typedef union {
-    struct {
-        unsigned char mask;
-        unsigned char crc;
-        unsigned char dataBytes[6];
-    };
-    unsigned char bytes[8];
-} tBlockLayout;
-
-typedef enum {
-    BUS_FRAME_WRITER_NONE = 0,
-    BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER = 10,
-    BUS_FRAME_WRITER_LOCK_BUFFER = 20,
-    BUS_FRAME_WRITER_CALCULATE_BLOCKS = 40,
-    BUS_FRAME_WRITER_WRITE_STARTCODE1 = 50,
-    BUS_FRAME_WRITER_WRITE_STARTCODE2 = 70,
-    BUS_FRAME_WRITER_INITIALISE_BLOCK = 90,
-    BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE = 100,
-    BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER = 200,
-    BUS_FRAME_WRITER_UNLOCK_BUFFER = 240,
-    BUS_FRAME_WRITER_WRITE_ENDCODE1 = 260,
-    BUS_FRAME_WRITER_WRITE_ENDCODE2 = 280,
-    BUS_FRAME_WRITER_TRIGGER_LISTENER = 300,
-    BUS_FRAME_WRITER_WAIT_PROCESSED = 310,
-    BUS_FRAME_WRITER_COMPLETE_RESET = 320,
-    BUS_FRAME_WRITER_PROCESS_ERROR = 330
-} eBusFrameWriterState;
-
-typedef union {
-    struct {
-        unsigned frameOpen: 1;
-        unsigned writeTrigger: 1;
-    };
-    unsigned char byte;
-} tBusFrameWriterFlags;
-
-tBlockLayout tempBlock;
-eBusFrameWriterState busFrameWriterState;
-tBuffer frameWriterProcessBuffer;
-unsigned char frameWriterProcessBufferArray[FRAME_WRITER_PROCESS_BUFFER_SIZE];
-tBusFrameWriterFlags busFrameWriterFlags;
-tBuffer *ptrSendBuffer;
-eBufferOperationStatus bufferProcessStatus;
-eBufferOperationStatus bufferWriteStatus;
-
-unsigned char byteCount;
-unsigned char frameWriterBlockCount;
-unsigned char byteToWrite;
-unsigned char tempMask;
-unsigned char outputBlockCount;
-unsigned char blockByteCount;
-unsigned char *ptrSendListener;
-unsigned char queuedFrameCount;
-
-eBusFrameWriterState lastState;
-unsigned char traceCount = 0;
+tBusFrameWriterCtx defaultBusFrameWriter;
+#if BUS_FRAME_TRACE_ENABLED
+extern tBusFrameTrace defaultBusFrameTrace;
+#endif
 
 void initialiseBusFrameWriter(void);
 void registerSendFrameListener(unsigned char *ptrListener);
 void runBusFrameWriter(void);
+unsigned int runBusFrameWriterBudget(eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget);
 void openBusFrame(eBusFrameWriterOperationStatus *ptrStatus);
+void openBusFrameWithFormat(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format);
+void openBusFrameWithPriority(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority);
 void writeToBusFrame(eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte);
 void closeBusFrame(eBusFrameWriterOperationStatus *ptrStatus);
 void sendFramesInBuffer(eBusFrameWriterOperationStatus *ptrStatus);
 void registerSendFrameBuffer(tBuffer *ptrBuffer);
 unsigned char getQueuedFrameCount(void);
+unsigned char getQueuedFrameCountByPriority(eBusFramePriority priority);
+void writeBusFrameDirect(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+void writeBusFrameCompressed(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+unsigned char isWriteDone(void);
+void initialiseBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx);
+void registerSendFrameListenerCtx(tBusFrameWriterCtx *ptrCtx, unsigned char *ptrListener);
+void runBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx);
+unsigned int runBusFrameWriterBudgetCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget);
+void openBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+void openBusFrameWithFormatCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format);
+void openBusFrameWithPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority);
+void writeToBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte);
+void closeBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+void sendFramesInBufferCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+void registerSendFrameBufferCtx(tBusFrameWriterCtx *ptrCtx, tBuffer *ptrBuffer);
+unsigned char getQueuedFrameCountCtx(tBusFrameWriterCtx *ptrCtx);
+unsigned char getQueuedFrameCountByPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFramePriority priority);
+void writeBusFrameDirectCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+void writeBusFrameCompressedCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+unsigned int getEncodedBusFrameSize(unsigned int length, unsigned char format);
+unsigned int encodeBusFrame(const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrOutput, unsigned int outputSize);
+void startBusFrameEncoder(tBusFrameEncoder *ptrEncoder, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+unsigned char encodeBusFramePiece(tBusFrameEncoder *ptrEncoder, unsigned char *ptrPiece);
+unsigned char isWriteDoneCtx(tBusFrameWriterCtx *ptrCtx);
+void setBusFrameRepairMode(unsigned char enabled);
+void queueBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing);
+void applyBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing);
+void setBusFrameRepairModeCtx(tBusFrameWriterCtx *ptrCtx, unsigned char enabled);
+void queueBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing);
+void applyBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing);
+void writeSendByte(tBusFrameWriterCtx *ptrCtx, unsigned char byte);
+void signalSendListener(tBusFrameWriterCtx *ptrCtx);
+unsigned char isCoalescing(tBusFrameWriterCtx *ptrCtx);
+unsigned int getWrittenFrameSize(tBusFrameWriterCtx *ptrCtx);
+tBusFrameWriterLane *getWriterLane(tBusFrameWriterCtx *ptrCtx, eBusFramePriority priority);
+tBusFrameWriterLane *pickSendingLane(tBusFrameWriterCtx *ptrCtx);
+void queueWriterFrame(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterLane *ptrLane);
+void popSentFrame(tBusFrameWriterCtx *ptrCtx);
+void registerBusFrameWriterClock(tBusFrameClock clock);
+void setBusFrameCoalescing(unsigned int maxBytes, unsigned long maxDelay);
+void registerBusFrameWriterClockCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameClock clock);
+void setBusFrameCoalescingCtx(tBusFrameWriterCtx *ptrCtx, unsigned int maxBytes, unsigned long maxDelay);
+void registerBusFrameWriterTrace(void);
+void registerBusFrameWriterTraceCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus);
+void writeFeedbackFrame(tBusFrameWriterCtx *ptrCtx);
+void writeRepairFrame(tBusFrameWriterCtx *ptrCtx);
+unsigned int countMissingBlocks(const unsigned char *ptrMissing, unsigned int blockCount);
+void startRepairWait(tBusFrameWriterCtx *ptrCtx);
+unsigned char isRepairWaitOver(tBusFrameWriterCtx *ptrCtx);
+void getBusFrameWriterWait(tBusFrameWriterWait *ptrWait);
+void registerBusFrameWriterWakeHook(tBusFrameWakeHook hook, void *ptrArgument);
+void getBusFrameWriterWaitCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterWait *ptrWait);
+void registerBusFrameWriterWakeHookCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument);
+void wakeBusFrameWriter(tBusFrameWriterCtx *ptrCtx);
+void snapshotBusFrameWriterStats(tBusFrameWriterStats *ptrStats);
+void resetBusFrameWriterStats(void);
+void snapshotBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterStats *ptrStats);
+void resetBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx);
 
 void initialiseBusFrameWriter(void) {
-    initialiseBuffer(&frameWriterProcessBuffer, &frameWriterProcessBufferArray[0], FRAME_WRITER_PROCESS_BUFFER_SIZE);
+    initialiseBusFrameWriterCtx(&defaultBusFrameWriter);
 }
 
 void runBusFrameWriter(void) {
+    runBusFrameWriterCtx(&defaultBusFrameWriter);
+}
+
+unsigned int runBusFrameWriterBudget(eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget) {
+    return runBusFrameWriterBudgetCtx(&defaultBusFrameWriter, ptrStatus, stepBudget);
+}
+
+void openBusFrame(eBusFrameWriterOperationStatus *ptrStatus) {
+    openBusFrameCtx(&defaultBusFrameWriter, ptrStatus);
+}
+
+void openBusFrameWithFormat(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format) {
+    openBusFrameWithFormatCtx(&defaultBusFrameWriter, ptrStatus, format);
+}
+
+void openBusFrameWithPriority(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority) {
+    openBusFrameWithPriorityCtx(&defaultBusFrameWriter, ptrStatus, format, priority);
+}
+
+void writeToBusFrame(eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte) {
+    writeToBusFrameCtx(&defaultBusFrameWriter, ptrStatus, byte);
+}
+
+void closeBusFrame(eBusFrameWriterOperationStatus *ptrStatus) {
+    closeBusFrameCtx(&defaultBusFrameWriter, ptrStatus);
+}
+
+void sendFramesInBuffer(eBusFrameWriterOperationStatus *ptrStatus) {
+    sendFramesInBufferCtx(&defaultBusFrameWriter, ptrStatus);
+}
+
+void writeBusFrameDirect(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    writeBusFrameDirectCtx(&defaultBusFrameWriter, ptrStatus, ptrPayload, length, format);
+}
+
+void writeBusFrameCompressed(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    writeBusFrameCompressedCtx(&defaultBusFrameWriter, ptrStatus, ptrPayload, length, format);
+}
+
+unsigned char getQueuedFrameCount(void) {
+    return getQueuedFrameCountCtx(&defaultBusFrameWriter);
+}
+
+unsigned char getQueuedFrameCountByPriority(eBusFramePriority priority) {
+    return getQueuedFrameCountByPriorityCtx(&defaultBusFrameWriter, priority);
+}
+
+unsigned char isWriteDone(void) {
+    return isWriteDoneCtx(&defaultBusFrameWriter);
+}
+
+void registerSendFrameBuffer(tBuffer *ptrBuffer) {
+    registerSendFrameBufferCtx(&defaultBusFrameWriter, ptrBuffer);
+}
+
+void registerSendFrameListener(unsigned char *ptrListener) {
+    registerSendFrameListenerCtx(&defaultBusFrameWriter, ptrListener);
+}
+
+void registerBusFrameWriterClock(tBusFrameClock clock) {
+    registerBusFrameWriterClockCtx(&defaultBusFrameWriter, clock);
+}
+
+void registerBusFrameWriterTrace(void) {
+#if BUS_FRAME_TRACE_ENABLED
+    registerBusFrameWriterTraceCtx(&defaultBusFrameWriter, &defaultBusFrameTrace, 0);
+#endif
+}
+
+void setBusFrameCoalescing(unsigned int maxBytes, unsigned long maxDelay) {
+    setBusFrameCoalescingCtx(&defaultBusFrameWriter, maxBytes, maxDelay);
+}
+
+void setBusFrameRepairMode(unsigned char enabled) {
+    setBusFrameRepairModeCtx(&defaultBusFrameWriter, enabled);
+}
+
+void queueBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing) {
+    queueBusFrameFeedbackCtx(&defaultBusFrameWriter, sequence, ptrMissing);
+}
+
+void applyBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing) {
+    applyBusFrameFeedbackCtx(&defaultBusFrameWriter, sequence, ptrMissing);
+}
+
+void getBusFrameWriterWait(tBusFrameWriterWait *ptrWait) {
+    getBusFrameWriterWaitCtx(&defaultBusFrameWriter, ptrWait);
+}
+
+void registerBusFrameWriterWakeHook(tBusFrameWakeHook hook, void *ptrArgument) {
+    registerBusFrameWriterWakeHookCtx(&defaultBusFrameWriter, hook, ptrArgument);
+}
+
+void snapshotBusFrameWriterStats(tBusFrameWriterStats *ptrStats) {
+    snapshotBusFrameWriterStatsCtx(&defaultBusFrameWriter, ptrStats);
+}
+
+void resetBusFrameWriterStats(void) {
+    resetBusFrameWriterStatsCtx(&defaultBusFrameWriter);
+}
+
+void initialiseBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx) {
     unsigned char i;
-    switch(busFrameWriterState) {    
+    ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_NONE;
+    ptrCtx->busFrameWriterFlags.byte = 0;
+    ptrCtx->queuedFrameCount = 0;
+    for(i = 0; i < BUS_FRAME_WRITER_LANES; i++) {
+        ptrCtx->lanes[i].frameQueueHead = 0;
+        ptrCtx->lanes[i].frameQueueTail = 0;
+        ptrCtx->lanes[i].queuedFrameCount = 0;
+    }
+    ptrCtx->ptrSendingLane = &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK];
+    ptrCtx->ptrOpenLane = &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK];
+    ptrCtx->ptrClock = 0;
+    ptrCtx->coalesceMaxBytes = 0;
+    ptrCtx->coalesceMaxDelay = 0;
+    ptrCtx->coalescedBytes = 0;
+    ptrCtx->lastFlushTick = 0;
+#if BUS_FRAME_TRACE_ENABLED
+    ptrCtx->ptrTrace = 0;
+    ptrCtx->traceCount = 0;
+#endif
+#if BUS_FRAME_REPAIR_ENABLED
+    ptrCtx->repairEnabled = 0;
+    ptrCtx->repairAwaiting = 0;
+    ptrCtx->repairFeedbackReceived = 0;
+    ptrCtx->repairSequence = 0;
+    ptrCtx->repairWaitStart = 0;
+    ptrCtx->feedbackPending = 0;
+#endif
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    ptrCtx->wakeHook = 0;
+    ptrCtx->ptrWakeArgument = 0;
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+    for(i = 0; i < BUS_FRAME_COMPRESSION_STREAMS; i++) {
+        ptrCtx->compressStreams[i].valid = 0;
+    }
+#endif
+    ptrCtx->ptrSendListener = &ptrCtx->dummyListener;
+    resetBusFrameWriterStatsCtx(ptrCtx);
+    initialiseBusFrameCrc();
+    initialiseBuffer(&ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK].processBuffer, &ptrCtx->frameWriterProcessBufferArray[0], FRAME_WRITER_PROCESS_BUFFER_SIZE);
+#if FRAME_WRITER_PRIORITY_ENABLED
+    initialiseBuffer(&ptrCtx->lanes[BUS_FRAME_PRIORITY_CONTROL].processBuffer, &ptrCtx->controlProcessBufferArray[0], FRAME_WRITER_CONTROL_BUFFER_SIZE);
+#endif
+}
+
+void runBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx) {
+    unsigned char i;
+    switch(ptrCtx->busFrameWriterState) {    
         case BUS_FRAME_WRITER_NONE:
-            busFrameWriterState = BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER;
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER;
             break;
 
         case BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER:
-            if (busFrameWriterFlags.writeTrigger) {
-                busFrameWriterState = BUS_FRAME_WRITER_LOCK_BUFFER;
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->feedbackPending) {
+                writeFeedbackFrame(ptrCtx);
+            }
+#endif
+            if (ptrCtx->busFrameWriterFlags.writeTrigger) {
+                if(ptrCtx->queuedFrameCount) {
+                    ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_CALCULATE_BLOCKS;
+                } else {
+                    ptrCtx->busFrameWriterFlags.writeTrigger = 0;
+                }
             }
-            break;
-
-        case BUS_FRAME_WRITER_LOCK_BUFFER:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            writeLockMainBuffer(&frameWriterProcessBuffer,&bufferProcessStatus);
-            busFrameWriterState = bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_CALCULATE_BLOCKS : BUS_FRAME_WRITER_LOCK_BUFFER;
             break;
 
         case BUS_FRAME_WRITER_CALCULATE_BLOCKS:
-            byteCount = getFillLevel(&frameWriterProcessBuffer);
-            outputBlockCount = (byteCount / 6) + ((byteCount % 6) > 0);
-            frameWriterBlockCount = 0;
-            busFrameWriterState = outputBlockCount <= 0x0F ? BUS_FRAME_WRITER_WRITE_STARTCODE1 : BUS_FRAME_WRITER_PROCESS_ERROR;
+            //Only the frame at the head of a lane, later ones may still be filling. Control frames jump the bulk queue here, between frames
+            ptrCtx->ptrSendingLane = pickSendingLane(ptrCtx);
+            ptrCtx->byteCount = ptrCtx->ptrSendingLane->frameQueue[ptrCtx->ptrSendingLane->frameQueueHead].length;
+            ptrCtx->outputBlockCount = (ptrCtx->byteCount / 6) + ((ptrCtx->byteCount % 6) > 0);
+            ptrCtx->frameWriterBlockCount = 0;
+            ptrCtx->headerCount = ptrCtx->outputBlockCount;
+            //Anything that won't fit in the marker nibble goes out as a jumbo frame
+            ptrCtx->frameFormat = ptrCtx->outputBlockCount > 0x0F ? BUS_FRAME_FORMAT_JUMBO : 0;
+            if(ptrCtx->ptrSendingLane->frameQueue[ptrCtx->ptrSendingLane->frameQueueHead].format & BUS_FRAME_FORMAT_DENSE) {
+                ptrCtx->frameFormat = BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_DENSE;
+                ptrCtx->headerCount = ptrCtx->byteCount;
+                ptrCtx->outputBlockCount = 0;
+                ptrCtx->frameCrc = BUS_FRAME_CRC16_INIT;
+            }
+            if(ptrCtx->ptrSendingLane->frameQueue[ptrCtx->ptrSendingLane->frameQueueHead].format & BUS_FRAME_FORMAT_COMPRESSED) {
+                ptrCtx->frameFormat |= BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_COMPRESSED;
+            }
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->repairEnabled && !(ptrCtx->frameFormat & (BUS_FRAME_FORMAT_DENSE | BUS_FRAME_FORMAT_COMPRESSED)) && ptrCtx->outputBlockCount && ptrCtx->outputBlockCount <= BUS_FRAME_REPAIR_MAX_BLOCKS) {
+                //Blocks are kept as they go out, so the receiver can ask for just the bad ones again
+                ptrCtx->frameFormat = BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_ACK_REQUEST;
+                ptrCtx->repairSequence = (ptrCtx->repairSequence + 1) & 0x7F;
+                ptrCtx->repairBlockCount = ptrCtx->outputBlockCount;
+                ptrCtx->repairRounds = 0;
+            }
+#endif
+            ptrCtx->markerBlockCount = ptrCtx->frameFormat ? 0 : ptrCtx->outputBlockCount;
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE; //A rejected direct write leaves it failed, getBusFrameWriterWait reads it in the marker states
+            ptrCtx->busFrameWriterState = ptrCtx->outputBlockCount <= BUS_FRAME_JUMBO_MAX_BLOCKS ? BUS_FRAME_WRITER_WRITE_STARTCODE1 : BUS_FRAME_WRITER_PROCESS_ERROR;
             break;
 
         case BUS_FRAME_WRITER_WRITE_STARTCODE1:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            byteToWrite = 0xC0 + outputBlockCount;
-            putByte(ptrSendBuffer,&bufferProcessStatus,byteToWrite);
-            busFrameWriterState = bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_WRITE_STARTCODE2 : BUS_FRAME_WRITER_WRITE_STARTCODE1;
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+            ptrCtx->byteToWrite = 0xC0 + ptrCtx->markerBlockCount;
+            putByte(ptrCtx->ptrSendBuffer,&ptrCtx->bufferProcessStatus,ptrCtx->byteToWrite);
+            ptrCtx->busFrameWriterState = ptrCtx->bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_WRITE_STARTCODE2 : BUS_FRAME_WRITER_WRITE_STARTCODE1;
             break;
 
         case BUS_FRAME_WRITER_WRITE_STARTCODE2:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            byteToWrite = 0xD0 + outputBlockCount;
-            putByte(ptrSendBuffer,&bufferProcessStatus,byteToWrite);
-            busFrameWriterState = bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_INITIALISE_BLOCK : BUS_FRAME_WRITER_WRITE_STARTCODE2;
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+            ptrCtx->byteToWrite = 0xD0 + ptrCtx->markerBlockCount;
+            putByte(ptrCtx->ptrSendBuffer,&ptrCtx->bufferProcessStatus,ptrCtx->byteToWrite);
+            if(ptrCtx->bufferProcessStatus == BUFFER_OPERATION_OK) {
+                if(ptrCtx->frameFormat) {
+                    ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WRITE_FORMAT_HEADER;
+                } else {
+                    ptrCtx->busFrameWriterState = ptrCtx->outputBlockCount ? BUS_FRAME_WRITER_INITIALISE_BLOCK : BUS_FRAME_WRITER_WRITE_ENDCODE1;
+                }
+            }
+            break;
+
+        case BUS_FRAME_WRITER_WRITE_FORMAT_HEADER:
+            ptrCtx->tempBlock.bytes[0] = ptrCtx->frameFormat;
+            ptrCtx->tempBlock.bytes[1] = (ptrCtx->headerCount >> 7) & 0x7F;
+            ptrCtx->tempBlock.bytes[2] = ptrCtx->headerCount & 0x7F;
+#if BUS_FRAME_REPAIR_ENABLED
+            ptrCtx->tempBlock.bytes[3] = ptrCtx->repairSequence;
+#endif
+            for(i = 0; i < ((ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) ? 4 : 3); i++) {
+                do {
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, ptrCtx->tempBlock.bytes[i]);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+            }
+            if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_DENSE) {
+                ptrCtx->busFrameWriterState = ptrCtx->byteCount ? BUS_FRAME_WRITER_DENSE_GROUP : BUS_FRAME_WRITER_WRITE_FRAME_CRC;
+            } else {
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_INITIALISE_BLOCK;
+            }
             break;
 
         case BUS_FRAME_WRITER_INITIALISE_BLOCK:
-            tempBlock.crc = 0;
-            tempBlock.mask = 0;
-            blockByteCount = 0;
-            frameWriterBlockCount++;
+            ptrCtx->tempBlock.crc = 0;
+            ptrCtx->tempBlock.mask = 0;
+            ptrCtx->blockByteCount = 0;
+            ptrCtx->frameWriterBlockCount++;
             for(i=0; i < 6; i++) {
-                tempBlock.dataBytes[i] = 0;
+                ptrCtx->tempBlock.dataBytes[i] = 0;
             }
-            busFrameWriterState = BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE;
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE;
             break;
 
         case BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE:
             do {
                 do {
-                    bufferProcessStatus = BUFFER_OPERATION_NONE;
-                    getByte(&frameWriterProcessBuffer, &bufferProcessStatus, &byteToWrite);
-                } while (bufferProcessStatus != BUFFER_OPERATION_OK);
-                if(blockByteCount < 6) {
-                    tempBlock.dataBytes[blockByteCount++] = byteToWrite;
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    getByte(&ptrCtx->ptrSendingLane->processBuffer, &ptrCtx->bufferProcessStatus, &ptrCtx->byteToWrite);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+                if(ptrCtx->blockByteCount < 6) {
+                    ptrCtx->tempBlock.dataBytes[ptrCtx->blockByteCount++] = ptrCtx->byteToWrite;
                 }
-            } while(!isEmpty(&frameWriterProcessBuffer) && blockByteCount < 6);
+                ptrCtx->byteCount--;
+            } while(ptrCtx->byteCount > 0 && ptrCtx->blockByteCount < 6);
             
             do {
-                if(blockByteCount < 6) {
-                    tempBlock.dataBytes[blockByteCount++] = 0xFF;
+                if(ptrCtx->blockByteCount < 6) {
+                    ptrCtx->tempBlock.dataBytes[ptrCtx->blockByteCount++] = 0xFF;
                 }
-            } while(blockByteCount < 6);
-            tempMask = 0x80;
-            blockByteCount = 0;
+            } while(ptrCtx->blockByteCount < 6);
+            ptrCtx->tempMask = 0x80 | maskBlockBytes(&ptrCtx->tempBlock.dataBytes[0]);
+            ptrCtx->blockByteCount = 0;
+            ptrCtx->tempBlock.mask = ptrCtx->tempMask;
+            ptrCtx->tempBlock.crc = calculateBlockCrc(&ptrCtx->tempBlock.dataBytes[0]);
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER;
+            break;
+
+        case BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER:
             do {
-                
-                if(tempBlock.dataBytes[blockByteCount] >= 0x80) {
-                    tempBlock.dataBytes[blockByteCount] = tempBlock.dataBytes[blockByteCount] & 0b01111111;
-                    tempMask = tempMask | (1 << blockByteCount);
+                do {
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, ptrCtx->tempBlock.bytes[ptrCtx->blockByteCount]);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+                ptrCtx->blockByteCount++;
+            } while (ptrCtx->blockByteCount < 8);
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) {
+                for(i = 0; i < 8; i++) {
+                    ptrCtx->repairBlocks[ptrCtx->frameWriterBlockCount - 1][i] = ptrCtx->tempBlock.bytes[i];
                 }
-                blockByteCount++;
-            } while (blockByteCount < 6); 
-            blockByteCount = 0;
-            tempBlock.mask = tempMask;
-            tempBlock.crc = calculateCrc(&tempBlock.dataBytes[0],6);
-            busFrameWriterState = BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER;
+            }
+#endif
+            ptrCtx->busFrameWriterState = ptrCtx->frameWriterBlockCount < ptrCtx->outputBlockCount ? BUS_FRAME_WRITER_INITIALISE_BLOCK : BUS_FRAME_WRITER_WRITE_ENDCODE1;
             break;
 
-        case BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER:
+        case BUS_FRAME_WRITER_DENSE_GROUP:
+            //Up to 7 payload bytes with bit 7 stripped, then their top bits gathered into one byte
+            ptrCtx->blockByteCount = 0;
             do {
                 do {
-                    bufferProcessStatus = BUFFER_OPERATION_NONE;
-                    putByte(ptrSendBuffer, &bufferProcessStatus, tempBlock.bytes[blockByteCount]);
-                } while (bufferProcessStatus != BUFFER_OPERATION_OK);
-                blockByteCount++;
-            } while (blockByteCount < 8);
-            busFrameWriterState = frameWriterBlockCount < outputBlockCount ? BUS_FRAME_WRITER_INITIALISE_BLOCK : BUS_FRAME_WRITER_UNLOCK_BUFFER;
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    getByte(&ptrCtx->ptrSendingLane->processBuffer, &ptrCtx->bufferProcessStatus, &ptrCtx->byteToWrite);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+                ptrCtx->frameCrc = updateFrameCrc(ptrCtx->frameCrc, ptrCtx->byteToWrite);
+                ptrCtx->tempBlock.bytes[ptrCtx->blockByteCount++] = ptrCtx->byteToWrite;
+                ptrCtx->byteCount--;
+            } while(ptrCtx->byteCount > 0 && ptrCtx->blockByteCount < BUS_FRAME_DENSE_GROUP_BYTES);
+            ptrCtx->tempBlock.bytes[ptrCtx->blockByteCount] = packDenseGroup(&ptrCtx->tempBlock.bytes[0], ptrCtx->blockByteCount);
+            for(i = 0; i <= ptrCtx->blockByteCount; i++) {
+                do {
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, ptrCtx->tempBlock.bytes[i]);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+            }
+            ptrCtx->frameWriterBlockCount++;
+            ptrCtx->busFrameWriterState = ptrCtx->byteCount ? BUS_FRAME_WRITER_DENSE_GROUP : BUS_FRAME_WRITER_WRITE_FRAME_CRC;
             break;
 
-        case BUS_FRAME_WRITER_UNLOCK_BUFFER:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            unlockWriteMainBuffer(&frameWriterProcessBuffer,&bufferProcessStatus);
-            if(bufferProcessStatus == BUFFER_OPERATION_OK) {
-                busFrameWriterState = BUS_FRAME_WRITER_WRITE_ENDCODE1;
-            } else {
-                busFrameWriterState = BUS_FRAME_WRITER_UNLOCK_BUFFER;
+        case BUS_FRAME_WRITER_WRITE_FRAME_CRC:
+            ptrCtx->tempBlock.bytes[0] = (ptrCtx->frameCrc >> 14) & 0x03;
+            ptrCtx->tempBlock.bytes[1] = (ptrCtx->frameCrc >> 7) & 0x7F;
+            ptrCtx->tempBlock.bytes[2] = ptrCtx->frameCrc & 0x7F;
+            for(i = 0; i < 3; i++) {
+                do {
+                    ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+                    putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, ptrCtx->tempBlock.bytes[i]);
+                } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
             }
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WRITE_ENDCODE1;
             break;
 
         case BUS_FRAME_WRITER_WRITE_ENDCODE1:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            byteToWrite = 0xE0 + outputBlockCount;
-            putByte(ptrSendBuffer,&bufferProcessStatus,byteToWrite);
-            busFrameWriterState = bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_WRITE_ENDCODE2 : BUS_FRAME_WRITER_WRITE_ENDCODE1;
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+            ptrCtx->byteToWrite = 0xE0 + ptrCtx->markerBlockCount;
+            putByte(ptrCtx->ptrSendBuffer,&ptrCtx->bufferProcessStatus,ptrCtx->byteToWrite);
+            ptrCtx->busFrameWriterState = ptrCtx->bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_WRITE_ENDCODE2 : BUS_FRAME_WRITER_WRITE_ENDCODE1;
             break;
 
         case BUS_FRAME_WRITER_WRITE_ENDCODE2:
-            bufferProcessStatus = BUFFER_OPERATION_NONE;
-            byteToWrite = 0xF0 + outputBlockCount;
-            putByte(ptrSendBuffer,&bufferProcessStatus,byteToWrite);
-            busFrameWriterState = bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_TRIGGER_LISTENER : BUS_FRAME_WRITER_WRITE_ENDCODE2;
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+            ptrCtx->byteToWrite = 0xF0 + ptrCtx->markerBlockCount;
+            putByte(ptrCtx->ptrSendBuffer,&ptrCtx->bufferProcessStatus,ptrCtx->byteToWrite);
+            ptrCtx->busFrameWriterState = ptrCtx->bufferProcessStatus == BUFFER_OPERATION_OK ? BUS_FRAME_WRITER_TRIGGER_LISTENER : BUS_FRAME_WRITER_WRITE_ENDCODE2;
             break;
 
         case BUS_FRAME_WRITER_TRIGGER_LISTENER:
-            *ptrSendListener = 1;
-            busFrameWriterState = BUS_FRAME_WRITER_WAIT_PROCESSED;
+            BUS_STAT_INC(ptrCtx, framesSent);
+            BUS_STAT_ADD(ptrCtx, bytesOut, getWrittenFrameSize(ptrCtx));
+#if BUS_FRAME_REPAIR_ENABLED
+            //Feedback can turn up before the application has drained the frame
+            ptrCtx->repairAwaiting = (ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) != 0;
+            ptrCtx->repairFeedbackReceived = 0;
+            startRepairWait(ptrCtx);
+#endif
+            if(isCoalescing(ptrCtx)) {
+                //Frame is whole in the send buffer, the listener hears about it with the rest of the batch
+                ptrCtx->coalescedBytes += getWrittenFrameSize(ptrCtx);
+                popSentFrame(ptrCtx);
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COALESCE;
+                break;
+            }
+            signalSendListener(ptrCtx);
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WAIT_PROCESSED;
+            //fall through
 
         case BUS_FRAME_WRITER_WAIT_PROCESSED:
-            if(!*ptrSendListener) {
-                busFrameWriterState = BUS_FRAME_WRITER_COMPLETE_RESET;
-                queuedFrameCount--;
+            if(!*ptrCtx->ptrSendListener) {
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COMPLETE_RESET;
+                popSentFrame(ptrCtx);
+            }
+            break;
+
+        case BUS_FRAME_WRITER_COALESCE:
+            //Frames already queued join the batch. With none, it's held until maxDelay after the last wakeup, so the first frame after a quiet spell goes straight out
+            if(ptrCtx->coalescedBytes == 0) {
+                //A direct write already woke the listener for everything in the buffer
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COALESCE_DRAIN;
+                break;
+            }
+            if(ptrCtx->coalescedBytes < ptrCtx->coalesceMaxBytes) {
+                if(ptrCtx->queuedFrameCount) {
+                    ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_CALCULATE_BLOCKS;
+                    break;
+                }
+                if(ptrCtx->ptrClock && (ptrCtx->ptrClock() - ptrCtx->lastFlushTick) < ptrCtx->coalesceMaxDelay) {
+                    break;
+                }
+            }
+            signalSendListener(ptrCtx);
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COALESCE_DRAIN;
+            break;
+
+        case BUS_FRAME_WRITER_COALESCE_DRAIN:
+            //Frames closed meanwhile wait here and go out as the next batch
+            if(!*ptrCtx->ptrSendListener) {
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COMPLETE_RESET;
             }
             break;
 
         case BUS_FRAME_WRITER_COMPLETE_RESET:
-            busFrameWriterFlags.writeTrigger = 0;
-            busFrameWriterState = BUS_FRAME_WRITER_NONE;
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->repairAwaiting) {
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WAIT_FEEDBACK;
+                break;
+            }
+#endif
+            if(ptrCtx->queuedFrameCount) {
+                //Frames closed while this one was going out, keep draining
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_CALCULATE_BLOCKS;
+            } else {
+                ptrCtx->busFrameWriterFlags.writeTrigger = 0;
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_NONE;
+            }
+            break;
+
+        case BUS_FRAME_WRITER_WAIT_FEEDBACK:
+            //Next frame holds off until the receiver says how the last one went, our own feedback still goes out meanwhile
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->feedbackPending) {
+                writeFeedbackFrame(ptrCtx);
+            }
+            if(ptrCtx->repairFeedbackReceived) {
+                ptrCtx->repairFeedbackReceived = 0;
+                ptrCtx->repairWaitSteps = 0;
+                if(countMissingBlocks(&ptrCtx->repairMissing[0], ptrCtx->repairBlockCount) == 0) {
+                    ptrCtx->repairAwaiting = 0;
+                } else if(ptrCtx->repairRounds++ < BUS_FRAME_REPAIR_MAX_ROUNDS) {
+                    ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WRITE_REPAIR;
+                    break;
+                } else {
+                    ptrCtx->repairAwaiting = 0;
+                    BUS_STAT_INC(ptrCtx, repairsAbandoned);
+                }
+            } else if(isRepairWaitOver(ptrCtx)) {
+                //Feedback lost somewhere, the frame is the application's problem again
+                ptrCtx->repairAwaiting = 0;
+                BUS_STAT_INC(ptrCtx, repairsAbandoned);
+            }
+            if(!ptrCtx->repairAwaiting) {
+                ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_COMPLETE_RESET;
+            }
+#endif
+            break;
+
+        case BUS_FRAME_WRITER_WRITE_REPAIR:
+            writeRepairFrame(ptrCtx);
+            ptrCtx->busFrameWriterState = BUS_FRAME_WRITER_WAIT_FEEDBACK;
             break;
 
         case BUS_FRAME_WRITER_PROCESS_ERROR:      
             break;
     }
+#if BUS_FRAME_TRACE_ENABLED
+    if(ptrCtx->ptrTrace && ptrCtx->busFrameWriterState != ptrCtx->lastState) {
+        recordBusFrameTrace(ptrCtx->ptrTrace, BUS_TRACE_WRITER_STATE, ptrCtx->traceBus, ptrCtx->lastState, ptrCtx->busFrameWriterState, 0);
+        ptrCtx->lastState = ptrCtx->busFrameWriterState;
+        ptrCtx->traceCount++;
+    }
+#endif
 }
 
-void openBusFrame(eBusFrameWriterOperationStatus *ptrStatus) {
-    if(busFrameWriterFlags.frameOpen) {
+//Keeps stepping until a step makes no progress (nothing queued, send buffer full or frame waiting on the listener) or stepBudget runs out. Returns the steps taken
+unsigned int runBusFrameWriterBudgetCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget) {
+    unsigned int steps = 0;
+    eBusFrameWriterState previousState;
+    unsigned int previousByteCount;
+    *ptrStatus = BUS_FRAME_WRITER_RUN_BUDGET_SPENT;
+    while(steps < stepBudget) {
+        previousState = ptrCtx->busFrameWriterState;
+        previousByteCount = ptrCtx->byteCount;
+        runBusFrameWriterCtx(ptrCtx);
+        steps++;
+        if(ptrCtx->busFrameWriterState != previousState || ptrCtx->byteCount != previousByteCount) {
+            continue;
+        }
+        switch(ptrCtx->busFrameWriterState) {
+            case BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER:
+                *ptrStatus = BUS_FRAME_WRITER_RUN_IDLE;
+                break;
+            case BUS_FRAME_WRITER_WAIT_PROCESSED:
+            case BUS_FRAME_WRITER_COALESCE_DRAIN:
+                *ptrStatus = BUS_FRAME_WRITER_RUN_WAITING_APPLICATION;
+                break;
+            case BUS_FRAME_WRITER_COALESCE:
+                *ptrStatus = BUS_FRAME_WRITER_RUN_COALESCING;
+                break;
+            case BUS_FRAME_WRITER_WAIT_FEEDBACK:
+                *ptrStatus = BUS_FRAME_WRITER_RUN_WAITING_FEEDBACK;
+                break;
+            default:
+                *ptrStatus = BUS_FRAME_WRITER_RUN_WAITING_OUTPUT;
+                break;
+        }
+        break;
+    }
+    return steps;
+}
+
+void openBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus) {
+    openBusFrameWithFormatCtx(ptrCtx, ptrStatus, 0);
+}
+
+//format is BUS_FRAME_FORMAT_DENSE for the packed encoding, 0 for the block encoding
+void openBusFrameWithFormatCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format) {
+    openBusFrameWithPriorityCtx(ptrCtx, ptrStatus, format, BUS_FRAME_PRIORITY_BULK);
+}
+
+//Control frames go out at the next frame boundary ahead of any bulk frames still queued, and don't wait for sendFramesInBuffer
+void openBusFrameWithPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority) {
+    tBusFrameWriterLane *ptrLane = getWriterLane(ptrCtx, priority);
+    if(ptrCtx->busFrameWriterFlags.frameOpen || ptrLane->queuedFrameCount >= FRAME_WRITER_MAX_QUEUED_FRAMES) {
         *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
         return;
     }
-    busFrameWriterFlags.frameOpen = 1;
+    ptrLane->frameQueue[ptrLane->frameQueueTail].length = 0;
+    ptrLane->frameQueue[ptrLane->frameQueueTail].format = format & BUS_FRAME_FORMAT_DENSE;
+    ptrCtx->ptrOpenLane = ptrLane;
+    ptrCtx->busFrameWriterFlags.frameOpen = 1;
     *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
 }
 
-void writeToBusFrame(eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte) {
-    if(!busFrameWriterFlags.frameOpen) {
+void writeToBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte) {
+    tBusFrameWriterLane *ptrLane = ptrCtx->ptrOpenLane;
+    if(!ptrCtx->busFrameWriterFlags.frameOpen || ptrLane->frameQueue[ptrLane->frameQueueTail].length >= FRAME_WRITER_MAX_PAYLOAD) {
         *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
         return;
     }
-    bufferWriteStatus = BUFFER_OPERATION_NONE;
-    putByte(&frameWriterProcessBuffer,&bufferWriteStatus,byte);
-    if(bufferWriteStatus != BUFFER_OPERATION_OK) {
+    ptrCtx->bufferWriteStatus = BUFFER_OPERATION_NONE;
+    putByte(&ptrLane->processBuffer,&ptrCtx->bufferWriteStatus,byte);
+    if(ptrCtx->bufferWriteStatus != BUFFER_OPERATION_OK) {
         *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
     } else {
+        ptrLane->frameQueue[ptrLane->frameQueueTail].length++;
         *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
     }
 }
 
-void closeBusFrame(eBusFrameWriterOperationStatus *ptrStatus) {
-    if(!busFrameWriterFlags.frameOpen) {
+void closeBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus) {
+    if(!ptrCtx->busFrameWriterFlags.frameOpen) {
         *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
         return;
     }
-    busFrameWriterFlags.frameOpen = 0;
-    queuedFrameCount++;
+    ptrCtx->busFrameWriterFlags.frameOpen = 0;
+    queueWriterFrame(ptrCtx, ptrCtx->ptrOpenLane);
     *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
 }
 
-unsigned char getQueuedFrameCount(void) {
-    return queuedFrameCount;
+unsigned char getQueuedFrameCountCtx(tBusFrameWriterCtx *ptrCtx) {
+    return ptrCtx->queuedFrameCount;
 }
 
-unsigned char isWriteDone(void) {
-    return busFrameWriterFlags.writeTrigger;
+//Closed frames waiting in one class's lane, the one on its way out included. Without FRAME_WRITER_PRIORITY_ENABLED both classes report the shared lane
+unsigned char getQueuedFrameCountByPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFramePriority priority) {
+    return getWriterLane(ptrCtx, priority)->queuedFrameCount;
 }
 
-void sendFramesInBuffer(eBusFrameWriterOperationStatus *ptrStatus) {
-    if(busFrameWriterFlags.writeTrigger) {
+unsigned char isWriteDoneCtx(tBusFrameWriterCtx *ptrCtx) {
+    return ptrCtx->busFrameWriterFlags.writeTrigger;
+}
+
+void sendFramesInBufferCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus) {
+    //Already draining is fine, frames closed since will be picked up in order
+    ptrCtx->busFrameWriterFlags.writeTrigger = 1;
+    wakeBusFrameWriter(ptrCtx);
+    *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
+}
+
+void registerSendFrameBufferCtx(tBusFrameWriterCtx *ptrCtx, tBuffer *ptrBuffer) {
+    ptrCtx->ptrSendBuffer = ptrBuffer;
+}
+void registerSendFrameListenerCtx(tBusFrameWriterCtx *ptrCtx, unsigned char *ptrListener) {
+    ptrCtx->ptrSendListener = ptrListener;
+}
+
+//Encodes the whole frame from the caller's memory straight into the send buffer, bypassing the process buffer and the state machine. Only while nothing is queued, so frames can't interleave
+void writeBusFrameDirectCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    tBusFrameEncoder encoder;
+    unsigned char piece[8];
+    unsigned char pieceLength;
+    unsigned char i;
+
+    //Repair, feedback and compressed frames are the writer's own, a caller only picks the encoding
+    format &= BUS_FRAME_FORMAT_KNOWN;
+    if(ptrCtx->queuedFrameCount || length > FRAME_WRITER_MAX_PAYLOAD) {
         *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
         return;
     }
-    busFrameWriterFlags.writeTrigger = 1;
+    startBusFrameEncoder(&encoder, ptrPayload, length, format);
+    startReversibleWrite(ptrCtx->ptrSendBuffer);
+    while((pieceLength = encodeBusFramePiece(&encoder, &piece[0]))) {
+        for(i = 0; i < pieceLength; i++) {
+            ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+            putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, piece[i]);
+            if(ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK) {
+                //Not enough room for the whole frame, leave the send buffer as it was
+                reverseWrite(ptrCtx->ptrSendBuffer);
+                *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+                BUS_STAT_INC(ptrCtx, writeRejections);
+                return;
+            }
+        }
+    }
+    completeReversibleWrite(ptrCtx->ptrSendBuffer);
+    BUS_STAT_INC(ptrCtx, framesSent);
+    BUS_STAT_ADD(ptrCtx, bytesOut, getEncodedBusFrameSize(length, format));
+    signalSendListener(ptrCtx);
     *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
 }
 
-void registerSendFrameBuffer(tBuffer *ptrBuffer) {
-    ptrSendBuffer = ptrBuffer;
+//Queues a whole frame like open/write/close, compressed against the last frame of its message type when that comes out smaller on the wire. Both ends need BUS_FRAME_COMPRESSION_ENABLED, without it the frame just goes out as it is
+void writeBusFrameCompressedCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    tBusFrameWriterLane *ptrLane = &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK];
+    const unsigned char *ptrBytes = ptrPayload;
+    unsigned int byteCount = length;
+    unsigned int i;
+#if BUS_FRAME_COMPRESSION_ENABLED
+    tBusFrameCompressStream *ptrStream = 0;
+    unsigned int compressedLength = 0;
+#endif
+
+    format &= BUS_FRAME_FORMAT_DENSE;
+    if(ptrCtx->busFrameWriterFlags.frameOpen || ptrLane->queuedFrameCount >= FRAME_WRITER_MAX_QUEUED_FRAMES || length > FRAME_WRITER_MAX_PAYLOAD) {
+        *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+        BUS_STAT_INC(ptrCtx, writeRejections);
+        return;
+    }
+#if BUS_FRAME_COMPRESSION_ENABLED
+    if(length && length <= BUS_FRAME_COMPRESSION_MAX_REFERENCE) {
+        ptrStream = &ptrCtx->compressStreams[ptrPayload[0] % BUS_FRAME_COMPRESSION_STREAMS];
+        compressedLength = compressBusFramePayload(ptrStream, ptrPayload, length, &ptrCtx->compressStaging[0], BUS_FRAME_COMPRESS_MAX_OUTPUT);
+        //Whole frames always go compressed, they're what both ends' deltas are made against. Deltas only when they come out smaller on the wire
+        if(compressedLength && (!(ptrCtx->compressStaging[0] & BUS_FRAME_COMPRESS_DELTA) ||
+                getEncodedBusFrameSize(compressedLength, format | BUS_FRAME_FORMAT_COMPRESSED) < getEncodedBusFrameSize(length, format))) {
+            ptrBytes = &ptrCtx->compressStaging[0];
+            byteCount = compressedLength;
+            format |= BUS_FRAME_FORMAT_COMPRESSED;
+        }
+    }
+#endif
+    startReversibleWrite(&ptrLane->processBuffer);
+    for(i = 0; i < byteCount; i++) {
+        ptrCtx->bufferWriteStatus = BUFFER_OPERATION_NONE;
+        putByte(&ptrLane->processBuffer, &ptrCtx->bufferWriteStatus, ptrBytes[i]);
+        if(ptrCtx->bufferWriteStatus != BUFFER_OPERATION_OK) {
+            //Half a compressed frame is worse than none, the stream is only moved on once it's queued
+            reverseWrite(&ptrLane->processBuffer);
+            *ptrStatus = BUS_FRAME_WRITER_ERROR_WRITING;
+            BUS_STAT_INC(ptrCtx, writeRejections);
+            return;
+        }
+    }
+    completeReversibleWrite(&ptrLane->processBuffer);
+    ptrLane->frameQueue[ptrLane->frameQueueTail].length = byteCount;
+    ptrLane->frameQueue[ptrLane->frameQueueTail].format = format;
+    queueWriterFrame(ptrCtx, ptrLane);
+#if BUS_FRAME_COMPRESSION_ENABLED
+    if(format & BUS_FRAME_FORMAT_COMPRESSED) {
+        commitBusFrameReference(ptrStream, ptrCtx->compressStaging[0], ptrPayload, length);
+        BUS_STAT_INC(ptrCtx, framesCompressed);
+        BUS_STAT_ADD(ptrCtx, compressionBytesSaved, length > compressedLength ? length - compressedLength : 0);
+    }
+#endif
+    *ptrStatus = BUS_FRAME_WRITER_OPERATION_OK;
+}
+
+//Ticks for the coalescing delay, 0 = no clock (batches are then just whatever was already queued)
+void registerBusFrameWriterClockCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameClock clock) {
+    ptrCtx->ptrClock = clock;
+    if(clock) {
+        ptrCtx->lastFlushTick = clock() - ptrCtx->coalesceMaxDelay;
+    }
+}
+
+//Finished frames pile up in the send buffer and the listener is set once per batch: at maxBytes, or maxDelay ticks after the last wakeup. maxBytes 0 = off, a wakeup per frame
+void setBusFrameCoalescingCtx(tBusFrameWriterCtx *ptrCtx, unsigned int maxBytes, unsigned long maxDelay) {
+    ptrCtx->coalesceMaxBytes = maxBytes;
+    ptrCtx->coalesceMaxDelay = maxDelay;
+    if(ptrCtx->ptrClock) {
+        ptrCtx->lastFlushTick = ptrCtx->ptrClock() - maxDelay;
+    }
+}
+
+//Writer transitions go into ptrTrace tagged with bus, the same number as the handler for this bus keeps the timelines together. 0 stops tracing
+void registerBusFrameWriterTraceCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus) {
+#if BUS_FRAME_TRACE_ENABLED
+    ptrCtx->ptrTrace = ptrTrace;
+    ptrCtx->traceBus = bus;
+    ptrCtx->lastState = ptrCtx->busFrameWriterState;
+#else
+    (void)ptrCtx;
+    (void)ptrTrace;
+    (void)bus;
+#endif
+}
+
+//1 = block frames that fit BUS_FRAME_REPAIR_MAX_BLOCKS wait for an ACK/NACK and get their bad blocks resent. Both ends need BUS_FRAME_REPAIR_ENABLED
+void setBusFrameRepairModeCtx(tBusFrameWriterCtx *ptrCtx, unsigned char enabled) {
+#if BUS_FRAME_REPAIR_ENABLED
+    ptrCtx->repairEnabled = enabled;
+#else
+    (void)ptrCtx;
+    (void)enabled;
+#endif
+}
+
+//What another step would be waiting on, same thread as runBusFrameWriter. Anything but BLOCKED_NONE, the loop can sleep until the wake hook fires or the deadline passes. Whoever drains the send buffer and clears the send listener has to wake the loop itself. A feedback wait counted in steps only runs out while stepped, use BUS_FRAME_REPAIR_WAIT_TICKS
+void getBusFrameWriterWaitCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterWait *ptrWait) {
+    ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_NONE;
+    ptrWait->hasDeadline = 0;
+    ptrWait->deadline = 0;
+    switch(ptrCtx->busFrameWriterState) {
+        case BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER:
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->feedbackPending) {
+                break;
+            }
+#endif
+            if(!ptrCtx->busFrameWriterFlags.writeTrigger) {
+                ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_FRAMES;
+            }
+            break;
+
+        case BUS_FRAME_WRITER_WRITE_STARTCODE1:
+        case BUS_FRAME_WRITER_WRITE_STARTCODE2:
+        case BUS_FRAME_WRITER_WRITE_ENDCODE1:
+        case BUS_FRAME_WRITER_WRITE_ENDCODE2:
+            //The only states that give up a step when the send buffer is full, the rest wait inside it
+            if(ptrCtx->bufferProcessStatus != BUFFER_OPERATION_NONE && ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK) {
+                ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_OUTPUT;
+            }
+            break;
+
+        case BUS_FRAME_WRITER_WAIT_PROCESSED:
+        case BUS_FRAME_WRITER_COALESCE_DRAIN:
+            if(*ptrCtx->ptrSendListener) {
+                ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_OUTPUT;
+            }
+            break;
+
+        case BUS_FRAME_WRITER_COALESCE:
+            if(ptrCtx->coalescedBytes && ptrCtx->coalescedBytes < ptrCtx->coalesceMaxBytes && !ptrCtx->queuedFrameCount &&
+                    ptrCtx->ptrClock && (ptrCtx->ptrClock() - ptrCtx->lastFlushTick) < ptrCtx->coalesceMaxDelay) {
+                ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_COALESCING;
+                ptrWait->hasDeadline = 1;
+                ptrWait->deadline = ptrCtx->lastFlushTick + ptrCtx->coalesceMaxDelay;
+            }
+            break;
+
+        case BUS_FRAME_WRITER_WAIT_FEEDBACK:
+#if BUS_FRAME_REPAIR_ENABLED
+            if(ptrCtx->feedbackPending || ptrCtx->repairFeedbackReceived) {
+                break;
+            }
+            ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_FEEDBACK;
+#if BUS_FRAME_REPAIR_WAIT_TICKS
+            if(ptrCtx->ptrClock) {
+                ptrWait->hasDeadline = 1;
+                ptrWait->deadline = ptrCtx->repairWaitStart + BUS_FRAME_REPAIR_WAIT_TICKS;
+            }
+#endif
+#endif
+            break;
+
+        case BUS_FRAME_WRITER_PROCESS_ERROR:
+            ptrWait->reason = BUS_FRAME_WRITER_BLOCKED_FRAMES; //Nothing moves it until the writer is initialised again
+            break;
+
+        default:
+            break;
+    }
+}
+
+//Called with ptrArgument when frames are released to the writer, feedback arrives, a frame joins a held batch or the send listener is set. 0 unregisters
+void registerBusFrameWriterWakeHookCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument) {
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    ptrCtx->ptrWakeArgument = ptrArgument;
+    ptrCtx->wakeHook = hook;
+#else
+    (void)ptrCtx;
+    (void)hook;
+    (void)ptrArgument;
+#endif
+}
+
+void wakeBusFrameWriter(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    if(ptrCtx->wakeHook) {
+        ptrCtx->wakeHook(ptrCtx->ptrWakeArgument);
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//From this end's handler: tell the far end how its frame arrived, ptrMissing is a bitmap of bad block indexes. Goes out at the next frame boundary
+void queueBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned char i;
+    for(i = 0; i < BUS_FRAME_REPAIR_BITMAP_BYTES; i++) {
+        ptrCtx->feedbackMissing[i] = ptrMissing[i];
+    }
+    ptrCtx->feedbackSequence = sequence;
+    ptrCtx->feedbackPending = 1;
+    wakeBusFrameWriter(ptrCtx);
+#else
+    (void)ptrCtx;
+    (void)sequence;
+    (void)ptrMissing;
+#endif
+}
+
+//From this end's handler: the far end's verdict on our last frame. Anything but the frame we're holding on to is stale and ignored
+void applyBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned char i;
+    if(!ptrCtx->repairAwaiting || sequence != ptrCtx->repairSequence) {
+        return;
+    }
+    for(i = 0; i < BUS_FRAME_REPAIR_BITMAP_BYTES; i++) {
+        ptrCtx->repairMissing[i] = ptrMissing[i];
+    }
+    ptrCtx->repairFeedbackReceived = 1;
+    wakeBusFrameWriter(ptrCtx);
+#else
+    (void)ptrCtx;
+    (void)sequence;
+    (void)ptrMissing;
+#endif
+}
+
+void writeSendByte(tBusFrameWriterCtx *ptrCtx, unsigned char byte) {
+    do {
+        ptrCtx->bufferProcessStatus = BUFFER_OPERATION_NONE;
+        putByte(ptrCtx->ptrSendBuffer, &ptrCtx->bufferProcessStatus, byte);
+    } while (ptrCtx->bufferProcessStatus != BUFFER_OPERATION_OK);
+}
+
+void signalSendListener(tBusFrameWriterCtx *ptrCtx) {
+    *ptrCtx->ptrSendListener = 1;
+    ptrCtx->coalescedBytes = 0;
+    if(ptrCtx->ptrClock) {
+        ptrCtx->lastFlushTick = ptrCtx->ptrClock();
+    }
+    BUS_STAT_INC(ptrCtx, listenerWakeups);
+    wakeBusFrameWriter(ptrCtx);
+}
+
+unsigned char isCoalescing(tBusFrameWriterCtx *ptrCtx) {
+#if FRAME_WRITER_PRIORITY_ENABLED
+    if(ptrCtx->ptrSendingLane != &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK]) {
+        return 0; //Control frames wake the listener now, taking the batch so far with them
+    }
+#endif
+#if BUS_FRAME_REPAIR_ENABLED
+    if(ptrCtx->repairAwaiting) {
+        return 0; //Straight out, the far end can't answer a frame it hasn't been sent
+    }
+#endif
+    return ptrCtx->coalesceMaxBytes != 0;
+}
+
+//Wire bytes of the frame the state machine just finished
+unsigned int getWrittenFrameSize(tBusFrameWriterCtx *ptrCtx) {
+    if(ptrCtx->frameFormat & BUS_FRAME_FORMAT_DENSE) {
+        return 4 + 3 + ptrCtx->headerCount + ptrCtx->frameWriterBlockCount + 3;
+    }
+    return 4 + (ptrCtx->frameFormat ? 3 : 0) + ((ptrCtx->frameFormat & BUS_FRAME_FORMAT_ACK_REQUEST) ? 1 : 0) + (ptrCtx->outputBlockCount * 8);
+}
+
+tBusFrameWriterLane *getWriterLane(tBusFrameWriterCtx *ptrCtx, eBusFramePriority priority) {
+#if FRAME_WRITER_PRIORITY_ENABLED
+    if(priority == BUS_FRAME_PRIORITY_CONTROL) {
+        return &ptrCtx->lanes[BUS_FRAME_PRIORITY_CONTROL];
+    }
+#else
+    (void)priority;
+#endif
+    return &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK];
+}
+
+//Highest class with a closed frame waiting
+tBusFrameWriterLane *pickSendingLane(tBusFrameWriterCtx *ptrCtx) {
+#if FRAME_WRITER_PRIORITY_ENABLED
+    if(ptrCtx->lanes[BUS_FRAME_PRIORITY_CONTROL].queuedFrameCount) {
+        if(ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK].queuedFrameCount) {
+            BUS_STAT_INC(ptrCtx, framesPreempting);
+        }
+        return &ptrCtx->lanes[BUS_FRAME_PRIORITY_CONTROL];
+    }
+#endif
+    return &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK];
+}
+
+//Frame at the lane's tail is complete
+void queueWriterFrame(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterLane *ptrLane) {
+    ptrLane->frameQueueTail = (ptrLane->frameQueueTail + 1) % FRAME_WRITER_MAX_QUEUED_FRAMES;
+    ptrLane->queuedFrameCount++;
+    ptrCtx->queuedFrameCount++;
+#if BUS_FRAME_STATS_ENABLED
+    if(ptrLane->queuedFrameCount > ptrCtx->stats.queueHighWater[ptrLane - &ptrCtx->lanes[0]]) {
+        ptrCtx->stats.queueHighWater[ptrLane - &ptrCtx->lanes[0]] = ptrLane->queuedFrameCount;
+    }
+#endif
+    if(ptrLane != &ptrCtx->lanes[BUS_FRAME_PRIORITY_BULK]) {
+        //Control frames start the writer themselves, bulk frames already closed follow them out
+        ptrCtx->busFrameWriterFlags.writeTrigger = 1;
+        wakeBusFrameWriter(ptrCtx);
+    } else if(ptrCtx->busFrameWriterState == BUS_FRAME_WRITER_COALESCE) {
+        wakeBusFrameWriter(ptrCtx); //Joins the batch being held
+    }
+}
+
+void popSentFrame(tBusFrameWriterCtx *ptrCtx) {
+    ptrCtx->ptrSendingLane->frameQueueHead = (ptrCtx->ptrSendingLane->frameQueueHead + 1) % FRAME_WRITER_MAX_QUEUED_FRAMES;
+    ptrCtx->ptrSendingLane->queuedFrameCount--;
+    ptrCtx->queuedFrameCount--;
+}
+
+void writeFeedbackFrame(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int count = countMissingBlocks(&ptrCtx->feedbackMissing[0], BUS_FRAME_REPAIR_MAX_BLOCKS);
+    unsigned int crc = BUS_FRAME_CRC16_INIT;
+    unsigned int i;
+
+    ptrCtx->feedbackPending = 0;
+    ptrCtx->tempBlock.bytes[0] = (count >> 7) & 0x7F;
+    ptrCtx->tempBlock.bytes[1] = count & 0x7F;
+    ptrCtx->tempBlock.bytes[2] = ptrCtx->feedbackSequence;
+    writeSendByte(ptrCtx, 0xC0);
+    writeSendByte(ptrCtx, 0xD0);
+    writeSendByte(ptrCtx, BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_FEEDBACK);
+    for(i = 0; i < 3; i++) {
+        crc = updateFrameCrc(crc, ptrCtx->tempBlock.bytes[i]);
+        writeSendByte(ptrCtx, ptrCtx->tempBlock.bytes[i]);
+    }
+    for(i = 0; i < BUS_FRAME_REPAIR_MAX_BLOCKS; i++) {
+        if(BUS_FRAME_REPAIR_BIT(ptrCtx->feedbackMissing, i)) {
+            ptrCtx->tempBlock.bytes[0] = (i >> 7) & 0x7F;
+            ptrCtx->tempBlock.bytes[1] = i & 0x7F;
+            crc = updateFrameCrc(crc, ptrCtx->tempBlock.bytes[0]);
+            crc = updateFrameCrc(crc, ptrCtx->tempBlock.bytes[1]);
+            writeSendByte(ptrCtx, ptrCtx->tempBlock.bytes[0]);
+            writeSendByte(ptrCtx, ptrCtx->tempBlock.bytes[1]);
+        }
+    }
+    writeSendByte(ptrCtx, (crc >> 14) & 0x03);
+    writeSendByte(ptrCtx, (crc >> 7) & 0x7F);
+    writeSendByte(ptrCtx, crc & 0x7F);
+    writeSendByte(ptrCtx, 0xE0);
+    writeSendByte(ptrCtx, 0xF0);
+    BUS_STAT_ADD(ptrCtx, bytesOut, 4 + 4 + (count * 2) + 3);
+    signalSendListener(ptrCtx);
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//Only the NACKed blocks, straight from the copy kept when the frame went out
+void writeRepairFrame(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned int count = countMissingBlocks(&ptrCtx->repairMissing[0], ptrCtx->repairBlockCount);
+    unsigned int i;
+    unsigned char j;
+
+    writeSendByte(ptrCtx, 0xC0);
+    writeSendByte(ptrCtx, 0xD0);
+    writeSendByte(ptrCtx, BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_ACK_REQUEST | BUS_FRAME_FORMAT_REPAIR);
+    writeSendByte(ptrCtx, (count >> 7) & 0x7F);
+    writeSendByte(ptrCtx, count & 0x7F);
+    writeSendByte(ptrCtx, ptrCtx->repairSequence);
+    for(i = 0; i < ptrCtx->repairBlockCount; i++) {
+        if(BUS_FRAME_REPAIR_BIT(ptrCtx->repairMissing, i)) {
+            for(j = 0; j < 8; j++) {
+                writeSendByte(ptrCtx, ptrCtx->repairBlocks[i][j]);
+            }
+            BUS_STAT_INC(ptrCtx, blocksResent);
+        }
+    }
+    writeSendByte(ptrCtx, 0xE0);
+    writeSendByte(ptrCtx, 0xF0);
+    BUS_STAT_ADD(ptrCtx, bytesOut, 4 + 4 + (count * 8));
+    signalSendListener(ptrCtx);
+    startRepairWait(ptrCtx);
+#else
+    (void)ptrCtx;
+#endif
+}
+
+//From when the frame or its repair went out
+void startRepairWait(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+    ptrCtx->repairWaitSteps = 0;
+    if(ptrCtx->ptrClock) {
+        ptrCtx->repairWaitStart = ptrCtx->ptrClock();
+    }
+#else
+    (void)ptrCtx;
+#endif
+}
+
+unsigned char isRepairWaitOver(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_REPAIR_ENABLED
+#if BUS_FRAME_REPAIR_WAIT_TICKS
+    if(ptrCtx->ptrClock) {
+        return (ptrCtx->ptrClock() - ptrCtx->repairWaitStart) >= BUS_FRAME_REPAIR_WAIT_TICKS;
+    }
+#endif
+    return ++ptrCtx->repairWaitSteps >= BUS_FRAME_REPAIR_WAIT_STEPS;
+#else
+    (void)ptrCtx;
+    return 1;
+#endif
+}
+
+unsigned int countMissingBlocks(const unsigned char *ptrMissing, unsigned int blockCount) {
+    unsigned int count = 0;
+    unsigned int i;
+    for(i = 0; i < blockCount; i++) {
+        if(BUS_FRAME_REPAIR_BIT(ptrMissing, i)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+//Wire size of a frame, 0 if the payload is too long to send
+unsigned int getEncodedBusFrameSize(unsigned int length, unsigned char format) {
+    unsigned int blocks;
+    if(length > MAX_JUMBO_UNPACKED_PAYLOAD) {
+        return 0;
+    }
+    if(format & BUS_FRAME_FORMAT_DENSE) {
+        return 4 + 3 + length + ((length + BUS_FRAME_DENSE_GROUP_BYTES - 1) / BUS_FRAME_DENSE_GROUP_BYTES) + 3;
+    }
+    blocks = (length / 6) + ((length % 6) > 0);
+    return 4 + ((blocks > 0x0F || (format & BUS_FRAME_FORMAT_COMPRESSED)) ? 3 : 0) + (blocks * 8);
+}
+
+//Stateless, encodes straight into the caller's span. Returns the bytes written, 0 if the frame doesn't fit
+unsigned int encodeBusFrame(const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrOutput, unsigned int outputSize) {
+    tBusFrameEncoder encoder;
+    unsigned int written = 0;
+    unsigned int size;
+    unsigned char pieceLength;
+
+    format &= BUS_FRAME_FORMAT_KNOWN;
+    size = getEncodedBusFrameSize(length, format);
+    if(size == 0 || size > outputSize) {
+        return 0;
+    }
+    startBusFrameEncoder(&encoder, ptrPayload, length, format);
+    while((pieceLength = encodeBusFramePiece(&encoder, ptrOutput + written))) {
+        written += pieceLength;
+        if(encoder.phase == BUS_FRAME_ENCODE_BODY && !(encoder.frameFormat & BUS_FRAME_FORMAT_DENSE)) {
+            //Whole frame is in the caller's span, so all the blocks go in one pass rather than a piece each
+            written += encodeBusFrameBlocks(ptrPayload, length, ptrOutput + written) * 8;
+            encoder.phase = BUS_FRAME_ENCODE_TAIL;
+        }
+    }
+    return written;
+}
+
+//Same format choice as CALCULATE_BLOCKS
+void startBusFrameEncoder(tBusFrameEncoder *ptrEncoder, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    ptrEncoder->ptrPayload = ptrPayload;
+    ptrEncoder->length = length;
+    ptrEncoder->position = 0;
+    ptrEncoder->headerCount = (length / 6) + ((length % 6) > 0);
+    ptrEncoder->frameFormat = ptrEncoder->headerCount > 0x0F ? BUS_FRAME_FORMAT_JUMBO : 0;
+    if(format & BUS_FRAME_FORMAT_DENSE) {
+        ptrEncoder->frameFormat = BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_DENSE;
+        ptrEncoder->headerCount = length;
+    }
+    if(format & BUS_FRAME_FORMAT_COMPRESSED) {
+        ptrEncoder->frameFormat |= BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_COMPRESSED;
+    }
+    ptrEncoder->markerBlockCount = ptrEncoder->frameFormat ? 0 : ptrEncoder->headerCount;
+    ptrEncoder->frameCrc = BUS_FRAME_CRC16_INIT;
+    ptrEncoder->phase = BUS_FRAME_ENCODE_HEAD;
+}
+
+//Next piece of wire bytes: start codes and header, one block or dense group, then CRC and end codes. Returns 0 once the frame is done
+unsigned char encodeBusFramePiece(tBusFrameEncoder *ptrEncoder, unsigned char *ptrPiece) {
+    unsigned char take;
+    unsigned char i;
+    switch(ptrEncoder->phase) {
+        case BUS_FRAME_ENCODE_HEAD:
+            ptrPiece[0] = 0xC0 + ptrEncoder->markerBlockCount;
+            ptrPiece[1] = 0xD0 + ptrEncoder->markerBlockCount;
+            ptrEncoder->phase = ptrEncoder->length ? BUS_FRAME_ENCODE_BODY : BUS_FRAME_ENCODE_TAIL;
+            if(!ptrEncoder->frameFormat) {
+                return 2;
+            }
+            ptrPiece[2] = ptrEncoder->frameFormat;
+            ptrPiece[3] = (ptrEncoder->headerCount >> 7) & 0x7F;
+            ptrPiece[4] = ptrEncoder->headerCount & 0x7F;
+            return 5;
+
+        case BUS_FRAME_ENCODE_BODY:
+            if(ptrEncoder->frameFormat & BUS_FRAME_FORMAT_DENSE) {
+                take = ptrEncoder->length - ptrEncoder->position < BUS_FRAME_DENSE_GROUP_BYTES ? ptrEncoder->length - ptrEncoder->position : BUS_FRAME_DENSE_GROUP_BYTES;
+                for(i = 0; i < take; i++) {
+                    ptrPiece[i] = ptrEncoder->ptrPayload[ptrEncoder->position + i];
+                    ptrEncoder->frameCrc = updateFrameCrc(ptrEncoder->frameCrc, ptrPiece[i]);
+                }
+                ptrPiece[take] = packDenseGroup(ptrPiece, take);
+                i = take + 1;
+            } else {
+                take = ptrEncoder->length - ptrEncoder->position < 6 ? ptrEncoder->length - ptrEncoder->position : 6;
+                encodeBusFrameBlocks(ptrEncoder->ptrPayload + ptrEncoder->position, take, ptrPiece);
+                i = 8;
+            }
+            ptrEncoder->position += take;
+            if(ptrEncoder->position >= ptrEncoder->length) {
+                ptrEncoder->phase = BUS_FRAME_ENCODE_TAIL;
+            }
+            return i;
+
+        case BUS_FRAME_ENCODE_TAIL:
+            ptrEncoder->phase = BUS_FRAME_ENCODE_DONE;
+            if(!(ptrEncoder->frameFormat & BUS_FRAME_FORMAT_DENSE)) {
+                ptrPiece[0] = 0xE0 + ptrEncoder->markerBlockCount;
+                ptrPiece[1] = 0xF0 + ptrEncoder->markerBlockCount;
+                return 2;
+            }
+            ptrPiece[0] = (ptrEncoder->frameCrc >> 14) & 0x03;
+            ptrPiece[1] = (ptrEncoder->frameCrc >> 7) & 0x7F;
+            ptrPiece[2] = ptrEncoder->frameCrc & 0x7F;
+            ptrPiece[3] = 0xE0;
+            ptrPiece[4] = 0xF0;
+            return 5;
+
+        case BUS_FRAME_ENCODE_DONE:
+            break;
+    }
+    return 0;
+}
+
+//Call from whichever thread runs this bus, counters aren't updated atomically
+void snapshotBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterStats *ptrStats) {
+#if BUS_FRAME_STATS_ENABLED
+    *ptrStats = ptrCtx->stats;
+#else
+    tBusFrameWriterStats emptyStats = {0};
+    (void)ptrCtx;
+    *ptrStats = emptyStats;
+#endif
+}
+
+void resetBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx) {
+#if BUS_FRAME_STATS_ENABLED
+    tBusFrameWriterStats emptyStats = {0};
+    ptrCtx->stats = emptyStats;
+#else
+    (void)ptrCtx;
+#endif
 }
-void registerSendFrameListener(unsigned char *ptrListener) {
-    ptrSendListener = ptrListener;
-}
\ No newline at end of file
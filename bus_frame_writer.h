@@ -3,16 +3,60 @@
 
 #include "../ring-buffer/ring_buffer_types.h"
 #include "bus_frame_writer_status.h"
+#include "bus_frame_writer_types.h"
 
 extern void initialiseBusFrameWriter(void);
 extern void runBusFrameWriter(void);
+extern unsigned int runBusFrameWriterBudget(eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget);
 extern void registerSendFrameBuffer(tBuffer *ptrBuffer);
 extern void registerSendFrameListener(unsigned char *ptrListener);
 extern void openBusFrame(eBusFrameWriterOperationStatus *ptrStatus);
+extern void openBusFrameWithFormat(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format);
+extern void openBusFrameWithPriority(eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority);
 extern void writeToBusFrame(eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte);
 extern void closeBusFrame(eBusFrameWriterOperationStatus *ptrStatus);
 extern void sendFramesInBuffer(eBusFrameWriterOperationStatus *ptrStatus);
 extern unsigned char getQueuedFrameCount(void);
+extern unsigned char getQueuedFrameCountByPriority(eBusFramePriority priority);
+extern void writeBusFrameDirect(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+extern void writeBusFrameCompressed(eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+extern unsigned int getEncodedBusFrameSize(unsigned int length, unsigned char format);
+extern unsigned int encodeBusFrame(const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrOutput, unsigned int outputSize);
+extern void setBusFrameRepairMode(unsigned char enabled);
+extern void registerBusFrameWriterClock(tBusFrameClock clock);
+extern void setBusFrameCoalescing(unsigned int maxBytes, unsigned long maxDelay);
+extern void registerBusFrameWriterTrace(void);
+extern void queueBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing);
+extern void applyBusFrameFeedback(unsigned char sequence, const unsigned char *ptrMissing);
+extern void getBusFrameWriterWait(tBusFrameWriterWait *ptrWait);
+extern void registerBusFrameWriterWakeHook(tBusFrameWakeHook hook, void *ptrArgument);
+extern void initialiseBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx);
+extern void runBusFrameWriterCtx(tBusFrameWriterCtx *ptrCtx);
+extern unsigned int runBusFrameWriterBudgetCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterRunStatus *ptrStatus, unsigned int stepBudget);
+extern void registerSendFrameBufferCtx(tBusFrameWriterCtx *ptrCtx, tBuffer *ptrBuffer);
+extern void registerSendFrameListenerCtx(tBusFrameWriterCtx *ptrCtx, unsigned char *ptrListener);
+extern void openBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+extern void openBusFrameWithFormatCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format);
+extern void openBusFrameWithPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char format, eBusFramePriority priority);
+extern void writeToBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, unsigned char byte);
+extern void closeBusFrameCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+extern void sendFramesInBufferCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus);
+extern unsigned char getQueuedFrameCountCtx(tBusFrameWriterCtx *ptrCtx);
+extern unsigned char getQueuedFrameCountByPriorityCtx(tBusFrameWriterCtx *ptrCtx, eBusFramePriority priority);
+extern void writeBusFrameDirectCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+extern void writeBusFrameCompressedCtx(tBusFrameWriterCtx *ptrCtx, eBusFrameWriterOperationStatus *ptrStatus, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+extern void registerBusFrameWriterClockCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameClock clock);
+extern void setBusFrameCoalescingCtx(tBusFrameWriterCtx *ptrCtx, unsigned int maxBytes, unsigned long maxDelay);
+extern void registerBusFrameWriterTraceCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameTrace *ptrTrace, unsigned char bus);
+extern void setBusFrameRepairModeCtx(tBusFrameWriterCtx *ptrCtx, unsigned char enabled);
+extern void queueBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing);
+extern void applyBusFrameFeedbackCtx(tBusFrameWriterCtx *ptrCtx, unsigned char sequence, const unsigned char *ptrMissing);
+extern void getBusFrameWriterWaitCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterWait *ptrWait);
+extern void registerBusFrameWriterWakeHookCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWakeHook hook, void *ptrArgument);
+extern void snapshotBusFrameWriterStats(tBusFrameWriterStats *ptrStats);
+extern void resetBusFrameWriterStats(void);
+extern void snapshotBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx, tBusFrameWriterStats *ptrStats);
+extern void resetBusFrameWriterStatsCtx(tBusFrameWriterCtx *ptrCtx);
 
 #endif	/* BUS_FRAME_WRITER_H */
 
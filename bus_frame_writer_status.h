@@ -7,4 +7,28 @@ typedef enum {
     BUS_FRAME_WRITER_ERROR_WRITING,
 } eBusFrameWriterOperationStatus;
 
+typedef enum {
+    BUS_FRAME_WRITER_RUN_NONE = 0,
+    BUS_FRAME_WRITER_RUN_IDLE,
+    BUS_FRAME_WRITER_RUN_WAITING_APPLICATION,
+    BUS_FRAME_WRITER_RUN_WAITING_OUTPUT,
+    BUS_FRAME_WRITER_RUN_BUDGET_SPENT,
+    BUS_FRAME_WRITER_RUN_WAITING_FEEDBACK,
+    BUS_FRAME_WRITER_RUN_COALESCING,
+} eBusFrameWriterRunStatus;
+
+typedef enum {
+    BUS_FRAME_WRITER_BLOCKED_NONE = 0, //Another step has work to do
+    BUS_FRAME_WRITER_BLOCKED_FRAMES, //Idle until sendFramesInBuffer or a control frame
+    BUS_FRAME_WRITER_BLOCKED_OUTPUT, //Send listener still set, or the send buffer is too full for the next marker
+    BUS_FRAME_WRITER_BLOCKED_COALESCING, //Holding the batch until the deadline or another frame
+    BUS_FRAME_WRITER_BLOCKED_FEEDBACK, //Holding the next frame for the far end's ACK/NACK
+} eBusFrameWriterWaitReason;
+
+typedef struct {
+    eBusFrameWriterWaitReason reason;
+    unsigned char hasDeadline;
+    unsigned long deadline; //Writer clock tick it has to be stepped by even if nothing else happens
+} tBusFrameWriterWait;
+
 #endif	/* BUS_FRAME_WRITER_STATUS_H */
\ No newline at end of file
@@ -0,0 +1,178 @@
+#ifndef BUS_FRAME_WRITER_TYPES_H
+#define	BUS_FRAME_WRITER_TYPES_H
+
+#include "../ring-buffer/ring_buffer_types.h"
+#include "bus_frame_details.h"
+#include "bus_frame_trace_types.h"
+#include "bus_frame_compress_types.h"
+
+typedef union {
+    struct {
+        unsigned char mask;
+        unsigned char crc;
+        unsigned char dataBytes[6];
+    };
+    unsigned char bytes[8];
+} tBlockLayout;
+
+typedef enum {
+    BUS_FRAME_WRITER_NONE = 0,
+    BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER = 10,
+    BUS_FRAME_WRITER_CALCULATE_BLOCKS = 40,
+    BUS_FRAME_WRITER_WRITE_STARTCODE1 = 50,
+    BUS_FRAME_WRITER_WRITE_STARTCODE2 = 70,
+    BUS_FRAME_WRITER_WRITE_FORMAT_HEADER = 80,
+    BUS_FRAME_WRITER_INITIALISE_BLOCK = 90,
+    BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE = 100,
+    BUS_FRAME_WRITER_DENSE_GROUP = 150,
+    BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER = 200,
+    BUS_FRAME_WRITER_WRITE_FRAME_CRC = 250,
+    BUS_FRAME_WRITER_WRITE_ENDCODE1 = 260,
+    BUS_FRAME_WRITER_WRITE_ENDCODE2 = 280,
+    BUS_FRAME_WRITER_TRIGGER_LISTENER = 300,
+    BUS_FRAME_WRITER_COALESCE = 305,
+    BUS_FRAME_WRITER_WAIT_PROCESSED = 310,
+    BUS_FRAME_WRITER_COALESCE_DRAIN = 315,
+    BUS_FRAME_WRITER_COMPLETE_RESET = 320,
+    BUS_FRAME_WRITER_PROCESS_ERROR = 330,
+    BUS_FRAME_WRITER_WAIT_FEEDBACK = 340,
+    BUS_FRAME_WRITER_WRITE_REPAIR = 350
+} eBusFrameWriterState;
+
+typedef union {
+    struct {
+        unsigned frameOpen: 1;
+        unsigned writeTrigger: 1;
+    };
+    unsigned char byte;
+} tBusFrameWriterFlags;
+
+typedef struct {
+    unsigned int length;
+    unsigned char format; //BUS_FRAME_FORMAT_DENSE, or 0 for blocks (jumbo picked automatically), plus BUS_FRAME_FORMAT_COMPRESSED
+} tBusFrameDescriptor;
+
+typedef enum {
+    BUS_FRAME_PRIORITY_BULK = 0,
+    BUS_FRAME_PRIORITY_CONTROL,
+    BUS_FRAME_PRIORITY_CLASSES
+} eBusFramePriority;
+
+#if FRAME_WRITER_PRIORITY_ENABLED
+#define BUS_FRAME_WRITER_LANES 2
+#else
+#define BUS_FRAME_WRITER_LANES 1 //Control frames share the bulk lane
+#endif
+
+//Frames of one priority class, oldest first. The payloads sit back to back in processBuffer
+typedef struct {
+    tBuffer processBuffer;
+    tBusFrameDescriptor frameQueue[FRAME_WRITER_MAX_QUEUED_FRAMES];
+    unsigned char frameQueueHead;
+    unsigned char frameQueueTail;
+    unsigned char queuedFrameCount;
+} tBusFrameWriterLane;
+
+//Something the handler/writer was blocked on has happened, may be called from the UART ISR / reader thread. Write an eventfd or signal a condition variable, don't step from here
+typedef void (*tBusFrameWakeHook)(void *ptrArgument);
+
+typedef enum {
+    BUS_FRAME_ENCODE_HEAD = 0,
+    BUS_FRAME_ENCODE_BODY,
+    BUS_FRAME_ENCODE_TAIL,
+    BUS_FRAME_ENCODE_DONE
+} eBusFrameEncodePhase;
+
+//One-shot encode of a frame held in the caller's memory, a piece (at most 8 bytes) at a time
+typedef struct {
+    const unsigned char *ptrPayload;
+    unsigned int length;
+    unsigned int position;
+    unsigned int headerCount;
+    unsigned int frameCrc;
+    unsigned char frameFormat;
+    unsigned char markerBlockCount;
+    eBusFrameEncodePhase phase;
+} tBusFrameEncoder;
+
+typedef struct {
+    unsigned long framesSent;
+    unsigned long bytesOut;
+    unsigned long writeRejections;
+    unsigned long blocksResent;
+    unsigned long repairsAbandoned;
+    unsigned long listenerWakeups;
+    unsigned long framesCompressed;
+    unsigned long compressionBytesSaved; //Payload bytes, before the block/dense encoding
+    unsigned long framesPreempting; //Control frames that went out ahead of waiting bulk frames
+    unsigned long queueHighWater[BUS_FRAME_WRITER_LANES]; //Most frames queued at once in each lane
+} tBusFrameWriterStats;
+
+//Everything one bus needs, so several writers can run side by side
+typedef struct {
+    tBlockLayout tempBlock;
+    eBusFrameWriterState busFrameWriterState;
+    tBusFrameWriterLane lanes[BUS_FRAME_WRITER_LANES];
+    tBusFrameWriterLane *ptrSendingLane; //Lane of the frame the state machine is on
+    tBusFrameWriterLane *ptrOpenLane; //Lane of the frame open for writeToBusFrame
+    unsigned char frameWriterProcessBufferArray[FRAME_WRITER_PROCESS_BUFFER_SIZE];
+#if FRAME_WRITER_PRIORITY_ENABLED
+    unsigned char controlProcessBufferArray[FRAME_WRITER_CONTROL_BUFFER_SIZE];
+#endif
+    tBusFrameWriterFlags busFrameWriterFlags;
+    tBuffer *ptrSendBuffer;
+    eBufferOperationStatus bufferProcessStatus;
+    eBufferOperationStatus bufferWriteStatus;
+    unsigned int byteCount;
+    unsigned int frameWriterBlockCount;
+    unsigned char byteToWrite;
+    unsigned char tempMask;
+    unsigned int outputBlockCount;
+    unsigned char markerBlockCount;
+    unsigned char frameFormat;
+    unsigned int headerCount;
+    unsigned int frameCrc;
+    unsigned char blockByteCount;
+    unsigned char *ptrSendListener;
+    unsigned char dummyListener;
+    unsigned char queuedFrameCount; //All lanes
+    tBusFrameClock ptrClock;
+    unsigned int coalesceMaxBytes;
+    unsigned long coalesceMaxDelay;
+    unsigned int coalescedBytes;
+    unsigned long lastFlushTick;
+#if BUS_FRAME_TRACE_ENABLED
+    tBusFrameTrace *ptrTrace;
+    unsigned char traceBus;
+    eBusFrameWriterState lastState;
+    unsigned char traceCount; //Transitions this writer has traced, wraps, for a debugger watch
+#endif
+#if BUS_FRAME_REPAIR_ENABLED
+    unsigned char repairEnabled;
+    unsigned char repairAwaiting;
+    unsigned char repairFeedbackReceived;
+    unsigned char repairRounds;
+    unsigned char repairSequence;
+    unsigned int repairBlockCount;
+    unsigned int repairWaitSteps;
+    unsigned long repairWaitStart; //Clock tick, for BUS_FRAME_REPAIR_WAIT_TICKS
+    unsigned char repairBlocks[BUS_FRAME_REPAIR_MAX_BLOCKS][8];
+    unsigned char repairMissing[BUS_FRAME_REPAIR_BITMAP_BYTES];
+    unsigned char feedbackPending;
+    unsigned char feedbackSequence;
+    unsigned char feedbackMissing[BUS_FRAME_REPAIR_BITMAP_BYTES];
+#endif
+#if BUS_FRAME_WAKE_HOOKS_ENABLED
+    tBusFrameWakeHook wakeHook;
+    void *ptrWakeArgument;
+#endif
+#if BUS_FRAME_COMPRESSION_ENABLED
+    tBusFrameCompressStream compressStreams[BUS_FRAME_COMPRESSION_STREAMS];
+    unsigned char compressStaging[BUS_FRAME_COMPRESS_MAX_OUTPUT];
+#endif
+#if BUS_FRAME_STATS_ENABLED
+    tBusFrameWriterStats stats;
+#endif
+} tBusFrameWriterCtx;
+
+#endif	/* BUS_FRAME_WRITER_TYPES_H */
@@ -0,0 +1,88 @@
+/*
+ * File:   bus_inbound_ring.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 15:20
+ */
+
+#include "../global.h"
+#include "bus_frame_details.h"
+#include "bus_inbound_ring.h"
+
+#if (HANDLER_INBOUND_RING_SIZE & (HANDLER_INBOUND_RING_SIZE - 1)) != 0
+#error HANDLER_INBOUND_RING_SIZE must be a power of two
+#endif
+#if !BUS_INBOUND_RING_ATOMIC && HANDLER_INBOUND_RING_SIZE > 128
+#error HANDLER_INBOUND_RING_SIZE must be 128 or less with single byte ring indexes
+#endif
+
+/*
+ * head and tail run freely and are only masked on access, so head - tail is
+ * the fill level. The producer only ever writes head and the consumer only
+ * ever writes tail; the release/acquire pairs make sure the bytes themselves
+ * are visible before the index that publishes them. Without C11 atomics
+ * (XC8 on the PIC) the bytes and both indexes are volatile, and the compiler
+ * may not reorder volatile accesses against each other, so the byte store
+ * stays ahead of the head store with or without RING_BARRIER. The PIC has
+ * no store buffer to reorder them in hardware.
+ */
+#if BUS_INBOUND_RING_ATOMIC
+#define RING_LOAD_ACQUIRE(index)            atomic_load_explicit(&(index), memory_order_acquire)
+#define RING_LOAD_RELAXED(index)            atomic_load_explicit(&(index), memory_order_relaxed)
+#define RING_STORE_RELEASE(index, value)    atomic_store_explicit(&(index), (value), memory_order_release)
+#else
+#if defined(__GNUC__)
+#define RING_BARRIER()                      __asm__ __volatile__("" ::: "memory")
+#else
+#define RING_BARRIER()
+#endif
+#define RING_LOAD_ACQUIRE(index)            (index)
+#define RING_LOAD_RELAXED(index)            (index)
+#define RING_STORE_RELEASE(index, value)    do { RING_BARRIER(); (index) = (value); } while(0)
+#endif
+
+#define RING_MASK   (HANDLER_INBOUND_RING_SIZE - 1)
+
+void initialiseBusInboundRing(tBusInboundRing *ptrRing);
+unsigned int putBusInboundBytes(tBusInboundRing *ptrRing, const unsigned char *ptrBytes, unsigned int length);
+unsigned char getBusInboundByte(tBusInboundRing *ptrRing, unsigned char *ptrByte);
+unsigned char isBusInboundRingEmpty(tBusInboundRing *ptrRing);
+
+void initialiseBusInboundRing(tBusInboundRing *ptrRing) {
+    RING_STORE_RELEASE(ptrRing->head, 0);
+    RING_STORE_RELEASE(ptrRing->tail, 0);
+}
+
+//Producer side, returns how many of the bytes fitted
+unsigned int putBusInboundBytes(tBusInboundRing *ptrRing, const unsigned char *ptrBytes, unsigned int length) {
+    unsigned int head = RING_LOAD_RELAXED(ptrRing->head);
+    unsigned int tail = RING_LOAD_ACQUIRE(ptrRing->tail);
+    unsigned int space = HANDLER_INBOUND_RING_SIZE - ((head - tail) & (RING_MASK | HANDLER_INBOUND_RING_SIZE));
+    unsigned int i;
+
+    if(length > space) {
+        length = space;
+    }
+    for(i = 0; i < length; i++) {
+        ptrRing->bytes[(head + i) & RING_MASK] = ptrBytes[i];
+    }
+    if(length) {
+        RING_STORE_RELEASE(ptrRing->head, head + length);
+    }
+    return length;
+}
+
+//Consumer side
+unsigned char getBusInboundByte(tBusInboundRing *ptrRing, unsigned char *ptrByte) {
+    unsigned int tail = RING_LOAD_RELAXED(ptrRing->tail);
+    if(((RING_LOAD_ACQUIRE(ptrRing->head) - tail) & (RING_MASK | HANDLER_INBOUND_RING_SIZE)) == 0) {
+        return 0;
+    }
+    *ptrByte = ptrRing->bytes[tail & RING_MASK];
+    RING_STORE_RELEASE(ptrRing->tail, tail + 1);
+    return 1;
+}
+
+unsigned char isBusInboundRingEmpty(tBusInboundRing *ptrRing) {
+    return ((RING_LOAD_ACQUIRE(ptrRing->head) - RING_LOAD_RELAXED(ptrRing->tail)) & (RING_MASK | HANDLER_INBOUND_RING_SIZE)) == 0;
+}
@@ -0,0 +1,29 @@
+#ifndef BUS_INBOUND_RING_H
+#define	BUS_INBOUND_RING_H
+
+#include "bus_frame_details.h"
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__) && !defined(__XC8)
+#include <stdatomic.h>
+#define BUS_INBOUND_RING_ATOMIC 1
+typedef atomic_uint tBusInboundRingIndex;
+typedef unsigned char tBusInboundRingByte;
+#else
+#define BUS_INBOUND_RING_ATOMIC 0
+typedef volatile unsigned char tBusInboundRingIndex; //Single byte so the ISR and main loop see it change in one go
+typedef volatile unsigned char tBusInboundRingByte; //Volatile accesses keep their order, so a byte is stored before the head that publishes it
+#endif
+
+//Single producer (ISR / reader thread), single consumer (runBusFrameHandler)
+typedef struct {
+    tBusInboundRingIndex head;
+    tBusInboundRingIndex tail;
+    tBusInboundRingByte bytes[HANDLER_INBOUND_RING_SIZE];
+} tBusInboundRing;
+
+extern void initialiseBusInboundRing(tBusInboundRing *ptrRing);
+extern unsigned int putBusInboundBytes(tBusInboundRing *ptrRing, const unsigned char *ptrBytes, unsigned int length);
+extern unsigned char getBusInboundByte(tBusInboundRing *ptrRing, unsigned char *ptrByte);
+extern unsigned char isBusInboundRingEmpty(tBusInboundRing *ptrRing);
+
+#endif	/* BUS_INBOUND_RING_H */
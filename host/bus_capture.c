@@ -0,0 +1,91 @@
+/*
+ * File:   bus_capture.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 18:20
+ *
+ * Writing and walking bus capture files, see bus_capture.h for the layout.
+ */
+
+#include <string.h>
+
+#include "bus_capture.h"
+
+int openBusCapture(tBusCapture *ptrCapture, const char *ptrPath);
+int writeBusCaptureChunk(tBusCapture *ptrCapture, uint16_t port, uint8_t direction, uint64_t timestampNs, const unsigned char *ptrBytes, uint32_t length);
+void closeBusCapture(tBusCapture *ptrCapture);
+const tBusCaptureRecord *getBusCaptureRecord(const unsigned char *ptrMapped, size_t mappedLength, size_t *ptrOffset);
+
+int openBusCapture(tBusCapture *ptrCapture, const char *ptrPath) {
+    tBusCaptureFileHeader header;
+
+    ptrCapture->records = 0;
+    ptrCapture->bytes = 0;
+    ptrCapture->ptrFile = fopen(ptrPath, "wb");
+    if(ptrCapture->ptrFile == 0) {
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUS_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = BUS_CAPTURE_VERSION;
+    if(fwrite(&header, sizeof(header), 1, ptrCapture->ptrFile) != 1) {
+        fclose(ptrCapture->ptrFile);
+        ptrCapture->ptrFile = 0;
+        return -1;
+    }
+    return 0;
+}
+
+//Buffered by stdio, a crash loses at most the last few KB
+int writeBusCaptureChunk(tBusCapture *ptrCapture, uint16_t port, uint8_t direction, uint64_t timestampNs, const unsigned char *ptrBytes, uint32_t length) {
+    unsigned char padding[8] = {0};
+    tBusCaptureRecord record;
+
+    if(ptrCapture->ptrFile == 0 || length == 0) {
+        return 0;
+    }
+    memset(&record, 0, sizeof(record));
+    record.timestampNs = timestampNs;
+    record.length = length;
+    record.port = port;
+    record.direction = direction;
+    if(fwrite(&record, sizeof(record), 1, ptrCapture->ptrFile) != 1
+            || fwrite(ptrBytes, 1, length, ptrCapture->ptrFile) != length
+            || fwrite(padding, 1, BUS_CAPTURE_ALIGNED(length) - length, ptrCapture->ptrFile) != BUS_CAPTURE_ALIGNED(length) - length) {
+        return -1;
+    }
+    ptrCapture->records++;
+    ptrCapture->bytes += length;
+    return 0;
+}
+
+void closeBusCapture(tBusCapture *ptrCapture) {
+    if(ptrCapture->ptrFile) {
+        fclose(ptrCapture->ptrFile);
+        ptrCapture->ptrFile = 0;
+    }
+}
+
+//Record at *ptrOffset (0 = first) and moves the offset past it, 0 at the end or on a bad file. Its bytes follow it directly
+const tBusCaptureRecord *getBusCaptureRecord(const unsigned char *ptrMapped, size_t mappedLength, size_t *ptrOffset) {
+    const tBusCaptureFileHeader *ptrHeader = (const tBusCaptureFileHeader *)ptrMapped;
+    const tBusCaptureRecord *ptrRecord;
+
+    if(*ptrOffset == 0) {
+        if(mappedLength < sizeof(*ptrHeader) || memcmp(ptrHeader->magic, BUS_CAPTURE_MAGIC, sizeof(ptrHeader->magic)) != 0
+                || ptrHeader->version != BUS_CAPTURE_VERSION) {
+            return 0;
+        }
+        *ptrOffset = sizeof(*ptrHeader);
+    }
+    if(*ptrOffset >= mappedLength || mappedLength - *ptrOffset < sizeof(*ptrRecord)) {
+        return 0;
+    }
+    ptrRecord = (const tBusCaptureRecord *)&ptrMapped[*ptrOffset];
+    //A capture cut short by a crash just ends at its last whole record
+    if(mappedLength - *ptrOffset - sizeof(*ptrRecord) < ptrRecord->length) {
+        return 0;
+    }
+    *ptrOffset += sizeof(*ptrRecord) + BUS_CAPTURE_ALIGNED(ptrRecord->length);
+    return ptrRecord;
+}
@@ -0,0 +1,46 @@
+#ifndef BUS_CAPTURE_H
+#define	BUS_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Capture file: a header, then one record per chunk of wire bytes in the
+ * order they were seen. Host byte order (little endian on everything we run
+ * on), each record header starts on an 8 byte boundary so a mapped file can
+ * be walked in place.
+ */
+
+#define BUS_CAPTURE_MAGIC           "BUSCAP\r\n"
+#define BUS_CAPTURE_VERSION         1
+#define BUS_CAPTURE_RX              0   //Bytes off the wire, as handed to putBytesForHandling
+#define BUS_CAPTURE_TX              1   //Bytes taken out of the send buffer for the wire
+#define BUS_CAPTURE_ALIGNED(length) (((length) + 7u) & ~7u)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} tBusCaptureFileHeader;
+
+//Followed by length bytes and padding up to the next 8 byte boundary
+typedef struct {
+    uint64_t timestampNs;   //CLOCK_MONOTONIC, only differences between records mean anything
+    uint32_t length;
+    uint16_t port;
+    uint8_t direction;
+    uint8_t reserved;
+} tBusCaptureRecord;
+
+typedef struct {
+    FILE *ptrFile;
+    unsigned long records;
+    unsigned long long bytes;
+} tBusCapture;
+
+extern int openBusCapture(tBusCapture *ptrCapture, const char *ptrPath);
+extern int writeBusCaptureChunk(tBusCapture *ptrCapture, uint16_t port, uint8_t direction, uint64_t timestampNs, const unsigned char *ptrBytes, uint32_t length);
+extern void closeBusCapture(tBusCapture *ptrCapture);
+extern const tBusCaptureRecord *getBusCaptureRecord(const unsigned char *ptrMapped, size_t mappedLength, size_t *ptrOffset);
+
+#endif	/* BUS_CAPTURE_H */
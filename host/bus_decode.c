@@ -0,0 +1,469 @@
+/*
+ * File:   bus_decode.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 22:40
+ *
+ * Offline bulk decoder for big bus logs, spread over several threads.
+ *
+ *   bus_decode [-j threads] [-s chunk KB] [-q] <capture file or raw wire bytes>
+ *
+ * A bus capture (bus_capture.h) is split into one stream per port and
+ * direction, anything else is taken as one stream of raw wire bytes. Each
+ * stream is indexed with bus_frame_index (SC1/EC2 positions, a slice per
+ * thread), cut into chunks at the first SC1 past every chunk size, and the
+ * chunks are decoded with decodeBusFrameSpan on a pool of threads. A chunk
+ * holds whole frames only, so it decodes exactly as it would in one pass.
+ * Frames are printed in wire order whichever thread finished first, -q
+ * leaves just the totals.
+ *
+ * decodeBusFrameSpan takes block, jumbo and dense frames. Compressed frames
+ * need the frames before them and acknowledged ones the feedback, both are
+ * counted as rejected here, bus_replay decodes those.
+ *
+ * Build alongside the bus sources with bus_frame_index.c, bus_capture.c,
+ * ../crc.c, ../ring-buffer and -pthread.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../bus_frame_details.h"
+#include "../bus_frame_crc.h"
+#include "../bus_frame_handler.h"
+#include "bus_capture.h"
+#include "bus_frame_index.h"
+
+#define DECODE_MAX_STREAMS          64
+#define DECODE_MAX_THREADS          64
+#define DECODE_DEFAULT_CHUNK_KB     4096
+#define DECODE_MIN_CHUNK_KB         64      //Comfortably more than the longest jumbo frame
+#define DECODE_WINDOW_PER_THREAD    4       //Chunks decoded ahead of the printer, bounds the memory held
+#define DECODE_SPAN_FRAMES          255     //tBusFrameSpanOutput.maxFrames
+#define DECODE_PRINT_BYTES          32
+
+typedef struct {
+    uint16_t port;
+    uint8_t direction;
+    unsigned char *ptrBytes;    //Owned when it came out of a capture, the mapping itself for raw files
+    size_t length;
+    size_t filled;
+} tDecodeStream;
+
+//One chunk's results, a slot is reused for every window'th chunk
+typedef struct {
+    unsigned char *ptrPayload;
+    unsigned int *ptrFrameLengths;
+    size_t frameSize;
+    size_t frameCount;
+    size_t payloadLength;
+    unsigned char done;
+} tDecodeSlot;
+
+typedef struct {
+    const unsigned char *ptrBytes;
+    size_t length;
+    size_t base;
+    tBusFrameIndex index;
+    int result;
+} tIndexSlice;
+
+tDecodeStream decodeStreams[DECODE_MAX_STREAMS];
+unsigned int decodeStreamCount;
+unsigned int decodeThreads = 1;
+size_t decodeChunkSize = (size_t)DECODE_DEFAULT_CHUNK_KB * 1024;
+unsigned char decodeQuiet;
+
+//Shared with the workers while one stream is being decoded
+tDecodeStream *ptrDecodeStream;
+tBusFrameIndex decodeIndex;
+size_t *ptrChunkStarts;     //chunkCount + 1 entries, the last is the stream length
+size_t chunkCount;
+tDecodeSlot *ptrDecodeSlots;
+size_t decodeWindow;
+size_t nextChunk;
+size_t printedChunk;
+unsigned char decodeFailed;
+pthread_mutex_t decodeLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t decodeChanged = PTHREAD_COND_INITIALIZER;
+
+unsigned long long getNowNs(void);
+tDecodeStream *getDecodeStream(uint16_t port, uint8_t direction);
+int splitCaptureStreams(const unsigned char *ptrMapped, size_t mappedLength);
+void *indexSliceThread(void *ptrArgument);
+int indexDecodeStream(tDecodeStream *ptrStream);
+void findChunkStarts(tDecodeStream *ptrStream);
+void *decodeChunkThread(void *ptrArgument);
+int decodeChunk(size_t chunk, tDecodeSlot *ptrSlot);
+void printDecodeSlot(tDecodeStream *ptrStream, tDecodeSlot *ptrSlot, unsigned long long *ptrFrameNumber);
+int decodeStream(tDecodeStream *ptrStream);
+
+unsigned long long getNowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+tDecodeStream *getDecodeStream(uint16_t port, uint8_t direction) {
+    unsigned int index;
+
+    for(index = 0; index < decodeStreamCount; index++) {
+        if(decodeStreams[index].port == port && decodeStreams[index].direction == direction) {
+            return &decodeStreams[index];
+        }
+    }
+    if(decodeStreamCount == DECODE_MAX_STREAMS) {
+        return 0;
+    }
+    decodeStreams[decodeStreamCount].port = port;
+    decodeStreams[decodeStreamCount].direction = direction;
+    return &decodeStreams[decodeStreamCount++];
+}
+
+//Records of different ports interleave and frames run across records, so each stream's bytes are gathered up first
+int splitCaptureStreams(const unsigned char *ptrMapped, size_t mappedLength) {
+    const tBusCaptureRecord *ptrRecord;
+    tDecodeStream *ptrStream;
+    size_t offset = 0;
+    unsigned int index;
+
+    while((ptrRecord = getBusCaptureRecord(ptrMapped, mappedLength, &offset)) != 0) {
+        ptrStream = getDecodeStream(ptrRecord->port, ptrRecord->direction);
+        if(ptrStream) {
+            ptrStream->length += ptrRecord->length;
+        }
+    }
+    for(index = 0; index < decodeStreamCount; index++) {
+        decodeStreams[index].ptrBytes = malloc(decodeStreams[index].length ? decodeStreams[index].length : 1);
+        if(decodeStreams[index].ptrBytes == 0) {
+            return -1;
+        }
+    }
+    offset = 0;
+    while((ptrRecord = getBusCaptureRecord(ptrMapped, mappedLength, &offset)) != 0) {
+        ptrStream = getDecodeStream(ptrRecord->port, ptrRecord->direction);
+        if(ptrStream) {
+            memcpy(&ptrStream->ptrBytes[ptrStream->filled], ptrRecord + 1, ptrRecord->length);
+            ptrStream->filled += ptrRecord->length;
+        }
+    }
+    return 0;
+}
+
+void *indexSliceThread(void *ptrArgument) {
+    tIndexSlice *ptrSlice = ptrArgument;
+    ptrSlice->result = indexBusFrameMarkers(&ptrSlice->index, ptrSlice->ptrBytes, ptrSlice->length, ptrSlice->base);
+    return 0;
+}
+
+//A slice of the stream per thread, stitched back together in order
+int indexDecodeStream(tDecodeStream *ptrStream) {
+    tIndexSlice slices[DECODE_MAX_THREADS];
+    pthread_t threads[DECODE_MAX_THREADS];
+    unsigned char started[DECODE_MAX_THREADS];
+    size_t sliceLength = ptrStream->length / decodeThreads + 1;
+    unsigned int index;
+    int result = 0;
+
+    initialiseBusFrameIndex(&decodeIndex);
+    for(index = 0; index < decodeThreads; index++) {
+        slices[index].base = sliceLength * index < ptrStream->length ? sliceLength * index : ptrStream->length;
+        slices[index].length = ptrStream->length - slices[index].base < sliceLength ? ptrStream->length - slices[index].base : sliceLength;
+        slices[index].ptrBytes = &ptrStream->ptrBytes[slices[index].base];
+        initialiseBusFrameIndex(&slices[index].index);
+        started[index] = index > 0 && pthread_create(&threads[index], 0, indexSliceThread, &slices[index]) == 0;
+        if(index > 0 && !started[index]) {
+            indexSliceThread(&slices[index]);
+        }
+    }
+    indexSliceThread(&slices[0]);
+    for(index = 0; index < decodeThreads; index++) {
+        if(started[index]) {
+            pthread_join(threads[index], 0);
+        }
+        if(slices[index].result < 0 || appendBusFrameIndex(&decodeIndex, &slices[index].index) < 0) {
+            result = -1;
+        }
+        freeBusFrameIndex(&slices[index].index);
+    }
+    return result;
+}
+
+/*
+ * Every chunk starts on an SC1 (the first chunk at 0), so no frame is split.
+ * With no SC1 in a whole chunk's worth of bytes it's junk, or the tail of
+ * one frame, and the cut goes after the next EC2 instead.
+ */
+void findChunkStarts(tDecodeStream *ptrStream) {
+    size_t nominal;
+    size_t start;
+    size_t position;
+
+    chunkCount = 0;
+    ptrChunkStarts[chunkCount++] = 0;
+    for(nominal = decodeChunkSize; nominal < ptrStream->length; nominal += decodeChunkSize) {
+        if(nominal <= ptrChunkStarts[chunkCount - 1]) {
+            continue;
+        }
+        position = findBusFrameStart(&decodeIndex, nominal);
+        if(position < decodeIndex.startCount && decodeIndex.ptrStarts[position] < nominal + decodeChunkSize) {
+            start = decodeIndex.ptrStarts[position];
+        } else {
+            position = countBusFrameMarkers(decodeIndex.ptrEnds, decodeIndex.endCount, 0, nominal);
+            start = position < decodeIndex.endCount ? decodeIndex.ptrEnds[position] + 1 : ptrStream->length;
+            start = start < nominal + decodeChunkSize ? start : nominal;
+        }
+        if(start < ptrStream->length) {
+            ptrChunkStarts[chunkCount++] = start;
+        }
+    }
+    ptrChunkStarts[chunkCount] = ptrStream->length;
+}
+
+//Takes the next chunk while it's within the window of the one being printed
+void *decodeChunkThread(void *ptrArgument) {
+    tDecodeSlot *ptrSlot;
+    size_t chunk;
+    int result;
+
+    (void)ptrArgument;
+    pthread_mutex_lock(&decodeLock);
+    while(1) {
+        while(nextChunk < chunkCount && nextChunk >= printedChunk + decodeWindow && !decodeFailed) {
+            pthread_cond_wait(&decodeChanged, &decodeLock);
+        }
+        if(nextChunk >= chunkCount || decodeFailed) {
+            break;
+        }
+        chunk = nextChunk++;
+        ptrSlot = &ptrDecodeSlots[chunk % decodeWindow];
+        pthread_mutex_unlock(&decodeLock);
+        result = decodeChunk(chunk, ptrSlot);
+        pthread_mutex_lock(&decodeLock);
+        if(result < 0) {
+            decodeFailed = 1;
+        }
+        ptrSlot->done = 1;
+        pthread_cond_broadcast(&decodeChanged);
+    }
+    pthread_mutex_unlock(&decodeLock);
+    return 0;
+}
+
+//Payload never comes out longer than the wire bytes it came from, and every frame accepted ends on one of the chunk's EC2s
+int decodeChunk(size_t chunk, tDecodeSlot *ptrSlot) {
+    tBusFrameSpanOutput output;
+    const unsigned char *ptrBytes = &ptrDecodeStream->ptrBytes[ptrChunkStarts[chunk]];
+    size_t length = ptrChunkStarts[chunk + 1] - ptrChunkStarts[chunk];
+    size_t frameSize = countBusFrameMarkers(decodeIndex.ptrEnds, decodeIndex.endCount, ptrChunkStarts[chunk], ptrChunkStarts[chunk + 1]);
+    size_t position = 0;
+    unsigned int *ptrGrown;
+
+    if(frameSize > ptrSlot->frameSize) {
+        ptrGrown = realloc(ptrSlot->ptrFrameLengths, frameSize * sizeof(unsigned int));
+        if(ptrGrown == 0) {
+            return -1;
+        }
+        ptrSlot->ptrFrameLengths = ptrGrown;
+        ptrSlot->frameSize = frameSize;
+    }
+    ptrSlot->frameCount = 0;
+    ptrSlot->payloadLength = 0;
+    output.ptrPayload = ptrSlot->ptrPayload;
+    output.payloadSize = (unsigned int)length;
+    output.payloadLength = 0;
+    //The span decoder hands back at most 255 frame lengths a call, carry on from the frame it stopped at
+    do {
+        output.ptrFrameLengths = &ptrSlot->ptrFrameLengths[ptrSlot->frameCount];
+        output.maxFrames = frameSize - ptrSlot->frameCount < DECODE_SPAN_FRAMES ? (unsigned char)(frameSize - ptrSlot->frameCount) : DECODE_SPAN_FRAMES;
+        output.frameCount = 0;
+        if(output.maxFrames == 0) {
+            break;
+        }
+        position += decodeBusFrameSpan(&ptrBytes[position], (unsigned int)(length - position), &output);
+        ptrSlot->frameCount += output.frameCount;
+    } while(output.frameCount == output.maxFrames);
+    ptrSlot->payloadLength = output.payloadLength;
+    return 0;
+}
+
+void printDecodeSlot(tDecodeStream *ptrStream, tDecodeSlot *ptrSlot, unsigned long long *ptrFrameNumber) {
+    size_t frame;
+    size_t payloadPosition = 0;
+    unsigned int index;
+
+    for(frame = 0; frame < ptrSlot->frameCount; frame++) {
+        if(!decodeQuiet) {
+            printf("port %u %s frame %llu %u:", ptrStream->port, ptrStream->direction == BUS_CAPTURE_TX ? "tx" : "rx",
+                    *ptrFrameNumber, ptrSlot->ptrFrameLengths[frame]);
+            for(index = 0; index < ptrSlot->ptrFrameLengths[frame] && index < DECODE_PRINT_BYTES; index++) {
+                printf(" %02x", ptrSlot->ptrPayload[payloadPosition + index]);
+            }
+            printf(ptrSlot->ptrFrameLengths[frame] > DECODE_PRINT_BYTES ? " ...\n" : "\n");
+        }
+        payloadPosition += ptrSlot->ptrFrameLengths[frame];
+        (*ptrFrameNumber)++;
+    }
+}
+
+int decodeStream(tDecodeStream *ptrStream) {
+    pthread_t threads[DECODE_MAX_THREADS];
+    unsigned char started[DECODE_MAX_THREADS];
+    unsigned long long startNs;
+    unsigned long long indexNs;
+    unsigned long long frames = 0;
+    unsigned long long payload = 0;
+    size_t longestChunk = 0;
+    size_t chunk;
+    unsigned int index;
+    int result = 0;
+
+    startNs = getNowNs();
+    if(indexDecodeStream(ptrStream) < 0) {
+        fprintf(stderr, "port %u: out of memory indexing\n", ptrStream->port);
+        return -1;
+    }
+    indexNs = getNowNs() - startNs;
+
+    ptrChunkStarts = malloc((ptrStream->length / decodeChunkSize + 2) * sizeof(size_t));
+    if(ptrChunkStarts == 0) {
+        return -1;
+    }
+    findChunkStarts(ptrStream);
+    for(chunk = 0; chunk < chunkCount; chunk++) {
+        if(ptrChunkStarts[chunk + 1] - ptrChunkStarts[chunk] > longestChunk) {
+            longestChunk = ptrChunkStarts[chunk + 1] - ptrChunkStarts[chunk];
+        }
+    }
+    decodeWindow = (size_t)decodeThreads * DECODE_WINDOW_PER_THREAD;
+    ptrDecodeSlots = calloc(decodeWindow, sizeof(tDecodeSlot));
+    for(index = 0; ptrDecodeSlots && index < decodeWindow; index++) {
+        ptrDecodeSlots[index].ptrPayload = malloc(longestChunk ? longestChunk : 1);
+        if(ptrDecodeSlots[index].ptrPayload == 0) {
+            result = -1;
+        }
+    }
+    if(ptrDecodeSlots == 0 || result < 0) {
+        fprintf(stderr, "port %u: out of memory for chunks\n", ptrStream->port);
+        return -1;
+    }
+
+    ptrDecodeStream = ptrStream;
+    nextChunk = 0;
+    printedChunk = 0;
+    decodeFailed = 0;
+    for(index = 0; index < decodeThreads; index++) {
+        started[index] = pthread_create(&threads[index], 0, decodeChunkThread, 0) == 0;
+        if(index == 0 && !started[index]) {
+            fprintf(stderr, "can't start a decode thread\n");
+            return -1;
+        }
+    }
+    //Chunks come off the workers in any order, they're printed in the order they were on the wire
+    for(chunk = 0; chunk < chunkCount; chunk++) {
+        pthread_mutex_lock(&decodeLock);
+        while(!ptrDecodeSlots[chunk % decodeWindow].done && !decodeFailed) {
+            pthread_cond_wait(&decodeChanged, &decodeLock);
+        }
+        pthread_mutex_unlock(&decodeLock);
+        if(decodeFailed) {
+            result = -1;
+            break;
+        }
+        printDecodeSlot(ptrStream, &ptrDecodeSlots[chunk % decodeWindow], &frames);
+        payload += ptrDecodeSlots[chunk % decodeWindow].payloadLength;
+        pthread_mutex_lock(&decodeLock);
+        ptrDecodeSlots[chunk % decodeWindow].done = 0;
+        printedChunk++;
+        pthread_cond_broadcast(&decodeChanged);
+        pthread_mutex_unlock(&decodeLock);
+    }
+    for(index = 0; index < decodeThreads; index++) {
+        if(started[index]) {
+            pthread_join(threads[index], 0);
+        }
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "port %u %s: %zu bytes, %zu SC1 %zu EC2, %llu frames (%llu payload bytes), %llu rejected, %zu chunks; index %.1f MB/s, total %.1f MB/s\n",
+            ptrStream->port, ptrStream->direction == BUS_CAPTURE_TX ? "tx" : "rx", ptrStream->length, decodeIndex.startCount, decodeIndex.endCount,
+            frames, payload, decodeIndex.startCount > frames ? decodeIndex.startCount - frames : 0, chunkCount,
+            indexNs ? (double)ptrStream->length * 1e3 / (double)indexNs : 0.0,
+            (double)ptrStream->length * 1e3 / (double)(getNowNs() - startNs));
+
+    for(index = 0; index < decodeWindow; index++) {
+        free(ptrDecodeSlots[index].ptrPayload);
+        free(ptrDecodeSlots[index].ptrFrameLengths);
+    }
+    free(ptrDecodeSlots);
+    free(ptrChunkStarts);
+    freeBusFrameIndex(&decodeIndex);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    const unsigned char *ptrMapped;
+    struct stat fileStat;
+    size_t offset = 0;
+    unsigned int index;
+    int argument = 1;
+    int result = 0;
+    int fd;
+
+    while(argument < argc - 1 && argv[argument][0] == '-') {
+        if(strcmp(argv[argument], "-q") == 0) {
+            decodeQuiet = 1;
+        } else if(strcmp(argv[argument], "-j") == 0 && argument < argc - 2) {
+            decodeThreads = (unsigned int)strtoul(argv[++argument], 0, 10);
+        } else if(strcmp(argv[argument], "-s") == 0 && argument < argc - 2) {
+            decodeChunkSize = (size_t)strtoul(argv[++argument], 0, 10) * 1024;
+        } else {
+            break;
+        }
+        argument++;
+    }
+    if(argument != argc - 1 || decodeThreads == 0 || decodeThreads > DECODE_MAX_THREADS
+            || decodeChunkSize < (size_t)DECODE_MIN_CHUNK_KB * 1024 || decodeChunkSize > 0x7FFFFFFF / 2) {
+        fprintf(stderr, "usage: %s [-j threads (1-%u)] [-s chunk KB (%u up)] [-q] <capture file or raw wire bytes>\n",
+                argv[0], DECODE_MAX_THREADS, DECODE_MIN_CHUNK_KB);
+        return 2;
+    }
+
+    fd = open(argv[argument], O_RDONLY);
+    if(fd < 0 || fstat(fd, &fileStat) < 0) {
+        perror(argv[argument]);
+        return 1;
+    }
+    ptrMapped = mmap(0, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(fileStat.st_size == 0 || ptrMapped == MAP_FAILED) {
+        fprintf(stderr, "%s: can't map\n", argv[argument]);
+        return 1;
+    }
+    madvise((void *)ptrMapped, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    initialiseBusFrameCrc();
+
+    if(getBusCaptureRecord(ptrMapped, (size_t)fileStat.st_size, &offset) != 0) {
+        if(splitCaptureStreams(ptrMapped, (size_t)fileStat.st_size) < 0) {
+            fprintf(stderr, "%s: out of memory splitting the capture\n", argv[argument]);
+            return 1;
+        }
+    } else {
+        decodeStreams[0].ptrBytes = (unsigned char *)ptrMapped;
+        decodeStreams[0].length = (size_t)fileStat.st_size;
+        decodeStreamCount = 1;
+    }
+    for(index = 0; index < decodeStreamCount; index++) {
+        if(decodeStream(&decodeStreams[index]) < 0) {
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,344 @@
+#ifndef BUS_FRAME_CODEC_HPP
+#define	BUS_FRAME_CODEC_HPP
+
+/*
+ * Header-only frame codec for host services written in C++, the same wire
+ * format as the C writer and handler (block frames, jumbo frames and dense
+ * frames). The geometry is a template parameter instead of the #defines in
+ * bus_frame_details.h and the block CRC is a policy, so every size is a
+ * constexpr, buffers are std::arrays sized at compile time and the whole
+ * encode/decode path inlines into the caller.
+ *
+ *   busframe::BusFrameCodec<15>                      classic frames only, jumbo handling compiled out
+ *   busframe::BusFrameCodec<1024, busframe::BitwiseCrc>
+ *
+ * Decoding takes one whole frame starting at its SC1. Block frames come out
+ * padded to a whole block like they do from the handler. Compressed and
+ * acknowledged frames are refused, they need the handler's state.
+ *
+ * C++17. Link ../crc.c for calculateCrc, which both CRC policies are built on.
+ */
+
+#include <array>
+#include <cstdint>
+
+extern "C" {
+#include "../../crc.h"
+}
+#include "../bus_frame_details.h"
+
+namespace busframe {
+
+constexpr unsigned blockDataBytes = 6;
+constexpr unsigned blockSize = 8;
+constexpr unsigned classicMaxBlocks = 0x0F;
+constexpr unsigned denseGroupBytes = BUS_FRAME_DENSE_GROUP_BYTES;
+constexpr unsigned frameCrcPoly = 0x1021; //CRC-16/CCITT, same as bus_frame_crc.c
+
+constexpr unsigned blocksFor(unsigned length) {
+    return (length + blockDataBytes - 1) / blockDataBytes;
+}
+
+constexpr unsigned denseGroupsFor(unsigned length) {
+    return (length + denseGroupBytes - 1) / denseGroupBytes;
+}
+
+constexpr unsigned updateFrameCrcBitwise(unsigned crc, unsigned char byte) {
+    crc ^= static_cast<unsigned>(byte) << 8;
+    for(unsigned bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ frameCrcPoly : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
+
+constexpr std::array<std::uint16_t, 256> makeFrameCrcTable() {
+    std::array<std::uint16_t, 256> table{};
+    for(unsigned value = 0; value < 256; value++) {
+        table[value] = static_cast<std::uint16_t>(updateFrameCrcBitwise(0, static_cast<unsigned char>(value)));
+    }
+    return table;
+}
+
+inline constexpr std::array<std::uint16_t, 256> frameCrcTable = makeFrameCrcTable();
+
+//calculateCrc over every block, what the C side does with BUS_FRAME_CRC_TABLE 0
+struct BitwiseCrc {
+    static unsigned char block(const unsigned char *ptrData) {
+        unsigned char copy[blockDataBytes];
+        for(unsigned i = 0; i < blockDataBytes; i++) {
+            copy[i] = ptrData[i];
+        }
+        return calculateCrc(copy, blockDataBytes);
+    }
+
+    static constexpr unsigned frame(unsigned crc, unsigned char byte) {
+        return updateFrameCrcBitwise(crc, byte);
+    }
+};
+
+/*
+ * Per-position tables like BUS_FRAME_CRC_TABLE 1: the CRC of a fixed length
+ * block is affine, so it's the all-zero block's CRC xor one entry per byte.
+ * Worked out from calculateCrc during static initialisation, so don't encode
+ * from another static initialiser.
+ */
+struct TableCrc {
+    struct Tables {
+        unsigned char zero;
+        unsigned char positions[blockDataBytes][256];
+
+        Tables() : zero(0), positions{} {
+            unsigned char probe[blockDataBytes] = {0};
+            zero = calculateCrc(probe, blockDataBytes);
+            for(unsigned position = 0; position < blockDataBytes; position++) {
+                for(unsigned bit = 0; bit < 8; bit++) {
+                    probe[position] = static_cast<unsigned char>(1 << bit);
+                    positions[position][1 << bit] = calculateCrc(probe, blockDataBytes) ^ zero;
+                }
+                probe[position] = 0;
+                for(unsigned value = 3; value < 256; value++) {
+                    positions[position][value] = positions[position][value & (value - 1)] ^ positions[position][value & (0 - value)];
+                }
+            }
+        }
+    };
+
+    static inline const Tables tables{};
+
+    static unsigned char block(const unsigned char *ptrData) {
+        return tables.zero ^
+                tables.positions[0][ptrData[0]] ^
+                tables.positions[1][ptrData[1]] ^
+                tables.positions[2][ptrData[2]] ^
+                tables.positions[3][ptrData[3]] ^
+                tables.positions[4][ptrData[4]] ^
+                tables.positions[5][ptrData[5]];
+    }
+
+    static constexpr unsigned frame(unsigned crc, unsigned char byte) {
+        return ((crc << 8) ^ frameCrcTable[((crc >> 8) ^ byte) & 0xFF]) & 0xFFFF;
+    }
+};
+
+template <unsigned MaxBlocks, class CrcPolicy = TableCrc>
+class BusFrameCodec {
+    static_assert(MaxBlocks >= 1 && MaxBlocks <= BUS_FRAME_JUMBO_MAX_BLOCKS, "MaxBlocks has to fit what the C handler takes (BUS_FRAME_JUMBO_MAX_BLOCKS)");
+
+public:
+    //More than a marker nibble's worth of blocks means jumbo frames, otherwise that code isn't generated
+    static constexpr bool jumbo = MaxBlocks > classicMaxBlocks;
+    static constexpr unsigned maxPayload = MaxBlocks * blockDataBytes;
+
+    //Wire size of a frame, 0 if the payload is too long for this codec. Dense frames always carry the jumbo header
+    static constexpr unsigned encodedSize(unsigned length, bool dense = false) {
+        if(length > maxPayload) {
+            return 0;
+        }
+        if(dense) {
+            return 4 + 3 + length + denseGroupsFor(length) + 3;
+        }
+        return 4 + (blocksFor(length) > classicMaxBlocks ? 3 : 0) + blocksFor(length) * blockSize;
+    }
+
+    static constexpr unsigned maxWireSize = encodedSize(maxPayload, false) > encodedSize(maxPayload, true) ?
+            encodedSize(maxPayload, false) : encodedSize(maxPayload, true);
+
+    using WireBuffer = std::array<unsigned char, maxWireSize>;
+    using PayloadBuffer = std::array<unsigned char, maxPayload>;
+
+    //Block frame, jumbo when it takes more than 15 blocks. Returns the wire bytes written, 0 if the payload is too long
+    static unsigned encode(const unsigned char *ptrPayload, unsigned length, unsigned char *ptrWire) {
+        unsigned blocks = blocksFor(length);
+        unsigned char markerCount = static_cast<unsigned char>(blocks);
+        unsigned position = 2;
+        unsigned block;
+
+        if(blocks > MaxBlocks) {
+            return 0;
+        }
+        if constexpr(jumbo) {
+            if(blocks > classicMaxBlocks) {
+                markerCount = 0;
+                ptrWire[2] = BUS_FRAME_FORMAT_JUMBO;
+                ptrWire[3] = static_cast<unsigned char>((blocks >> 7) & 0x7F);
+                ptrWire[4] = static_cast<unsigned char>(blocks & 0x7F);
+                position = 5;
+            }
+        }
+        ptrWire[0] = static_cast<unsigned char>(0xC0 + markerCount);
+        ptrWire[1] = static_cast<unsigned char>(0xD0 + markerCount);
+        for(block = 0; block < length / blockDataBytes; block++) {
+            encodeBlock(&ptrPayload[block * blockDataBytes], &ptrWire[position]);
+            position += blockSize;
+        }
+        if(length % blockDataBytes) {
+            unsigned char last[blockDataBytes];
+            for(unsigned i = 0; i < blockDataBytes; i++) {
+                last[i] = i < length % blockDataBytes ? ptrPayload[block * blockDataBytes + i] : 0xFF;
+            }
+            encodeBlock(last, &ptrWire[position]);
+            position += blockSize;
+        }
+        ptrWire[position++] = static_cast<unsigned char>(0xE0 + markerCount);
+        ptrWire[position++] = static_cast<unsigned char>(0xF0 + markerCount);
+        return position;
+    }
+
+    //Payload length known at compile time, so the block loop is unrolled and the jumbo choice made up front
+    template <unsigned Length>
+    static unsigned encode(const unsigned char (&payload)[Length], WireBuffer &wire) {
+        static_assert(Length <= maxPayload, "payload is longer than this codec's frames");
+        return encode(payload, Length, wire.data());
+    }
+
+    //Dense 7-in-8 frame with a frame CRC-16. Returns the wire bytes written, 0 if the payload is too long
+    static unsigned encodeDense(const unsigned char *ptrPayload, unsigned length, unsigned char *ptrWire) {
+        unsigned crc = BUS_FRAME_CRC16_INIT;
+        unsigned position = 5;
+        unsigned done = 0;
+        unsigned take;
+        unsigned char highBits;
+
+        if(length > maxPayload) {
+            return 0;
+        }
+        ptrWire[0] = 0xC0;
+        ptrWire[1] = 0xD0;
+        ptrWire[2] = BUS_FRAME_FORMAT_JUMBO | BUS_FRAME_FORMAT_DENSE;
+        ptrWire[3] = static_cast<unsigned char>((length >> 7) & 0x7F);
+        ptrWire[4] = static_cast<unsigned char>(length & 0x7F);
+        while(done < length) {
+            take = length - done < denseGroupBytes ? length - done : denseGroupBytes;
+            highBits = 0;
+            for(unsigned i = 0; i < take; i++) {
+                crc = CrcPolicy::frame(crc, ptrPayload[done + i]);
+                highBits |= static_cast<unsigned char>((ptrPayload[done + i] >> 7) << i);
+                ptrWire[position++] = ptrPayload[done + i] & 0x7F;
+            }
+            ptrWire[position++] = highBits;
+            done += take;
+        }
+        ptrWire[position++] = static_cast<unsigned char>((crc >> 14) & 0x03);
+        ptrWire[position++] = static_cast<unsigned char>((crc >> 7) & 0x7F);
+        ptrWire[position++] = static_cast<unsigned char>(crc & 0x7F);
+        ptrWire[position++] = 0xE0;
+        ptrWire[position++] = 0xF0;
+        return position;
+    }
+
+    /*
+     * One whole frame from its SC1. Returns the wire bytes it took up with
+     * the payload in ptrPayload (room for maxPayload) and its length in
+     * *ptrPayloadLength, 0 if it's cut short, corrupt or too big for this
+     * codec.
+     */
+    static unsigned decode(const unsigned char *ptrWire, unsigned wireLength, unsigned char *ptrPayload, unsigned *ptrPayloadLength) {
+        unsigned count;
+        unsigned char markerCount;
+        unsigned position = 2;
+
+        if(wireLength < 4 || (ptrWire[0] & 0xF0) != 0xC0 || ptrWire[1] != ptrWire[0] + 0x10) {
+            return 0;
+        }
+        markerCount = ptrWire[0] & 0x0F;
+        count = markerCount;
+        //A count of 0 is either an empty frame (EC1 next) or a jumbo frame (format header next)
+        if(markerCount == 0 && (ptrWire[2] & 0xF0) != 0xE0) {
+            if(wireLength < 5 || ptrWire[2] & ~BUS_FRAME_FORMAT_KNOWN || !(ptrWire[2] & BUS_FRAME_FORMAT_JUMBO) || (ptrWire[3] | ptrWire[4]) & 0x80) {
+                return 0;
+            }
+            count = (static_cast<unsigned>(ptrWire[3]) << 7) | ptrWire[4];
+            if(ptrWire[2] & BUS_FRAME_FORMAT_DENSE) {
+                return decodeDense(ptrWire, wireLength, count, ptrPayload, ptrPayloadLength);
+            }
+            if constexpr(!jumbo) {
+                return 0;
+            }
+            position = 5;
+        }
+        if(count > MaxBlocks || position + count * blockSize + 2 > wireLength) {
+            return 0;
+        }
+        for(unsigned block = 0; block < count; block++) {
+            if(!decodeBlock(&ptrWire[position], &ptrPayload[block * blockDataBytes])) {
+                return 0;
+            }
+            position += blockSize;
+        }
+        if(ptrWire[position] != 0xE0 + markerCount || ptrWire[position + 1] != 0xF0 + markerCount) {
+            return 0;
+        }
+        *ptrPayloadLength = count * blockDataBytes;
+        return position + 2;
+    }
+
+    static unsigned decode(const unsigned char *ptrWire, unsigned wireLength, PayloadBuffer &payload, unsigned *ptrPayloadLength) {
+        return decode(ptrWire, wireLength, payload.data(), ptrPayloadLength);
+    }
+
+private:
+    //Mask byte, CRC of the masked data, then the 6 data bytes with bit 7 stripped
+    static void encodeBlock(const unsigned char *ptrData, unsigned char *ptrBlock) {
+        unsigned char mask = 0;
+        for(unsigned i = 0; i < blockDataBytes; i++) {
+            mask |= static_cast<unsigned char>((ptrData[i] >> 7) << i);
+            ptrBlock[2 + i] = ptrData[i] & 0x7F;
+        }
+        ptrBlock[0] = static_cast<unsigned char>(0x80 | mask);
+        ptrBlock[1] = CrcPolicy::block(&ptrBlock[2]);
+    }
+
+    static bool decodeBlock(const unsigned char *ptrBlock, unsigned char *ptrData) {
+        unsigned char highBits = 0;
+        if((ptrBlock[0] & 0xC0) != 0x80 || ptrBlock[1] & 0x80 || CrcPolicy::block(&ptrBlock[2]) != ptrBlock[1]) {
+            return false;
+        }
+        for(unsigned i = 0; i < blockDataBytes; i++) {
+            highBits |= ptrBlock[2 + i];
+            ptrData[i] = static_cast<unsigned char>(ptrBlock[2 + i] | (((ptrBlock[0] >> i) & 1) << 7));
+        }
+        return !(highBits & 0x80);
+    }
+
+    static unsigned decodeDense(const unsigned char *ptrWire, unsigned wireLength, unsigned length, unsigned char *ptrPayload, unsigned *ptrPayloadLength) {
+        unsigned crc = BUS_FRAME_CRC16_INIT;
+        unsigned received;
+        unsigned position = 5;
+        unsigned done = 0;
+        unsigned take;
+        unsigned char highBits;
+
+        if(length > maxPayload || position + length + denseGroupsFor(length) + 5 > wireLength) {
+            return 0;
+        }
+        while(done < length) {
+            take = length - done < denseGroupBytes ? length - done : denseGroupBytes;
+            highBits = ptrWire[position + take];
+            if(highBits & 0x80) {
+                return 0;
+            }
+            for(unsigned i = 0; i < take; i++) {
+                if(ptrWire[position + i] & 0x80) {
+                    return 0;
+                }
+                ptrPayload[done + i] = static_cast<unsigned char>(ptrWire[position + i] | (((highBits >> i) & 1) << 7));
+                crc = CrcPolicy::frame(crc, ptrPayload[done + i]);
+            }
+            position += take + 1;
+            done += take;
+        }
+        if(ptrWire[position] & 0xFC || (ptrWire[position + 1] | ptrWire[position + 2]) & 0x80) {
+            return 0;
+        }
+        received = (static_cast<unsigned>(ptrWire[position]) << 14) | (static_cast<unsigned>(ptrWire[position + 1]) << 7) | ptrWire[position + 2];
+        if(received != crc || ptrWire[position + 3] != 0xE0 || ptrWire[position + 4] != 0xF0) {
+            return 0;
+        }
+        *ptrPayloadLength = length;
+        return position + 5;
+    }
+};
+
+}
+
+#endif	/* BUS_FRAME_CODEC_HPP */
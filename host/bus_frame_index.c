@@ -0,0 +1,179 @@
+/*
+ * File:   bus_frame_index.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 22:10
+ *
+ * SC1/EC2 index of a buffer of wire bytes, see bus_frame_index.h.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bus_frame_index.h"
+
+#if BUS_FRAME_INDEX_VECTOR && defined(__AVX2__)
+#include <immintrin.h>
+#define INDEX_VECTOR_BYTES 32
+#elif BUS_FRAME_INDEX_VECTOR && defined(__SSE2__)
+#include <emmintrin.h>
+#define INDEX_VECTOR_BYTES 16
+#else
+#define INDEX_VECTOR_BYTES 8
+#endif
+
+#define INDEX_HIGH_BITS     0x8080808080808080ULL
+#define INDEX_GATHER        0x0102040810204080ULL   //Bit 0 of byte i lands on bit 56 + i
+#define INDEX_INITIAL_SIZE  1024
+
+void initialiseBusFrameIndex(tBusFrameIndex *ptrIndex);
+void freeBusFrameIndex(tBusFrameIndex *ptrIndex);
+int indexBusFrameMarkers(tBusFrameIndex *ptrIndex, const unsigned char *ptrBytes, size_t length, size_t base);
+int appendBusFrameIndex(tBusFrameIndex *ptrIndex, const tBusFrameIndex *ptrMore);
+size_t findBusFrameStart(const tBusFrameIndex *ptrIndex, size_t offset);
+size_t countBusFrameMarkers(const size_t *ptrOffsets, size_t count, size_t from, size_t to);
+uint64_t getMarkerBits(const unsigned char *ptrBytes);
+int addBusFrameMarker(tBusFrameIndex *ptrIndex, unsigned char byte, size_t offset);
+int growBusFrameIndex(size_t **ptrOffsets, size_t *ptrSize, size_t needed);
+size_t findFirstOffset(const size_t *ptrOffsets, size_t count, size_t offset);
+
+void initialiseBusFrameIndex(tBusFrameIndex *ptrIndex) {
+    memset(ptrIndex, 0, sizeof(*ptrIndex));
+}
+
+void freeBusFrameIndex(tBusFrameIndex *ptrIndex) {
+    free(ptrIndex->ptrStarts);
+    free(ptrIndex->ptrEnds);
+    initialiseBusFrameIndex(ptrIndex);
+}
+
+//Adds the SC1s and EC2s in ptrBytes, recorded as base + their position. Call in ascending order of base. -1 when out of memory
+int indexBusFrameMarkers(tBusFrameIndex *ptrIndex, const unsigned char *ptrBytes, size_t length, size_t base) {
+    uint64_t bits;
+    size_t position = 0;
+    unsigned int bit;
+
+    //One bit per byte with both top bits set, almost always none so the whole vector is skipped
+    for(; position + INDEX_VECTOR_BYTES <= length; position += INDEX_VECTOR_BYTES) {
+        bits = getMarkerBits(&ptrBytes[position]);
+        while(bits) {
+            bit = (unsigned int)__builtin_ctzll(bits);
+            if(addBusFrameMarker(ptrIndex, ptrBytes[position + bit], base + position + bit) < 0) {
+                return -1;
+            }
+            bits &= bits - 1;
+        }
+    }
+    for(; position < length; position++) {
+        if((ptrBytes[position] & 0b11000000) == 0b11000000 && addBusFrameMarker(ptrIndex, ptrBytes[position], base + position) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//For indexes built a slice at a time, ptrMore has to cover the bytes after ptrIndex's
+int appendBusFrameIndex(tBusFrameIndex *ptrIndex, const tBusFrameIndex *ptrMore) {
+    if(growBusFrameIndex(&ptrIndex->ptrStarts, &ptrIndex->startSize, ptrIndex->startCount + ptrMore->startCount) < 0
+            || growBusFrameIndex(&ptrIndex->ptrEnds, &ptrIndex->endSize, ptrIndex->endCount + ptrMore->endCount) < 0) {
+        return -1;
+    }
+    if(ptrMore->startCount) {
+        memcpy(&ptrIndex->ptrStarts[ptrIndex->startCount], ptrMore->ptrStarts, ptrMore->startCount * sizeof(size_t));
+    }
+    if(ptrMore->endCount) {
+        memcpy(&ptrIndex->ptrEnds[ptrIndex->endCount], ptrMore->ptrEnds, ptrMore->endCount * sizeof(size_t));
+    }
+    ptrIndex->startCount += ptrMore->startCount;
+    ptrIndex->endCount += ptrMore->endCount;
+    return 0;
+}
+
+//Position in ptrStarts of the first SC1 at or after offset, startCount if there isn't one
+size_t findBusFrameStart(const tBusFrameIndex *ptrIndex, size_t offset) {
+    return findFirstOffset(ptrIndex->ptrStarts, ptrIndex->startCount, offset);
+}
+
+//Markers in [from, to) of one of the index's lists
+size_t countBusFrameMarkers(const size_t *ptrOffsets, size_t count, size_t from, size_t to) {
+    if(to <= from) {
+        return 0;
+    }
+    return findFirstOffset(ptrOffsets, count, to) - findFirstOffset(ptrOffsets, count, from);
+}
+
+#if INDEX_VECTOR_BYTES == 32
+uint64_t getMarkerBits(const unsigned char *ptrBytes) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)ptrBytes);
+    //Adding a byte to itself moves bit 6 up to bit 7
+    return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(bytes, _mm256_add_epi8(bytes, bytes)));
+}
+#elif INDEX_VECTOR_BYTES == 16
+uint64_t getMarkerBits(const unsigned char *ptrBytes) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)ptrBytes);
+    //Adding a byte to itself moves bit 6 up to bit 7
+    return (uint32_t)_mm_movemask_epi8(_mm_and_si128(bytes, _mm_add_epi8(bytes, bytes)));
+}
+#else
+uint64_t getMarkerBits(const unsigned char *ptrBytes) {
+    uint64_t word;
+    memcpy(&word, ptrBytes, sizeof(word));
+    //Shifting the word moves each byte's bit 6 up to its bit 7, then the flags are gathered into one byte like the block mask
+    return ((((word & (word << 1) & INDEX_HIGH_BITS) >> 7) * INDEX_GATHER) >> 56);
+}
+#endif
+
+int addBusFrameMarker(tBusFrameIndex *ptrIndex, unsigned char byte, size_t offset) {
+    switch(byte & 0xF0) {
+        case 0xC0:
+            if(growBusFrameIndex(&ptrIndex->ptrStarts, &ptrIndex->startSize, ptrIndex->startCount + 1) < 0) {
+                return -1;
+            }
+            ptrIndex->ptrStarts[ptrIndex->startCount++] = offset;
+            break;
+
+        case 0xF0:
+            if(growBusFrameIndex(&ptrIndex->ptrEnds, &ptrIndex->endSize, ptrIndex->endCount + 1) < 0) {
+                return -1;
+            }
+            ptrIndex->ptrEnds[ptrIndex->endCount++] = offset;
+            break;
+    }
+    return 0;
+}
+
+int growBusFrameIndex(size_t **ptrOffsets, size_t *ptrSize, size_t needed) {
+    size_t *ptrGrown;
+    size_t size = *ptrSize ? *ptrSize : INDEX_INITIAL_SIZE;
+
+    if(needed <= *ptrSize) {
+        return 0;
+    }
+    while(size < needed) {
+        size *= 2;
+    }
+    ptrGrown = realloc(*ptrOffsets, size * sizeof(size_t));
+    if(ptrGrown == 0) {
+        return -1;
+    }
+    *ptrOffsets = ptrGrown;
+    *ptrSize = size;
+    return 0;
+}
+
+size_t findFirstOffset(const size_t *ptrOffsets, size_t count, size_t offset) {
+    size_t low = 0;
+    size_t high = count;
+    size_t middle;
+
+    while(low < high) {
+        middle = low + (high - low) / 2;
+        if(ptrOffsets[middle] < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,34 @@
+#ifndef BUS_FRAME_INDEX_H
+#define	BUS_FRAME_INDEX_H
+
+#include <stddef.h>
+
+/*
+ * Frame boundaries straight from the wire bytes. Only marker bytes have both
+ * top bits set (mask bytes are 0b10xxxxxx, payload, CRC and header bytes have
+ * bit 7 clear), so SC1 (0xCn) and EC2 (0xFn) can be picked out a vector at a
+ * time without running the handler.
+ */
+
+//0 = 64 bit SWAR everywhere, otherwise SSE2/AVX2 when the compiler targets them
+#ifndef BUS_FRAME_INDEX_VECTOR
+#define BUS_FRAME_INDEX_VECTOR 1
+#endif
+
+typedef struct {
+    size_t *ptrStarts;  //SC1 offsets, ascending
+    size_t startCount;
+    size_t startSize;
+    size_t *ptrEnds;    //EC2 offsets, ascending
+    size_t endCount;
+    size_t endSize;
+} tBusFrameIndex;
+
+extern void initialiseBusFrameIndex(tBusFrameIndex *ptrIndex);
+extern void freeBusFrameIndex(tBusFrameIndex *ptrIndex);
+extern int indexBusFrameMarkers(tBusFrameIndex *ptrIndex, const unsigned char *ptrBytes, size_t length, size_t base);
+extern int appendBusFrameIndex(tBusFrameIndex *ptrIndex, const tBusFrameIndex *ptrMore);
+extern size_t findBusFrameStart(const tBusFrameIndex *ptrIndex, size_t offset);
+extern size_t countBusFrameMarkers(const size_t *ptrOffsets, size_t count, size_t from, size_t to);
+
+#endif	/* BUS_FRAME_INDEX_H */
@@ -0,0 +1,547 @@
+/*
+ * File:   bus_gateway.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 17:05
+ *
+ * Linux gateway: one epoll loop serving any number of serial buses.
+ *
+ *   bus_gateway [-b baud] [-c capture file] <socket path> <tty> [<tty> ...]
+ *
+ * Each tty is put in raw mode and gets its own bus handler context. Decoded
+ * frames go to every client of the SOCK_SEQPACKET unix socket as
+ * [port][payload...]. A client sends [port][format][payload...] to put a
+ * frame on a bus, format being 0 or BUS_FRAME_FORMAT_DENSE.
+ *
+ * Try it without hardware using a pty pair per bus, e.g.
+ *   socat -d -d pty,raw,echo=0 pty,raw,echo=0
+ *
+ * -c records every chunk read from and written to each tty, timestamped, in
+ * the bus_capture.h format for bus_replay.
+ *
+ * A tty that hangs up or fails is closed and marked down: frames sent to
+ * it are refused until a reopen works, tried again after a backoff that
+ * doubles from GATEWAY_REOPEN_MIN_MS to GATEWAY_REOPEN_MAX_MS.
+ *
+ * SIGUSR1 prints per-port counters and the latency from the read() that
+ * completed a frame to its delivery on the socket. SIGINT/SIGTERM print
+ * them and exit.
+ *
+ * Build alongside the bus sources, bus_capture.c, ../crc.c and ../ring-buffer.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../ring-buffer/ring_buffer.h"
+#include "../bus_frame_details.h"
+#include "../bus_frame_handler.h"
+#include "../bus_frame_writer.h"
+#include "bus_capture.h"
+
+#define GATEWAY_MAX_PORTS           32
+#define GATEWAY_MAX_CLIENTS         32
+#define GATEWAY_MAX_EVENTS          64
+#define GATEWAY_READ_CHUNK          512
+#define GATEWAY_FRAME_MAX           (MAX_JUMBO_UNPACKED_PAYLOAD + 6)    //Block frames are padded to a whole block
+#define GATEWAY_APPLICATION_SIZE    (GATEWAY_FRAME_MAX + 64)
+#define GATEWAY_OUT_SIZE            (4 * GATEWAY_FRAME_MAX)
+#define GATEWAY_STEP_BUDGET         4096
+#define GATEWAY_REOPEN_MIN_MS       250
+#define GATEWAY_REOPEN_MAX_MS       8000
+
+#define EVENT_KIND_PORT             1ULL
+#define EVENT_KIND_LISTEN           2ULL
+#define EVENT_KIND_CLIENT           3ULL
+#define EVENT_DATA(kind, index)     (((kind) << 32) | (unsigned long long)(index))
+
+typedef struct {
+    const char *ptrPath;
+    int fd;                         //-1 while the port is down
+    tBusFrameHandlerCtx handler;
+    tBuffer applicationBuffer;
+    unsigned char applicationBufferArray[GATEWAY_APPLICATION_SIZE];
+    unsigned char applicationListener;
+    unsigned char outBytes[GATEWAY_OUT_SIZE];
+    unsigned int outStart;
+    unsigned int outLength;
+    unsigned char outWatched;
+    unsigned long bytesIn;
+    unsigned long framesIn;
+    unsigned long framesOut;
+    unsigned long framesRefused;
+    unsigned long long latencyTotalNs;
+    unsigned long long latencyMaxNs;
+    unsigned long downCount;
+    unsigned int reopenMs;
+    unsigned long long reopenNs;
+} tGatewayPort;
+
+tGatewayPort gatewayPorts[GATEWAY_MAX_PORTS];
+unsigned int gatewayPortCount;
+int gatewayClients[GATEWAY_MAX_CLIENTS];
+int gatewayEpoll;
+speed_t gatewaySpeed = B115200;
+tBusCapture gatewayCapture;
+volatile sig_atomic_t gatewayReportWanted;
+volatile sig_atomic_t gatewayStopWanted;
+
+unsigned long long getNowNs(void);
+speed_t getBaudConstant(long baud);
+int openPort(tGatewayPort *ptrPort, speed_t speed);
+int startPort(unsigned int index);
+void closePort(unsigned int index, const char *ptrReason);
+void reopenPorts(void);
+int getReopenTimeout(void);
+int openListenSocket(const char *ptrPath);
+void watchPortOutput(unsigned int index, unsigned char enabled);
+void feedPort(unsigned int index, const unsigned char *ptrBytes, unsigned int length, unsigned long long arrivalNs);
+void deliverFrame(unsigned int index, unsigned long long arrivalNs);
+void sendToPort(unsigned int index, unsigned char format, const unsigned char *ptrPayload, unsigned int length);
+void flushPort(unsigned int index);
+void acceptClient(int listenFd);
+void handleClient(unsigned int slot);
+void dropClient(unsigned int slot);
+void reportPorts(void);
+void onSignal(int signalNumber);
+
+unsigned long long getNowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+speed_t getBaudConstant(long baud) {
+    switch(baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return 0;
+    }
+}
+
+int openPort(tGatewayPort *ptrPort, speed_t speed) {
+    struct termios tio;
+
+    ptrPort->fd = open(ptrPort->ptrPath, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(ptrPort->fd < 0) {
+        return -1;
+    }
+    if(tcgetattr(ptrPort->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(ptrPort->fd, TCSANOW, &tio);
+    }
+    initialiseBusFrameHandlerCtx(&ptrPort->handler);
+    initialiseBuffer(&ptrPort->applicationBuffer, &ptrPort->applicationBufferArray[0], GATEWAY_APPLICATION_SIZE);
+    registerApplicationBufferCtx(&ptrPort->handler, &ptrPort->applicationBuffer);
+    registerApplicationListenerCtx(&ptrPort->handler, &ptrPort->applicationListener);
+    ptrPort->outStart = 0;
+    ptrPort->outLength = 0;
+    ptrPort->outWatched = 0;
+    return 0;
+}
+
+//Opens the tty and adds it to the epoll set, fd left at -1 if either fails
+int startPort(unsigned int index) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+    struct epoll_event event;
+
+    if(openPort(ptrPort, gatewaySpeed) < 0) {
+        ptrPort->fd = -1;
+        return -1;
+    }
+    event.events = EPOLLIN;
+    event.data.u64 = EVENT_DATA(EVENT_KIND_PORT, index);
+    if(epoll_ctl(gatewayEpoll, EPOLL_CTL_ADD, ptrPort->fd, &event) < 0) {
+        close(ptrPort->fd);
+        ptrPort->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+//Closing the fd takes it out of the epoll set too. Whatever was waiting to go out is lost with the port
+void closePort(unsigned int index, const char *ptrReason) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+
+    if(ptrPort->fd < 0) {
+        return;
+    }
+    fprintf(stderr, "port %u %s: down, %s\n", index, ptrPort->ptrPath, ptrReason);
+    close(ptrPort->fd);
+    ptrPort->fd = -1;
+    ptrPort->outStart = 0;
+    ptrPort->outLength = 0;
+    ptrPort->outWatched = 0;
+    ptrPort->downCount++;
+    ptrPort->reopenMs = GATEWAY_REOPEN_MIN_MS;
+    ptrPort->reopenNs = getNowNs() + ptrPort->reopenMs * 1000000ULL;
+}
+
+void reopenPorts(void) {
+    unsigned long long nowNs = getNowNs();
+    tGatewayPort *ptrPort;
+    unsigned int index;
+
+    for(index = 0; index < gatewayPortCount; index++) {
+        ptrPort = &gatewayPorts[index];
+        if(ptrPort->fd >= 0 || nowNs < ptrPort->reopenNs) {
+            continue;
+        }
+        if(startPort(index) == 0) {
+            fprintf(stderr, "port %u %s: up again\n", index, ptrPort->ptrPath);
+            continue;
+        }
+        ptrPort->reopenMs = ptrPort->reopenMs * 2 < GATEWAY_REOPEN_MAX_MS ? ptrPort->reopenMs * 2 : GATEWAY_REOPEN_MAX_MS;
+        ptrPort->reopenNs = nowNs + ptrPort->reopenMs * 1000000ULL;
+    }
+}
+
+//epoll_wait timeout until the next reopen is due, -1 with every port up
+int getReopenTimeout(void) {
+    unsigned long long nowNs = getNowNs();
+    unsigned long long waitNs;
+    int timeoutMs = -1;
+    unsigned int index;
+
+    for(index = 0; index < gatewayPortCount; index++) {
+        if(gatewayPorts[index].fd >= 0) {
+            continue;
+        }
+        waitNs = gatewayPorts[index].reopenNs > nowNs ? gatewayPorts[index].reopenNs - nowNs : 0;
+        if(timeoutMs < 0 || (int)(waitNs / 1000000ULL) < timeoutMs) {
+            timeoutMs = (int)(waitNs / 1000000ULL);
+        }
+    }
+    return timeoutMs;
+}
+
+int openListenSocket(const char *ptrPath) {
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(fd < 0 || strlen(ptrPath) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, ptrPath);
+    unlink(ptrPath);
+    if(bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void watchPortOutput(unsigned int index, unsigned char enabled) {
+    struct epoll_event event;
+    if(gatewayPorts[index].outWatched == enabled) {
+        return;
+    }
+    event.events = EPOLLIN | (enabled ? EPOLLOUT : 0);
+    event.data.u64 = EVENT_DATA(EVENT_KIND_PORT, index);
+    if(epoll_ctl(gatewayEpoll, EPOLL_CTL_MOD, gatewayPorts[index].fd, &event) < 0) {
+        //Without the watch the queued bytes would never go out
+        closePort(index, strerror(errno));
+        return;
+    }
+    gatewayPorts[index].outWatched = enabled;
+}
+
+//Pushes a read's worth of bytes through the handler, handing out every frame it completes
+void feedPort(unsigned int index, const unsigned char *ptrBytes, unsigned int length, unsigned long long arrivalNs) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus;
+    unsigned int accepted;
+
+    ptrPort->bytesIn += length;
+    do {
+        putBytesForHandlingCtx(&ptrPort->handler, &putStatus, ptrBytes, length, &accepted);
+        ptrBytes += accepted;
+        length -= accepted;
+        do {
+            runBusFrameHandlerBudgetCtx(&ptrPort->handler, &runStatus, GATEWAY_STEP_BUDGET);
+            if(runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION) {
+                deliverFrame(index, arrivalNs);
+            }
+        } while(runStatus != BUS_HANDLER_RUN_STARVED);
+    } while(length > 0);
+}
+
+void deliverFrame(unsigned int index, unsigned long long arrivalNs) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+    unsigned char message[1 + GATEWAY_APPLICATION_SIZE];
+    unsigned int length = 1;
+    unsigned long long latencyNs;
+    eBufferOperationStatus status;
+    unsigned int slot;
+
+    message[0] = (unsigned char)index;
+    do {
+        status = BUFFER_OPERATION_NONE;
+        getByte(&ptrPort->applicationBuffer, &status, &message[length]);
+        if(status == BUFFER_OPERATION_OK) {
+            length++;
+        }
+    } while(status == BUFFER_OPERATION_OK && length < sizeof(message));
+    ptrPort->applicationListener = 0;
+
+    for(slot = 0; slot < GATEWAY_MAX_CLIENTS; slot++) {
+        //A client that can't keep up misses frames rather than stalling every bus
+        if(gatewayClients[slot] >= 0 && send(gatewayClients[slot], message, length, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno != EAGAIN) {
+            dropClient(slot);
+        }
+    }
+    latencyNs = getNowNs() - arrivalNs;
+    ptrPort->framesIn++;
+    ptrPort->latencyTotalNs += latencyNs;
+    if(latencyNs > ptrPort->latencyMaxNs) {
+        ptrPort->latencyMaxNs = latencyNs;
+    }
+}
+
+void sendToPort(unsigned int index, unsigned char format, const unsigned char *ptrPayload, unsigned int length) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+    unsigned int written;
+
+    if(ptrPort->fd < 0) {
+        ptrPort->framesRefused++;
+        return;
+    }
+    if(ptrPort->outLength && ptrPort->outStart) {
+        memmove(&ptrPort->outBytes[0], &ptrPort->outBytes[ptrPort->outStart], ptrPort->outLength);
+    }
+    ptrPort->outStart = 0;
+    written = encodeBusFrame(ptrPayload, length, format & BUS_FRAME_FORMAT_KNOWN, &ptrPort->outBytes[ptrPort->outLength], GATEWAY_OUT_SIZE - ptrPort->outLength);
+    if(written == 0) {
+        ptrPort->framesRefused++;
+        return;
+    }
+    ptrPort->outLength += written;
+    ptrPort->framesOut++;
+    flushPort(index);
+}
+
+void flushPort(unsigned int index) {
+    tGatewayPort *ptrPort = &gatewayPorts[index];
+    ssize_t sent;
+
+    while(ptrPort->outLength) {
+        sent = write(ptrPort->fd, &ptrPort->outBytes[ptrPort->outStart], ptrPort->outLength);
+        if(sent < 0 && errno != EAGAIN && errno != EINTR) {
+            closePort(index, strerror(errno));
+            return;
+        }
+        if(sent <= 0) {
+            break;
+        }
+        writeBusCaptureChunk(&gatewayCapture, (uint16_t)index, BUS_CAPTURE_TX, getNowNs(), &ptrPort->outBytes[ptrPort->outStart], (uint32_t)sent);
+        ptrPort->outStart += (unsigned int)sent;
+        ptrPort->outLength -= (unsigned int)sent;
+    }
+    if(ptrPort->outLength == 0) {
+        ptrPort->outStart = 0;
+    }
+    watchPortOutput(index, ptrPort->outLength > 0);
+}
+
+void acceptClient(int listenFd) {
+    struct epoll_event event;
+    unsigned int slot;
+    int fd;
+
+    while((fd = accept4(listenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        for(slot = 0; slot < GATEWAY_MAX_CLIENTS && gatewayClients[slot] >= 0; slot++) {
+        }
+        if(slot == GATEWAY_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        event.events = EPOLLIN;
+        event.data.u64 = EVENT_DATA(EVENT_KIND_CLIENT, slot);
+        if(epoll_ctl(gatewayEpoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("client");
+            close(fd);
+            continue;
+        }
+        gatewayClients[slot] = fd;
+    }
+}
+
+void handleClient(unsigned int slot) {
+    unsigned char message[2 + GATEWAY_FRAME_MAX];
+    ssize_t length;
+
+    while((length = recv(gatewayClients[slot], message, sizeof(message), MSG_DONTWAIT)) != 0) {
+        if(length < 0) {
+            if(errno != EAGAIN) {
+                dropClient(slot);
+            }
+            return;
+        }
+        if(length >= 2 && message[0] < gatewayPortCount) {
+            sendToPort(message[0], message[1], &message[2], (unsigned int)length - 2);
+        }
+    }
+    dropClient(slot);
+}
+
+//Closing the fd takes it out of the epoll set, nothing else holds a copy of it
+void dropClient(unsigned int slot) {
+    close(gatewayClients[slot]);
+    gatewayClients[slot] = -1;
+}
+
+void reportPorts(void) {
+    unsigned int index;
+    tGatewayPort *ptrPort;
+    for(index = 0; index < gatewayPortCount; index++) {
+        ptrPort = &gatewayPorts[index];
+        fprintf(stderr, "port %u %s: %s, in %lu bytes %lu frames, out %lu frames (%lu refused), latency avg %.1fus max %.1fus, down %lu times\n",
+                index, ptrPort->ptrPath, ptrPort->fd >= 0 ? "up" : "down", ptrPort->bytesIn, ptrPort->framesIn, ptrPort->framesOut,
+                ptrPort->framesRefused, ptrPort->framesIn ? (double)ptrPort->latencyTotalNs / ptrPort->framesIn / 1000.0 : 0.0,
+                (double)ptrPort->latencyMaxNs / 1000.0, ptrPort->downCount);
+    }
+}
+
+void onSignal(int signalNumber) {
+    if(signalNumber == SIGUSR1) {
+        gatewayReportWanted = 1;
+    } else {
+        gatewayStopWanted = 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    struct epoll_event events[GATEWAY_MAX_EVENTS];
+    struct epoll_event event;
+    unsigned char readBytes[GATEWAY_READ_CHUNK];
+    unsigned long long arrivalNs;
+    unsigned int kind;
+    unsigned int index;
+    ssize_t length;
+    int listenFd;
+    int argument = 1;
+    int ready;
+    int i;
+
+    while(argc - argument > 2 && argv[argument][0] == '-') {
+        if(strcmp(argv[argument], "-b") == 0) {
+            gatewaySpeed = getBaudConstant(atol(argv[argument + 1]));
+        } else if(strcmp(argv[argument], "-c") == 0) {
+            if(openBusCapture(&gatewayCapture, argv[argument + 1]) < 0) {
+                perror(argv[argument + 1]);
+                return 1;
+            }
+        } else {
+            gatewaySpeed = 0;
+        }
+        argument += 2;
+    }
+    if(gatewaySpeed == 0 || argc - argument < 2 || argc - argument - 1 > GATEWAY_MAX_PORTS) {
+        fprintf(stderr, "usage: %s [-b baud] [-c capture file] <socket path> <tty> [<tty> ...]\n", argv[0]);
+        return 2;
+    }
+
+    signal(SIGUSR1, onSignal);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    gatewayEpoll = epoll_create1(EPOLL_CLOEXEC);
+    for(i = 0; i < GATEWAY_MAX_CLIENTS; i++) {
+        gatewayClients[i] = -1;
+    }
+    listenFd = openListenSocket(argv[argument]);
+    if(gatewayEpoll < 0 || listenFd < 0) {
+        perror(argv[argument]);
+        return 1;
+    }
+    event.events = EPOLLIN;
+    event.data.u64 = EVENT_DATA(EVENT_KIND_LISTEN, 0);
+    if(epoll_ctl(gatewayEpoll, EPOLL_CTL_ADD, listenFd, &event) < 0) {
+        perror(argv[argument]);
+        return 1;
+    }
+
+    for(i = argument + 1; i < argc; i++) {
+        index = gatewayPortCount++;
+        gatewayPorts[index].ptrPath = argv[i];
+        if(startPort(index) < 0) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    while(!gatewayStopWanted) {
+        if(gatewayReportWanted) {
+            gatewayReportWanted = 0;
+            reportPorts();
+        }
+        ready = epoll_wait(gatewayEpoll, events, GATEWAY_MAX_EVENTS, getReopenTimeout());
+        for(i = 0; i < ready; i++) {
+            kind = (unsigned int)(events[i].data.u64 >> 32);
+            index = (unsigned int)events[i].data.u64;
+            switch(kind) {
+                case EVENT_KIND_PORT:
+                    if(gatewayPorts[index].fd >= 0 && (events[i].events & EPOLLOUT)) {
+                        flushPort(index);
+                    }
+                    //Already closed by an earlier event in this batch
+                    if(gatewayPorts[index].fd >= 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                        while((length = read(gatewayPorts[index].fd, readBytes, sizeof(readBytes))) > 0) {
+                            arrivalNs = getNowNs();
+                            writeBusCaptureChunk(&gatewayCapture, (uint16_t)index, BUS_CAPTURE_RX, arrivalNs, readBytes, (uint32_t)length);
+                            feedPort(index, readBytes, (unsigned int)length, arrivalNs);
+                        }
+                        if(length == 0) {
+                            //Other end of a pty went away
+                            closePort(index, "hung up");
+                        } else if(length < 0 && errno != EAGAIN && errno != EINTR) {
+                            closePort(index, strerror(errno));
+                        }
+                    }
+                    break;
+
+                case EVENT_KIND_LISTEN:
+                    acceptClient(listenFd);
+                    break;
+
+                case EVENT_KIND_CLIENT:
+                    handleClient(index);
+                    break;
+            }
+        }
+        reopenPorts();
+    }
+    reportPorts();
+    if(gatewayCapture.ptrFile) {
+        fprintf(stderr, "capture: %lu records, %llu bytes\n", gatewayCapture.records, gatewayCapture.bytes);
+    }
+    closeBusCapture(&gatewayCapture);
+    unlink(argv[argument]);
+    return 0;
+}
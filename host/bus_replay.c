@@ -0,0 +1,344 @@
+/*
+ * File:   bus_replay.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 18:45
+ *
+ * Replays a bus capture (bus_capture.h, e.g. from bus_gateway -c) through
+ * the frame handler, one handler context per port and direction.
+ *
+ *   bus_replay [-r] [-q] [-n repeats] [-t trace dump] <capture file>
+ *
+ * By default the chunks go in back to back as fast as the handler takes
+ * them. -r waits out the recorded gaps so the handler sees the bytes at the
+ * pace they crossed the wire. Every decoded frame and every error the
+ * handler counted while taking a chunk is printed, -q leaves just the
+ * totals, which with -n makes a decode benchmark out of real traffic.
+ *
+ * Built with -DBUS_FRAME_TRACE_ENABLED=1, -t writes every handler
+ * transition (bus number = order each port/direction first shows up,
+ * timestamps in ns) for bus_trace to turn into per-frame timelines. Give it
+ * a -DBUS_FRAME_TRACE_SIZE of a few thousand so a chunk's worth fits.
+ *
+ * Build alongside the bus sources with -DBUS_FRAME_STATS_ENABLED=1,
+ * bus_capture.c, ../crc.c and ../ring-buffer.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../ring-buffer/ring_buffer.h"
+#include "../bus_frame_details.h"
+#include "../bus_frame_handler.h"
+#include "../bus_frame_trace.h"
+#include "bus_capture.h"
+
+#if !BUS_FRAME_STATS_ENABLED
+#error "bus_replay reports errors from the handler counters, build everything with -DBUS_FRAME_STATS_ENABLED=1"
+#endif
+
+#define REPLAY_MAX_BUSES            64
+#define REPLAY_FRAME_MAX            (MAX_JUMBO_UNPACKED_PAYLOAD + 6)
+#define REPLAY_APPLICATION_SIZE     (REPLAY_FRAME_MAX + 64)
+#define REPLAY_STEP_BUDGET          4096
+#define REPLAY_PRINT_BYTES          32
+
+typedef struct {
+    uint16_t port;
+    uint8_t direction;
+    tBusFrameHandlerCtx handler;
+    tBuffer applicationBuffer;
+    unsigned char applicationBufferArray[REPLAY_APPLICATION_SIZE];
+    unsigned char applicationListener;
+    tBusFrameHandlerStats lastStats;
+    unsigned long frames;
+    unsigned long errors;
+} tReplayBus;
+
+const char *replayErrorNames[BHE_ERROR_KINDS] = {
+    [BHE_NONE] = "NONE",
+    [BHE_LISTENER_NOT_REGISTERED] = "LISTENER_NOT_REGISTERED",
+    [BHE_WRITE_OUT_FAILED] = "WRITE_OUT_FAILED",
+    [BHE_GET_FOR_WRITE_OUT_FAILED] = "GET_FOR_WRITE_OUT_FAILED",
+    [BHE_OUT_OF_BOUNDS_BLOCK] = "OUT_OF_BOUNDS_BLOCK",
+    [BHE_TOO_MANY_STUFF] = "TOO_MANY_STUFF",
+    [BHE_SC1_WITHOUT_SC2] = "SC1_WITHOUT_SC2",
+    [BHE_ALREADY_IN_BLOCK] = "ALREADY_IN_BLOCK",
+    [BHE_I_SHOULDNT_BE_HERE] = "I_SHOULDNT_BE_HERE",
+    [BHE_INVALID_B2F_IN_EC2] = "INVALID_B2F_IN_EC2",
+    [BHE_INVALID_B2F_IN_EC1] = "INVALID_B2F_IN_EC1",
+    [BHE_INVALID_B2F_IN_SC2] = "INVALID_B2F_IN_SC2",
+    [BHE_OUT_OF_POS_SC2] = "OUT_OF_POS_SC2",
+    [BHE_GOALPOST_OR_MASK_NOT_RECEIVED] = "GOALPOST_OR_MASK_NOT_RECEIVED",
+    [BHE_GOALPOST_NOT_RECEIVED] = "GOALPOST_NOT_RECEIVED",
+    [BHE_MASK_NOT_RECEIVED] = "MASK_NOT_RECEIVED",
+    [BHE_INVALID_FORMAT_HEADER] = "INVALID_FORMAT_HEADER",
+    [BHE_DENSE_BYTE_INVALID] = "DENSE_BYTE_INVALID",
+    [BHE_REPAIR_UNEXPECTED] = "REPAIR_UNEXPECTED",
+    [BHE_FEEDBACK_INVALID] = "FEEDBACK_INVALID",
+    [BHE_COMPRESSION_REFERENCE] = "COMPRESSION_REFERENCE",
+    [BHE_COMPRESSION_INVALID] = "COMPRESSION_INVALID",
+    [BHE_CRC_FAILED] = "CRC_FAILED",
+};
+
+tReplayBus *replayBuses[REPLAY_MAX_BUSES];
+unsigned int replayBusCount;
+unsigned char replayQuiet;
+#if BUS_FRAME_TRACE_ENABLED
+tBusFrameTrace replayTrace;
+unsigned long replayTraceCursor;
+FILE *ptrReplayTraceFile;
+#endif
+
+unsigned long long getNowNs(void);
+unsigned long getTraceTick(void);
+void drainReplayTrace(void);
+void sleepUntilNs(unsigned long long wakeNs);
+tReplayBus *getReplayBus(uint16_t port, uint8_t direction);
+void feedReplayBus(tReplayBus *ptrBus, const unsigned char *ptrBytes, unsigned int length, double atMs);
+void deliverReplayFrame(tReplayBus *ptrBus, double atMs);
+void reportReplayErrors(tReplayBus *ptrBus, double atMs);
+
+unsigned long long getNowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+unsigned long getTraceTick(void) {
+    return (unsigned long)getNowNs();
+}
+
+void drainReplayTrace(void) {
+#if BUS_FRAME_TRACE_ENABLED
+    tBusFrameTraceEvent events[64];
+    unsigned long before;
+    unsigned int count;
+    unsigned int index;
+
+    if(ptrReplayTraceFile == 0) {
+        return;
+    }
+    do {
+        before = replayTraceCursor;
+        count = readBusFrameTraceCtx(&replayTrace, &replayTraceCursor, events, 64);
+        if(replayTraceCursor - before > count) {
+            fprintf(ptrReplayTraceFile, "# lost %lu\n", replayTraceCursor - before - count);
+        }
+        for(index = 0; index < count; index++) {
+            fprintf(ptrReplayTraceFile, "%lu %u %u %u %u %u\n", events[index].timestamp, events[index].bus, events[index].component,
+                    events[index].oldState, events[index].newState, events[index].error);
+        }
+    } while(count == 64);
+#endif
+}
+
+void sleepUntilNs(unsigned long long wakeNs) {
+    struct timespec wake;
+    wake.tv_sec = (time_t)(wakeNs / 1000000000ULL);
+    wake.tv_nsec = (long)(wakeNs % 1000000000ULL);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, 0) != 0) {
+    }
+}
+
+//Receive and transmit of a port decode separately, the transmit side shows what we actually put on the wire
+tReplayBus *getReplayBus(uint16_t port, uint8_t direction) {
+    tReplayBus *ptrBus;
+    unsigned int index;
+
+    for(index = 0; index < replayBusCount; index++) {
+        if(replayBuses[index]->port == port && replayBuses[index]->direction == direction) {
+            return replayBuses[index];
+        }
+    }
+    if(replayBusCount == REPLAY_MAX_BUSES || (ptrBus = calloc(1, sizeof(*ptrBus))) == 0) {
+        return 0;
+    }
+    ptrBus->port = port;
+    ptrBus->direction = direction;
+    initialiseBusFrameHandlerCtx(&ptrBus->handler);
+    initialiseBuffer(&ptrBus->applicationBuffer, &ptrBus->applicationBufferArray[0], REPLAY_APPLICATION_SIZE);
+    registerApplicationBufferCtx(&ptrBus->handler, &ptrBus->applicationBuffer);
+    registerApplicationListenerCtx(&ptrBus->handler, &ptrBus->applicationListener);
+#if BUS_FRAME_TRACE_ENABLED
+    if(ptrReplayTraceFile) {
+        registerBusFrameTraceCtx(&ptrBus->handler, &replayTrace, (unsigned char)replayBusCount);
+    }
+#endif
+    replayBuses[replayBusCount++] = ptrBus;
+    return ptrBus;
+}
+
+//Same loop as the gateway's feedPort, so a capture decodes the way it did live
+void feedReplayBus(tReplayBus *ptrBus, const unsigned char *ptrBytes, unsigned int length, double atMs) {
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus;
+    unsigned int accepted;
+
+    do {
+        putBytesForHandlingCtx(&ptrBus->handler, &putStatus, ptrBytes, length, &accepted);
+        ptrBytes += accepted;
+        length -= accepted;
+        do {
+            runBusFrameHandlerBudgetCtx(&ptrBus->handler, &runStatus, REPLAY_STEP_BUDGET);
+            if(runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION) {
+                deliverReplayFrame(ptrBus, atMs);
+            }
+            drainReplayTrace();
+        } while(runStatus != BUS_HANDLER_RUN_STARVED);
+    } while(length > 0);
+    reportReplayErrors(ptrBus, atMs);
+}
+
+void deliverReplayFrame(tReplayBus *ptrBus, double atMs) {
+    unsigned char frame[REPLAY_APPLICATION_SIZE];
+    eBufferOperationStatus status;
+    unsigned int length = 0;
+    unsigned int index;
+
+    do {
+        status = BUFFER_OPERATION_NONE;
+        getByte(&ptrBus->applicationBuffer, &status, &frame[length]);
+        if(status == BUFFER_OPERATION_OK) {
+            length++;
+        }
+    } while(status == BUFFER_OPERATION_OK && length < sizeof(frame));
+    ptrBus->applicationListener = 0;
+    ptrBus->frames++;
+
+    if(replayQuiet) {
+        return;
+    }
+    printf("%12.3f port %u %s frame %u:", atMs, ptrBus->port, ptrBus->direction == BUS_CAPTURE_TX ? "tx" : "rx", length);
+    for(index = 0; index < length && index < REPLAY_PRINT_BYTES; index++) {
+        printf(" %02x", frame[index]);
+    }
+    printf(length > REPLAY_PRINT_BYTES ? " ...\n" : "\n");
+}
+
+//Errors show up as counter movements, the handler only keeps the last one itself
+void reportReplayErrors(tReplayBus *ptrBus, double atMs) {
+    tBusFrameHandlerStats stats;
+    unsigned long count;
+    unsigned int kind;
+
+    snapshotBusFrameHandlerStatsCtx(&ptrBus->handler, &stats);
+    for(kind = BHE_NONE + 1; kind < BHE_ERROR_KINDS; kind++) {
+        count = stats.errorCounts[kind] - ptrBus->lastStats.errorCounts[kind];
+        ptrBus->errors += count;
+        if(count && !replayQuiet) {
+            printf("%12.3f port %u %s error %s x%lu\n", atMs, ptrBus->port, ptrBus->direction == BUS_CAPTURE_TX ? "tx" : "rx",
+                    replayErrorNames[kind] ? replayErrorNames[kind] : "?", count);
+        }
+    }
+    //CRC failures that dropped a frame are CRC_FAILED above, the rest were blocks left for selective repeat
+    count = (stats.crcFailures - ptrBus->lastStats.crcFailures) - (stats.errorCounts[BHE_CRC_FAILED] - ptrBus->lastStats.errorCounts[BHE_CRC_FAILED]);
+    if(count && !replayQuiet) {
+        printf("%12.3f port %u %s blocks failing CRC left for repair x%lu\n", atMs, ptrBus->port, ptrBus->direction == BUS_CAPTURE_TX ? "tx" : "rx", count);
+    }
+    ptrBus->lastStats = stats;
+}
+
+int main(int argc, char **argv) {
+    const tBusCaptureRecord *ptrRecord;
+    const unsigned char *ptrMapped;
+    tReplayBus *ptrBus;
+    struct stat fileStat;
+    unsigned long long firstNs = 0;
+    unsigned long long startNs;
+    unsigned long long elapsedNs;
+    unsigned long long bytes = 0;
+    unsigned long records = 0;
+    unsigned long repeats = 1;
+    unsigned long repeat;
+    unsigned char wireSpeed = 0;
+    size_t offset;
+    unsigned int index;
+    int argument = 1;
+    int fd;
+
+    while(argument < argc - 1 && argv[argument][0] == '-') {
+        if(strcmp(argv[argument], "-r") == 0) {
+            wireSpeed = 1;
+        } else if(strcmp(argv[argument], "-q") == 0) {
+            replayQuiet = 1;
+        } else if(strcmp(argv[argument], "-n") == 0 && argument < argc - 2) {
+            repeats = strtoul(argv[++argument], 0, 10);
+#if BUS_FRAME_TRACE_ENABLED
+        } else if(strcmp(argv[argument], "-t") == 0 && argument < argc - 2) {
+            ptrReplayTraceFile = fopen(argv[++argument], "w");
+            if(ptrReplayTraceFile == 0) {
+                perror(argv[argument]);
+                return 1;
+            }
+            initialiseBusFrameTraceCtx(&replayTrace, getTraceTick);
+#endif
+        } else {
+            break;
+        }
+        argument++;
+    }
+    if(argument != argc - 1 || repeats == 0) {
+        fprintf(stderr, "usage: %s [-r] [-q] [-n repeats] [-t trace dump] <capture file>\n", argv[0]);
+        return 2;
+    }
+
+    fd = open(argv[argument], O_RDONLY);
+    if(fd < 0 || fstat(fd, &fileStat) < 0) {
+        perror(argv[argument]);
+        return 1;
+    }
+    ptrMapped = mmap(0, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if(fileStat.st_size == 0 || ptrMapped == MAP_FAILED) {
+        fprintf(stderr, "%s: can't map\n", argv[argument]);
+        return 1;
+    }
+    madvise((void *)ptrMapped, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    offset = 0;
+    if(getBusCaptureRecord(ptrMapped, (size_t)fileStat.st_size, &offset) == 0) {
+        fprintf(stderr, "%s: not a bus capture or empty\n", argv[argument]);
+        return 1;
+    }
+
+    startNs = getNowNs();
+    for(repeat = 0; repeat < repeats; repeat++) {
+        offset = 0;
+        while((ptrRecord = getBusCaptureRecord(ptrMapped, (size_t)fileStat.st_size, &offset)) != 0) {
+            if(records == 0) {
+                firstNs = ptrRecord->timestampNs;
+            }
+            if(wireSpeed && repeat == 0) {
+                sleepUntilNs(startNs + (ptrRecord->timestampNs - firstNs));
+            }
+            ptrBus = getReplayBus(ptrRecord->port, ptrRecord->direction);
+            if(ptrBus) {
+                feedReplayBus(ptrBus, (const unsigned char *)(ptrRecord + 1), ptrRecord->length, (double)(ptrRecord->timestampNs - firstNs) / 1e6);
+            }
+            records++;
+            bytes += ptrRecord->length;
+        }
+    }
+    elapsedNs = getNowNs() - startNs;
+#if BUS_FRAME_TRACE_ENABLED
+    if(ptrReplayTraceFile) {
+        fclose(ptrReplayTraceFile);
+    }
+#endif
+
+    for(index = 0; index < replayBusCount; index++) {
+        ptrBus = replayBuses[index];
+        fprintf(stderr, "port %u %s: %lu frames, %lu errors, %lu crc failures, %lu bytes discarded resyncing\n",
+                ptrBus->port, ptrBus->direction == BUS_CAPTURE_TX ? "tx" : "rx", ptrBus->frames, ptrBus->errors,
+                ptrBus->lastStats.crcFailures, ptrBus->lastStats.resyncBytesDiscarded);
+    }
+    fprintf(stderr, "%lu records, %llu bytes in %.3fs: %.1f MB/s, %.2f ns/byte\n", records, bytes, (double)elapsedNs / 1e9,
+            elapsedNs ? (double)bytes * 1e3 / (double)elapsedNs : 0.0, bytes ? (double)elapsedNs / (double)bytes : 0.0);
+    return 0;
+}
@@ -0,0 +1,361 @@
+/*
+ * File:   bus_trace.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 20:10
+ *
+ * Turns a dump of the bus trace ring (bus_frame_trace.h) back into per-frame
+ * timelines.
+ *
+ *   bus_trace [-v] [-s ns per tick] < dump
+ *
+ * The dump is text, one event per line as read out with readBusFrameTrace:
+ *
+ *   <timestamp> <bus> <component> <old state> <new state> <error>
+ *
+ * all decimal, so firmware can printf it down a debug UART. Lines starting
+ * with # are ignored except "# lost <n>", which abandons the frames in
+ * progress. bus_replay -t writes this format.
+ *
+ * Received frames run from SC1 arriving to the application releasing the
+ * listener (or the frame being queued), split at SC2, the last end code and
+ * the listener being raised. Sent frames run from the writer picking the
+ * frame up to the send buffer being drained, split at the listener being
+ * raised. Times are in clock ticks unless -s gives the tick length. -v
+ * also prints every event ahead of the frame it closes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bus_frame_details.h"
+#include "../bus_frame_handler_types.h"
+#include "../bus_frame_writer_types.h"
+#include "../bus_frame_trace_types.h"
+
+#define TRACE_MAX_BUSES     256
+#define TRACE_LINE_SIZE     256
+
+#define MARKERS_NONE        0
+#define MARKERS_IN_PRESTART 1
+#define MARKERS_STARTED     3
+#define MARKERS_FINISHED    15
+
+//Received frame milestones, in the order they happen
+typedef enum {
+    RX_SC1 = 0,
+    RX_SC2,
+    RX_EC2,
+    RX_DECODED,
+    RX_CONSUMED,
+    RX_MILESTONES
+} eRxMilestone;
+
+typedef enum {
+    TX_PICKED = 0,
+    TX_ENCODED,
+    TX_DRAINED,
+    TX_MILESTONES
+} eTxMilestone;
+
+typedef struct {
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long count;
+} tTraceSpan;
+
+typedef struct {
+    unsigned char rxOpen;
+    unsigned char txOpen;
+    unsigned long long rxAt[RX_MILESTONES];
+    unsigned char rxSeen[RX_MILESTONES];
+    unsigned long long txAt[TX_MILESTONES];
+    unsigned char txSeen[TX_MILESTONES];
+    unsigned long rxFrames;
+    unsigned long rxErrors;
+    unsigned long txFrames;
+    tTraceSpan rxSpans[RX_MILESTONES];
+    tTraceSpan txSpans[TX_MILESTONES];
+} tTraceBus;
+
+const char *handlerStateNames[] = {
+    [BUS_HANDLER_NONE] = "NONE",
+    [BUS_HANDLER_WAIT_FOR_BYTES] = "WAIT_FOR_BYTES",
+    [BUS_HANDLER_GET_BYTES] = "GET_BYTES",
+    [BUS_HANDLER_HANDLE_BLOCK] = "HANDLE_BLOCK",
+    [BUS_HANDLER_CHECK_FINAL] = "CHECK_FINAL",
+    [BUS_HANDLER_WAIT_PROCESSED] = "WAIT_PROCESSED",
+    [BUS_HANDLER_COMPLETE_RESET] = "COMPLETE_RESET",
+    [BUS_HANDLER_PROCESS_ERROR] = "PROCESS_ERROR",
+    [BUS_HANDLER_RESYNC] = "RESYNC",
+    [BUS_HANDLER_QUEUE_FRAME] = "QUEUE_FRAME",
+};
+
+const char *blockPhaseNames[] = {
+    [BLOCK_PHASE_NONE] = "NONE",
+    [BLOCK_BEGIN_BLOCK] = "BEGIN_BLOCK",
+    [BLOCK_CHECK_CRC] = "CHECK_CRC",
+    [BLOCK_DEMASK] = "DEMASK",
+    [BLOCK_WAIT_ACKNOWLEDGE] = "WAIT_ACKNOWLEDGE",
+    [BLOCK_FAIL_CRC_RESET] = "FAIL_CRC_RESET",
+    [BLOCK_DENSE_DATA] = "DENSE_DATA",
+    [BLOCK_FEEDBACK_DATA] = "FEEDBACK_DATA",
+};
+
+const char *writerStateNames[] = {
+    [BUS_FRAME_WRITER_NONE] = "NONE",
+    [BUS_FRAME_WRITER_WAIT_FOR_WRITE_TRIGGER] = "WAIT_FOR_WRITE_TRIGGER",
+    [BUS_FRAME_WRITER_CALCULATE_BLOCKS] = "CALCULATE_BLOCKS",
+    [BUS_FRAME_WRITER_WRITE_STARTCODE1] = "WRITE_STARTCODE1",
+    [BUS_FRAME_WRITER_WRITE_STARTCODE2] = "WRITE_STARTCODE2",
+    [BUS_FRAME_WRITER_WRITE_FORMAT_HEADER] = "WRITE_FORMAT_HEADER",
+    [BUS_FRAME_WRITER_INITIALISE_BLOCK] = "INITIALISE_BLOCK",
+    [BUS_FRAME_WRITER_BLOCK_FILL_GET_BYTE] = "BLOCK_FILL_GET_BYTE",
+    [BUS_FRAME_WRITER_DENSE_GROUP] = "DENSE_GROUP",
+    [BUS_FRAME_WRITER_WRITE_BYTE_TO_BUFFER] = "WRITE_BYTE_TO_BUFFER",
+    [BUS_FRAME_WRITER_WRITE_FRAME_CRC] = "WRITE_FRAME_CRC",
+    [BUS_FRAME_WRITER_WRITE_ENDCODE1] = "WRITE_ENDCODE1",
+    [BUS_FRAME_WRITER_WRITE_ENDCODE2] = "WRITE_ENDCODE2",
+    [BUS_FRAME_WRITER_TRIGGER_LISTENER] = "TRIGGER_LISTENER",
+    [BUS_FRAME_WRITER_COALESCE] = "COALESCE",
+    [BUS_FRAME_WRITER_WAIT_PROCESSED] = "WAIT_PROCESSED",
+    [BUS_FRAME_WRITER_COALESCE_DRAIN] = "COALESCE_DRAIN",
+    [BUS_FRAME_WRITER_COMPLETE_RESET] = "COMPLETE_RESET",
+    [BUS_FRAME_WRITER_PROCESS_ERROR] = "PROCESS_ERROR",
+    [BUS_FRAME_WRITER_WAIT_FEEDBACK] = "WAIT_FEEDBACK",
+    [BUS_FRAME_WRITER_WRITE_REPAIR] = "WRITE_REPAIR",
+};
+
+const char *rxMilestoneNames[RX_MILESTONES] = {"sc1", "sc2", "ec2", "decoded", "consumed"};
+const char *txMilestoneNames[TX_MILESTONES] = {"picked", "encoded", "drained"};
+
+tTraceBus traceBuses[TRACE_MAX_BUSES];
+unsigned char traceVerbose;
+double traceNsPerTick;
+
+const char *getStateName(unsigned int component, unsigned int state);
+double getTraceTime(unsigned long long ticks);
+void addTraceSpan(tTraceSpan *ptrSpan, unsigned long long ticks);
+void openRxFrame(tTraceBus *ptrBus, unsigned long long timestamp);
+void closeRxFrame(unsigned int bus, tTraceBus *ptrBus, int error);
+void closeTxFrame(unsigned int bus, tTraceBus *ptrBus);
+void handleTraceEvent(unsigned long long timestamp, unsigned int bus, unsigned int component, unsigned int oldState, unsigned int newState, unsigned int error);
+void printTraceSummary(void);
+
+const char *getStateName(unsigned int component, unsigned int state) {
+    const char *ptrName = 0;
+    switch(component) {
+        case BUS_TRACE_HANDLER_STATE:
+            ptrName = state < sizeof(handlerStateNames) / sizeof(handlerStateNames[0]) ? handlerStateNames[state] : 0;
+            break;
+        case BUS_TRACE_BLOCK_PHASE:
+            ptrName = state < sizeof(blockPhaseNames) / sizeof(blockPhaseNames[0]) ? blockPhaseNames[state] : 0;
+            break;
+        case BUS_TRACE_WRITER_STATE:
+            ptrName = state < sizeof(writerStateNames) / sizeof(writerStateNames[0]) ? writerStateNames[state] : 0;
+            break;
+    }
+    return ptrName ? ptrName : "?";
+}
+
+//Microseconds with -s, otherwise plain ticks
+double getTraceTime(unsigned long long ticks) {
+    return traceNsPerTick > 0.0 ? (double)ticks * traceNsPerTick / 1000.0 : (double)ticks;
+}
+
+void addTraceSpan(tTraceSpan *ptrSpan, unsigned long long ticks) {
+    ptrSpan->sum += ticks;
+    ptrSpan->count++;
+    if(ticks > ptrSpan->max) {
+        ptrSpan->max = ticks;
+    }
+}
+
+void openRxFrame(tTraceBus *ptrBus, unsigned long long timestamp) {
+    memset(ptrBus->rxSeen, 0, sizeof(ptrBus->rxSeen));
+    ptrBus->rxOpen = 1;
+    ptrBus->rxAt[RX_SC1] = timestamp;
+    ptrBus->rxSeen[RX_SC1] = 1;
+}
+
+//Each span runs from the previous milestone that was seen, a frame dropped on error is only counted
+void closeRxFrame(unsigned int bus, tTraceBus *ptrBus, int error) {
+    unsigned int milestone;
+    unsigned int previous = RX_SC1;
+
+    ptrBus->rxOpen = 0;
+    if(error >= 0) {
+        ptrBus->rxErrors++;
+        printf("bus %u rx @%.1f dropped, error %d\n", bus, getTraceTime(ptrBus->rxAt[RX_SC1]), error);
+        return;
+    }
+    ptrBus->rxFrames++;
+    printf("bus %u rx @%.1f", bus, getTraceTime(ptrBus->rxAt[RX_SC1]));
+    for(milestone = RX_SC2; milestone < RX_MILESTONES; milestone++) {
+        if(ptrBus->rxSeen[milestone]) {
+            addTraceSpan(&ptrBus->rxSpans[milestone], ptrBus->rxAt[milestone] - ptrBus->rxAt[previous]);
+            printf(" %s +%.1f", rxMilestoneNames[milestone], getTraceTime(ptrBus->rxAt[milestone] - ptrBus->rxAt[previous]));
+            previous = milestone;
+        }
+    }
+    addTraceSpan(&ptrBus->rxSpans[RX_SC1], ptrBus->rxAt[previous] - ptrBus->rxAt[RX_SC1]);
+    printf(" total %.1f\n", getTraceTime(ptrBus->rxAt[previous] - ptrBus->rxAt[RX_SC1]));
+}
+
+void closeTxFrame(unsigned int bus, tTraceBus *ptrBus) {
+    unsigned int milestone;
+    unsigned int previous = TX_PICKED;
+
+    ptrBus->txOpen = 0;
+    ptrBus->txFrames++;
+    printf("bus %u tx @%.1f", bus, getTraceTime(ptrBus->txAt[TX_PICKED]));
+    for(milestone = TX_ENCODED; milestone < TX_MILESTONES; milestone++) {
+        if(ptrBus->txSeen[milestone]) {
+            addTraceSpan(&ptrBus->txSpans[milestone], ptrBus->txAt[milestone] - ptrBus->txAt[previous]);
+            printf(" %s +%.1f", txMilestoneNames[milestone], getTraceTime(ptrBus->txAt[milestone] - ptrBus->txAt[previous]));
+            previous = milestone;
+        }
+    }
+    addTraceSpan(&ptrBus->txSpans[TX_PICKED], ptrBus->txAt[previous] - ptrBus->txAt[TX_PICKED]);
+    printf(" total %.1f\n", getTraceTime(ptrBus->txAt[previous] - ptrBus->txAt[TX_PICKED]));
+}
+
+void handleTraceEvent(unsigned long long timestamp, unsigned int bus, unsigned int component, unsigned int oldState, unsigned int newState, unsigned int error) {
+    tTraceBus *ptrBus = &traceBuses[bus];
+
+    if(traceVerbose) {
+        if(component == BUS_TRACE_MARKERS) {
+            printf("  %.1f bus %u markers %x -> %x\n", getTraceTime(timestamp), bus, oldState, newState);
+        } else {
+            printf("  %.1f bus %u %s %s -> %s", getTraceTime(timestamp), bus,
+                    component == BUS_TRACE_WRITER_STATE ? "writer" : component == BUS_TRACE_BLOCK_PHASE ? "block" : "handler",
+                    getStateName(component, oldState), getStateName(component, newState));
+            printf(error ? " error %u\n" : "\n", error);
+        }
+    }
+
+    switch(component) {
+        case BUS_TRACE_MARKERS:
+            if(oldState == MARKERS_NONE && newState == MARKERS_IN_PRESTART) {
+                openRxFrame(ptrBus, timestamp);
+            } else if(ptrBus->rxOpen && newState == MARKERS_STARTED && !ptrBus->rxSeen[RX_SC2]) {
+                ptrBus->rxAt[RX_SC2] = timestamp;
+                ptrBus->rxSeen[RX_SC2] = 1;
+            } else if(ptrBus->rxOpen && newState == MARKERS_FINISHED) {
+                ptrBus->rxAt[RX_EC2] = timestamp;
+                ptrBus->rxSeen[RX_EC2] = 1;
+            }
+            break;
+
+        case BUS_TRACE_HANDLER_STATE:
+            if(!ptrBus->rxOpen) {
+                break;
+            }
+            if(newState == BUS_HANDLER_PROCESS_ERROR) {
+                closeRxFrame(bus, ptrBus, (int)error);
+            } else if(newState == BUS_HANDLER_WAIT_PROCESSED || newState == BUS_HANDLER_QUEUE_FRAME) {
+                ptrBus->rxAt[RX_DECODED] = timestamp;
+                ptrBus->rxSeen[RX_DECODED] = 1;
+            } else if(newState == BUS_HANDLER_COMPLETE_RESET) {
+                ptrBus->rxAt[RX_CONSUMED] = timestamp;
+                ptrBus->rxSeen[RX_CONSUMED] = 1;
+                closeRxFrame(bus, ptrBus, -1);
+            }
+            break;
+
+        case BUS_TRACE_WRITER_STATE:
+            if(newState == BUS_FRAME_WRITER_CALCULATE_BLOCKS) {
+                //Coalescing goes straight from one frame to the next, the previous one is as done as it gets
+                if(ptrBus->txOpen) {
+                    closeTxFrame(bus, ptrBus);
+                }
+                memset(ptrBus->txSeen, 0, sizeof(ptrBus->txSeen));
+                ptrBus->txOpen = 1;
+                ptrBus->txAt[TX_PICKED] = timestamp;
+                ptrBus->txSeen[TX_PICKED] = 1;
+            } else if(ptrBus->txOpen && newState == BUS_FRAME_WRITER_TRIGGER_LISTENER) {
+                ptrBus->txAt[TX_ENCODED] = timestamp;
+                ptrBus->txSeen[TX_ENCODED] = 1;
+            } else if(ptrBus->txOpen && newState == BUS_FRAME_WRITER_COMPLETE_RESET) {
+                ptrBus->txAt[TX_DRAINED] = timestamp;
+                ptrBus->txSeen[TX_DRAINED] = 1;
+                closeTxFrame(bus, ptrBus);
+            }
+            break;
+    }
+}
+
+void printTraceSummary(void) {
+    tTraceBus *ptrBus;
+    tTraceSpan *ptrSpan;
+    unsigned int bus;
+    unsigned int milestone;
+
+    for(bus = 0; bus < TRACE_MAX_BUSES; bus++) {
+        ptrBus = &traceBuses[bus];
+        if(ptrBus->rxFrames || ptrBus->rxErrors) {
+            fprintf(stderr, "bus %u rx: %lu frames, %lu dropped\n", bus, ptrBus->rxFrames, ptrBus->rxErrors);
+            for(milestone = 0; milestone < RX_MILESTONES; milestone++) {
+                ptrSpan = &ptrBus->rxSpans[milestone];
+                if(ptrSpan->count) {
+                    fprintf(stderr, "  %-10s avg %10.1f max %10.1f\n", milestone == RX_SC1 ? "total" : rxMilestoneNames[milestone],
+                            getTraceTime(ptrSpan->sum) / ptrSpan->count, getTraceTime(ptrSpan->max));
+                }
+            }
+        }
+        if(ptrBus->txFrames) {
+            fprintf(stderr, "bus %u tx: %lu frames\n", bus, ptrBus->txFrames);
+            for(milestone = 0; milestone < TX_MILESTONES; milestone++) {
+                ptrSpan = &ptrBus->txSpans[milestone];
+                if(ptrSpan->count) {
+                    fprintf(stderr, "  %-10s avg %10.1f max %10.1f\n", milestone == TX_PICKED ? "total" : txMilestoneNames[milestone],
+                            getTraceTime(ptrSpan->sum) / ptrSpan->count, getTraceTime(ptrSpan->max));
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    char line[TRACE_LINE_SIZE];
+    unsigned long long timestamp;
+    unsigned int bus;
+    unsigned int component;
+    unsigned int oldState;
+    unsigned int newState;
+    unsigned int error;
+    unsigned long lost;
+    int argument;
+
+    for(argument = 1; argument < argc; argument++) {
+        if(strcmp(argv[argument], "-v") == 0) {
+            traceVerbose = 1;
+        } else if(strcmp(argv[argument], "-s") == 0 && argument + 1 < argc) {
+            traceNsPerTick = atof(argv[++argument]);
+        } else {
+            fprintf(stderr, "usage: %s [-v] [-s ns per tick] < dump\n", argv[0]);
+            return 2;
+        }
+    }
+
+    while(fgets(line, sizeof(line), stdin)) {
+        if(sscanf(line, "# lost %lu", &lost) == 1) {
+            //The ring wrapped before it was read, nothing in progress can be trusted
+            for(bus = 0; bus < TRACE_MAX_BUSES; bus++) {
+                traceBuses[bus].rxOpen = 0;
+                traceBuses[bus].txOpen = 0;
+            }
+            printf("# lost %lu events\n", lost);
+            continue;
+        }
+        if(line[0] == '#' || sscanf(line, "%llu %u %u %u %u %u", &timestamp, &bus, &component, &oldState, &newState, &error) != 6) {
+            continue;
+        }
+        if(bus < TRACE_MAX_BUSES) {
+            handleTraceEvent(timestamp, bus, component, oldState, newState, error);
+        }
+    }
+    printTraceSummary();
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * File:   crc.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 23:30
+ *
+ * Host stand-in for the project's ../crc.c: CRC-7 (poly 0x09, as SD cards
+ * use). The block CRC goes on the wire as is, so it has to stay below 0x80
+ * or it would read as a mask byte or a 0xC0-0xFF marker.
+ */
+
+#include "crc.h"
+
+#define CRC7_POLY_SHIFTED   0x12    //0x09 lined up with bit 7, the CRC sits in the top 7 bits while it runs
+
+unsigned char calculateCrc(unsigned char *ptrData, unsigned char length);
+
+unsigned char calculateCrc(unsigned char *ptrData, unsigned char length) {
+    unsigned char crc = 0;
+    unsigned char bit;
+    while(length > 0) {
+        crc ^= *ptrData;
+        for(bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ CRC7_POLY_SHIFTED : crc << 1;
+        }
+        ptrData++;
+        length--;
+    }
+    return crc >> 1;
+}
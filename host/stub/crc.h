@@ -0,0 +1,6 @@
+#ifndef CRC_H
+#define	CRC_H
+
+extern unsigned char calculateCrc(unsigned char *ptrData, unsigned char length);
+
+#endif	/* CRC_H */
@@ -0,0 +1,9 @@
+#ifndef GLOBAL_H
+#define	GLOBAL_H
+
+/*
+ * Host stand-in for the project's ../global.h, nothing in the bus sources
+ * needs more than the guard.
+ */
+
+#endif	/* GLOBAL_H */
@@ -0,0 +1,93 @@
+/*
+ * File:   ring_buffer.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 23:30
+ *
+ * Host stand-in for the project's ../ring-buffer, the same interface over a
+ * plain byte ring. Not interrupt safe, the host builds don't need it to be.
+ */
+
+#include "ring_buffer.h"
+
+void initialiseBuffer(tBuffer *ptrBuffer, unsigned char *ptrArray, unsigned int size);
+void putByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char byte);
+void getByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char *ptrByte);
+unsigned char isEmpty(tBuffer *ptrBuffer);
+unsigned int getFillLevel(tBuffer *ptrBuffer);
+void writeLockMainBuffer(tBuffer *ptrBuffer);
+void unlockWriteMainBuffer(tBuffer *ptrBuffer);
+void startReversibleWrite(tBuffer *ptrBuffer);
+void completeReversibleWrite(tBuffer *ptrBuffer);
+void reverseWrite(tBuffer *ptrBuffer);
+
+void initialiseBuffer(tBuffer *ptrBuffer, unsigned char *ptrArray, unsigned int size) {
+    ptrBuffer->array = ptrArray;
+    ptrBuffer->size = size;
+    ptrBuffer->head = 0;
+    ptrBuffer->tail = 0;
+    ptrBuffer->count = 0;
+    ptrBuffer->mark = 0;
+    ptrBuffer->markWritten = 0;
+    ptrBuffer->writeLocked = 0;
+}
+
+void putByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char byte) {
+    if(ptrBuffer->writeLocked) {
+        *ptrStatus = BUFFER_OPERATION_LOCKED;
+        return;
+    }
+    if(ptrBuffer->count >= ptrBuffer->size) {
+        *ptrStatus = BUFFER_OPERATION_FULL;
+        return;
+    }
+    ptrBuffer->array[ptrBuffer->head] = byte;
+    ptrBuffer->head = (ptrBuffer->head + 1) % ptrBuffer->size;
+    ptrBuffer->count++;
+    ptrBuffer->markWritten++;
+    *ptrStatus = BUFFER_OPERATION_OK;
+}
+
+void getByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char *ptrByte) {
+    if(ptrBuffer->count == 0) {
+        *ptrStatus = BUFFER_OPERATION_EMPTY;
+        return;
+    }
+    *ptrByte = ptrBuffer->array[ptrBuffer->tail];
+    ptrBuffer->tail = (ptrBuffer->tail + 1) % ptrBuffer->size;
+    ptrBuffer->count--;
+    *ptrStatus = BUFFER_OPERATION_OK;
+}
+
+unsigned char isEmpty(tBuffer *ptrBuffer) {
+    return ptrBuffer->count == 0;
+}
+
+unsigned int getFillLevel(tBuffer *ptrBuffer) {
+    return ptrBuffer->count;
+}
+
+void writeLockMainBuffer(tBuffer *ptrBuffer) {
+    ptrBuffer->writeLocked = 1;
+}
+
+void unlockWriteMainBuffer(tBuffer *ptrBuffer) {
+    ptrBuffer->writeLocked = 0;
+}
+
+void startReversibleWrite(tBuffer *ptrBuffer) {
+    ptrBuffer->mark = ptrBuffer->head;
+    ptrBuffer->markWritten = 0;
+}
+
+void completeReversibleWrite(tBuffer *ptrBuffer) {
+    ptrBuffer->mark = ptrBuffer->head;
+    ptrBuffer->markWritten = 0;
+}
+
+//Drops everything put since startReversibleWrite
+void reverseWrite(tBuffer *ptrBuffer) {
+    ptrBuffer->head = ptrBuffer->mark;
+    ptrBuffer->count -= ptrBuffer->markWritten;
+    ptrBuffer->markWritten = 0;
+}
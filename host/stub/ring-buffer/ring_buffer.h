@@ -0,0 +1,17 @@
+#ifndef RING_BUFFER_H
+#define	RING_BUFFER_H
+
+#include "ring_buffer_types.h"
+
+extern void initialiseBuffer(tBuffer *ptrBuffer, unsigned char *ptrArray, unsigned int size);
+extern void putByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char byte);
+extern void getByte(tBuffer *ptrBuffer, eBufferOperationStatus *ptrStatus, unsigned char *ptrByte);
+extern unsigned char isEmpty(tBuffer *ptrBuffer);
+extern unsigned int getFillLevel(tBuffer *ptrBuffer);
+extern void writeLockMainBuffer(tBuffer *ptrBuffer);
+extern void unlockWriteMainBuffer(tBuffer *ptrBuffer);
+extern void startReversibleWrite(tBuffer *ptrBuffer);
+extern void completeReversibleWrite(tBuffer *ptrBuffer);
+extern void reverseWrite(tBuffer *ptrBuffer);
+
+#endif	/* RING_BUFFER_H */
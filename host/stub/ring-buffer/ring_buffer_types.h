@@ -0,0 +1,23 @@
+#ifndef RING_BUFFER_TYPES_H
+#define	RING_BUFFER_TYPES_H
+
+typedef enum {
+    BUFFER_OPERATION_NONE = 0,
+    BUFFER_OPERATION_OK,
+    BUFFER_OPERATION_FULL,
+    BUFFER_OPERATION_EMPTY,
+    BUFFER_OPERATION_LOCKED
+} eBufferOperationStatus;
+
+typedef struct {
+    unsigned char *array;
+    unsigned int size;
+    unsigned int head;          //Next byte in
+    unsigned int tail;          //Next byte out
+    unsigned int count;
+    unsigned int mark;          //head when the reversible write started
+    unsigned int markWritten;   //Bytes put since then
+    unsigned char writeLocked;
+} tBuffer;
+
+#endif	/* RING_BUFFER_TYPES_H */
@@ -0,0 +1,279 @@
+/*
+ * File:   bus_test.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 23:40
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+unsigned int busTestFailures = 0;
+
+void initialiseBusTestLink(tBusTestLink *ptrLink);
+unsigned int writeBusTestFrame(tBusTestLink *ptrLink, const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize);
+unsigned int collectBusTestWire(tBusTestLink *ptrLink, unsigned char *ptrWire, unsigned int wireSize);
+unsigned int readBusTestFrames(tBusTestLink *ptrLink, const unsigned char *ptrWire, unsigned int length, unsigned char *ptrPayload, unsigned int payloadSize, unsigned int *ptrFrameLengths, unsigned int maxFrames);
+unsigned int drainBusTestApplication(tBusTestLink *ptrLink, unsigned char *ptrPayload, unsigned int payloadSize);
+unsigned int getBusTestPaddedLength(unsigned int length, unsigned char format);
+double getBusTestSeconds(void);
+unsigned long getBusTestMicroseconds(void);
+unsigned int getBusTestRandom(unsigned int *ptrSeed);
+void fillBusTestPayload(unsigned char *ptrPayload, unsigned int length, unsigned int *ptrSeed);
+unsigned int makeBusTestTelemetry(unsigned int frame, unsigned char *ptrPayload, unsigned int *ptrSeed);
+void checkBusTest(int passed, const char *ptrFormat, ...);
+int finishBusTest(const char *ptrName);
+
+void initialiseBusTestLink(tBusTestLink *ptrLink) {
+    initialiseBusFrameWriterCtx(&ptrLink->writer);
+    initialiseBusFrameHandlerCtx(&ptrLink->handler);
+    initialiseBuffer(&ptrLink->sendBuffer, &ptrLink->sendArray[0], BUS_TEST_SEND_BUFFER_SIZE);
+    initialiseBuffer(&ptrLink->applicationBuffer, &ptrLink->applicationArray[0], BUS_TEST_APPLICATION_BUFFER_SIZE);
+    ptrLink->sendListener = 0;
+    ptrLink->applicationListener = 0;
+    registerSendFrameBufferCtx(&ptrLink->writer, &ptrLink->sendBuffer);
+    registerSendFrameListenerCtx(&ptrLink->writer, &ptrLink->sendListener);
+    registerApplicationBufferCtx(&ptrLink->handler, &ptrLink->applicationBuffer);
+    registerApplicationListenerCtx(&ptrLink->handler, &ptrLink->applicationListener);
+}
+
+//Queues one frame through open/write/close and runs the writer until it's on the wire. Returns the wire bytes, 0 if the writer refused it
+unsigned int writeBusTestFrame(tBusTestLink *ptrLink, const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    unsigned int i;
+
+    openBusFrameWithFormatCtx(&ptrLink->writer, &status, format);
+    for(i = 0; i < length && status == BUS_FRAME_WRITER_OPERATION_OK; i++) {
+        writeToBusFrameCtx(&ptrLink->writer, &status, ptrPayload[i]);
+    }
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    closeBusFrameCtx(&ptrLink->writer, &status);
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    sendFramesInBufferCtx(&ptrLink->writer, &status);
+    return collectBusTestWire(ptrLink, ptrWire, wireSize);
+}
+
+//Runs the writer until it's idle, taking whatever it sends. Bytes past wireSize are counted but dropped
+unsigned int collectBusTestWire(tBusTestLink *ptrLink, unsigned char *ptrWire, unsigned int wireSize) {
+    eBusFrameWriterRunStatus runStatus;
+    eBufferOperationStatus bufferStatus;
+    unsigned int collected = 0;
+    unsigned int steps = 0;
+    unsigned char byte;
+
+    while(steps < BUS_TEST_WRITER_STEPS) {
+        //The writer spins on a full send buffer, waiting for a UART that isn't here. A step puts at most a block or a dense group, so 16 can't fill it
+        steps += runBusFrameWriterBudgetCtx(&ptrLink->writer, &runStatus, 16);
+        while(1) {
+            bufferStatus = BUFFER_OPERATION_NONE;
+            getByte(&ptrLink->sendBuffer, &bufferStatus, &byte);
+            if(bufferStatus != BUFFER_OPERATION_OK) {
+                break;
+            }
+            if(collected < wireSize) {
+                ptrWire[collected] = byte;
+            }
+            collected++;
+        }
+        if(ptrLink->sendListener) {
+            ptrLink->sendListener = 0;
+            continue;
+        }
+        if(runStatus == BUS_FRAME_WRITER_RUN_IDLE) {
+            break;
+        }
+    }
+    return collected;
+}
+
+unsigned int drainBusTestApplication(tBusTestLink *ptrLink, unsigned char *ptrPayload, unsigned int payloadSize) {
+    eBufferOperationStatus bufferStatus;
+    unsigned int drained = 0;
+    unsigned char byte;
+    while(1) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&ptrLink->applicationBuffer, &bufferStatus, &byte);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        if(drained < payloadSize) {
+            ptrPayload[drained] = byte;
+        }
+        drained++;
+    }
+    return drained;
+}
+
+/*
+ * Feeds wire bytes to the handler as fast as its inbound ring takes them and
+ * collects every frame raised on the application listener, payloads back to
+ * back in ptrPayload. Returns the frame count, which can be more than
+ * maxFrames (the extra lengths aren't stored).
+ */
+unsigned int readBusTestFrames(tBusTestLink *ptrLink, const unsigned char *ptrWire, unsigned int length, unsigned char *ptrPayload, unsigned int payloadSize, unsigned int *ptrFrameLengths, unsigned int maxFrames) {
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus = BUS_HANDLER_RUN_NONE;
+    unsigned int position = 0;
+    unsigned int accepted;
+    unsigned int frames = 0;
+    unsigned int payloadLength = 0;
+    unsigned int frameLength;
+
+    while(1) {
+        if(position < length) {
+            accepted = 0;
+            putBytesForHandlingCtx(&ptrLink->handler, &putStatus, ptrWire + position, length - position, &accepted);
+            position += accepted;
+        }
+        runBusFrameHandlerBudgetCtx(&ptrLink->handler, &runStatus, 256);
+        if(ptrLink->applicationListener) {
+            frameLength = drainBusTestApplication(ptrLink, ptrPayload + payloadLength, payloadLength < payloadSize ? payloadSize - payloadLength : 0);
+            if(frames < maxFrames) {
+                ptrFrameLengths[frames] = frameLength;
+            }
+            payloadLength += frameLength;
+            frames++;
+            ptrLink->applicationListener = 0;
+            continue;
+        }
+        if(position >= length && runStatus == BUS_HANDLER_RUN_STARVED) {
+            break;
+        }
+    }
+    return frames;
+}
+
+//What the handler hands over for a frame of length bytes: block frames come out padded to whole blocks
+unsigned int getBusTestPaddedLength(unsigned int length, unsigned char format) {
+    if(format & BUS_FRAME_FORMAT_DENSE) {
+        return length;
+    }
+    return ((length + 5) / 6) * 6;
+}
+
+double getBusTestSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+unsigned long getBusTestMicroseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)now.tv_sec * 1000000UL + (unsigned long)now.tv_nsec / 1000UL;
+}
+
+//xorshift32, so runs are repeatable whatever the C library's rand()
+unsigned int getBusTestRandom(unsigned int *ptrSeed) {
+    unsigned int x = *ptrSeed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *ptrSeed = x;
+    return x;
+}
+
+void fillBusTestPayload(unsigned char *ptrPayload, unsigned int length, unsigned int *ptrSeed) {
+    unsigned int i;
+    for(i = 0; i < length; i++) {
+        ptrPayload[i] = (unsigned char)getBusTestRandom(ptrSeed);
+    }
+}
+
+/*
+ * Frame number frame of a sensor node's traffic, at most 30 bytes: in turn
+ * temperatures with their setpoints and an uptime, a gravity reading, valve
+ * states with a sequence number, and a line of log text. Readings drift
+ * slowly with frame, the text is random, so like the real thing most frames
+ * repeat most of the last one of their type. Returns the length.
+ */
+unsigned int makeBusTestTelemetry(unsigned int frame, unsigned char *ptrPayload, unsigned int *ptrSeed) {
+    unsigned int tick = frame / 4;
+    unsigned int value;
+    unsigned int i;
+
+    switch(frame % 4) {
+        case 0:
+            ptrPayload[0] = 0x11;
+            ptrPayload[1] = 4;
+            for(i = 0; i < 4; i++) {
+                value = 2031 + (i * 13) + ((tick + i) / 40) % 3;
+                ptrPayload[2 + (i * 2)] = value >> 8;
+                ptrPayload[3 + (i * 2)] = value & 0xFF;
+                ptrPayload[10 + (i * 2)] = 2000 >> 8;
+                ptrPayload[11 + (i * 2)] = 2000 & 0xFF;
+            }
+            ptrPayload[18] = 0;
+            ptrPayload[19] = tick >> 24;
+            ptrPayload[20] = (tick >> 16) & 0xFF;
+            ptrPayload[21] = (tick >> 8) & 0xFF;
+            ptrPayload[22] = tick & 0xFF;
+            return 23;
+
+        case 1:
+            value = 1050 - (tick / 100) % 50;
+            ptrPayload[0] = 0x22;
+            ptrPayload[1] = value >> 8;
+            ptrPayload[2] = value & 0xFF;
+            ptrPayload[3] = 2031 >> 8;
+            ptrPayload[4] = 2031 & 0xFF;
+            ptrPayload[5] = 87;
+            ptrPayload[6] = (unsigned char)(196 - getBusTestRandom(ptrSeed) % 3);
+            for(i = 7; i < 13; i++) {
+                ptrPayload[i] = 0;
+            }
+            return 13;
+
+        case 2:
+            ptrPayload[0] = 0x33;
+            ptrPayload[1] = 0x15 ^ ((tick / 50) & 0x03);
+            ptrPayload[2] = 100;
+            ptrPayload[3] = 100;
+            ptrPayload[4] = 0;
+            ptrPayload[5] = 0;
+            ptrPayload[6] = (tick >> 8) & 0xFF;
+            ptrPayload[7] = tick & 0xFF;
+            return 8;
+
+        default:
+            ptrPayload[0] = 0x44;
+            for(i = 1; i < 30; i++) {
+                ptrPayload[i] = (unsigned char)(' ' + getBusTestRandom(ptrSeed) % 90);
+            }
+            return 30;
+    }
+}
+
+void checkBusTest(int passed, const char *ptrFormat, ...) {
+    va_list arguments;
+    if(passed) {
+        return;
+    }
+    busTestFailures++;
+    if(busTestFailures > 20) {
+        return; //Enough to go on
+    }
+    va_start(arguments, ptrFormat);
+    printf("FAIL: ");
+    vprintf(ptrFormat, arguments);
+    printf("\n");
+    va_end(arguments);
+}
+
+int finishBusTest(const char *ptrName) {
+    if(busTestFailures) {
+        printf("%s: %u failures\n", ptrName, busTestFailures);
+        return 1;
+    }
+    printf("%s: passed\n", ptrName);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef BUS_TEST_H
+#define	BUS_TEST_H
+
+#include "../../ring-buffer/ring_buffer_types.h"
+#include "../bus_frame_details.h"
+#include "../bus_frame_handler.h"
+#include "../bus_frame_writer.h"
+
+/*
+ * Shared by the tests and benchmarks: a writer and a handler context with
+ * their buffers, wired back to back through a caller's wire buffer, plus
+ * timing, a repeatable random source and failure counting.
+ */
+
+#define BUS_TEST_SEND_BUFFER_SIZE           256
+#define BUS_TEST_APPLICATION_BUFFER_SIZE    (MAX_JUMBO_UNPACKED_PAYLOAD + 6)
+#define BUS_TEST_WRITER_STEPS               1000000 //Per frame before the writer counts as stuck
+
+typedef struct {
+    tBusFrameWriterCtx writer;
+    tBusFrameHandlerCtx handler;
+    tBuffer sendBuffer;
+    tBuffer applicationBuffer;
+    unsigned char sendListener;
+    unsigned char applicationListener;
+    unsigned char sendArray[BUS_TEST_SEND_BUFFER_SIZE];
+    unsigned char applicationArray[BUS_TEST_APPLICATION_BUFFER_SIZE];
+} tBusTestLink;
+
+extern unsigned int busTestFailures;
+
+extern void initialiseBusTestLink(tBusTestLink *ptrLink);
+extern unsigned int writeBusTestFrame(tBusTestLink *ptrLink, const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize);
+extern unsigned int collectBusTestWire(tBusTestLink *ptrLink, unsigned char *ptrWire, unsigned int wireSize);
+extern unsigned int readBusTestFrames(tBusTestLink *ptrLink, const unsigned char *ptrWire, unsigned int length, unsigned char *ptrPayload, unsigned int payloadSize, unsigned int *ptrFrameLengths, unsigned int maxFrames);
+extern unsigned int drainBusTestApplication(tBusTestLink *ptrLink, unsigned char *ptrPayload, unsigned int payloadSize);
+extern unsigned int getBusTestPaddedLength(unsigned int length, unsigned char format);
+extern double getBusTestSeconds(void);
+extern unsigned long getBusTestMicroseconds(void);
+extern unsigned int getBusTestRandom(unsigned int *ptrSeed);
+extern void fillBusTestPayload(unsigned char *ptrPayload, unsigned int length, unsigned int *ptrSeed);
+extern unsigned int makeBusTestTelemetry(unsigned int frame, unsigned char *ptrPayload, unsigned int *ptrSeed);
+extern void checkBusTest(int passed, const char *ptrFormat, ...);
+extern int finishBusTest(const char *ptrName);
+
+#endif	/* BUS_TEST_H */
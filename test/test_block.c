@@ -0,0 +1,112 @@
+/*
+ * File:   test_block.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 00:50
+ *
+ * Block kernels against a plain byte-at-a-time model of the 7 bit block
+ * encoding. Built once per BUS_FRAME_BLOCK_SWAR setting (test_block and
+ * test_block_fast), so the SWAR kernels are held to the scalar behaviour.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bus_test.h"
+#include "../bus_frame_block.h"
+#include "../bus_frame_crc.h"
+
+#define BLOCK_RANDOM_BLOCKS     200000
+#define BLOCK_MAX_LENGTH        1200
+#define BLOCK_MAX_BLOCKS        ((BLOCK_MAX_LENGTH + 5) / 6)
+
+void testMaskKernels(void);
+void testBlockRoundTrip(void);
+unsigned char maskModel(unsigned char *ptrData);
+
+unsigned char source[BLOCK_MAX_LENGTH];
+unsigned char blocks[BLOCK_MAX_BLOCKS * 8];
+unsigned char decoded[BLOCK_MAX_BLOCKS * 6];
+
+unsigned char maskModel(unsigned char *ptrData) {
+    unsigned char mask = 0;
+    unsigned char i;
+    for(i = 0; i < 6; i++) {
+        if(ptrData[i] >= 0x80) {
+            mask |= 1 << i;
+            ptrData[i] -= 0x80;
+        }
+    }
+    return mask;
+}
+
+void testMaskKernels(void) {
+    unsigned char data[6];
+    unsigned char model[6];
+    unsigned char original[6];
+    unsigned char mask;
+    unsigned int seed = 7;
+    unsigned int block;
+    unsigned int value;
+    unsigned char position;
+
+    for(block = 0; block < BLOCK_RANDOM_BLOCKS + 6 * 256; block++) {
+        if(block < 6 * 256) {
+            //Every value in every position, the rest zero
+            memset(&data[0], 0, sizeof(data));
+            position = block / 256;
+            value = block % 256;
+            data[position] = (unsigned char)value;
+        } else {
+            fillBusTestPayload(&data[0], sizeof(data), &seed);
+        }
+        memcpy(&original[0], &data[0], sizeof(data));
+        memcpy(&model[0], &data[0], sizeof(data));
+        mask = maskBlockBytes(&data[0]);
+        checkBusTest(mask == maskModel(&model[0]), "block %u: mask %02X", block, mask);
+        checkBusTest(memcmp(&data[0], &model[0], sizeof(data)) == 0, "block %u: masked bytes differ", block);
+        //The mask byte goes out with the marker bit set, demask has to ignore it
+        demaskBlockBytes(&data[0], 0x80 | mask);
+        checkBusTest(memcmp(&data[0], &original[0], sizeof(data)) == 0, "block %u: demask doesn't restore it", block);
+    }
+}
+
+void testBlockRoundTrip(void) {
+    unsigned int seed = 9;
+    unsigned int length;
+    unsigned int blockCount;
+    unsigned int decodedCount;
+    unsigned int bad;
+    unsigned int i;
+
+    initialiseBusFrameCrc();
+    fillBusTestPayload(&source[0], BLOCK_MAX_LENGTH, &seed);
+    for(length = 1; length <= BLOCK_MAX_LENGTH; length++) {
+        blockCount = encodeBusFrameBlocks(&source[0], length, &blocks[0]);
+        checkBusTest(blockCount == (length + 5) / 6, "length %u: %u blocks", length, blockCount);
+        for(i = 0; i < blockCount * 8; i++) {
+            if(i % 8 == 0) {
+                checkBusTest((blocks[i] & 0b11000000) == 0b10000000, "length %u: mask byte %02X", length, blocks[i]);
+            } else {
+                checkBusTest(blocks[i] < 0x80, "length %u: wire byte %u is %02X", length, i, blocks[i]);
+            }
+        }
+        decodedCount = decodeBusFrameBlocks(&blocks[0], blockCount, &decoded[0]);
+        checkBusTest(decodedCount == blockCount, "length %u: %u of %u blocks decoded", length, decodedCount, blockCount);
+        checkBusTest(memcmp(&decoded[0], &source[0], length) == 0, "length %u: payload differs", length);
+        for(i = length; i < blockCount * 6; i++) {
+            checkBusTest(decoded[i] == 0xFF, "length %u: padding byte %u is %02X", length, i, decoded[i]);
+        }
+
+        //A flipped data bit has to stop the decode at that block
+        bad = getBusTestRandom(&seed) % blockCount;
+        blocks[bad * 8 + 2 + getBusTestRandom(&seed) % 6] ^= 1 << (getBusTestRandom(&seed) % 7);
+        decodedCount = decodeBusFrameBlocks(&blocks[0], blockCount, &decoded[0]);
+        checkBusTest(decodedCount == bad, "length %u: corrupt block %u, decode stopped at %u", length, bad, decodedCount);
+    }
+}
+
+int main(void) {
+    testMaskKernels();
+    testBlockRoundTrip();
+    return finishBusTest(BUS_FRAME_BLOCK_SWAR ? "test_block (SWAR)" : "test_block");
+}
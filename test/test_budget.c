@@ -0,0 +1,204 @@
+/*
+ * File:   test_budget.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:25
+ *
+ * runBusFrameWriterBudget and runBusFrameHandlerBudget at the edges: a
+ * budget of 0 takes no step and reports BUDGET_SPENT with nothing touched,
+ * and a budget of 1 reports BUDGET_SPENT while a step makes progress and
+ * the right wait once one doesn't (application listener, a send buffer
+ * too full for the next marker, no input, nothing to send). A frame stepped
+ * through one step at a time, with budget 0 calls thrown in, has to come
+ * out byte for byte as encodeBusFrame has it and decode intact. Blocks are
+ * put whole within a step, so the small send buffer holds the start codes
+ * and one block and the writer waits on output at the end codes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#define BUDGET_LENGTH       40
+#define BUDGET_SMALL_LENGTH 6
+#define BUDGET_SMALL_SEND   (2 + 8) //SC1, SC2 and the one block, nothing left for EC1
+#define BUDGET_MAX_STEPS    100000
+
+unsigned int takeSentBytes(tBuffer *ptrBuffer, unsigned char *ptrWire, unsigned int wireLength, unsigned int maxBytes);
+void testWriterBudget(unsigned char smallSend);
+void testHandlerBudget(void);
+
+tBusTestLink link;
+tBuffer smallSendBuffer;
+unsigned char smallSendArray[BUDGET_SMALL_SEND];
+unsigned char payload[BUDGET_LENGTH];
+
+//Moves up to maxBytes out of the send buffer onto the end of the wire, returns the new wire length
+unsigned int takeSentBytes(tBuffer *ptrBuffer, unsigned char *ptrWire, unsigned int wireLength, unsigned int maxBytes) {
+    eBufferOperationStatus bufferStatus;
+    unsigned char byte;
+    while(maxBytes > 0) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(ptrBuffer, &bufferStatus, &byte);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        if(wireLength < MAX_FRAME_SIZE) {
+            ptrWire[wireLength] = byte;
+        }
+        wireLength++;
+        maxBytes--;
+    }
+    return wireLength;
+}
+
+void testWriterBudget(unsigned char smallSend) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    eBusFrameWriterRunStatus runStatus;
+    tBuffer *ptrSendBuffer = smallSend ? &smallSendBuffer : &link.sendBuffer;
+    unsigned char wire[MAX_FRAME_SIZE];
+    unsigned int wireLength = 0;
+    unsigned int steps;
+    unsigned int taken;
+    unsigned int i;
+    unsigned char sawOutputWait = 0;
+    unsigned char sawApplicationWait = 0;
+    const char *ptrName = smallSend ? "small send buffer" : "writer";
+    unsigned int length = smallSend ? BUDGET_SMALL_LENGTH : BUDGET_LENGTH;
+    unsigned char reference[MAX_FRAME_SIZE];
+    unsigned int referenceLength = encodeBusFrame(&payload[0], length, 0, &reference[0], sizeof(reference));
+
+    initialiseBusTestLink(&link);
+    if(smallSend) {
+        initialiseBuffer(&smallSendBuffer, &smallSendArray[0], BUDGET_SMALL_SEND);
+        registerSendFrameBufferCtx(&link.writer, &smallSendBuffer);
+    }
+
+    //The first step only leaves the reset state, the one after finds nothing to do
+    runStatus = BUS_FRAME_WRITER_RUN_NONE;
+    steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+    checkBusTest(steps == 1 && runStatus == BUS_FRAME_WRITER_RUN_BUDGET_SPENT, "%s: first step, %u steps, status %u", ptrName, steps, runStatus);
+    runStatus = BUS_FRAME_WRITER_RUN_NONE;
+    steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+    checkBusTest(steps == 1 && runStatus == BUS_FRAME_WRITER_RUN_IDLE, "%s: nothing queued, %u steps, status %u", ptrName, steps, runStatus);
+
+    openBusFrameCtx(&link.writer, &status);
+    for(i = 0; i < length; i++) {
+        writeToBusFrameCtx(&link.writer, &status, payload[i]);
+    }
+    closeBusFrameCtx(&link.writer, &status);
+    sendFramesInBufferCtx(&link.writer, &status);
+
+    runStatus = BUS_FRAME_WRITER_RUN_NONE;
+    steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 0);
+    checkBusTest(steps == 0 && runStatus == BUS_FRAME_WRITER_RUN_BUDGET_SPENT, "%s: budget 0 took %u steps, status %u", ptrName, steps, runStatus);
+    checkBusTest(getQueuedFrameCountCtx(&link.writer) == 1 && takeSentBytes(ptrSendBuffer, &wire[0], 0, 1) == 0,
+            "%s: budget 0 moved the frame on", ptrName);
+
+    for(i = 0; i < BUDGET_MAX_STEPS; i++) {
+        runStatus = BUS_FRAME_WRITER_RUN_NONE;
+        steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+        if(steps != 1) {
+            checkBusTest(0, "%s: budget 1 took %u steps", ptrName, steps);
+            break;
+        }
+        if(runStatus == BUS_FRAME_WRITER_RUN_IDLE) {
+            break;
+        }
+        if(runStatus == BUS_FRAME_WRITER_RUN_WAITING_OUTPUT) {
+            //Full, a byte at a time like a UART, and a budget 0 call mustn't lose the byte that's waiting
+            sawOutputWait = 1;
+            checkBusTest(smallSend, "%s: waiting on output with %u bytes sent", ptrName, wireLength);
+            steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 0);
+            checkBusTest(steps == 0 && runStatus == BUS_FRAME_WRITER_RUN_BUDGET_SPENT, "%s: budget 0 while waiting on output took %u steps, status %u",
+                    ptrName, steps, runStatus);
+            wireLength = takeSentBytes(ptrSendBuffer, &wire[0], wireLength, 1);
+        } else if(runStatus == BUS_FRAME_WRITER_RUN_WAITING_APPLICATION) {
+            sawApplicationWait = 1;
+            checkBusTest(link.sendListener, "%s: waiting on the application with the listener clear", ptrName);
+            //Held for the listener however many more times it's stepped, then let go
+            steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+            checkBusTest(steps == 1 && runStatus == BUS_FRAME_WRITER_RUN_WAITING_APPLICATION && getQueuedFrameCountCtx(&link.writer) == 1,
+                    "%s: stepped past the listener, status %u, %u frames queued", ptrName, runStatus, getQueuedFrameCountCtx(&link.writer));
+            wireLength = takeSentBytes(ptrSendBuffer, &wire[0], wireLength, MAX_FRAME_SIZE);
+            link.sendListener = 0;
+        } else {
+            checkBusTest(runStatus == BUS_FRAME_WRITER_RUN_BUDGET_SPENT, "%s: budget 1 status %u", ptrName, runStatus);
+        }
+        if(!smallSend) {
+            wireLength = takeSentBytes(ptrSendBuffer, &wire[0], wireLength, MAX_FRAME_SIZE);
+        }
+    }
+    taken = takeSentBytes(ptrSendBuffer, &wire[0], wireLength, MAX_FRAME_SIZE);
+    checkBusTest(taken == wireLength, "%s: %u bytes left in the send buffer when idle", ptrName, taken - wireLength);
+    checkBusTest(runStatus == BUS_FRAME_WRITER_RUN_IDLE && getQueuedFrameCountCtx(&link.writer) == 0, "%s: ended with status %u, %u frames queued",
+            ptrName, runStatus, getQueuedFrameCountCtx(&link.writer));
+    checkBusTest(sawApplicationWait, "%s: never waited on the application", ptrName);
+    checkBusTest(sawOutputWait == smallSend, "%s: waited on output %u, expected %u", ptrName, sawOutputWait, smallSend);
+    checkBusTest(wireLength == referenceLength && memcmp(&wire[0], &reference[0], referenceLength) == 0, "%s: sent %u bytes, encodeBusFrame %u, not the same",
+            ptrName, wireLength, referenceLength);
+}
+
+void testHandlerBudget(void) {
+    unsigned char reference[MAX_FRAME_SIZE];
+    unsigned int referenceLength = encodeBusFrame(&payload[0], BUDGET_LENGTH, 0, &reference[0], sizeof(reference));
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus;
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    unsigned int decodedLength = 0;
+    unsigned int accepted = 0;
+    unsigned int steps;
+    unsigned int i;
+
+    initialiseBusTestLink(&link);
+    runStatus = BUS_HANDLER_RUN_NONE;
+    steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 1);
+    checkBusTest(steps == 1 && runStatus == BUS_HANDLER_RUN_STARVED, "handler: no input, %u steps, status %u", steps, runStatus);
+
+    putBytesForHandlingCtx(&link.handler, &putStatus, &reference[0], referenceLength, &accepted);
+    checkBusTest(accepted == referenceLength, "handler: ring took %u of %u bytes", accepted, referenceLength);
+    runStatus = BUS_HANDLER_RUN_NONE;
+    steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 0);
+    checkBusTest(steps == 0 && runStatus == BUS_HANDLER_RUN_BUDGET_SPENT && !link.applicationListener,
+            "handler: budget 0 took %u steps, status %u", steps, runStatus);
+
+    for(i = 0; i < BUDGET_MAX_STEPS; i++) {
+        runStatus = BUS_HANDLER_RUN_NONE;
+        steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 1);
+        if(steps != 1 || runStatus != BUS_HANDLER_RUN_BUDGET_SPENT) {
+            break;
+        }
+        steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 0);
+        if(steps != 0 || runStatus != BUS_HANDLER_RUN_BUDGET_SPENT) {
+            checkBusTest(0, "handler: budget 0 mid frame took %u steps, status %u", steps, runStatus);
+        }
+    }
+    checkBusTest(steps == 1 && runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION && link.applicationListener,
+            "handler: stopped after %u steps with status %u, listener %u", i, runStatus, link.applicationListener);
+
+    //Stays put on the listener, the frame untouched
+    steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 1);
+    checkBusTest(steps == 1 && runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION, "handler: stepped past the listener, status %u", runStatus);
+    decodedLength = drainBusTestApplication(&link, &decoded[0], sizeof(decoded));
+    checkBusTest(decodedLength == getBusTestPaddedLength(BUDGET_LENGTH, 0) && memcmp(&decoded[0], &payload[0], BUDGET_LENGTH) == 0,
+            "handler: %u bytes out", decodedLength);
+    link.applicationListener = 0;
+    for(i = 0; i < BUDGET_MAX_STEPS; i++) {
+        steps = runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 1);
+        if(runStatus != BUS_HANDLER_RUN_BUDGET_SPENT) {
+            break;
+        }
+    }
+    checkBusTest(runStatus == BUS_HANDLER_RUN_STARVED && !link.applicationListener, "handler: ended with status %u, listener %u", runStatus, link.applicationListener);
+}
+
+int main(void) {
+    unsigned int seed = 67;
+
+    fillBusTestPayload(&payload[0], BUDGET_LENGTH, &seed);
+    testWriterBudget(0);
+    testWriterBudget(1);
+    testHandlerBudget();
+    return finishBusTest("test_budget");
+}
@@ -0,0 +1,131 @@
+/*
+ * File:   test_buffer_sizes.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:35
+ *
+ * The link run on the buffer sizes bus_frame_details.h hands an application,
+ * SEND_BUFFER_SIZE and APPLICATION_BUFFER_SIZE, rather than the roomy ones
+ * the other tests use. Every payload the writer takes (up to
+ * FRAME_WRITER_MAX_PAYLOAD) has to fit the send buffer as a whole frame,
+ * go out through the queued and direct paths alike and come out of the
+ * handler intact, and one byte more has to be refused by every way in with
+ * nothing put on the wire. Built against bus_frame, where that's 90 bytes,
+ * and bus_frame_jumbo, where it's a full jumbo frame.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#define SIZES_WIRE_SIZE (SEND_BUFFER_SIZE + 16)
+
+void initialiseSizesLink(void);
+void checkFrameFits(unsigned int length, unsigned char format);
+void checkFrameThrough(unsigned int length, unsigned char format, unsigned char direct);
+void checkTooLong(void);
+unsigned int getNextLength(unsigned int length);
+
+tBusTestLink link;
+unsigned char sendArray[SEND_BUFFER_SIZE];
+unsigned char applicationArray[APPLICATION_BUFFER_SIZE];
+unsigned char payload[FRAME_WRITER_MAX_PAYLOAD + 1];
+unsigned char wire[SIZES_WIRE_SIZE];
+unsigned char decoded[APPLICATION_BUFFER_SIZE + 6];
+
+//The link's buffers swapped for ones of the sizes an application gets, the writer and handler already point at the tBuffers
+void initialiseSizesLink(void) {
+    initialiseBusTestLink(&link);
+    initialiseBuffer(&link.sendBuffer, &sendArray[0], SEND_BUFFER_SIZE);
+    initialiseBuffer(&link.applicationBuffer, &applicationArray[0], APPLICATION_BUFFER_SIZE);
+}
+
+//Every length while frames are small, then a spread so a jumbo build doesn't take all day. Always ends on FRAME_WRITER_MAX_PAYLOAD
+unsigned int getNextLength(unsigned int length) {
+    if(length < 2 * MAX_UNPACKED_PAYLOAD) {
+        return length + 1;
+    }
+    if(length < FRAME_WRITER_MAX_PAYLOAD && length + 97 > FRAME_WRITER_MAX_PAYLOAD) {
+        return FRAME_WRITER_MAX_PAYLOAD;
+    }
+    return length + 97;
+}
+
+void checkFrameFits(unsigned int length, unsigned char format) {
+    unsigned int size = getEncodedBusFrameSize(length, format);
+    checkBusTest(size > 0 && size <= SEND_BUFFER_SIZE, "format %02X length %u: %u bytes on the wire, SEND_BUFFER_SIZE %u", format, length, size, SEND_BUFFER_SIZE);
+    checkBusTest(getBusTestPaddedLength(length, format) <= APPLICATION_BUFFER_SIZE, "format %02X length %u: %u bytes handed over, APPLICATION_BUFFER_SIZE %u",
+            format, length, getBusTestPaddedLength(length, format), APPLICATION_BUFFER_SIZE);
+}
+
+void checkFrameThrough(unsigned int length, unsigned char format, unsigned char direct) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    const char *ptrPath = direct ? "direct" : "queued";
+    unsigned int decodedLength = 0;
+    unsigned int wireLength;
+    unsigned int frames;
+
+    initialiseSizesLink();
+    if(direct) {
+        writeBusFrameDirectCtx(&link.writer, &status, &payload[0], length, format);
+        checkBusTest(status == BUS_FRAME_WRITER_OPERATION_OK, "%s format %02X length %u: refused", ptrPath, format, length);
+        wireLength = collectBusTestWire(&link, &wire[0], sizeof(wire));
+    } else {
+        wireLength = writeBusTestFrame(&link, &payload[0], length, format, &wire[0], sizeof(wire));
+    }
+    checkBusTest(wireLength == getEncodedBusFrameSize(length, format), "%s format %02X length %u: %u bytes sent, %u expected",
+            ptrPath, format, length, wireLength, getEncodedBusFrameSize(length, format));
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+    checkBusTest(frames == 1 && decodedLength == getBusTestPaddedLength(length, format) && memcmp(&decoded[0], &payload[0], length) == 0,
+            "%s format %02X length %u: %u frames, %u bytes back", ptrPath, format, length, frames, decodedLength);
+}
+
+void checkTooLong(void) {
+    eBusFrameWriterOperationStatus status;
+    unsigned int wireLength;
+    unsigned int i;
+
+    initialiseSizesLink();
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    openBusFrameCtx(&link.writer, &status);
+    for(i = 0; i < FRAME_WRITER_MAX_PAYLOAD && status == BUS_FRAME_WRITER_OPERATION_OK; i++) {
+        writeToBusFrameCtx(&link.writer, &status, payload[i]);
+    }
+    checkBusTest(status == BUS_FRAME_WRITER_OPERATION_OK, "writeToBusFrame: refused at byte %u of %u", i, FRAME_WRITER_MAX_PAYLOAD);
+    writeToBusFrameCtx(&link.writer, &status, payload[FRAME_WRITER_MAX_PAYLOAD]);
+    checkBusTest(status == BUS_FRAME_WRITER_ERROR_WRITING, "writeToBusFrame: took byte %u", FRAME_WRITER_MAX_PAYLOAD + 1);
+
+    initialiseSizesLink();
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    writeBusFrameDirectCtx(&link.writer, &status, &payload[0], FRAME_WRITER_MAX_PAYLOAD + 1, 0);
+    wireLength = collectBusTestWire(&link, &wire[0], sizeof(wire));
+    checkBusTest(status == BUS_FRAME_WRITER_ERROR_WRITING && wireLength == 0, "writeBusFrameDirect: %u bytes, status %u, %u bytes sent",
+            FRAME_WRITER_MAX_PAYLOAD + 1, status, wireLength);
+
+    initialiseSizesLink();
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    writeBusFrameCompressedCtx(&link.writer, &status, &payload[0], FRAME_WRITER_MAX_PAYLOAD + 1, 0);
+    sendFramesInBufferCtx(&link.writer, &status);
+    wireLength = collectBusTestWire(&link, &wire[0], sizeof(wire));
+    checkBusTest(getQueuedFrameCountCtx(&link.writer) == 0 && wireLength == 0, "writeBusFrameCompressed: %u bytes, %u frames queued, %u bytes sent",
+            FRAME_WRITER_MAX_PAYLOAD + 1, getQueuedFrameCountCtx(&link.writer), wireLength);
+}
+
+int main(void) {
+    unsigned char formats[] = {0, BUS_FRAME_FORMAT_DENSE};
+    unsigned int seed = 71;
+    unsigned int length;
+    unsigned int f;
+
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+    for(f = 0; f < sizeof(formats); f++) {
+        for(length = 1; length <= FRAME_WRITER_MAX_PAYLOAD; length = getNextLength(length)) {
+            checkFrameFits(length, formats[f]);
+            checkFrameThrough(length, formats[f], 0);
+            checkFrameThrough(length, formats[f], 1);
+        }
+    }
+    checkTooLong();
+    return finishBusTest("test_buffer_sizes");
+}
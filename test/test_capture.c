@@ -0,0 +1,275 @@
+/*
+ * File:   test_capture.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:40
+ *
+ * A capture taken with the handler's capture hook (BUS_FRAME_CAPTURE_ENABLED)
+ * and played back through bus_replay. Block, jumbo and dense frames, some
+ * with a CRC flipped and quiet garbage between them, go into a handler whose
+ * hook writes every chunk it's handed to a capture file as port 3 receive.
+ * The ring takes the wire a piece at a time, so the hook has to see exactly
+ * what was accepted: the records joined up are the wire, nothing twice. The
+ * same frames taken off a writer go in as port 3 transmit. bus_replay then
+ * has to list, for each direction, the frames the live handler decoded (or
+ * the writer sent), same lengths, same bytes as far as it prints them, and
+ * count the same errors.
+ *
+ *   test_capture <bus_replay binary>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../host/bus_capture.h"
+#include "bus_test.h"
+
+#if !BUS_FRAME_CAPTURE_ENABLED || !BUS_FRAME_STATS_ENABLED
+#error test_capture needs a library built with BUS_FRAME_CAPTURE_ENABLED and BUS_FRAME_STATS_ENABLED
+#endif
+
+#define CAPTURE_FRAMES          200
+#define CAPTURE_TX_FRAMES       50
+#define CAPTURE_MAX_LENGTH      300
+#define CAPTURE_PORT            3
+#define CAPTURE_WIRE_SIZE       (CAPTURE_FRAMES * (7 + (CAPTURE_MAX_LENGTH / 6 + 1) * 8 + 16))
+#define CAPTURE_PAYLOAD_SIZE    (CAPTURE_FRAMES * (CAPTURE_MAX_LENGTH + 6))
+#define CAPTURE_PRINT_BYTES     32 //What bus_replay prints of a frame
+
+typedef struct {
+    unsigned char payload[CAPTURE_PAYLOAD_SIZE];
+    unsigned int lengths[CAPTURE_FRAMES];
+    unsigned int frameCount;
+    unsigned int payloadLength;
+} tCaptureFrames;
+
+void captureChunk(const unsigned char *ptrBytes, unsigned int length);
+unsigned int makeCaptureWire(unsigned int *ptrSeed, unsigned int *ptrCorrupt);
+void captureTransmit(unsigned int *ptrSeed);
+void checkCaptureRecords(const char *ptrPath);
+void replayCapture(const char *ptrReplay, const char *ptrPath, unsigned long liveErrors);
+void checkReplayFrame(const char *ptrName, tCaptureFrames *ptrExpected, unsigned int *ptrNext, unsigned int *ptrPosition, unsigned int length, const char *ptrBytes);
+
+tBusTestLink captureLink;
+tBusCapture capture;
+unsigned long long captureClock;
+unsigned int captureRecords;
+unsigned char wire[CAPTURE_WIRE_SIZE];
+unsigned int wireLength;
+unsigned char txWire[CAPTURE_WIRE_SIZE];
+unsigned int txWireLength;
+tCaptureFrames received;
+tCaptureFrames sent;
+
+//The hook has nothing but the bytes, so the port, direction and a made up clock come from here
+void captureChunk(const unsigned char *ptrBytes, unsigned int length) {
+    captureClock += 1000;
+    if(writeBusCaptureChunk(&capture, CAPTURE_PORT, BUS_CAPTURE_RX, captureClock, ptrBytes, length) == 0) {
+        captureRecords++;
+    }
+}
+
+//Frames with up to 8 bytes of garbage after them, none of it marker bytes so every good frame still decodes. About 1 in 8 with a CRC flipped
+unsigned int makeCaptureWire(unsigned int *ptrSeed, unsigned int *ptrCorrupt) {
+    unsigned char payload[CAPTURE_MAX_LENGTH];
+    unsigned int frames = 0;
+    unsigned int frame;
+    unsigned int length;
+    unsigned int added;
+    unsigned int garbage;
+    unsigned char format;
+
+    wireLength = 0;
+    *ptrCorrupt = 0;
+    for(frame = 0; frame < CAPTURE_FRAMES; frame++) {
+        length = 1 + getBusTestRandom(ptrSeed) % CAPTURE_MAX_LENGTH;
+        format = (getBusTestRandom(ptrSeed) & 1) ? BUS_FRAME_FORMAT_DENSE : 0;
+        fillBusTestPayload(&payload[0], length, ptrSeed);
+        added = encodeBusFrame(&payload[0], length, format, &wire[wireLength], sizeof(wire) - wireLength);
+        if(getBusTestRandom(ptrSeed) % 8 == 0) {
+            wire[wireLength + added - ((format & BUS_FRAME_FORMAT_DENSE) ? 3 : 2 + 8 - 1)] ^= 1;
+            (*ptrCorrupt)++;
+        } else {
+            frames++;
+        }
+        wireLength += added;
+        for(garbage = getBusTestRandom(ptrSeed) % 9; garbage > 0; garbage--) {
+            wire[wireLength++] = (unsigned char)(getBusTestRandom(ptrSeed) % 0xC0);
+        }
+    }
+    return frames;
+}
+
+//Frames from the link's writer, captured as transmit in whatever pieces they come off the send buffer
+void captureTransmit(unsigned int *ptrSeed) {
+    unsigned char payload[CAPTURE_MAX_LENGTH];
+    unsigned int frame;
+    unsigned int length;
+    unsigned int added;
+
+    txWireLength = 0;
+    sent.frameCount = 0;
+    sent.payloadLength = 0;
+    for(frame = 0; frame < CAPTURE_TX_FRAMES; frame++) {
+        length = 1 + getBusTestRandom(ptrSeed) % FRAME_WRITER_MAX_PAYLOAD;
+        fillBusTestPayload(&payload[0], length, ptrSeed);
+        added = writeBusTestFrame(&captureLink, &payload[0], length, (frame & 1) ? BUS_FRAME_FORMAT_DENSE : 0, &txWire[txWireLength], sizeof(txWire) - txWireLength);
+        checkBusTest(added > 0, "transmit: frame %u refused", frame);
+        writeBusCaptureChunk(&capture, CAPTURE_PORT, BUS_CAPTURE_TX, captureClock += 1000, &txWire[txWireLength], added);
+        txWireLength += added;
+        memcpy(&sent.payload[sent.payloadLength], &payload[0], length);
+        //The writer fills out a block's last data bytes with 0xFF
+        memset(&sent.payload[sent.payloadLength + length], 0xFF, getBusTestPaddedLength(length, (frame & 1) ? BUS_FRAME_FORMAT_DENSE : 0) - length);
+        sent.lengths[sent.frameCount++] = getBusTestPaddedLength(length, (frame & 1) ? BUS_FRAME_FORMAT_DENSE : 0);
+        sent.payloadLength += sent.lengths[sent.frameCount - 1];
+    }
+}
+
+//The receive records joined up have to be the wire exactly, and the transmit ones the writer's output
+void checkCaptureRecords(const char *ptrPath) {
+    const tBusCaptureRecord *ptrRecord;
+    unsigned char *ptrFile;
+    unsigned int rxLength = 0;
+    unsigned int txLength = 0;
+    unsigned int rxRecords = 0;
+    unsigned int rxMatches = 1;
+    unsigned int txMatches = 1;
+    size_t fileLength;
+    size_t offset = 0;
+    FILE *ptrStream;
+
+    ptrStream = fopen(ptrPath, "rb");
+    if(ptrStream == 0) {
+        checkBusTest(0, "records: can't open %s", ptrPath);
+        return;
+    }
+    ptrFile = malloc(2 * CAPTURE_WIRE_SIZE + 64 * (captureRecords + CAPTURE_TX_FRAMES) + 64);
+    fileLength = fread(ptrFile, 1, 2 * CAPTURE_WIRE_SIZE + 64 * (captureRecords + CAPTURE_TX_FRAMES) + 64, ptrStream);
+    fclose(ptrStream);
+    while((ptrRecord = getBusCaptureRecord(ptrFile, fileLength, &offset)) != 0) {
+        if(ptrRecord->port != CAPTURE_PORT) {
+            checkBusTest(0, "records: one for port %u", ptrRecord->port);
+        } else if(ptrRecord->direction == BUS_CAPTURE_RX) {
+            rxMatches &= rxLength + ptrRecord->length <= wireLength && memcmp(ptrRecord + 1, &wire[rxLength], ptrRecord->length) == 0;
+            rxLength += ptrRecord->length;
+            rxRecords++;
+        } else {
+            txMatches &= txLength + ptrRecord->length <= txWireLength && memcmp(ptrRecord + 1, &txWire[txLength], ptrRecord->length) == 0;
+            txLength += ptrRecord->length;
+        }
+    }
+    free(ptrFile);
+    checkBusTest(rxRecords == captureRecords && rxRecords > 1, "records: %u receive records read back, %u captured", rxRecords, captureRecords);
+    checkBusTest(rxLength == wireLength && rxMatches, "records: %u receive bytes captured for %u on the wire, or not the same ones", rxLength, wireLength);
+    checkBusTest(txLength == txWireLength && txMatches, "records: %u transmit bytes captured for %u sent, or not the same ones", txLength, txWireLength);
+}
+
+void checkReplayFrame(const char *ptrName, tCaptureFrames *ptrExpected, unsigned int *ptrNext, unsigned int *ptrPosition, unsigned int length, const char *ptrBytes) {
+    unsigned int index;
+    unsigned int byte;
+    int consumed;
+
+    if(*ptrNext >= ptrExpected->frameCount) {
+        (*ptrNext)++;
+        return;
+    }
+    if(length != ptrExpected->lengths[*ptrNext]) {
+        checkBusTest(0, "%s: replayed frame %u is %u bytes, %u live", ptrName, *ptrNext, length, ptrExpected->lengths[*ptrNext]);
+    } else {
+        for(index = 0; index < length && index < CAPTURE_PRINT_BYTES; index++) {
+            if(sscanf(ptrBytes, " %2x%n", &byte, &consumed) != 1 || byte != ptrExpected->payload[*ptrPosition + index]) {
+                checkBusTest(0, "%s: replayed frame %u differs at byte %u", ptrName, *ptrNext, index);
+                break;
+            }
+            ptrBytes += consumed;
+        }
+    }
+    *ptrPosition += ptrExpected->lengths[*ptrNext];
+    (*ptrNext)++;
+}
+
+void replayCapture(const char *ptrReplay, const char *ptrPath, unsigned long liveErrors) {
+    char command[256];
+    char line[512];
+    char direction[8];
+    char error[64];
+    FILE *ptrPipe;
+    unsigned long count;
+    unsigned long errors = 0;
+    unsigned int port;
+    unsigned int length;
+    unsigned int rxNext = 0;
+    unsigned int rxPosition = 0;
+    unsigned int txNext = 0;
+    unsigned int txPosition = 0;
+    int consumed;
+
+    snprintf(command, sizeof(command), "%s %s 2>/dev/null", ptrReplay, ptrPath);
+    ptrPipe = popen(command, "r");
+    if(ptrPipe == 0) {
+        checkBusTest(0, "replay: can't run %s", command);
+        return;
+    }
+    while(fgets(line, sizeof(line), ptrPipe)) {
+        if(sscanf(line, "%*f port %u %7s frame %u:%n", &port, direction, &length, &consumed) == 3) {
+            checkBusTest(port == CAPTURE_PORT, "replay: frame on port %u", port);
+            if(strcmp(direction, "rx") == 0) {
+                checkReplayFrame("replay rx", &received, &rxNext, &rxPosition, length, &line[consumed]);
+            } else {
+                checkReplayFrame("replay tx", &sent, &txNext, &txPosition, length, &line[consumed]);
+            }
+        } else if(sscanf(line, "%*f port %u %7s error %63s x%lu", &port, direction, error, &count) == 4) {
+            checkBusTest(strcmp(direction, "rx") == 0, "replay: %s error on the transmit side", error);
+            errors += count;
+        } else {
+            checkBusTest(0, "replay: unexpected line %s", line);
+        }
+    }
+    checkBusTest(pclose(ptrPipe) == 0, "replay: %s failed", command);
+    checkBusTest(rxNext == received.frameCount, "replay: %u receive frames, %u live", rxNext, received.frameCount);
+    checkBusTest(txNext == sent.frameCount, "replay: %u transmit frames, %u sent", txNext, sent.frameCount);
+    checkBusTest(errors == liveErrors, "replay: %lu errors, %lu live", errors, liveErrors);
+}
+
+int main(int argc, char **argv) {
+    tBusFrameHandlerStats stats;
+    char path[64];
+    unsigned long liveErrors = 0;
+    unsigned int seed = 37;
+    unsigned int goodFrames;
+    unsigned int corrupt;
+    unsigned int kind;
+
+    if(argc < 2) {
+        printf("usage: %s <bus_replay binary>\n", argv[0]);
+        return 2;
+    }
+    snprintf(path, sizeof(path), "/tmp/test_capture.%d.cap", (int)getpid());
+    if(openBusCapture(&capture, path) < 0) {
+        checkBusTest(0, "can't create %s", path);
+        return finishBusTest("test_capture");
+    }
+
+    initialiseBusTestLink(&captureLink);
+    registerBusFrameCaptureHookCtx(&captureLink.handler, captureChunk);
+    goodFrames = makeCaptureWire(&seed, &corrupt);
+    received.frameCount = readBusTestFrames(&captureLink, &wire[0], wireLength, &received.payload[0], sizeof(received.payload), &received.lengths[0], CAPTURE_FRAMES);
+    received.payloadLength = 0;
+    checkBusTest(received.frameCount == goodFrames && corrupt > 0, "live: %u frames decoded, %u good ones sent (%u corrupt)", received.frameCount, goodFrames, corrupt);
+    snapshotBusFrameHandlerStatsCtx(&captureLink.handler, &stats);
+    for(kind = BHE_NONE + 1; kind < BHE_ERROR_KINDS; kind++) {
+        liveErrors += stats.errorCounts[kind];
+    }
+    checkBusTest(stats.errorCounts[BHE_CRC_FAILED] == corrupt, "live: %lu CRC_FAILED for %u corrupt frames", stats.errorCounts[BHE_CRC_FAILED], corrupt);
+
+    //Unhooked, the transmit side goes in by hand
+    registerBusFrameCaptureHookCtx(&captureLink.handler, 0);
+    captureTransmit(&seed);
+    closeBusCapture(&capture);
+
+    checkCaptureRecords(path);
+    replayCapture(argv[1], path, liveErrors);
+    remove(path);
+    return finishBusTest("test_capture");
+}
@@ -0,0 +1,243 @@
+/*
+ * File:   test_coalesce.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:20
+ *
+ * Send listener coalescing (setBusFrameCoalescing) counted in wakeups, the
+ * thing it's there to save. With a byte threshold and frames queued faster
+ * than they go, every batch has to be exactly maxBytes of whole frames with
+ * one wakeup each, the leftovers going at the deadline. With a clock and
+ * frames trickling in, one wakeup per maxDelay ticks carrying everything
+ * closed since, none early and none twice. A lone frame after a flush is
+ * still held, and goes on its own at the deadline. Every frame has to
+ * decode, in order.
+ *
+ *   test_coalesce [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#define COALESCE_DEFAULT_FRAMES 600
+#define COALESCE_MAX_FRAMES     4000
+#define COALESCE_LENGTH         6
+#define COALESCE_FRAME_WIRE     (4 + 8)
+#define COALESCE_BATCH_FRAMES   3
+#define COALESCE_DELAY          50
+#define COALESCE_FRAME_GAP      10 //Ticks between frames, so a batch is COALESCE_DELAY / COALESCE_FRAME_GAP of them
+#define COALESCE_MAX_STEPS      1000
+
+unsigned long readCoalesceClock(void);
+unsigned char queueCoalesceFrame(unsigned int sequence);
+unsigned int stepCoalesceWriter(void);
+void checkCoalescedFrames(const char *ptrName, unsigned int sent);
+void testByteThreshold(unsigned int frames);
+void testDeadline(unsigned int frames);
+void testSingleFrame(void);
+
+tBusTestLink link;
+unsigned long now;
+unsigned int wakeups;
+unsigned int lastBatchBytes;
+unsigned int wireLength;
+unsigned char wire[COALESCE_MAX_FRAMES * COALESCE_FRAME_WIRE];
+unsigned char decoded[COALESCE_MAX_FRAMES * COALESCE_LENGTH];
+unsigned int decodedLengths[COALESCE_MAX_FRAMES];
+
+unsigned long readCoalesceClock(void) {
+    return now;
+}
+
+//Payload is the sequence number (low byte, high byte) and then padding
+unsigned char queueCoalesceFrame(unsigned int sequence) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    unsigned int i;
+
+    openBusFrameCtx(&link.writer, &status);
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    for(i = 0; i < COALESCE_LENGTH; i++) {
+        writeToBusFrameCtx(&link.writer, &status, (unsigned char)(i == 0 ? sequence : i == 1 ? sequence >> 8 : 0x5A));
+    }
+    closeBusFrameCtx(&link.writer, &status);
+    sendFramesInBufferCtx(&link.writer, &status);
+    return 1;
+}
+
+//Steps the writer until it's blocked. A set listener is one wakeup: the batch is taken off the send buffer and the listener cleared. Returns the wakeups
+unsigned int stepCoalesceWriter(void) {
+    eBusFrameWriterRunStatus runStatus;
+    eBufferOperationStatus bufferStatus;
+    tBusFrameWriterWait wait;
+    unsigned int woken = 0;
+    unsigned int steps;
+    unsigned char byte;
+
+    for(steps = 0; steps < COALESCE_MAX_STEPS; steps++) {
+        runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+        if(link.sendListener) {
+            woken++;
+            wakeups++;
+            lastBatchBytes = 0;
+            while(1) {
+                bufferStatus = BUFFER_OPERATION_NONE;
+                getByte(&link.sendBuffer, &bufferStatus, &byte);
+                if(bufferStatus != BUFFER_OPERATION_OK) {
+                    break;
+                }
+                if(wireLength < sizeof(wire)) {
+                    wire[wireLength] = byte;
+                }
+                wireLength++;
+                lastBatchBytes++;
+            }
+            link.sendListener = 0;
+            continue;
+        }
+        getBusFrameWriterWaitCtx(&link.writer, &wait);
+        if(wait.reason != BUS_FRAME_WRITER_BLOCKED_NONE) {
+            break;
+        }
+    }
+    return woken;
+}
+
+void checkCoalescedFrames(const char *ptrName, unsigned int sent) {
+    unsigned int frames;
+    unsigned int frame;
+    unsigned int bad = 0;
+    unsigned int sequence;
+
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLengths[0], COALESCE_MAX_FRAMES);
+    checkBusTest(frames == sent && wireLength == sent * COALESCE_FRAME_WIRE, "%s: %u frames out in %u bytes, %u sent", ptrName, frames, wireLength, sent);
+    for(frame = 0; frame < frames && frame < sent; frame++) {
+        sequence = decoded[frame * COALESCE_LENGTH] | ((unsigned int)decoded[frame * COALESCE_LENGTH + 1] << 8);
+        if((decodedLengths[frame] != COALESCE_LENGTH || sequence != frame) && bad++ < 5) {
+            checkBusTest(0, "%s: frame %u came out as %u bytes, sequence %u", ptrName, frame, decodedLengths[frame], sequence);
+        }
+    }
+}
+
+void testByteThreshold(unsigned int frames) {
+    unsigned int sequence = 0;
+    unsigned int batches = 0;
+    unsigned int woken;
+    unsigned int burst;
+
+    initialiseBusTestLink(&link);
+    now = 1000;
+    registerBusFrameWriterClockCtx(&link.writer, readCoalesceClock);
+    setBusFrameCoalescingCtx(&link.writer, COALESCE_BATCH_FRAMES * COALESCE_FRAME_WIRE, 1000000);
+    wakeups = 0;
+    wireLength = 0;
+
+    //Queued in bursts that don't line up with the batches, the clock stood still so only the threshold can wake the listener
+    while(sequence < frames) {
+        for(burst = 0; burst < FRAME_WRITER_MAX_QUEUED_FRAMES - 2 && sequence < frames; burst++) {
+            if(!queueCoalesceFrame(sequence)) {
+                break;
+            }
+            sequence++;
+        }
+        woken = stepCoalesceWriter();
+        checkBusTest(woken == 0 || lastBatchBytes == COALESCE_BATCH_FRAMES * COALESCE_FRAME_WIRE, "threshold: batch %u was %u bytes", batches, lastBatchBytes);
+        batches += woken;
+    }
+    checkBusTest(wakeups == frames / COALESCE_BATCH_FRAMES, "threshold: %u wakeups for %u frames in batches of %u", wakeups, frames, COALESCE_BATCH_FRAMES);
+    checkBusTest(wireLength == wakeups * COALESCE_BATCH_FRAMES * COALESCE_FRAME_WIRE, "threshold: %u bytes out before the deadline", wireLength);
+
+    //What's left of a batch goes at the deadline, in the one wakeup
+    now += 1000000;
+    woken = stepCoalesceWriter();
+    checkBusTest(woken == (frames % COALESCE_BATCH_FRAMES != 0) && (woken == 0 || lastBatchBytes == (frames % COALESCE_BATCH_FRAMES) * COALESCE_FRAME_WIRE),
+            "threshold: %u wakeups for the last %u frames, %u bytes", woken, frames % COALESCE_BATCH_FRAMES, lastBatchBytes);
+    checkCoalescedFrames("threshold", frames);
+}
+
+void testDeadline(unsigned int frames) {
+    unsigned long lastWakeup = 0;
+    unsigned int sequence = 0;
+    unsigned int woken;
+    unsigned int early = 0;
+    unsigned int tick;
+
+    initialiseBusTestLink(&link);
+    now = 1000;
+    registerBusFrameWriterClockCtx(&link.writer, readCoalesceClock);
+    setBusFrameCoalescingCtx(&link.writer, 100000, COALESCE_DELAY);
+    wakeups = 0;
+    wireLength = 0;
+
+    //A frame every COALESCE_FRAME_GAP ticks, the writer stepped every tick
+    for(tick = 0; sequence < frames; tick++) {
+        if(tick % COALESCE_FRAME_GAP == 0) {
+            queueCoalesceFrame(sequence++);
+        }
+        woken = stepCoalesceWriter();
+        if(woken) {
+            //The first frame of the run finds the listener long since quiet and goes straight out
+            if(woken != 1 || (wakeups > 1 && now - lastWakeup != COALESCE_DELAY)) {
+                if(early++ < 5) {
+                    checkBusTest(0, "deadline: %u wakeups at tick %lu, %lu after the last", woken, now, now - lastWakeup);
+                }
+            }
+            if(wakeups > 1 && lastBatchBytes != COALESCE_DELAY / COALESCE_FRAME_GAP * COALESCE_FRAME_WIRE && early++ < 5) {
+                checkBusTest(0, "deadline: batch at tick %lu was %u bytes", now, lastBatchBytes);
+            }
+            lastWakeup = now;
+        }
+        now++;
+    }
+    while(stepCoalesceWriter() == 0 && now - lastWakeup <= COALESCE_DELAY) {
+        now++;
+    }
+    checkBusTest(wakeups == 1 + (frames - 1 + COALESCE_DELAY / COALESCE_FRAME_GAP - 1) / (COALESCE_DELAY / COALESCE_FRAME_GAP),
+            "deadline: %u wakeups for %u frames", wakeups, frames);
+    checkCoalescedFrames("deadline", frames);
+}
+
+void testSingleFrame(void) {
+    unsigned long flushed;
+    unsigned int woken = 0;
+
+    initialiseBusTestLink(&link);
+    now = 1000;
+    registerBusFrameWriterClockCtx(&link.writer, readCoalesceClock);
+    setBusFrameCoalescingCtx(&link.writer, 100000, COALESCE_DELAY);
+    wakeups = 0;
+    wireLength = 0;
+
+    queueCoalesceFrame(0);
+    checkBusTest(stepCoalesceWriter() == 1 && lastBatchBytes == COALESCE_FRAME_WIRE, "single: first frame after a quiet spell held");
+    flushed = now;
+
+    now += 5;
+    queueCoalesceFrame(1);
+    while(now < flushed + COALESCE_DELAY && (woken = stepCoalesceWriter()) == 0) {
+        now++;
+    }
+    checkBusTest(woken == 0 && now == flushed + COALESCE_DELAY, "single: went out %lu ticks after the last wakeup", now - flushed);
+    woken = stepCoalesceWriter();
+    checkBusTest(woken == 1 && lastBatchBytes == COALESCE_FRAME_WIRE, "single: %u wakeups at the deadline, %u bytes", woken, lastBatchBytes);
+    now += 10 * COALESCE_DELAY;
+    checkBusTest(stepCoalesceWriter() == 0, "single: woken again with nothing sent");
+    checkCoalescedFrames("single", 2);
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : COALESCE_DEFAULT_FRAMES;
+
+    if(frames == 0 || frames > COALESCE_MAX_FRAMES) {
+        frames = COALESCE_DEFAULT_FRAMES;
+    }
+    testByteThreshold(frames);
+    testByteThreshold(frames + 1);
+    testDeadline(frames);
+    testSingleFrame();
+    return finishBusTest("test_coalesce");
+}
@@ -0,0 +1,95 @@
+/*
+ * File:   test_codec.cpp
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:55
+ *
+ * host/bus_frame_codec.hpp against the C code, both ways: frames from
+ * encodeBusFrame and the writer decode in the C++ codec, and the C++
+ * codec's frames are byte for byte encodeBusFrame's and come out of the
+ * handler, as block, jumbo and dense frames with both CRC policies. A
+ * classic only codec refuses jumbo frames, and a flipped data bit fails
+ * the decode.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "../host/bus_frame_codec.hpp"
+extern "C" {
+#include "bus_test.h"
+}
+
+using TableCodec = busframe::BusFrameCodec<BUS_FRAME_JUMBO_MAX_BLOCKS, busframe::TableCrc>;
+using BitwiseCodec = busframe::BusFrameCodec<BUS_FRAME_JUMBO_MAX_BLOCKS, busframe::BitwiseCrc>;
+using ClassicCodec = busframe::BusFrameCodec<15>;
+
+template <class Codec>
+void checkCodec(const char *ptrName, const unsigned char *ptrPayload, unsigned length, unsigned char format);
+
+tBusTestLink link;
+unsigned char cWire[TableCodec::maxWireSize];
+unsigned char codecWire[TableCodec::maxWireSize];
+unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+unsigned char payload[MAX_JUMBO_UNPACKED_PAYLOAD];
+
+template <class Codec>
+void checkCodec(const char *ptrName, const unsigned char *ptrPayload, unsigned length, unsigned char format) {
+    bool dense = (format & BUS_FRAME_FORMAT_DENSE) != 0;
+    unsigned padded = getBusTestPaddedLength(length, format);
+    unsigned cLength;
+    unsigned codecLength;
+    unsigned decodedLength = 0;
+    unsigned consumed;
+    unsigned frames;
+
+    //C to C++, straight from encodeBusFrame and through the writer
+    cLength = encodeBusFrame(ptrPayload, length, format, &cWire[0], sizeof(cWire));
+    consumed = Codec::decode(&cWire[0], cLength, &decoded[0], &decodedLength);
+    checkBusTest(consumed == cLength && decodedLength == padded && memcmp(&decoded[0], ptrPayload, length) == 0,
+            "%s format %02X length %u: decoding encodeBusFrame took %u of %u bytes, %u payload bytes", ptrName, format, length, consumed, cLength, decodedLength);
+    cLength = writeBusTestFrame(&link, ptrPayload, length, format, &cWire[0], sizeof(cWire));
+    consumed = Codec::decode(&cWire[0], cLength, &decoded[0], &decodedLength);
+    checkBusTest(cLength && consumed == cLength && decodedLength == padded && memcmp(&decoded[0], ptrPayload, length) == 0,
+            "%s format %02X length %u: decoding the writer took %u of %u bytes, %u payload bytes", ptrName, format, length, consumed, cLength, decodedLength);
+
+    //C++ to C
+    codecLength = dense ? Codec::encodeDense(ptrPayload, length, &codecWire[0]) : Codec::encode(ptrPayload, length, &codecWire[0]);
+    checkBusTest(codecLength == Codec::encodedSize(length, dense) && codecLength == cLength && memcmp(&codecWire[0], &cWire[0], cLength) == 0,
+            "%s format %02X length %u: encoded %u bytes, encodeBusFrame %u, not the same", ptrName, format, length, codecLength, cLength);
+    frames = readBusTestFrames(&link, &codecWire[0], codecLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+    checkBusTest(frames == 1 && decodedLength == padded && memcmp(&decoded[0], ptrPayload, length) == 0,
+            "%s format %02X length %u: handler gave %u frames, %u bytes", ptrName, format, length, frames, decodedLength);
+
+    //Low bit of the last data byte of the first block or group, under the block or frame CRC either way
+    codecWire[dense ? 5 + (length < busframe::denseGroupBytes ? length : busframe::denseGroupBytes) - 1 : (length > 90 ? 5 : 2) + 7] ^= 0x01;
+    checkBusTest(Codec::decode(&codecWire[0], codecLength, &decoded[0], &decodedLength) == 0,
+            "%s format %02X length %u: decoded with a data bit flipped", ptrName, format, length);
+}
+
+int main(void) {
+    unsigned lengths[] = {1, 5, 6, 7, 40, 89, 90, 91, 300, 1000, 4096, MAX_JUMBO_UNPACKED_PAYLOAD};
+    unsigned char formats[] = {0, BUS_FRAME_FORMAT_DENSE};
+    ClassicCodec::PayloadBuffer classicPayload;
+    unsigned int seed = 97;
+    unsigned decodedLength = 0;
+    unsigned wireLength;
+
+    initialiseBusTestLink(&link);
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+    for(unsigned char format : formats) {
+        for(unsigned length : lengths) {
+            checkCodec<TableCodec>("table", &payload[0], length, format);
+            checkCodec<BitwiseCodec>("bitwise", &payload[0], length, format);
+        }
+    }
+
+    //The classic codec takes up to 15 blocks and leaves jumbo frames alone
+    wireLength = encodeBusFrame(&payload[0], 90, 0, &cWire[0], sizeof(cWire));
+    checkBusTest(ClassicCodec::decode(&cWire[0], wireLength, classicPayload, &decodedLength) == wireLength &&
+            memcmp(classicPayload.data(), &payload[0], 90) == 0, "classic: 90 byte frame didn't decode");
+    wireLength = encodeBusFrame(&payload[0], 91, 0, &cWire[0], sizeof(cWire));
+    checkBusTest(ClassicCodec::decode(&cWire[0], wireLength, classicPayload, &decodedLength) == 0, "classic: decoded a jumbo frame");
+    checkBusTest(ClassicCodec::encode(&payload[0], 91, &codecWire[0]) == 0 && ClassicCodec::encodedSize(91) == 0, "classic: encoded 91 bytes");
+
+    return finishBusTest("test_codec");
+}
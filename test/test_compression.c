@@ -0,0 +1,126 @@
+/*
+ * File:   test_compression.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:25
+ *
+ * writeBusFrameCompressed round trips (BUS_FRAME_COMPRESSION_ENABLED): a
+ * run of sensor telemetry through the writer and the handler as block and
+ * as dense frames, every payload out as it went in and the compressed
+ * frames smaller on the wire. Then a delta reaching a handler that never
+ * got the frame it's against: one reference error, nothing handed up, and
+ * the next frame still decodes.
+ *
+ *   test_compression [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bus_test.h"
+
+#if !BUS_FRAME_COMPRESSION_ENABLED || !BUS_FRAME_STATS_ENABLED
+#error test_compression needs a library built with BUS_FRAME_COMPRESSION_ENABLED and BUS_FRAME_STATS_ENABLED
+#endif
+
+#define COMPRESSION_DEFAULT_FRAMES  2000
+
+unsigned int writeCompressedFrame(tBusTestLink *ptrLink, const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize);
+unsigned long countHandlerErrors(tBusFrameHandlerStats *ptrStats);
+
+tBusTestLink link;
+tBusTestLink lateLink;
+
+unsigned int writeCompressedFrame(tBusTestLink *ptrLink, const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+
+    writeBusFrameCompressedCtx(&ptrLink->writer, &status, ptrPayload, length, format);
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    sendFramesInBufferCtx(&ptrLink->writer, &status);
+    return collectBusTestWire(ptrLink, ptrWire, wireSize);
+}
+
+unsigned long countHandlerErrors(tBusFrameHandlerStats *ptrStats) {
+    unsigned long errors = 0;
+    unsigned int kind;
+    for(kind = BHE_NONE + 1; kind < BHE_ERROR_KINDS; kind++) {
+        errors += ptrStats->errorCounts[kind];
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : COMPRESSION_DEFAULT_FRAMES;
+    unsigned char encodings[] = {0, BUS_FRAME_FORMAT_DENSE};
+    unsigned char payload[32];
+    unsigned char wire[64];
+    unsigned char decoded[64];
+    tBusFrameWriterStats writerStats;
+    tBusFrameHandlerStats handlerStats;
+    unsigned long wireBytes;
+    unsigned long plainBytes;
+    unsigned int seed;
+    unsigned int length;
+    unsigned int wireLength;
+    unsigned int decodedLength;
+    unsigned int decodedFrames;
+    unsigned int bad;
+    unsigned int frame;
+    unsigned int e;
+
+    for(e = 0; e < sizeof(encodings); e++) {
+        initialiseBusTestLink(&link);
+        seed = 81;
+        wireBytes = 0;
+        plainBytes = 0;
+        bad = 0;
+        for(frame = 0; frame < frames; frame++) {
+            length = makeBusTestTelemetry(frame, &payload[0], &seed);
+            wireLength = writeCompressedFrame(&link, &payload[0], length, encodings[e], &wire[0], sizeof(wire));
+            decodedFrames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+            //Compressed frames expand to their own length, the ones that went out plain come padded
+            if((decodedFrames != 1 || decodedLength < length || decodedLength > getBusTestPaddedLength(length, encodings[e]) ||
+                    memcmp(&decoded[0], &payload[0], length) != 0) && bad++ < 5) {
+                checkBusTest(0, "format %02X frame %u: %u wire bytes, %u frames, %u of %u bytes back", encodings[e], frame, wireLength,
+                        decodedFrames, decodedLength, length);
+            }
+            wireBytes += wireLength;
+            plainBytes += getEncodedBusFrameSize(length, encodings[e]);
+        }
+        snapshotBusFrameWriterStatsCtx(&link.writer, &writerStats);
+        snapshotBusFrameHandlerStatsCtx(&link.handler, &handlerStats);
+        checkBusTest(bad == 0, "format %02X: %u frames came out wrong", encodings[e], bad);
+        checkBusTest(writerStats.framesCompressed > frames / 2, "format %02X: only %lu of %u frames compressed", encodings[e],
+                writerStats.framesCompressed, frames);
+        checkBusTest(wireBytes < plainBytes, "format %02X: %lu wire bytes compressed, %lu without", encodings[e], wireBytes, plainBytes);
+        checkBusTest(countHandlerErrors(&handlerStats) == 0, "format %02X: %lu handler errors", encodings[e], countHandlerErrors(&handlerStats));
+    }
+
+    //Frame 0 goes to both handlers, frame 4 (a delta against it) only to the late one after it's been reset
+    initialiseBusTestLink(&link);
+    initialiseBusTestLink(&lateLink);
+    seed = 83;
+    length = makeBusTestTelemetry(0, &payload[0], &seed);
+    wireLength = writeCompressedFrame(&link, &payload[0], length, 0, &wire[0], sizeof(wire));
+    decodedFrames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+    checkBusTest(decodedFrames == 1, "reference frame: %u frames out", decodedFrames);
+    length = makeBusTestTelemetry(4, &payload[0], &seed);
+    wireLength = writeCompressedFrame(&link, &payload[0], length, 0, &wire[0], sizeof(wire));
+    snapshotBusFrameWriterStatsCtx(&link.writer, &writerStats);
+    checkBusTest(writerStats.framesCompressed == 2, "delta: %lu frames compressed", writerStats.framesCompressed);
+    decodedFrames = readBusTestFrames(&lateLink, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+    snapshotBusFrameHandlerStatsCtx(&lateLink.handler, &handlerStats);
+    checkBusTest(decodedFrames == 0, "delta without its reference: %u frames out", decodedFrames);
+    checkBusTest(handlerStats.errorCounts[BHE_COMPRESSION_REFERENCE] == 1, "delta without its reference: %lu reference errors",
+            handlerStats.errorCounts[BHE_COMPRESSION_REFERENCE]);
+    checkBusTest(countHandlerErrors(&handlerStats) == 1, "delta without its reference: %lu errors, expected just the reference error",
+            countHandlerErrors(&handlerStats));
+    wireLength = encodeBusFrame(&payload[0], length, 0, &wire[0], sizeof(wire));
+    decodedFrames = readBusTestFrames(&lateLink, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLength, 1);
+    checkBusTest(decodedFrames == 1 && decodedLength == getBusTestPaddedLength(length, 0) && memcmp(&decoded[0], &payload[0], length) == 0,
+            "after the reference error: %u frames, %u bytes back", decodedFrames, decodedLength);
+
+    return finishBusTest("test_compression");
+}
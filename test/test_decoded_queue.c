@@ -0,0 +1,156 @@
+/*
+ * File:   test_decoded_queue.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 03:45
+ *
+ * Decoded frame queue (HANDLER_DECODED_QUEUE_SIZE) with a consumer that
+ * lags. A burst has to stop the handler with the queue full and nothing
+ * lost; then a UART sized trickle against a consumer taking one frame every
+ * few ticks, where the queue fills, the inbound ring pushes back, and every
+ * frame still has to come out in order with the right sequence, offset and
+ * payload.
+ *
+ *   test_decoded_queue [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#if HANDLER_DECODED_QUEUE_SIZE < 2
+#error test_decoded_queue needs a library built with HANDLER_DECODED_QUEUE_SIZE of 2 or more
+#endif
+
+#define QUEUE_DEFAULT_FRAMES    5000
+#define QUEUE_MAX_LENGTH        40
+#define QUEUE_WIRE_PER_FRAME    (4 + 3 + QUEUE_MAX_LENGTH + ((QUEUE_MAX_LENGTH + 6) / 7) + 3 + 8)
+#define QUEUE_UART_BYTES        16      //Per tick
+#define QUEUE_CONSUMER_TICKS    5       //Between pops
+
+unsigned char popQueueFrame(unsigned int frame, unsigned int *ptrOffset);
+
+tBusTestLink link;
+unsigned char *ptrPayloads;
+unsigned int *ptrLengths;
+unsigned char *ptrFormats;
+unsigned int popBad;
+
+//Pops the next descriptor and checks it and its bytes against frame. 0 if the queue was empty
+unsigned char popQueueFrame(unsigned int frame, unsigned int *ptrOffset) {
+    tBusDecodedFrame decodedFrame;
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    eBufferOperationStatus bufferStatus;
+    unsigned int i;
+
+    if(!popDecodedFrameCtx(&link.handler, &decodedFrame)) {
+        return 0;
+    }
+    for(i = 0; i < decodedFrame.length; i++) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&link.applicationBuffer, &bufferStatus, &decoded[i < sizeof(decoded) ? i : 0]);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+    }
+    if((i != decodedFrame.length || decodedFrame.sequence != frame || decodedFrame.offset != *ptrOffset ||
+            decodedFrame.length != getBusTestPaddedLength(ptrLengths[frame], ptrFormats[frame]) ||
+            memcmp(&decoded[0], ptrPayloads + frame * QUEUE_MAX_LENGTH, ptrLengths[frame]) != 0) && popBad++ < 5) {
+        checkBusTest(0, "frame %u: sequence %u, offset %u (expected %u), %u bytes of %u", frame, decodedFrame.sequence,
+                decodedFrame.offset, *ptrOffset, decodedFrame.length, ptrLengths[frame]);
+    }
+    *ptrOffset += decodedFrame.length;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 1 ? (unsigned int)atoi(argv[1]) : QUEUE_DEFAULT_FRAMES;
+    unsigned char *ptrWire;
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus = BUS_HANDLER_RUN_NONE;
+    unsigned int seed = 61;
+    unsigned int wireLength = 0;
+    unsigned int position = 0;
+    unsigned int accepted;
+    unsigned int chunk;
+    unsigned int frame;
+    unsigned int popped = 0;
+    unsigned int offset = 0;
+    unsigned int maxQueued = 0;
+    unsigned int pushBacks = 0;
+    unsigned long tick;
+
+    if(frames < 2 * HANDLER_DECODED_QUEUE_SIZE) {
+        frames = 2 * HANDLER_DECODED_QUEUE_SIZE;
+    }
+    ptrPayloads = malloc((size_t)frames * QUEUE_MAX_LENGTH);
+    ptrLengths = malloc((size_t)frames * sizeof(unsigned int));
+    ptrFormats = malloc(frames);
+    ptrWire = malloc((size_t)frames * QUEUE_WIRE_PER_FRAME);
+    if(ptrPayloads == 0 || ptrLengths == 0 || ptrFormats == 0 || ptrWire == 0) {
+        return 1;
+    }
+    for(frame = 0; frame < frames; frame++) {
+        ptrLengths[frame] = 1 + getBusTestRandom(&seed) % QUEUE_MAX_LENGTH;
+        ptrFormats[frame] = frame % 3 == 0 ? BUS_FRAME_FORMAT_DENSE : 0;
+        fillBusTestPayload(ptrPayloads + frame * QUEUE_MAX_LENGTH, ptrLengths[frame], &seed);
+        wireLength += encodeBusFrame(ptrPayloads + frame * QUEUE_MAX_LENGTH, ptrLengths[frame], ptrFormats[frame],
+                ptrWire + wireLength, QUEUE_WIRE_PER_FRAME);
+    }
+    initialiseBusTestLink(&link);
+
+    //Burst: nobody pops until the handler stops
+    while(position < wireLength) {
+        accepted = 0;
+        putBytesForHandlingCtx(&link.handler, &putStatus, ptrWire + position, wireLength - position, &accepted);
+        position += accepted;
+        runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 256);
+        if(runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION) {
+            break;
+        }
+    }
+    checkBusTest(runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION, "burst: handler didn't wait for the application, run status %u", runStatus);
+    checkBusTest(getDecodedFrameCountCtx(&link.handler) == HANDLER_DECODED_QUEUE_SIZE, "burst: %u frames queued, expected %u",
+            getDecodedFrameCountCtx(&link.handler), HANDLER_DECODED_QUEUE_SIZE);
+    checkBusTest(link.applicationListener, "burst: application listener not raised");
+    runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 256);
+    checkBusTest(getDecodedFrameCountCtx(&link.handler) == HANDLER_DECODED_QUEUE_SIZE, "burst: queue moved with nothing popped");
+    while(popQueueFrame(popped, &offset)) {
+        popped++;
+    }
+    checkBusTest(popped == HANDLER_DECODED_QUEUE_SIZE, "burst: popped %u frames", popped);
+    checkBusTest(!link.applicationListener, "burst: application listener still up with the queue empty");
+
+    //Trickle against a lagging consumer, picking up where the burst stopped
+    for(tick = 0; popped < frames && tick < 100UL * frames; tick++) {
+        if(position < wireLength) {
+            chunk = wireLength - position < QUEUE_UART_BYTES ? wireLength - position : QUEUE_UART_BYTES;
+            accepted = 0;
+            putBytesForHandlingCtx(&link.handler, &putStatus, ptrWire + position, chunk, &accepted);
+            position += accepted;
+            if(accepted < chunk) {
+                pushBacks++;
+            }
+        }
+        runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 256);
+        if(getDecodedFrameCountCtx(&link.handler) > maxQueued) {
+            maxQueued = getDecodedFrameCountCtx(&link.handler);
+        }
+        if(tick % QUEUE_CONSUMER_TICKS == 0 && popQueueFrame(popped, &offset)) {
+            popped++;
+        }
+    }
+    checkBusTest(popped == frames, "trickle: %u of %u frames popped", popped, frames);
+    checkBusTest(popBad == 0, "%u frames came out wrong", popBad);
+    checkBusTest(maxQueued == HANDLER_DECODED_QUEUE_SIZE, "trickle: queue peaked at %u, the consumer never fell behind", maxQueued);
+    checkBusTest(pushBacks > 0, "trickle: the inbound ring never pushed back");
+    checkBusTest(getDecodedFrameCountCtx(&link.handler) == 0 && !link.applicationListener, "trickle: frames left over");
+
+    free(ptrPayloads);
+    free(ptrLengths);
+    free(ptrFormats);
+    free(ptrWire);
+    return finishBusTest("test_decoded_queue");
+}
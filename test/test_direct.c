@@ -0,0 +1,130 @@
+/*
+ * File:   test_direct.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:50
+ *
+ * writeBusFrameDirect and encodeBusFrame against the queued path: for every
+ * length the writer takes, block and dense, the three have to put the same
+ * bytes on the wire. Queued and direct frames are then mixed on one writer
+ * in a random order, so neither leaves state behind that changes the other,
+ * and the lot has to decode in order. On SEND_BUFFER_SIZE, which is all the
+ * room the direct path gets for a whole frame.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#define DIRECT_MIXED_FRAMES     200
+#define DIRECT_MIXED_MAX_LENGTH MAX_UNPACKED_PAYLOAD
+
+void initialiseDirectLink(void);
+unsigned int writeDirectFrame(const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize);
+unsigned int getNextLength(unsigned int length);
+void testSameBytes(unsigned char format);
+void testMixed(void);
+
+tBusTestLink link;
+unsigned char sendArray[SEND_BUFFER_SIZE];
+unsigned char payload[FRAME_WRITER_MAX_PAYLOAD];
+unsigned char queuedWire[SEND_BUFFER_SIZE];
+unsigned char directWire[SEND_BUFFER_SIZE];
+unsigned char encodedWire[SEND_BUFFER_SIZE];
+unsigned char mixedWire[DIRECT_MIXED_FRAMES * MAX_FRAME_SIZE];
+unsigned char decoded[DIRECT_MIXED_FRAMES * DIRECT_MIXED_MAX_LENGTH];
+unsigned int decodedLengths[DIRECT_MIXED_FRAMES];
+unsigned int mixedLengths[DIRECT_MIXED_FRAMES];
+unsigned char mixedFormats[DIRECT_MIXED_FRAMES];
+
+void initialiseDirectLink(void) {
+    initialiseBusTestLink(&link);
+    initialiseBuffer(&link.sendBuffer, &sendArray[0], SEND_BUFFER_SIZE);
+}
+
+//Returns the wire bytes, 0 if the writer refused it
+unsigned int writeDirectFrame(const unsigned char *ptrPayload, unsigned int length, unsigned char format, unsigned char *ptrWire, unsigned int wireSize) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    writeBusFrameDirectCtx(&link.writer, &status, ptrPayload, length, format);
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    return collectBusTestWire(&link, ptrWire, wireSize);
+}
+
+//Every length up to two legacy frames, then a spread so a jumbo build doesn't take all day. Always ends on FRAME_WRITER_MAX_PAYLOAD
+unsigned int getNextLength(unsigned int length) {
+    if(length < 2 * MAX_UNPACKED_PAYLOAD) {
+        return length + 1;
+    }
+    if(length < FRAME_WRITER_MAX_PAYLOAD && length + 89 > FRAME_WRITER_MAX_PAYLOAD) {
+        return FRAME_WRITER_MAX_PAYLOAD;
+    }
+    return length + 89;
+}
+
+void testSameBytes(unsigned char format) {
+    unsigned int queuedLength;
+    unsigned int directLength;
+    unsigned int encodedLength;
+    unsigned int length;
+
+    initialiseDirectLink();
+    for(length = 1; length <= FRAME_WRITER_MAX_PAYLOAD; length = getNextLength(length)) {
+        queuedLength = writeBusTestFrame(&link, &payload[0], length, format, &queuedWire[0], sizeof(queuedWire));
+        directLength = writeDirectFrame(&payload[0], length, format, &directWire[0], sizeof(directWire));
+        encodedLength = encodeBusFrame(&payload[0], length, format, &encodedWire[0], sizeof(encodedWire));
+        checkBusTest(queuedLength > 0 && queuedLength == getEncodedBusFrameSize(length, format), "format %02X length %u: queued %u bytes, getEncodedBusFrameSize %u",
+                format, length, queuedLength, getEncodedBusFrameSize(length, format));
+        checkBusTest(directLength == queuedLength && memcmp(&directWire[0], &queuedWire[0], queuedLength) == 0,
+                "format %02X length %u: direct %u bytes, queued %u, not the same", format, length, directLength, queuedLength);
+        checkBusTest(encodedLength == queuedLength && memcmp(&encodedWire[0], &queuedWire[0], queuedLength) == 0,
+                "format %02X length %u: encodeBusFrame %u bytes, queued %u, not the same", format, length, encodedLength, queuedLength);
+    }
+}
+
+void testMixed(void) {
+    unsigned int seed = 73;
+    unsigned int wireLength = 0;
+    unsigned int offset = 0;
+    unsigned int written;
+    unsigned int frames;
+    unsigned int frame;
+    unsigned char direct;
+
+    initialiseDirectLink();
+    for(frame = 0; frame < DIRECT_MIXED_FRAMES; frame++) {
+        mixedLengths[frame] = 1 + getBusTestRandom(&seed) % DIRECT_MIXED_MAX_LENGTH;
+        mixedFormats[frame] = (getBusTestRandom(&seed) & 1) ? BUS_FRAME_FORMAT_DENSE : 0;
+        direct = getBusTestRandom(&seed) & 1;
+        payload[0] = (unsigned char)frame;
+        if(direct) {
+            written = writeDirectFrame(&payload[0], mixedLengths[frame], mixedFormats[frame], &mixedWire[wireLength], sizeof(mixedWire) - wireLength);
+        } else {
+            written = writeBusTestFrame(&link, &payload[0], mixedLengths[frame], mixedFormats[frame], &mixedWire[wireLength], sizeof(mixedWire) - wireLength);
+        }
+        checkBusTest(written == getEncodedBusFrameSize(mixedLengths[frame], mixedFormats[frame]), "mixed frame %u (%s, %u bytes): %u bytes sent",
+                frame, direct ? "direct" : "queued", mixedLengths[frame], written);
+        wireLength += written;
+    }
+
+    frames = readBusTestFrames(&link, &mixedWire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLengths[0], DIRECT_MIXED_FRAMES);
+    checkBusTest(frames == DIRECT_MIXED_FRAMES, "mixed: %u frames out, %u in", frames, DIRECT_MIXED_FRAMES);
+    for(frame = 0; frame < frames && frame < DIRECT_MIXED_FRAMES; frame++) {
+        checkBusTest(decodedLengths[frame] == getBusTestPaddedLength(mixedLengths[frame], mixedFormats[frame]) && decoded[offset] == (unsigned char)frame &&
+                memcmp(&decoded[offset + 1], &payload[1], mixedLengths[frame] - 1) == 0,
+                "mixed frame %u: %u bytes back, sequence %u", frame, decodedLengths[frame], decoded[offset]);
+        offset += decodedLengths[frame];
+    }
+}
+
+int main(void) {
+    unsigned int seed = 79;
+
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+    testSameBytes(0);
+    testSameBytes(BUS_FRAME_FORMAT_DENSE);
+    testMixed();
+    return finishBusTest("test_direct");
+}
@@ -0,0 +1,190 @@
+/*
+ * File:   test_dispatch.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:00
+ *
+ * Routing by message type (HANDLER_DISPATCH_ENABLED), over a random mix of
+ * legacy block, jumbo block and dense frames. A subscribed type comes to its
+ * handler with the staged payload, the staging pointer and the length the
+ * application buffer would have had, and never reaches the application. One
+ * bigger than HANDLER_DISPATCH_STAGING_SIZE goes to the application buffer
+ * like any other frame, as do unsubscribed types unless early drop is on. With
+ * early drop they go nowhere but are still CRC checked: corrupt copies of
+ * every kind are counted as CRC failures and nothing is delivered for them.
+ * Built against bus_frame_dispatch, whose staging holds 192 bytes so some
+ * jumbo frames are dispatched and some fall back.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bus_test.h"
+
+#if !HANDLER_DISPATCH_ENABLED || !BUS_FRAME_STATS_ENABLED
+#error test_dispatch needs a library built with HANDLER_DISPATCH_ENABLED and BUS_FRAME_STATS_ENABLED
+#endif
+
+#define DISPATCH_FRAMES         300
+#define DISPATCH_MAX_LENGTH     (2 * HANDLER_DISPATCH_STAGING_SIZE)
+#define DISPATCH_TYPE_SENSOR    0x10
+#define DISPATCH_TYPE_STATUS    0x20
+#define DISPATCH_TYPE_OTHER     0x30
+#define DISPATCH_WIRE_SIZE      (DISPATCH_FRAMES * (7 + (DISPATCH_MAX_LENGTH / 6 + 1) * 8))
+
+typedef struct {
+    unsigned char messageType;
+    unsigned int length;
+    unsigned int frame;
+    unsigned char stagedPointer;
+    unsigned char payloadMatches;
+} tDispatchRecord;
+
+void recordDispatch(unsigned char messageType, const unsigned char *ptrPayload, unsigned int length);
+unsigned int addDispatchFrame(unsigned int frame, unsigned char messageType, unsigned int length, unsigned char format, unsigned char corrupt);
+void testRouting(unsigned char earlyDrop);
+
+tBusTestLink link;
+tDispatchRecord records[DISPATCH_FRAMES];
+unsigned int recordCount;
+unsigned char payloads[DISPATCH_FRAMES][DISPATCH_MAX_LENGTH];
+unsigned int lengths[DISPATCH_FRAMES];
+unsigned char formats[DISPATCH_FRAMES];
+unsigned char wire[DISPATCH_WIRE_SIZE];
+unsigned int wireLength;
+unsigned char decoded[DISPATCH_FRAMES * DISPATCH_MAX_LENGTH];
+unsigned int decodedLengths[DISPATCH_FRAMES];
+
+//Payload byte 1 carries the frame number so a record can be matched up with what was sent
+void recordDispatch(unsigned char messageType, const unsigned char *ptrPayload, unsigned int length) {
+    tDispatchRecord *ptrRecord;
+    unsigned int frame = ptrPayload[1] | (ptrPayload[2] << 8);
+
+    if(recordCount >= DISPATCH_FRAMES) {
+        recordCount++;
+        return;
+    }
+    ptrRecord = &records[recordCount++];
+    ptrRecord->messageType = messageType;
+    ptrRecord->length = length;
+    ptrRecord->frame = frame;
+    ptrRecord->stagedPointer = ptrPayload == &link.handler.dispatchStaging[0];
+    ptrRecord->payloadMatches = frame < DISPATCH_FRAMES && length <= DISPATCH_MAX_LENGTH && memcmp(ptrPayload, &payloads[frame][0], lengths[frame]) == 0;
+}
+
+//Encodes the frame onto the end of the wire, a corrupt one with its last block's CRC (block) or its frame CRC (dense) flipped. Returns the wire bytes added
+unsigned int addDispatchFrame(unsigned int frame, unsigned char messageType, unsigned int length, unsigned char format, unsigned char corrupt) {
+    unsigned int added;
+    unsigned int seed = frame * 7 + 1;
+
+    fillBusTestPayload(&payloads[frame][0], length, &seed);
+    payloads[frame][0] = messageType;
+    payloads[frame][1] = (unsigned char)frame;
+    payloads[frame][2] = (unsigned char)(frame >> 8);
+    lengths[frame] = length;
+    formats[frame] = format;
+    added = encodeBusFrame(&payloads[frame][0], length, format, &wire[wireLength], sizeof(wire) - wireLength);
+    if(corrupt) {
+        wire[wireLength + added - ((format & BUS_FRAME_FORMAT_DENSE) ? 3 : 2 + 8 - 1)] ^= 1;
+    }
+    wireLength += added;
+    return added;
+}
+
+void testRouting(unsigned char earlyDrop) {
+    unsigned char types[] = {DISPATCH_TYPE_SENSOR, DISPATCH_TYPE_STATUS, DISPATCH_TYPE_OTHER};
+    unsigned char expectDispatch[DISPATCH_FRAMES];
+    unsigned char expectApplication[DISPATCH_FRAMES];
+    unsigned char corrupt[DISPATCH_FRAMES];
+    tBusFrameHandlerStats stats;
+    const char *ptrName = earlyDrop ? "early drop" : "no early drop";
+    unsigned int seed = earlyDrop ? 83 : 89;
+    unsigned int corruptCount = 0;
+    unsigned int goodCount = 0;
+    unsigned int dispatched = 0;
+    unsigned int applicationFrames = 0;
+    unsigned int fallbacks = 0;
+    unsigned int jumboDispatched = 0;
+    unsigned int offset = 0;
+    unsigned int frames;
+    unsigned int frame;
+    unsigned int next;
+    unsigned int length;
+    unsigned char messageType;
+    unsigned char format;
+    unsigned char subscribed;
+
+    initialiseBusTestLink(&link);
+    registerBusFrameDispatchCtx(&link.handler, DISPATCH_TYPE_SENSOR, recordDispatch);
+    registerBusFrameDispatchCtx(&link.handler, DISPATCH_TYPE_STATUS, recordDispatch);
+    setBusFrameEarlyDropCtx(&link.handler, earlyDrop);
+    recordCount = 0;
+    wireLength = 0;
+
+    for(frame = 0; frame < DISPATCH_FRAMES; frame++) {
+        messageType = types[getBusTestRandom(&seed) % sizeof(types)];
+        format = (getBusTestRandom(&seed) & 1) ? BUS_FRAME_FORMAT_DENSE : 0;
+        //Past one legacy block so a corrupt last block comes after the type byte has picked the route
+        length = 7 + getBusTestRandom(&seed) % (DISPATCH_MAX_LENGTH - 6);
+        corrupt[frame] = getBusTestRandom(&seed) % 8 == 0;
+        addDispatchFrame(frame, messageType, length, format, corrupt[frame]);
+        subscribed = messageType != DISPATCH_TYPE_OTHER;
+        expectDispatch[frame] = !corrupt[frame] && subscribed && getBusTestPaddedLength(length, format) <= HANDLER_DISPATCH_STAGING_SIZE;
+        expectApplication[frame] = !corrupt[frame] && !expectDispatch[frame] && (subscribed || !earlyDrop);
+        corruptCount += corrupt[frame];
+        goodCount += !corrupt[frame];
+        fallbacks += !corrupt[frame] && subscribed && !expectDispatch[frame];
+        jumboDispatched += expectDispatch[frame] && length > MAX_UNPACKED_PAYLOAD;
+    }
+    checkBusTest(fallbacks > 0 && jumboDispatched > 0 && corruptCount > 0, "%s: the mix has %u fallbacks, %u jumbo frames dispatched, %u corrupt",
+            ptrName, fallbacks, jumboDispatched, corruptCount);
+
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLengths[0], DISPATCH_FRAMES);
+
+    //Dispatched frames in the order they were sent, each with its own payload in the staging buffer
+    next = 0;
+    for(frame = 0; frame < DISPATCH_FRAMES; frame++) {
+        if(!expectDispatch[frame]) {
+            continue;
+        }
+        if(next < recordCount && next < DISPATCH_FRAMES) {
+            checkBusTest(records[next].frame == frame && records[next].messageType == payloads[frame][0] &&
+                    records[next].length == getBusTestPaddedLength(lengths[frame], formats[frame]) && records[next].stagedPointer && records[next].payloadMatches,
+                    "%s: dispatch %u was frame %u type %02X %u bytes (staged %u, payload %u), expected frame %u type %02X %u bytes", ptrName, next,
+                    records[next].frame, records[next].messageType, records[next].length, records[next].stagedPointer, records[next].payloadMatches,
+                    frame, payloads[frame][0], getBusTestPaddedLength(lengths[frame], formats[frame]));
+        }
+        next++;
+    }
+    dispatched = next;
+    checkBusTest(recordCount == dispatched, "%s: %u frames dispatched, expected %u", ptrName, recordCount, dispatched);
+
+    //Everything else that should reach the application, in order, nothing that was dispatched or dropped
+    next = 0;
+    for(frame = 0; frame < DISPATCH_FRAMES; frame++) {
+        if(!expectApplication[frame]) {
+            continue;
+        }
+        if(next < frames && next < DISPATCH_FRAMES) {
+            checkBusTest(decodedLengths[next] == getBusTestPaddedLength(lengths[frame], formats[frame]) &&
+                    memcmp(&decoded[offset], &payloads[frame][0], lengths[frame]) == 0,
+                    "%s: application frame %u was %u bytes type %02X, expected frame %u type %02X %u bytes", ptrName, next, decodedLengths[next],
+                    decoded[offset], frame, payloads[frame][0], getBusTestPaddedLength(lengths[frame], formats[frame]));
+            offset += decodedLengths[next];
+        }
+        next++;
+    }
+    applicationFrames = next;
+    checkBusTest(frames == applicationFrames, "%s: %u frames reached the application, expected %u", ptrName, frames, applicationFrames);
+
+    //Dropped frames are decoded all the same, and their CRCs checked
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    checkBusTest(stats.framesDecoded == goodCount, "%s: %lu frames decoded, %u good ones sent", ptrName, stats.framesDecoded, goodCount);
+    checkBusTest(stats.crcFailures == corruptCount && stats.errorCounts[BHE_CRC_FAILED] == corruptCount, "%s: %lu CRC failures, %lu CRC_FAILED, %u corrupt frames sent",
+            ptrName, stats.crcFailures, stats.errorCounts[BHE_CRC_FAILED], corruptCount);
+}
+
+int main(void) {
+    testRouting(0);
+    testRouting(1);
+    return finishBusTest("test_dispatch");
+}
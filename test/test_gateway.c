@@ -0,0 +1,270 @@
+/*
+ * File:   test_gateway.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 04:10
+ *
+ * bus_gateway end to end over two pty pairs standing in for serial buses.
+ * Frames written to each pty's master have to come out of the socket
+ * tagged with their port, with the write to delivery latency reported per
+ * port. Frames sent from the socket, with stray format bits set, have to
+ * reach the right master exactly as encodeBusFrame makes them. Then port 1's
+ * master is closed: the gateway must mark it down, refuse the next frame
+ * for it, and keep port 0 working.
+ *
+ *   test_gateway <bus_gateway binary> [frames per port]
+ *
+ * Exits 77 (skipped) when the system has no ptys to hand out.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include "bus_test.h"
+
+#define GATEWAY_TEST_PORTS          2
+#define GATEWAY_TEST_DEFAULT_FRAMES 200
+#define GATEWAY_TEST_MAX_LENGTH     300
+#define GATEWAY_TEST_TIMEOUT_MS     3000
+#define GATEWAY_TEST_SKIPPED        77
+#define GATEWAY_TEST_LOG_SIZE       8192
+
+typedef struct {
+    int master;
+    int slave;
+    char path[64];
+    unsigned long frames;
+    unsigned long latencyTotalUs;
+    unsigned long latencyMaxUs;
+} tGatewayTestPort;
+
+int openTestPty(tGatewayTestPort *ptrPort);
+int connectGateway(const char *ptrPath);
+int readGatewayLog(const char *ptrText, int timeoutMs);
+int receiveGatewayFrame(int client, unsigned char *ptrMessage, unsigned int size);
+unsigned int readMasterFrame(int master, unsigned char *ptrWire, unsigned int expected);
+void checkInbound(int client, unsigned int port, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+void checkOutbound(int client, unsigned int port, const unsigned char *ptrPayload, unsigned int length, unsigned char format);
+
+tGatewayTestPort testPorts[GATEWAY_TEST_PORTS];
+int gatewayLog = -1;
+char gatewayLogText[GATEWAY_TEST_LOG_SIZE];
+unsigned int gatewayLogLength;
+
+//Raw from the start, so nothing written before the gateway is up gets cooked. Close on exec, or the gateway would hold the master open too
+int openTestPty(tGatewayTestPort *ptrPort) {
+    struct termios tio;
+
+    ptrPort->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(ptrPort->master < 0 || fcntl(ptrPort->master, F_SETFD, FD_CLOEXEC) < 0 || grantpt(ptrPort->master) < 0 || unlockpt(ptrPort->master) < 0 ||
+            ptsname_r(ptrPort->master, ptrPort->path, sizeof(ptrPort->path)) != 0) {
+        return -1;
+    }
+    ptrPort->slave = open(ptrPort->path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if(ptrPort->slave < 0 || tcgetattr(ptrPort->slave, &tio) < 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(ptrPort->slave, TCSANOW, &tio);
+    return 0;
+}
+
+int connectGateway(const char *ptrPath) {
+    struct sockaddr_un address;
+    unsigned int attempt;
+    int fd;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, ptrPath, sizeof(address.sun_path) - 1);
+    for(attempt = 0; attempt < 200; attempt++) {
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if(fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+        if(fd >= 0) {
+            close(fd);
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+//Collects the gateway's stderr until ptrText turns up in it or the time runs out. 0 if it never did
+int readGatewayLog(const char *ptrText, int timeoutMs) {
+    struct pollfd waitFor = {gatewayLog, POLLIN, 0};
+    ssize_t length;
+
+    while(strstr(gatewayLogText, ptrText) == 0) {
+        if(gatewayLogLength >= GATEWAY_TEST_LOG_SIZE - 1 || poll(&waitFor, 1, timeoutMs) <= 0) {
+            return 0;
+        }
+        length = read(gatewayLog, &gatewayLogText[gatewayLogLength], GATEWAY_TEST_LOG_SIZE - 1 - gatewayLogLength);
+        if(length <= 0) {
+            return 0;
+        }
+        gatewayLogLength += (unsigned int)length;
+        gatewayLogText[gatewayLogLength] = 0;
+    }
+    return 1;
+}
+
+int receiveGatewayFrame(int client, unsigned char *ptrMessage, unsigned int size) {
+    struct pollfd waitFor = {client, POLLIN, 0};
+    if(poll(&waitFor, 1, GATEWAY_TEST_TIMEOUT_MS) <= 0) {
+        return -1;
+    }
+    return (int)recv(client, ptrMessage, size, 0);
+}
+
+//Reads what the gateway put on a bus until the expected number of bytes is in. Returns how many came
+unsigned int readMasterFrame(int master, unsigned char *ptrWire, unsigned int expected) {
+    struct pollfd waitFor = {master, POLLIN, 0};
+    unsigned int received = 0;
+    ssize_t length;
+
+    while(received < expected && poll(&waitFor, 1, GATEWAY_TEST_TIMEOUT_MS) > 0) {
+        length = read(master, ptrWire + received, expected - received);
+        if(length <= 0) {
+            break;
+        }
+        received += (unsigned int)length;
+    }
+    return received;
+}
+
+void checkInbound(int client, unsigned int port, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    unsigned char wire[GATEWAY_TEST_MAX_LENGTH * 2];
+    unsigned char message[1 + GATEWAY_TEST_MAX_LENGTH + 6];
+    unsigned int wireLength = encodeBusFrame(ptrPayload, length, format, &wire[0], sizeof(wire));
+    unsigned long startUs = getBusTestMicroseconds();
+    unsigned long latencyUs;
+    int received;
+
+    checkBusTest(write(testPorts[port].master, &wire[0], wireLength) == (ssize_t)wireLength, "port %u: writing %u bytes to the master failed", port, wireLength);
+    received = receiveGatewayFrame(client, &message[0], sizeof(message));
+    latencyUs = getBusTestMicroseconds() - startUs;
+    checkBusTest(received == (int)(1 + getBusTestPaddedLength(length, format)) && message[0] == port &&
+            memcmp(&message[1], ptrPayload, length) == 0, "port %u: %u byte frame came out as %d bytes for port %u", port, length, received, message[0]);
+    testPorts[port].frames++;
+    testPorts[port].latencyTotalUs += latencyUs;
+    if(latencyUs > testPorts[port].latencyMaxUs) {
+        testPorts[port].latencyMaxUs = latencyUs;
+    }
+}
+
+void checkOutbound(int client, unsigned int port, const unsigned char *ptrPayload, unsigned int length, unsigned char format) {
+    unsigned char message[2 + GATEWAY_TEST_MAX_LENGTH];
+    unsigned char clean[GATEWAY_TEST_MAX_LENGTH * 2];
+    unsigned char wire[GATEWAY_TEST_MAX_LENGTH * 2];
+    unsigned int cleanLength = encodeBusFrame(ptrPayload, length, format & BUS_FRAME_FORMAT_KNOWN, &clean[0], sizeof(clean));
+    unsigned int wireLength;
+
+    message[0] = (unsigned char)port;
+    message[1] = format;
+    memcpy(&message[2], ptrPayload, length);
+    checkBusTest(send(client, &message[0], 2 + length, 0) == (ssize_t)(2 + length), "port %u: sending %u bytes to the gateway failed", port, length);
+    wireLength = readMasterFrame(testPorts[port].master, &wire[0], cleanLength);
+    checkBusTest(wireLength == cleanLength && memcmp(&wire[0], &clean[0], cleanLength) == 0,
+            "port %u: format %02X, %u byte frame came out as %u wire bytes, expected %u", port, format, length, wireLength, cleanLength);
+}
+
+int main(int argc, char **argv) {
+    unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : GATEWAY_TEST_DEFAULT_FRAMES;
+    unsigned char payload[GATEWAY_TEST_MAX_LENGTH];
+    unsigned char message[2 + GATEWAY_TEST_MAX_LENGTH];
+    char socketPath[64];
+    char expected[128];
+    int logPipe[2];
+    unsigned int seed = 71;
+    unsigned int frame;
+    unsigned int port;
+    unsigned int length;
+    unsigned char format;
+    pid_t gateway;
+    int client;
+    int status;
+
+    if(argc < 2) {
+        printf("usage: %s <bus_gateway binary> [frames per port]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    for(port = 0; port < GATEWAY_TEST_PORTS; port++) {
+        if(openTestPty(&testPorts[port]) < 0) {
+            printf("test_gateway: skipped, no ptys (%s)\n", strerror(errno));
+            return GATEWAY_TEST_SKIPPED;
+        }
+    }
+    snprintf(socketPath, sizeof(socketPath), "/tmp/test_gateway.%d.sock", (int)getpid());
+    if(pipe2(logPipe, O_CLOEXEC) < 0) {
+        return 1;
+    }
+    gateway = fork();
+    if(gateway == 0) {
+        dup2(logPipe[1], STDERR_FILENO);
+        close(logPipe[0]);
+        execl(argv[1], argv[1], socketPath, testPorts[0].path, testPorts[1].path, (char *)0);
+        _exit(127);
+    }
+    close(logPipe[1]);
+    gatewayLog = logPipe[0];
+    client = connectGateway(socketPath);
+    if(gateway < 0 || client < 0) {
+        printf("test_gateway: couldn't start %s\n", argv[1]);
+        if(gateway > 0) {
+            kill(gateway, SIGKILL);
+        }
+        return 1;
+    }
+
+    for(frame = 0; frame < frames; frame++) {
+        port = frame % GATEWAY_TEST_PORTS;
+        length = 1 + getBusTestRandom(&seed) % GATEWAY_TEST_MAX_LENGTH;
+        format = frame % 3 == 0 ? BUS_FRAME_FORMAT_DENSE : 0;
+        fillBusTestPayload(&payload[0], length, &seed);
+        checkInbound(client, port, &payload[0], length, format);
+        //Bits a client has no business setting ride along on every other frame, the gateway has to drop them
+        checkOutbound(client, port, &payload[0], length, format | (frame % 2 ? BUS_FRAME_FORMAT_COMPRESSED | BUS_FRAME_FORMAT_ACK_REQUEST : 0));
+    }
+    for(port = 0; port < GATEWAY_TEST_PORTS; port++) {
+        printf("port %u: %lu frames in, latency avg %.1f us max %lu us\n", port, testPorts[port].frames,
+                testPorts[port].frames ? (double)testPorts[port].latencyTotalUs / testPorts[port].frames : 0.0, testPorts[port].latencyMaxUs);
+    }
+
+    //Port 1's bus goes away
+    close(testPorts[1].slave);
+    close(testPorts[1].master);
+    snprintf(expected, sizeof(expected), "port 1 %s: down", testPorts[1].path);
+    checkBusTest(readGatewayLog(expected, GATEWAY_TEST_TIMEOUT_MS), "gateway never marked port 1 down");
+    message[0] = 1;
+    message[1] = 0;
+    message[2] = 0x55;
+    checkBusTest(send(client, &message[0], 3, 0) == 3, "sending to the down port failed");
+    fillBusTestPayload(&payload[0], 40, &seed);
+    checkInbound(client, 0, &payload[0], 40, 0);
+    checkOutbound(client, 0, &payload[0], 40, 0);
+
+    kill(gateway, SIGTERM);
+    snprintf(expected, sizeof(expected), "port 1 %s: down, in", testPorts[1].path);
+    checkBusTest(readGatewayLog(expected, GATEWAY_TEST_TIMEOUT_MS), "final report doesn't show port 1 down");
+    checkBusTest(readGatewayLog("(1 refused)", GATEWAY_TEST_TIMEOUT_MS), "frame for the down port wasn't refused");
+    checkBusTest(waitpid(gateway, &status, 0) == gateway && WIFEXITED(status) && WEXITSTATUS(status) == 0, "gateway didn't exit cleanly");
+    if(busTestFailures) {
+        printf("gateway log:\n%s", gatewayLogText);
+    }
+    close(client);
+    close(testPorts[0].slave);
+    close(testPorts[0].master);
+    return finishBusTest("test_gateway");
+}
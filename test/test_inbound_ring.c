@@ -0,0 +1,197 @@
+/*
+ * File:   test_inbound_ring.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 02:10
+ *
+ * Two thread stress of the inbound SPSC ring: a producer thread puts random
+ * sized chunks (bigger than the ring too) while the main thread consumes.
+ * First on the bare ring with a counting byte pattern, any lost, repeated or
+ * torn byte breaks the sequence; then through putBytesForHandlingCtx with
+ * the handler decoding on the consumer side, where every frame has to come
+ * out whole and in order.
+ *
+ *   test_inbound_ring [ring bytes] [frames]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bus_test.h"
+#include "../bus_inbound_ring.h"
+
+#define RING_DEFAULT_BYTES      4000000
+#define RING_DEFAULT_FRAMES     20000
+#define RING_MAX_CHUNK          (2 * HANDLER_INBOUND_RING_SIZE + 3)
+#define RING_MAX_LENGTH         40
+#define RING_WIRE_PER_FRAME     (2 + ((RING_MAX_LENGTH + 5) / 6) * 8 + 2)
+
+typedef struct {
+    tBusInboundRing *ptrRing;
+    tBusFrameHandlerCtx *ptrHandler;
+    const unsigned char *ptrWire;
+    unsigned int length;
+    unsigned int overAccepted;
+    volatile unsigned char done;
+} tRingProducer;
+
+void *produceRingPattern(void *ptrArgument);
+void *produceHandlerWire(void *ptrArgument);
+unsigned char getRingPatternByte(unsigned int index);
+
+tBusTestLink link;
+tBusInboundRing ring;
+
+//Not just the low byte of the index, so a wrap that lands on the wrong lap still shows
+unsigned char getRingPatternByte(unsigned int index) {
+    return (unsigned char)(index ^ (index >> 8) ^ (index >> 16));
+}
+
+void *produceRingPattern(void *ptrArgument) {
+    tRingProducer *ptrProducer = ptrArgument;
+    unsigned char chunk[RING_MAX_CHUNK];
+    unsigned int seed = 21;
+    unsigned int position = 0;
+    unsigned int length;
+    unsigned int accepted;
+    unsigned int i;
+
+    while(position < ptrProducer->length) {
+        length = 1 + getBusTestRandom(&seed) % RING_MAX_CHUNK;
+        if(length > ptrProducer->length - position) {
+            length = ptrProducer->length - position;
+        }
+        for(i = 0; i < length; i++) {
+            chunk[i] = getRingPatternByte(position + i);
+        }
+        accepted = putBusInboundBytes(ptrProducer->ptrRing, &chunk[0], length);
+        if(accepted > length) {
+            ptrProducer->overAccepted++;
+            accepted = length;
+        }
+        position += accepted;
+        if(accepted == 0) {
+            sched_yield();
+        }
+    }
+    ptrProducer->done = 1;
+    return 0;
+}
+
+void *produceHandlerWire(void *ptrArgument) {
+    tRingProducer *ptrProducer = ptrArgument;
+    eBusHandlerOperationStatus status;
+    unsigned int seed = 22;
+    unsigned int position = 0;
+    unsigned int length;
+    unsigned int accepted;
+
+    while(position < ptrProducer->length) {
+        length = 1 + getBusTestRandom(&seed) % RING_MAX_CHUNK;
+        if(length > ptrProducer->length - position) {
+            length = ptrProducer->length - position;
+        }
+        accepted = 0;
+        putBytesForHandlingCtx(ptrProducer->ptrHandler, &status, ptrProducer->ptrWire + position, length, &accepted);
+        if(accepted > length || (status == BUS_HANDLER_OPERATION_OK) != (accepted == length)) {
+            ptrProducer->overAccepted++;
+            accepted = accepted > length ? length : accepted;
+        }
+        position += accepted;
+        if(accepted < length) {
+            sched_yield();
+        }
+    }
+    ptrProducer->done = 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned int ringBytes = argc > 1 ? (unsigned int)atoi(argv[1]) : RING_DEFAULT_BYTES;
+    unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : RING_DEFAULT_FRAMES;
+    unsigned char *ptrPayloads = malloc((size_t)frames * RING_MAX_LENGTH);
+    unsigned int *ptrLengths = malloc((size_t)frames * sizeof(unsigned int));
+    unsigned char *ptrWire = malloc((size_t)frames * RING_WIRE_PER_FRAME);
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    tRingProducer producer;
+    pthread_t thread;
+    eBusHandlerRunStatus runStatus = BUS_HANDLER_RUN_NONE;
+    unsigned int seed = 23;
+    unsigned int position = 0;
+    unsigned int wireLength = 0;
+    unsigned int decodedLength;
+    unsigned int frame;
+    unsigned int broken = 0;
+    unsigned char byte;
+
+    if(ptrPayloads == 0 || ptrLengths == 0 || ptrWire == 0) {
+        return 1;
+    }
+
+    //Bare ring
+    initialiseBusInboundRing(&ring);
+    memset(&producer, 0, sizeof(producer));
+    producer.ptrRing = &ring;
+    producer.length = ringBytes;
+    pthread_create(&thread, 0, produceRingPattern, &producer);
+    while(position < ringBytes) {
+        if(!getBusInboundByte(&ring, &byte)) {
+            sched_yield();
+            continue;
+        }
+        if(byte != getRingPatternByte(position) && broken++ < 5) {
+            checkBusTest(0, "ring byte %u is %02X, expected %02X", position, byte, getRingPatternByte(position));
+        }
+        position++;
+    }
+    pthread_join(thread, 0);
+    checkBusTest(broken == 0, "%u of %u ring bytes out of sequence", broken, ringBytes);
+    checkBusTest(producer.overAccepted == 0, "ring accepted more than it was given %u times", producer.overAccepted);
+    checkBusTest(isBusInboundRingEmpty(&ring), "ring not empty after every byte was read");
+    checkBusTest(!getBusInboundByte(&ring, &byte), "ring gave a byte it was never given");
+
+    //Through the handler
+    for(frame = 0; frame < frames; frame++) {
+        ptrLengths[frame] = 1 + getBusTestRandom(&seed) % RING_MAX_LENGTH;
+        fillBusTestPayload(ptrPayloads + frame * RING_MAX_LENGTH, ptrLengths[frame], &seed);
+        wireLength += encodeBusFrame(ptrPayloads + frame * RING_MAX_LENGTH, ptrLengths[frame], 0, ptrWire + wireLength, RING_WIRE_PER_FRAME);
+    }
+    initialiseBusTestLink(&link);
+    memset(&producer, 0, sizeof(producer));
+    producer.ptrHandler = &link.handler;
+    producer.ptrWire = ptrWire;
+    producer.length = wireLength;
+    pthread_create(&thread, 0, produceHandlerWire, &producer);
+    frame = 0;
+    broken = 0;
+    while(frame < frames) {
+        runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, 256);
+        if(link.applicationListener) {
+            decodedLength = drainBusTestApplication(&link, &decoded[0], sizeof(decoded));
+            link.applicationListener = 0;
+            if((decodedLength != getBusTestPaddedLength(ptrLengths[frame], 0) ||
+                    memcmp(&decoded[0], ptrPayloads + frame * RING_MAX_LENGTH, ptrLengths[frame]) != 0) && broken++ < 5) {
+                checkBusTest(0, "frame %u: %u bytes out of %u, or different", frame, decodedLength, ptrLengths[frame]);
+            }
+            frame++;
+            continue;
+        }
+        if(runStatus == BUS_HANDLER_RUN_STARVED) {
+            if(producer.done && isBusInboundRingEmpty(&link.handler.busHandleInboundRing)) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    pthread_join(thread, 0);
+    checkBusTest(frame == frames, "%u of %u frames came out of the handler", frame, frames);
+    checkBusTest(broken == 0, "%u frames damaged between the threads", broken);
+    checkBusTest(producer.overAccepted == 0, "putBytesForHandlingCtx misreported what it took %u times", producer.overAccepted);
+
+    free(ptrPayloads);
+    free(ptrLengths);
+    free(ptrWire);
+    return finishBusTest("test_inbound_ring");
+}
@@ -0,0 +1,348 @@
+/*
+ * File:   test_index.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:30
+ *
+ * host/bus_frame_index.c against a byte at a time SC1/EC2 scan, built once
+ * per marker finder: SSE2 (the x86-64 default), AVX2 (-mavx2, skipped on a
+ * CPU without it) and 64 bit SWAR (BUS_FRAME_INDEX_VECTOR 0). Over random
+ * bytes, noisy wire (frames of every format with garbage between them and
+ * bits flipped) and markers put either side of every vector boundary and in
+ * the tail, indexed in one go and in slices cut at odd offsets and appended,
+ * so markers straddle every kind of chunk boundary. Then the wire cut into
+ * chunks at the index's SC1s, the way bus_decode splits it between threads,
+ * has to decode with decodeBusFrameSpan to exactly the frames of one pass
+ * over the lot. Given bus_decode's path, the noisy wire is written out and
+ * bus_decode's multi-threaded output has to match that one pass as well.
+ *
+ *   test_index [bus_decode]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../host/bus_frame_index.h"
+#include "bus_test.h"
+
+#if BUS_FRAME_INDEX_VECTOR && defined(__AVX2__)
+#define INDEX_TEST_NAME "test_index (AVX2)"
+#elif BUS_FRAME_INDEX_VECTOR && defined(__SSE2__)
+#define INDEX_TEST_NAME "test_index (SSE2)"
+#else
+#define INDEX_TEST_NAME "test_index (SWAR)"
+#endif
+
+#define INDEX_WIRE_SIZE     (512 * 1024)
+#define INDEX_MAX_FRAMES    (INDEX_WIRE_SIZE / 12)
+#define INDEX_MAX_LENGTH    300
+#define INDEX_CHUNK_SIZE    (64 * 1024) //bus_decode's smallest
+#define INDEX_PRINT_BYTES   32          //What bus_decode prints of a payload
+
+typedef struct {
+    unsigned char *ptrPayload;
+    unsigned int *ptrLengths;
+    size_t payloadLength;
+    size_t frameCount;
+} tIndexFrames;
+
+unsigned int makeNoisyWire(unsigned char *ptrWire, unsigned int size, unsigned int *ptrSeed, unsigned char noisy, unsigned int *ptrFrames);
+unsigned int makeBoundaryBytes(unsigned char *ptrBytes, unsigned int size);
+void scanMarkers(const unsigned char *ptrBytes, size_t length);
+void checkIndex(const char *ptrName, const tBusFrameIndex *ptrIndex);
+void testIndex(const char *ptrName, const unsigned char *ptrBytes, size_t length, unsigned int *ptrSeed);
+void decodeIndexSpan(const unsigned char *ptrBytes, size_t length, tIndexFrames *ptrFrames);
+void checkSameFrames(const char *ptrName, const tIndexFrames *ptrGot, const tIndexFrames *ptrExpected);
+void testChunkedDecode(const char *ptrName, const unsigned char *ptrWire, size_t length, unsigned int expectedFrames);
+void testBusDecode(const char *ptrDecoder, const unsigned char *ptrWire, size_t length);
+
+unsigned char bytes[INDEX_WIRE_SIZE];
+size_t scannedStarts[INDEX_WIRE_SIZE];
+size_t scannedEnds[INDEX_WIRE_SIZE];
+size_t scannedStartCount;
+size_t scannedEndCount;
+unsigned char onePassPayload[INDEX_WIRE_SIZE];
+unsigned int onePassLengths[INDEX_MAX_FRAMES];
+unsigned char chunkedPayload[INDEX_WIRE_SIZE];
+unsigned int chunkedLengths[INDEX_MAX_FRAMES];
+tIndexFrames onePass = {&onePassPayload[0], &onePassLengths[0], 0, 0};
+tIndexFrames chunked = {&chunkedPayload[0], &chunkedLengths[0], 0, 0};
+
+//Frames of random length and format back to back. Noisy: up to 20 random bytes between them and about one bit in 2000 flipped. Returns the length
+unsigned int makeNoisyWire(unsigned char *ptrWire, unsigned int size, unsigned int *ptrSeed, unsigned char noisy, unsigned int *ptrFrames) {
+    unsigned char payload[INDEX_MAX_LENGTH];
+    unsigned int length = 0;
+    unsigned int payloadLength;
+    unsigned int garbage;
+    unsigned int i;
+
+    *ptrFrames = 0;
+    while(length + getEncodedBusFrameSize(INDEX_MAX_LENGTH, 0) + 20 < size) {
+        payloadLength = 1 + getBusTestRandom(ptrSeed) % INDEX_MAX_LENGTH;
+        fillBusTestPayload(&payload[0], payloadLength, ptrSeed);
+        length += encodeBusFrame(&payload[0], payloadLength, (getBusTestRandom(ptrSeed) & 1) ? BUS_FRAME_FORMAT_DENSE : 0, &ptrWire[length], size - length);
+        (*ptrFrames)++;
+        if(noisy) {
+            for(garbage = getBusTestRandom(ptrSeed) % 21; garbage > 0; garbage--) {
+                ptrWire[length++] = (unsigned char)getBusTestRandom(ptrSeed);
+            }
+        }
+    }
+    if(noisy) {
+        for(i = 0; i < length / 250; i++) {
+            ptrWire[getBusTestRandom(ptrSeed) % length] ^= (unsigned char)(1 << (getBusTestRandom(ptrSeed) % 8));
+        }
+    }
+    return length;
+}
+
+//Quiet bytes with every kind of marker either side of each 8, 16 and 32 byte boundary, and a run of them in the tail
+unsigned int makeBoundaryBytes(unsigned char *ptrBytes, unsigned int size) {
+    unsigned char markers[] = {0xC3, 0xD3, 0xE3, 0xF3, 0xC0, 0xFF};
+    unsigned int position;
+    unsigned int marker = 0;
+
+    for(position = 0; position < size; position++) {
+        ptrBytes[position] = (unsigned char)(position & 0x3F);
+        //0b10xxxxxx looks like a mask byte, only one top bit so never a marker
+        if(position % 5 == 0) {
+            ptrBytes[position] |= 0x80;
+        }
+        if(position % 8 == 0 || position % 8 == 7 || position % 16 == 15 || position % 32 == 31 || position + 40 > size) {
+            if(position % 3 != 1) {
+                ptrBytes[position] = markers[marker++ % sizeof(markers)];
+            }
+        }
+    }
+    return size;
+}
+
+void scanMarkers(const unsigned char *ptrBytes, size_t length) {
+    size_t position;
+
+    scannedStartCount = 0;
+    scannedEndCount = 0;
+    for(position = 0; position < length; position++) {
+        if((ptrBytes[position] & 0xF0) == 0xC0) {
+            scannedStarts[scannedStartCount++] = position;
+        } else if((ptrBytes[position] & 0xF0) == 0xF0) {
+            scannedEnds[scannedEndCount++] = position;
+        }
+    }
+}
+
+void checkIndex(const char *ptrName, const tBusFrameIndex *ptrIndex) {
+    checkBusTest(ptrIndex->startCount == scannedStartCount && (scannedStartCount == 0 ||
+            memcmp(ptrIndex->ptrStarts, &scannedStarts[0], scannedStartCount * sizeof(size_t)) == 0),
+            "%s: %zu SC1 indexed, %zu scanned, or not at the same offsets", ptrName, ptrIndex->startCount, scannedStartCount);
+    checkBusTest(ptrIndex->endCount == scannedEndCount && (scannedEndCount == 0 ||
+            memcmp(ptrIndex->ptrEnds, &scannedEnds[0], scannedEndCount * sizeof(size_t)) == 0),
+            "%s: %zu EC2 indexed, %zu scanned, or not at the same offsets", ptrName, ptrIndex->endCount, scannedEndCount);
+}
+
+//One pass, then slices of 1 to 100 bytes from wherever the last one stopped, each indexed on its own and appended
+void testIndex(const char *ptrName, const unsigned char *ptrBytes, size_t length, unsigned int *ptrSeed) {
+    tBusFrameIndex index;
+    tBusFrameIndex slice;
+    char name[64];
+    size_t position = 0;
+    size_t sliceLength;
+    size_t start;
+
+    scanMarkers(ptrBytes, length);
+    initialiseBusFrameIndex(&index);
+    checkBusTest(indexBusFrameMarkers(&index, ptrBytes, length, 0) == 0, "%s: out of memory", ptrName);
+    checkIndex(ptrName, &index);
+    start = findBusFrameStart(&index, length / 2);
+    checkBusTest(start == index.startCount || (index.ptrStarts[start] >= length / 2 && (start == 0 || index.ptrStarts[start - 1] < length / 2)),
+            "%s: findBusFrameStart from the middle gave SC1 %zu", ptrName, start);
+    checkBusTest(countBusFrameMarkers(index.ptrStarts, index.startCount, 0, length) == scannedStartCount, "%s: countBusFrameMarkers over the lot", ptrName);
+    freeBusFrameIndex(&index);
+
+    snprintf(name, sizeof(name), "%s in slices", ptrName);
+    initialiseBusFrameIndex(&index);
+    while(position < length) {
+        sliceLength = 1 + getBusTestRandom(ptrSeed) % 100;
+        if(sliceLength > length - position) {
+            sliceLength = length - position;
+        }
+        initialiseBusFrameIndex(&slice);
+        if(indexBusFrameMarkers(&slice, &ptrBytes[position], sliceLength, position) < 0 || appendBusFrameIndex(&index, &slice) < 0) {
+            checkBusTest(0, "%s: out of memory", name);
+        }
+        freeBusFrameIndex(&slice);
+        position += sliceLength;
+    }
+    checkIndex(name, &index);
+    freeBusFrameIndex(&index);
+}
+
+//Like bus_decode's decodeChunk, appending to whatever ptrFrames already holds
+void decodeIndexSpan(const unsigned char *ptrBytes, size_t length, tIndexFrames *ptrFrames) {
+    tBusFrameSpanOutput output;
+    size_t position = 0;
+
+    output.ptrPayload = ptrFrames->ptrPayload;
+    output.payloadSize = INDEX_WIRE_SIZE;
+    output.payloadLength = (unsigned int)ptrFrames->payloadLength;
+    do {
+        output.ptrFrameLengths = &ptrFrames->ptrLengths[ptrFrames->frameCount];
+        output.maxFrames = INDEX_MAX_FRAMES - ptrFrames->frameCount < 255 ? (unsigned char)(INDEX_MAX_FRAMES - ptrFrames->frameCount) : 255;
+        output.frameCount = 0;
+        if(output.maxFrames == 0) {
+            break;
+        }
+        position += decodeBusFrameSpan(&ptrBytes[position], (unsigned int)(length - position), &output);
+        ptrFrames->frameCount += output.frameCount;
+    } while(output.frameCount == output.maxFrames);
+    ptrFrames->payloadLength = output.payloadLength;
+}
+
+void checkSameFrames(const char *ptrName, const tIndexFrames *ptrGot, const tIndexFrames *ptrExpected) {
+    size_t frame;
+
+    checkBusTest(ptrGot->frameCount == ptrExpected->frameCount && ptrGot->payloadLength == ptrExpected->payloadLength,
+            "%s: %zu frames (%zu bytes), one pass %zu (%zu bytes)", ptrName, ptrGot->frameCount, ptrGot->payloadLength,
+            ptrExpected->frameCount, ptrExpected->payloadLength);
+    for(frame = 0; frame < ptrGot->frameCount && frame < ptrExpected->frameCount; frame++) {
+        if(ptrGot->ptrLengths[frame] != ptrExpected->ptrLengths[frame]) {
+            checkBusTest(0, "%s: frame %zu is %u bytes, %u in one pass", ptrName, frame, ptrGot->ptrLengths[frame], ptrExpected->ptrLengths[frame]);
+            return;
+        }
+    }
+    checkBusTest(ptrGot->payloadLength != ptrExpected->payloadLength || memcmp(ptrGot->ptrPayload, ptrExpected->ptrPayload, ptrGot->payloadLength) == 0,
+            "%s: payloads differ from one pass", ptrName);
+}
+
+//Chunks start at the first SC1 past every INDEX_CHUNK_SIZE, as bus_decode cuts them
+void testChunkedDecode(const char *ptrName, const unsigned char *ptrWire, size_t length, unsigned int expectedFrames) {
+    tBusFrameIndex index;
+    size_t chunkStart = 0;
+    size_t chunkEnd;
+    size_t next;
+    unsigned int chunks = 0;
+
+    onePass.frameCount = 0;
+    onePass.payloadLength = 0;
+    decodeIndexSpan(ptrWire, length, &onePass);
+    if(expectedFrames) {
+        checkBusTest(onePass.frameCount == expectedFrames, "%s: one pass decoded %zu frames of %u", ptrName, onePass.frameCount, expectedFrames);
+    }
+
+    initialiseBusFrameIndex(&index);
+    indexBusFrameMarkers(&index, ptrWire, length, 0);
+    if(expectedFrames) {
+        checkBusTest(index.startCount == expectedFrames && index.endCount == expectedFrames, "%s: %zu SC1 and %zu EC2 for %u frames",
+                ptrName, index.startCount, index.endCount, expectedFrames);
+    }
+    chunked.frameCount = 0;
+    chunked.payloadLength = 0;
+    while(chunkStart < length) {
+        next = findBusFrameStart(&index, chunkStart + INDEX_CHUNK_SIZE);
+        chunkEnd = next < index.startCount ? index.ptrStarts[next] : length;
+        decodeIndexSpan(&ptrWire[chunkStart], chunkEnd - chunkStart, &chunked);
+        chunkStart = chunkEnd;
+        chunks++;
+    }
+    freeBusFrameIndex(&index);
+    checkBusTest(chunks > 4, "%s: only %u chunks", ptrName, chunks);
+    checkSameFrames(ptrName, &chunked, &onePass);
+}
+
+//bus_decode on the same wire, four threads at its smallest chunk size, its frame listing against onePass
+void testBusDecode(const char *ptrDecoder, const unsigned char *ptrWire, size_t length) {
+    char path[64];
+    char command[256];
+    char line[512];
+    char *ptrBytes;
+    FILE *ptrFile;
+    unsigned long long number;
+    unsigned int frameLength;
+    unsigned int byte;
+    unsigned int index;
+    size_t frame = 0;
+    size_t payloadPosition = 0;
+    int consumed;
+    unsigned int bad = 0;
+
+    snprintf(path, sizeof(path), "/tmp/test_index.%d.wire", (int)getpid());
+    ptrFile = fopen(path, "wb");
+    if(ptrFile == 0 || fwrite(ptrWire, 1, length, ptrFile) != length) {
+        checkBusTest(0, "bus_decode: can't write %s", path);
+        if(ptrFile) {
+            fclose(ptrFile);
+        }
+        return;
+    }
+    fclose(ptrFile);
+
+    snprintf(command, sizeof(command), "%s -j 4 -s %u %s 2>/dev/null", ptrDecoder, INDEX_CHUNK_SIZE / 1024, path);
+    ptrFile = popen(command, "r");
+    checkBusTest(ptrFile != 0, "bus_decode: can't run %s", command);
+    while(ptrFile && fgets(line, sizeof(line), ptrFile)) {
+        if(sscanf(line, "port %*u %*s frame %llu %u:%n", &number, &frameLength, &consumed) != 2) {
+            continue;
+        }
+        if(frame < onePass.frameCount) {
+            if(number != frame || frameLength != onePass.ptrLengths[frame]) {
+                if(bad++ < 5) {
+                    checkBusTest(0, "bus_decode: frame %llu is %u bytes, one pass has frame %zu at %u bytes", number, frameLength, frame, onePass.ptrLengths[frame]);
+                }
+            } else {
+                ptrBytes = &line[consumed];
+                for(index = 0; index < frameLength && index < INDEX_PRINT_BYTES; index++) {
+                    if(sscanf(ptrBytes, " %2x%n", &byte, &consumed) != 1 || byte != onePass.ptrPayload[payloadPosition + index]) {
+                        if(bad++ < 5) {
+                            checkBusTest(0, "bus_decode: frame %zu byte %u differs", frame, index);
+                        }
+                        break;
+                    }
+                    ptrBytes += consumed;
+                }
+            }
+            payloadPosition += onePass.ptrLengths[frame];
+        }
+        frame++;
+    }
+    checkBusTest(ptrFile != 0 && pclose(ptrFile) == 0, "bus_decode: failed");
+    checkBusTest(frame == onePass.frameCount, "bus_decode: %zu frames, one pass %zu", frame, onePass.frameCount);
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    unsigned int seed = 101;
+    unsigned int frames;
+    unsigned int length;
+    unsigned int i;
+
+#if BUS_FRAME_INDEX_VECTOR && defined(__AVX2__)
+    if(!__builtin_cpu_supports("avx2")) {
+        printf("%s: no AVX2 here, skipped\n", INDEX_TEST_NAME);
+        return 77;
+    }
+#endif
+    for(i = 0; i < 64 * 1024; i++) {
+        bytes[i] = (unsigned char)getBusTestRandom(&seed);
+    }
+    testIndex("random bytes", &bytes[0], 64 * 1024, &seed);
+    //Every tail length the vector loop leaves to the byte loop
+    for(i = 0; i < 70; i++) {
+        testIndex("random bytes, short", &bytes[i], i, &seed);
+    }
+    length = makeBoundaryBytes(&bytes[0], 4096 + 13);
+    testIndex("boundary markers", &bytes[0], length, &seed);
+    testIndex("boundary markers, shifted a byte", &bytes[1], length - 1, &seed);
+
+    length = makeNoisyWire(&bytes[0], INDEX_WIRE_SIZE, &seed, 0, &frames);
+    testIndex("clean wire", &bytes[0], length, &seed);
+    testChunkedDecode("clean wire", &bytes[0], length, frames);
+
+    length = makeNoisyWire(&bytes[0], INDEX_WIRE_SIZE, &seed, 1, &frames);
+    testIndex("noisy wire", &bytes[0], length, &seed);
+    testChunkedDecode("noisy wire", &bytes[0], length, 0);
+    if(argc > 1) {
+        testBusDecode(argv[1], &bytes[0], length);
+    }
+    return finishBusTest(INDEX_TEST_NAME);
+}
@@ -0,0 +1,233 @@
+/*
+ * File:   test_span.c
+ * Author: Alex
+ *
+ * Created on 17 October 2026, 23:50
+ *
+ * decodeBusFrameSpan against the frame handler: writer frames, some with a bit
+ * flipped and line noise in between, fed to the span decoder in random chunks
+ * with the unconsumed tail carried over, must come out exactly as the handler
+ * decodes them. Then every length up to 1200 bytes in block, jumbo and dense
+ * encodings from encodeBusFrame, decoded in one go. First of all, before
+ * any context exists, a few threads encode at once: the CRCs have to be
+ * right straight away (BUS_FRAME_CRC_TABLE builds its tables on first use).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "bus_test.h"
+#include "../../crc.h"
+
+#define SPAN_FRAMES         400
+#define SPAN_WIRE_SIZE      (SPAN_FRAMES * (MAX_FRAME_SIZE + 8))
+#define SPAN_PAYLOAD_SIZE   (SPAN_FRAMES * MAX_UNPACKED_PAYLOAD)
+#define SPAN_MAX_LENGTH     1200
+#define SPAN_CARRY_SIZE     (MAX_JUMBO_UNPACKED_PAYLOAD * 2)
+#define SPAN_FIRST_THREADS  4
+#define SPAN_FIRST_LENGTH   12
+
+typedef struct {
+    pthread_t thread;
+    unsigned char block[MAX_FRAME_SIZE];
+    unsigned char dense[MAX_FRAME_SIZE];
+    unsigned int blockLength;
+    unsigned int denseLength;
+} tSpanFirstUse;
+
+void *encodeFirstFrames(void *ptrArgument);
+void testSpanFirstUse(void);
+void testSpanAgainstHandler(void);
+void testSpanFormats(void);
+
+tBusTestLink link;
+unsigned char wire[SPAN_WIRE_SIZE];
+unsigned char handlerPayload[SPAN_PAYLOAD_SIZE];
+unsigned char spanPayload[SPAN_PAYLOAD_SIZE];
+unsigned int handlerLengths[SPAN_FRAMES];
+unsigned int spanLengths[SPAN_FRAMES];
+unsigned char carry[SPAN_CARRY_SIZE];
+unsigned char formatWire[3 * SPAN_MAX_LENGTH * (SPAN_MAX_LENGTH + 24)];
+unsigned char formatPayload[3 * SPAN_MAX_LENGTH * (SPAN_MAX_LENGTH + 6)];
+unsigned int formatLengths[3 * SPAN_MAX_LENGTH];
+unsigned char source[SPAN_MAX_LENGTH];
+const unsigned char firstPayload[SPAN_FIRST_LENGTH] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C};
+
+void *encodeFirstFrames(void *ptrArgument) {
+    tSpanFirstUse *ptrFirst = (tSpanFirstUse *)ptrArgument;
+    ptrFirst->blockLength = encodeBusFrame(&firstPayload[0], SPAN_FIRST_LENGTH, 0, &ptrFirst->block[0], sizeof(ptrFirst->block));
+    ptrFirst->denseLength = encodeBusFrame(&firstPayload[0], SPAN_FIRST_LENGTH, BUS_FRAME_FORMAT_DENSE, &ptrFirst->dense[0], sizeof(ptrFirst->dense));
+    return 0;
+}
+
+void testSpanFirstUse(void) {
+    tSpanFirstUse first[SPAN_FIRST_THREADS];
+    tBusFrameSpanOutput output;
+    unsigned char reference[MAX_FRAME_SIZE];
+    unsigned char payload[MAX_FRAME_SIZE];
+    unsigned int frameLength;
+    unsigned int length;
+    unsigned int block;
+    unsigned int i;
+
+    for(i = 0; i < SPAN_FIRST_THREADS; i++) {
+        pthread_create(&first[i].thread, 0, encodeFirstFrames, &first[i]);
+    }
+    for(i = 0; i < SPAN_FIRST_THREADS; i++) {
+        pthread_join(first[i].thread, 0);
+    }
+
+    //Every block CRC against calculateCrc itself, SC1 and SC2 then 8 byte blocks (mask, CRC, 6 data)
+    for(block = 0; block < (SPAN_FIRST_LENGTH + 5) / 6; block++) {
+        checkBusTest(first[0].block[2 + block * 8 + 1] == calculateCrc(&first[0].block[2 + block * 8 + 2], 6),
+                "first use: block %u CRC %02X, calculateCrc %02X", block, first[0].block[2 + block * 8 + 1], calculateCrc(&first[0].block[2 + block * 8 + 2], 6));
+    }
+    //The dense frame's CRC-16 against the handler, the contexts being up now
+    initialiseBusTestLink(&link);
+    length = readBusTestFrames(&link, &first[0].dense[0], first[0].denseLength, &payload[0], sizeof(payload), &frameLength, 1);
+    checkBusTest(length == 1 && memcmp(&payload[0], &firstPayload[0], SPAN_FIRST_LENGTH) == 0, "first use: handler took %u dense frames", length);
+    for(i = 0; i < SPAN_FIRST_THREADS; i++) {
+        length = encodeBusFrame(&firstPayload[0], SPAN_FIRST_LENGTH, 0, &reference[0], sizeof(reference));
+        checkBusTest(first[i].blockLength == length && memcmp(&first[i].block[0], &reference[0], length) == 0, "first use: thread %u block frame differs", i);
+        length = encodeBusFrame(&firstPayload[0], SPAN_FIRST_LENGTH, BUS_FRAME_FORMAT_DENSE, &reference[0], sizeof(reference));
+        checkBusTest(first[i].denseLength == length && memcmp(&first[i].dense[0], &reference[0], length) == 0, "first use: thread %u dense frame differs", i);
+    }
+    output.ptrPayload = &payload[0];
+    output.payloadSize = sizeof(payload);
+    output.payloadLength = 0;
+    output.ptrFrameLengths = &frameLength;
+    output.maxFrames = 1;
+    output.frameCount = 0;
+    decodeBusFrameSpan(&first[0].block[0], first[0].blockLength, &output);
+    checkBusTest(output.frameCount == 1 && memcmp(&payload[0], &firstPayload[0], SPAN_FIRST_LENGTH) == 0, "first use: span decoded %u frames", output.frameCount);
+}
+
+void testSpanAgainstHandler(void) {
+    tBusFrameSpanOutput output;
+    unsigned char payload[MAX_UNPACKED_PAYLOAD];
+    unsigned int seed = 3;
+    unsigned int wireLength = 0;
+    unsigned int handlerFrames;
+    unsigned int handlerPayloadLength = 0;
+    unsigned int spanFrames = 0;
+    unsigned int corrupted = 0;
+    unsigned int written;
+    unsigned int carryLength = 0;
+    unsigned int position = 0;
+    unsigned int consumed;
+    unsigned int chunk;
+    unsigned int length;
+    unsigned int noise;
+    unsigned int frame;
+
+    initialiseBusTestLink(&link);
+    for(frame = 0; frame < SPAN_FRAMES; frame++) {
+        length = 1 + getBusTestRandom(&seed) % MAX_UNPACKED_PAYLOAD;
+        fillBusTestPayload(&payload[0], length, &seed);
+        written = writeBusTestFrame(&link, &payload[0], length, 0, &wire[wireLength], SPAN_WIRE_SIZE - wireLength);
+        if(getBusTestRandom(&seed) % 10 == 0) {
+            //Bit 0 of a mask, CRC or data byte, it stays the same kind of byte but the frame is lost (or demasks differently)
+            wire[wireLength + 2 + getBusTestRandom(&seed) % (written - 4)] ^= 1;
+            corrupted++;
+        }
+        wireLength += written;
+        if(getBusTestRandom(&seed) % 5 == 0) {
+            for(noise = getBusTestRandom(&seed) % 5; noise > 0; noise--) {
+                wire[wireLength++] = getBusTestRandom(&seed) & 0x7F;
+            }
+        }
+    }
+    handlerFrames = readBusTestFrames(&link, &wire[0], wireLength, &handlerPayload[0], SPAN_PAYLOAD_SIZE, &handlerLengths[0], SPAN_FRAMES);
+    for(frame = 0; frame < handlerFrames && frame < SPAN_FRAMES; frame++) {
+        handlerPayloadLength += handlerLengths[frame];
+    }
+
+    output.ptrPayload = &spanPayload[0];
+    output.payloadSize = SPAN_PAYLOAD_SIZE;
+    output.payloadLength = 0;
+    while(position < wireLength || carryLength > 0) {
+        chunk = getBusTestRandom(&seed) % 40;
+        if(chunk > wireLength - position) {
+            chunk = wireLength - position;
+        }
+        memcpy(&carry[carryLength], &wire[position], chunk);
+        carryLength += chunk;
+        position += chunk;
+        //A few frames per call, so frames also get held back for want of room
+        output.ptrFrameLengths = &spanLengths[spanFrames];
+        output.maxFrames = SPAN_FRAMES - spanFrames < 3 ? SPAN_FRAMES - spanFrames : 3;
+        output.frameCount = 0;
+        consumed = decodeBusFrameSpan(&carry[0], carryLength, &output);
+        spanFrames += output.frameCount;
+        memmove(&carry[0], &carry[consumed], carryLength - consumed);
+        carryLength -= consumed;
+        if(position >= wireLength && output.frameCount == 0) {
+            break; //Only a partial frame or noise left
+        }
+    }
+
+    checkBusTest(handlerFrames >= SPAN_FRAMES - corrupted && handlerFrames <= SPAN_FRAMES, "handler decoded %u of %u frames, %u corrupted", handlerFrames, SPAN_FRAMES, corrupted);
+    checkBusTest(spanFrames == handlerFrames, "span decoded %u frames, handler %u", spanFrames, handlerFrames);
+    checkBusTest(output.payloadLength == handlerPayloadLength, "span decoded %u bytes, handler %u", output.payloadLength, handlerPayloadLength);
+    for(frame = 0; frame < spanFrames && frame < handlerFrames; frame++) {
+        checkBusTest(spanLengths[frame] == handlerLengths[frame], "frame %u: span length %u, handler %u", frame, spanLengths[frame], handlerLengths[frame]);
+    }
+    checkBusTest(memcmp(&spanPayload[0], &handlerPayload[0], handlerPayloadLength) == 0, "span payload differs from the handler's");
+}
+
+void testSpanFormats(void) {
+    static const unsigned char formats[3] = {0, BUS_FRAME_FORMAT_JUMBO, BUS_FRAME_FORMAT_DENSE};
+    tBusFrameSpanOutput output;
+    unsigned int seed = 11;
+    unsigned int wireLength = 0;
+    unsigned int consumed;
+    unsigned int expectedOffset = 0;
+    unsigned int frames = 0;
+    unsigned int length;
+    unsigned int written;
+    unsigned int frame;
+    unsigned char f;
+
+    fillBusTestPayload(&source[0], SPAN_MAX_LENGTH, &seed);
+    for(f = 0; f < 3; f++) {
+        for(length = 1; length <= SPAN_MAX_LENGTH; length++) {
+            //Jumbo is what the encoder picks by itself past 15 blocks, below that it's plain block frames again
+            written = encodeBusFrame(&source[0], length, formats[f], &formatWire[wireLength], sizeof(formatWire) - wireLength);
+            checkBusTest(written == getEncodedBusFrameSize(length, formats[f]), "format %u length %u: encoded %u bytes", formats[f], length, written);
+            wireLength += written;
+            frames++;
+        }
+    }
+
+    output.ptrPayload = &formatPayload[0];
+    output.payloadSize = sizeof(formatPayload);
+    output.payloadLength = 0;
+    for(frame = 0; frame < frames; frame += output.frameCount) {
+        output.ptrFrameLengths = &formatLengths[frame];
+        output.maxFrames = 255;
+        output.frameCount = 0;
+        consumed = decodeBusFrameSpan(&formatWire[0], wireLength, &output);
+        memmove(&formatWire[0], &formatWire[consumed], wireLength - consumed);
+        wireLength -= consumed;
+        if(output.frameCount == 0) {
+            break;
+        }
+    }
+    checkBusTest(frame == frames, "span decoded %u of %u frames", frame, frames);
+
+    frame = 0;
+    for(f = 0; f < 3; f++) {
+        for(length = 1; length <= SPAN_MAX_LENGTH && frame < frames; length++, frame++) {
+            checkBusTest(formatLengths[frame] == getBusTestPaddedLength(length, formats[f]), "format %u length %u: decoded %u bytes", formats[f], length, formatLengths[frame]);
+            checkBusTest(memcmp(&formatPayload[expectedOffset], &source[0], length) == 0, "format %u length %u: payload differs", formats[f], length);
+            expectedOffset += formatLengths[frame];
+        }
+    }
+}
+
+int main(void) {
+    testSpanFirstUse();
+    testSpanAgainstHandler();
+    testSpanFormats();
+    return finishBusTest("test_span");
+}
@@ -0,0 +1,67 @@
+/*
+ * File:   test_stats.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 01:50
+ *
+ * Handler counters (BUS_FRAME_STATS_ENABLED) for good frames, a frame that
+ * fails its block CRC and one that fails its dense frame CRC.
+ */
+
+#include <stdio.h>
+#include "bus_test.h"
+
+tBusTestLink link;
+
+int main(void) {
+    tBusFrameHandlerStats stats;
+    unsigned char payload[40];
+    unsigned char wire[80];
+    unsigned char decoded[48];
+    unsigned int lengths[4];
+    unsigned int wireLength;
+    unsigned int frames;
+    unsigned int seed = 13;
+    unsigned int kind;
+    unsigned long errors = 0;
+
+    initialiseBusTestLink(&link);
+    fillBusTestPayload(&payload[0], sizeof(payload), &seed);
+
+    wireLength = encodeBusFrame(&payload[0], 20, 0, &wire[0], sizeof(wire));
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &lengths[0], 4);
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    checkBusTest(frames == 1 && stats.framesDecoded == 1, "good frame: %u out, %lu counted", frames, stats.framesDecoded);
+    checkBusTest(stats.bytesIn == wireLength, "good frame: %lu bytes in, %u sent", stats.bytesIn, wireLength);
+
+    //CRC byte of the second block
+    wire[2 + 8 + 1] ^= 1;
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &lengths[0], 4);
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    checkBusTest(frames == 0, "bad block CRC: %u frames out", frames);
+    checkBusTest(stats.crcFailures == 1, "bad block CRC: %lu CRC failures", stats.crcFailures);
+    checkBusTest(stats.errorCounts[BHE_CRC_FAILED] == 1, "bad block CRC: %lu CRC_FAILED errors", stats.errorCounts[BHE_CRC_FAILED]);
+    checkBusTest(stats.framesDropped == 1, "bad block CRC: %lu frames dropped", stats.framesDropped);
+
+    //Last byte of the dense frame CRC
+    wireLength = encodeBusFrame(&payload[0], sizeof(payload), BUS_FRAME_FORMAT_DENSE, &wire[0], sizeof(wire));
+    wire[wireLength - 3] ^= 1;
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &lengths[0], 4);
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    checkBusTest(frames == 0, "bad frame CRC: %u frames out", frames);
+    checkBusTest(stats.crcFailures == 2 && stats.errorCounts[BHE_CRC_FAILED] == 2, "bad frame CRC: %lu CRC failures, %lu CRC_FAILED errors",
+            stats.crcFailures, stats.errorCounts[BHE_CRC_FAILED]);
+    checkBusTest(stats.framesDropped == 2, "bad frame CRC: %lu frames dropped", stats.framesDropped);
+
+    for(kind = BHE_NONE + 1; kind < BHE_ERROR_KINDS; kind++) {
+        errors += stats.errorCounts[kind];
+    }
+    checkBusTest(errors == 2, "%lu errors counted, expected just the 2 CRC failures", errors);
+
+    wire[wireLength - 3] ^= 1;
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &lengths[0], 4);
+    snapshotBusFrameHandlerStatsCtx(&link.handler, &stats);
+    checkBusTest(frames == 1 && lengths[0] == sizeof(payload) && stats.framesDecoded == 2, "good dense frame after the errors: %u out, %lu counted",
+            frames, stats.framesDecoded);
+    return finishBusTest("test_stats");
+}
@@ -0,0 +1,305 @@
+/*
+ * File:   test_trace.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:50
+ *
+ * The trace ring (bus_frame_trace.c) and bus_trace's timelines from it.
+ * Events read back in order with every field as recorded, in one go or a
+ * few at a time. Once the ring has wrapped twice over, a read has to skip
+ * to the oldest event still held and move the cursor by exactly what was
+ * lost. Then a writer (bus 0) sends a known frame, and a handler (bus 1)
+ * takes it and a copy with its CRC flipped, both traced on one ring from a
+ * clock that ticks 10 per call. The ring has to hold SC1, SC2, EC2, decoded
+ * and consumed in that order for the good frame and a PROCESS_ERROR with
+ * CRC_FAILED for the bad one. The dump goes through bus_trace, which has to
+ * print exactly those milestones as the frames' timelines, and forget the
+ * frame in progress when told events were lost.
+ *
+ *   test_trace <bus_trace binary>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../bus_frame_trace.h"
+#include "bus_test.h"
+
+#if !BUS_FRAME_TRACE_ENABLED
+#error test_trace needs a library built with BUS_FRAME_TRACE_ENABLED
+#endif
+
+#define TRACE_TEST_LENGTH       24
+#define TRACE_TEST_READ         5   //Events per read when reading a few at a time
+#define TRACE_TEST_TICK         10
+#define TRACE_TEST_WRITER_BUS   0
+#define TRACE_TEST_HANDLER_BUS  1
+
+//When each milestone bus_trace looks for happened, 0 = not seen
+typedef struct {
+    unsigned long sc1;
+    unsigned long sc2;
+    unsigned long ec2;
+    unsigned long decoded;
+    unsigned long consumed;
+    unsigned long failed;
+    unsigned int failedError;
+    unsigned long picked;
+    unsigned long encoded;
+    unsigned long drained;
+} tTraceMilestones;
+
+unsigned long readTraceClock(void);
+void testRing(void);
+void testWraparound(void);
+unsigned int traceFrames(void);
+void findMilestones(unsigned int count, tTraceMilestones *ptrGood, tTraceMilestones *ptrBad);
+void writeTraceDump(const char *ptrPath, unsigned int count, unsigned int lostAfter);
+unsigned int runBusTrace(const char *ptrTrace, const char *ptrPath, char lines[][256], unsigned int maxLines);
+void testTimeline(const char *ptrTrace);
+
+tBusTestLink traceLink;
+tBusFrameTrace trace;
+tBusFrameTraceEvent events[BUS_FRAME_TRACE_SIZE];
+unsigned long now;
+unsigned char wire[256];
+unsigned char decoded[2 * TRACE_TEST_LENGTH];
+unsigned int decodedLengths[2];
+
+unsigned long readTraceClock(void) {
+    now += TRACE_TEST_TICK;
+    return now;
+}
+
+//No clock, so each event is stamped with its own sequence number
+void testRing(void) {
+    tBusFrameTraceEvent read[TRACE_TEST_READ];
+    unsigned long cursor = 0;
+    unsigned int recorded = BUS_FRAME_TRACE_SIZE / 2 + 3;
+    unsigned int count;
+    unsigned int index;
+    unsigned int next = 0;
+    unsigned int bad = 0;
+
+    initialiseBusFrameTraceCtx(&trace, 0);
+    for(index = 0; index < recorded; index++) {
+        recordBusFrameTrace(&trace, (eBusFrameTraceComponent)(index % 4), (unsigned char)(index % 7), index, index * 3 + 1, (unsigned char)(index % 5));
+    }
+    count = readBusFrameTraceCtx(&trace, &cursor, &events[0], BUS_FRAME_TRACE_SIZE);
+    checkBusTest(count == recorded && cursor == recorded, "ring: %u events read, cursor %lu, %u recorded", count, cursor, recorded);
+    for(index = 0; index < count; index++) {
+        if((events[index].timestamp != index || events[index].component != index % 4 || events[index].bus != index % 7 || events[index].oldState != index ||
+                events[index].newState != index * 3 + 1 || events[index].error != index % 5) && bad++ < 5) {
+            checkBusTest(0, "ring: event %u came back as %lu %u %u %u %u %u", index, events[index].timestamp, events[index].bus,
+                    events[index].component, events[index].oldState, events[index].newState, events[index].error);
+        }
+    }
+    checkBusTest(readBusFrameTraceCtx(&trace, &cursor, &events[0], BUS_FRAME_TRACE_SIZE) == 0 && cursor == recorded, "ring: events read twice");
+
+    //A few at a time from the start, picking up where the last read stopped
+    cursor = 0;
+    while((count = readBusFrameTraceCtx(&trace, &cursor, &read[0], TRACE_TEST_READ)) > 0) {
+        checkBusTest(count == TRACE_TEST_READ || cursor == recorded, "ring: short read of %u before the end", count);
+        for(index = 0; index < count; index++) {
+            if(read[index].oldState != next && bad++ < 5) {
+                checkBusTest(0, "ring: read a few at a time, got event %u where %u was next", read[index].oldState, next);
+            }
+            next++;
+        }
+    }
+    checkBusTest(next == recorded, "ring: %u events read a few at a time, %u recorded", next, recorded);
+}
+
+void testWraparound(void) {
+    unsigned long cursor = 3;
+    unsigned long recorded = 2 * BUS_FRAME_TRACE_SIZE + 7;
+    unsigned long index;
+    unsigned int count;
+    unsigned int bad = 0;
+
+    now = 1000;
+    initialiseBusFrameTraceCtx(&trace, readTraceClock);
+    for(index = 0; index < recorded; index++) {
+        recordBusFrameTrace(&trace, BUS_TRACE_HANDLER_STATE, 0, (unsigned int)index, 0, BHE_NONE);
+    }
+    //Read up to event 3 before the wrap, so everything from there to the oldest still held is lost
+    count = readBusFrameTraceCtx(&trace, &cursor, &events[0], BUS_FRAME_TRACE_SIZE);
+    checkBusTest(count == BUS_FRAME_TRACE_SIZE && cursor == recorded, "wraparound: %u events read, cursor %lu of %lu", count, cursor, recorded);
+    for(index = 0; index < count; index++) {
+        if((events[index].oldState != recorded - BUS_FRAME_TRACE_SIZE + index || events[index].timestamp != 1000 + (recorded - BUS_FRAME_TRACE_SIZE + index + 1) * TRACE_TEST_TICK)
+                && bad++ < 5) {
+            checkBusTest(0, "wraparound: event %lu is number %u at %lu", index, events[index].oldState, events[index].timestamp);
+        }
+    }
+
+    //One more overwrites the oldest, a reader that kept up loses nothing
+    recordBusFrameTrace(&trace, BUS_TRACE_HANDLER_STATE, 0, (unsigned int)recorded, 0, BHE_NONE);
+    count = readBusFrameTraceCtx(&trace, &cursor, &events[0], BUS_FRAME_TRACE_SIZE);
+    checkBusTest(count == 1 && events[0].oldState == recorded && cursor == recorded + 1, "wraparound: %u events after the next one, number %u", count, events[0].oldState);
+}
+
+//The known frame from the writer, then it and a copy with its last block's CRC flipped into the handler. Returns the events traced
+unsigned int traceFrames(void) {
+    unsigned char payload[TRACE_TEST_LENGTH];
+    unsigned long cursor = 0;
+    unsigned int length;
+    unsigned int frames;
+    unsigned int index;
+
+    for(index = 0; index < TRACE_TEST_LENGTH; index++) {
+        payload[index] = (unsigned char)(index * 5 + 1);
+    }
+    now = 0;
+    initialiseBusFrameTraceCtx(&trace, readTraceClock);
+    initialiseBusTestLink(&traceLink);
+    registerBusFrameWriterTraceCtx(&traceLink.writer, &trace, TRACE_TEST_WRITER_BUS);
+    registerBusFrameTraceCtx(&traceLink.handler, &trace, TRACE_TEST_HANDLER_BUS);
+
+    length = writeBusTestFrame(&traceLink, &payload[0], TRACE_TEST_LENGTH, 0, &wire[0], sizeof(wire) / 2);
+    memcpy(&wire[length], &wire[0], length);
+    wire[2 * length - 2 - 8 + 1] ^= 1;
+    frames = readBusTestFrames(&traceLink, &wire[0], 2 * length, &decoded[0], sizeof(decoded), &decodedLengths[0], 2);
+    checkBusTest(frames == 1 && decodedLengths[0] == TRACE_TEST_LENGTH && memcmp(&decoded[0], &payload[0], TRACE_TEST_LENGTH) == 0,
+            "timeline: %u frames decoded, the first %u bytes", frames, decodedLengths[0]);
+    checkBusTest(trace.recorded < BUS_FRAME_TRACE_SIZE, "timeline: %lu events don't fit the ring", trace.recorded);
+    return readBusFrameTraceCtx(&trace, &cursor, &events[0], BUS_FRAME_TRACE_SIZE);
+}
+
+//The handler's first frame is the good one, its second the bad one
+void findMilestones(unsigned int count, tTraceMilestones *ptrGood, tTraceMilestones *ptrBad) {
+    tTraceMilestones *ptrFrame = 0;
+    tBusFrameTraceEvent *ptrEvent;
+    unsigned int index;
+
+    memset(ptrGood, 0, sizeof(*ptrGood));
+    memset(ptrBad, 0, sizeof(*ptrBad));
+    for(index = 0; index < count; index++) {
+        ptrEvent = &events[index];
+        if(ptrEvent->bus == TRACE_TEST_WRITER_BUS && ptrEvent->component == BUS_TRACE_WRITER_STATE) {
+            if(ptrEvent->newState == BUS_FRAME_WRITER_CALCULATE_BLOCKS) {
+                ptrGood->picked = ptrEvent->timestamp;
+            } else if(ptrEvent->newState == BUS_FRAME_WRITER_TRIGGER_LISTENER) {
+                ptrGood->encoded = ptrEvent->timestamp;
+            } else if(ptrEvent->newState == BUS_FRAME_WRITER_COMPLETE_RESET) {
+                ptrGood->drained = ptrEvent->timestamp;
+            }
+            continue;
+        }
+        if(ptrEvent->bus != TRACE_TEST_HANDLER_BUS) {
+            checkBusTest(0, "timeline: an event for bus %u", ptrEvent->bus);
+            continue;
+        }
+        if(ptrEvent->component == BUS_TRACE_MARKERS && ptrEvent->oldState == 0 && ptrEvent->newState == 1) {
+            ptrFrame = ptrFrame == 0 ? ptrGood : ptrBad;
+            ptrFrame->sc1 = ptrEvent->timestamp;
+        } else if(ptrFrame == 0) {
+            continue;
+        } else if(ptrEvent->component == BUS_TRACE_MARKERS && ptrEvent->newState == 3 && ptrFrame->sc2 == 0) {
+            ptrFrame->sc2 = ptrEvent->timestamp;
+        } else if(ptrEvent->component == BUS_TRACE_MARKERS && ptrEvent->newState == 15) {
+            ptrFrame->ec2 = ptrEvent->timestamp;
+        } else if(ptrEvent->component == BUS_TRACE_HANDLER_STATE && ptrEvent->newState == BUS_HANDLER_WAIT_PROCESSED) {
+            ptrFrame->decoded = ptrEvent->timestamp;
+        } else if(ptrEvent->component == BUS_TRACE_HANDLER_STATE && ptrEvent->newState == BUS_HANDLER_COMPLETE_RESET && ptrFrame->consumed == 0 && ptrFrame->failed == 0) {
+            ptrFrame->consumed = ptrEvent->timestamp;
+        } else if(ptrEvent->component == BUS_TRACE_HANDLER_STATE && ptrEvent->newState == BUS_HANDLER_PROCESS_ERROR) {
+            ptrFrame->failed = ptrEvent->timestamp;
+            ptrFrame->failedError = ptrEvent->error;
+        }
+    }
+}
+
+//In readBusFrameTrace's order and bus_replay -t's format, with "# lost" after event lostAfter (count for none)
+void writeTraceDump(const char *ptrPath, unsigned int count, unsigned int lostAfter) {
+    FILE *ptrFile = fopen(ptrPath, "w");
+    unsigned int index;
+
+    if(ptrFile == 0) {
+        checkBusTest(0, "can't write %s", ptrPath);
+        return;
+    }
+    fprintf(ptrFile, "# test_trace\n");
+    for(index = 0; index < count; index++) {
+        fprintf(ptrFile, "%lu %u %u %u %u %u\n", events[index].timestamp, events[index].bus, events[index].component,
+                events[index].oldState, events[index].newState, events[index].error);
+        if(index == lostAfter) {
+            fprintf(ptrFile, "# lost 3\n");
+        }
+    }
+    fclose(ptrFile);
+}
+
+unsigned int runBusTrace(const char *ptrTrace, const char *ptrPath, char lines[][256], unsigned int maxLines) {
+    char command[256];
+    FILE *ptrPipe;
+    unsigned int count = 0;
+
+    snprintf(command, sizeof(command), "%s < %s 2>/dev/null", ptrTrace, ptrPath);
+    ptrPipe = popen(command, "r");
+    if(ptrPipe == 0) {
+        checkBusTest(0, "can't run %s", command);
+        return 0;
+    }
+    while(count < maxLines && fgets(lines[count], 256, ptrPipe)) {
+        count++;
+    }
+    checkBusTest(pclose(ptrPipe) == 0, "%s failed", command);
+    return count;
+}
+
+void testTimeline(const char *ptrTrace) {
+    tTraceMilestones good;
+    tTraceMilestones bad;
+    char path[64];
+    char lines[8][256];
+    char expected[3][256];
+    unsigned int count;
+    unsigned int lineCount;
+    unsigned int index;
+
+    count = traceFrames();
+    findMilestones(count, &good, &bad);
+    checkBusTest(good.picked && good.picked < good.encoded && good.encoded < good.drained, "timeline: writer picked %lu, encoded %lu, drained %lu",
+            good.picked, good.encoded, good.drained);
+    checkBusTest(good.sc1 && good.sc1 < good.sc2 && good.sc2 < good.ec2 && good.ec2 < good.decoded && good.decoded < good.consumed && good.failed == 0,
+            "timeline: good frame sc1 %lu, sc2 %lu, ec2 %lu, decoded %lu, consumed %lu, failed %lu", good.sc1, good.sc2, good.ec2, good.decoded, good.consumed, good.failed);
+    checkBusTest(bad.sc1 > good.consumed && bad.sc2 > bad.sc1 && bad.failed > bad.sc2 && bad.failedError == BHE_CRC_FAILED && bad.decoded == 0 && bad.consumed == 0,
+            "timeline: bad frame sc1 %lu, failed %lu with error %u, decoded %lu", bad.sc1, bad.failed, bad.failedError, bad.decoded);
+    if(ptrTrace == 0) {
+        return;
+    }
+
+    snprintf(expected[0], sizeof(expected[0]), "bus %u tx @%.1f encoded +%.1f drained +%.1f total %.1f\n", TRACE_TEST_WRITER_BUS, (double)good.picked,
+            (double)(good.encoded - good.picked), (double)(good.drained - good.encoded), (double)(good.drained - good.picked));
+    snprintf(expected[1], sizeof(expected[1]), "bus %u rx @%.1f sc2 +%.1f ec2 +%.1f decoded +%.1f consumed +%.1f total %.1f\n", TRACE_TEST_HANDLER_BUS,
+            (double)good.sc1, (double)(good.sc2 - good.sc1), (double)(good.ec2 - good.sc2), (double)(good.decoded - good.ec2),
+            (double)(good.consumed - good.decoded), (double)(good.consumed - good.sc1));
+    snprintf(expected[2], sizeof(expected[2]), "bus %u rx @%.1f dropped, error %u\n", TRACE_TEST_HANDLER_BUS, (double)bad.sc1, BHE_CRC_FAILED);
+
+    snprintf(path, sizeof(path), "/tmp/test_trace.%d.dump", (int)getpid());
+    writeTraceDump(path, count, count);
+    lineCount = runBusTrace(ptrTrace, path, lines, 8);
+    checkBusTest(lineCount == 3, "bus_trace: %u lines for a sent frame, a received one and a dropped one", lineCount);
+    for(index = 0; index < lineCount && index < 3; index++) {
+        checkBusTest(strcmp(lines[index], expected[index]) == 0, "bus_trace: printed %s  expected %s", lines[index], expected[index]);
+    }
+
+    //Events lost after the good frame's SC1: it's forgotten, the writer's frame and the bad one still come out
+    index = 0;
+    while(index < count && events[index].timestamp != good.sc1) {
+        index++;
+    }
+    writeTraceDump(path, count, index);
+    lineCount = runBusTrace(ptrTrace, path, lines, 8);
+    checkBusTest(lineCount == 3 && strcmp(lines[0], expected[0]) == 0 && strcmp(lines[1], "# lost 3 events\n") == 0 && strcmp(lines[2], expected[2]) == 0,
+            "bus_trace: with events lost printed %u lines, %s", lineCount, lineCount > 1 ? lines[1] : "");
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    testRing();
+    testWraparound();
+    testTimeline(argc > 1 ? argv[1] : 0);
+    return finishBusTest("test_trace");
+}
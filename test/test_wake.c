@@ -0,0 +1,314 @@
+/*
+ * File:   test_wake.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 06:10
+ *
+ * Wait reasons and wake hooks (BUS_FRAME_WAKE_HOOKS_ENABLED), the pair a host
+ * loop sleeps on. For each thing a handler or writer can be blocked on, the
+ * wait query has to report it (with the deadline where there is one) for as
+ * long as it lasts, stepping mustn't get past it, and the hook has to fire,
+ * once, with its argument, when the library is what ends it: input bytes
+ * arriving, a frame handed to the application, frames released to the
+ * writer, the send listener set, a frame joining a held batch, the batch's
+ * coalescing deadline, feedback arriving and the feedback deadline. A full
+ * send buffer is ended by whoever drains it, so there the hook mustn't fire
+ * and the wait has to clear once the loop steps again. The feedback deadline
+ * is BUS_FRAME_REPAIR_WAIT_TICKS on the writer clock, however many steps go
+ * by, and BUS_FRAME_REPAIR_WAIT_STEPS without a clock. Built against
+ * bus_frame_wake.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#if !BUS_FRAME_WAKE_HOOKS_ENABLED || !BUS_FRAME_REPAIR_ENABLED || !BUS_FRAME_REPAIR_WAIT_TICKS
+#error test_wake needs a library built with BUS_FRAME_WAKE_HOOKS_ENABLED, BUS_FRAME_REPAIR_ENABLED and BUS_FRAME_REPAIR_WAIT_TICKS
+#endif
+
+#define WAKE_LENGTH         6
+#define WAKE_SMALL_SEND     (2 + 8) //SC1, SC2 and the one block, nothing left for EC1
+#define WAKE_MAX_STEPS      1000
+#define WAKE_COALESCE_DELAY 50
+
+unsigned long readWakeClock(void);
+void countWake(void *ptrArgument);
+eBusFrameWriterWaitReason stepWriterUntilBlocked(tBusFrameWriterWait *ptrWait);
+void queueWakeFrame(unsigned char send);
+unsigned int takeWakeWire(unsigned int maxBytes);
+void testHandlerWaits(void);
+void testWriterFrames(void);
+void testSendSpace(void);
+void testCoalescing(void);
+void testRepairWait(unsigned char clock);
+
+tBusTestLink link;
+tBuffer smallSendBuffer;
+unsigned char smallSendArray[WAKE_SMALL_SEND];
+unsigned char payload[WAKE_LENGTH];
+unsigned char wire[BUS_TEST_SEND_BUFFER_SIZE];
+unsigned long now;
+unsigned int wakes;
+void *ptrWakeArgument;
+
+unsigned long readWakeClock(void) {
+    return now;
+}
+
+void countWake(void *ptrArgument) {
+    wakes++;
+    ptrWakeArgument = ptrArgument;
+}
+
+//Steps the writer one at a time, at least once, until it says it's blocked
+eBusFrameWriterWaitReason stepWriterUntilBlocked(tBusFrameWriterWait *ptrWait) {
+    eBusFrameWriterRunStatus runStatus;
+    unsigned int steps = 0;
+    do {
+        runBusFrameWriterBudgetCtx(&link.writer, &runStatus, 1);
+        getBusFrameWriterWaitCtx(&link.writer, ptrWait);
+    } while(ptrWait->reason == BUS_FRAME_WRITER_BLOCKED_NONE && ++steps < WAKE_MAX_STEPS);
+    return ptrWait->reason;
+}
+
+void queueWakeFrame(unsigned char send) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    unsigned int i;
+
+    openBusFrameCtx(&link.writer, &status);
+    for(i = 0; i < WAKE_LENGTH; i++) {
+        writeToBusFrameCtx(&link.writer, &status, payload[i]);
+    }
+    closeBusFrameCtx(&link.writer, &status);
+    if(send) {
+        sendFramesInBufferCtx(&link.writer, &status);
+    }
+}
+
+//Takes up to maxBytes off whichever send buffer the writer has, like a UART would
+unsigned int takeWakeWire(unsigned int maxBytes) {
+    eBufferOperationStatus bufferStatus;
+    unsigned int taken = 0;
+    while(taken < maxBytes) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(link.writer.ptrSendBuffer, &bufferStatus, &wire[taken < sizeof(wire) ? taken : 0]);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        taken++;
+    }
+    return taken;
+}
+
+void testHandlerWaits(void) {
+    eBusHandlerOperationStatus putStatus;
+    eBusHandlerRunStatus runStatus;
+    unsigned char frame[MAX_FRAME_SIZE];
+    unsigned char decoded[BUS_TEST_APPLICATION_BUFFER_SIZE];
+    unsigned int frameLength = encodeBusFrame(&payload[0], WAKE_LENGTH, 0, &frame[0], sizeof(frame));
+    unsigned int accepted;
+
+    initialiseBusTestLink(&link);
+    wakes = 0;
+    registerBusFrameHandlerWakeHookCtx(&link.handler, countWake, &link.handler);
+    runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, WAKE_MAX_STEPS);
+    checkBusTest(getBusFrameHandlerWaitCtx(&link.handler) == BUS_HANDLER_BLOCKED_INPUT && wakes == 0, "handler: nothing in, wait %u, %u wakes",
+            getBusFrameHandlerWaitCtx(&link.handler), wakes);
+
+    //Input bytes
+    putBytesForHandlingCtx(&link.handler, &putStatus, &frame[0], frameLength, &accepted);
+    checkBusTest(wakes == 1 && ptrWakeArgument == &link.handler, "handler: %u wakes after the bytes went in", wakes);
+    checkBusTest(getBusFrameHandlerWaitCtx(&link.handler) == BUS_HANDLER_BLOCKED_NONE, "handler: wait %u with bytes in", getBusFrameHandlerWaitCtx(&link.handler));
+
+    //Application ack: the frame being handed over wakes the loop, then nothing moves until the listener is cleared
+    runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, WAKE_MAX_STEPS);
+    checkBusTest(runStatus == BUS_HANDLER_RUN_WAITING_APPLICATION && link.applicationListener, "handler: ran to status %u, listener %u",
+            runStatus, link.applicationListener);
+    checkBusTest(wakes == 2, "handler: %u wakes after the frame was handed over", wakes);
+    runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, WAKE_MAX_STEPS);
+    checkBusTest(getBusFrameHandlerWaitCtx(&link.handler) == BUS_HANDLER_BLOCKED_APPLICATION && wakes == 2, "handler: stepped on the listener, wait %u, %u wakes",
+            getBusFrameHandlerWaitCtx(&link.handler), wakes);
+    checkBusTest(drainBusTestApplication(&link, &decoded[0], sizeof(decoded)) == WAKE_LENGTH && memcmp(&decoded[0], &payload[0], WAKE_LENGTH) == 0,
+            "handler: frame came out wrong");
+    link.applicationListener = 0;
+    checkBusTest(getBusFrameHandlerWaitCtx(&link.handler) == BUS_HANDLER_BLOCKED_NONE, "handler: wait %u with the listener cleared",
+            getBusFrameHandlerWaitCtx(&link.handler));
+    runBusFrameHandlerBudgetCtx(&link.handler, &runStatus, WAKE_MAX_STEPS);
+    checkBusTest(runStatus == BUS_HANDLER_RUN_STARVED && getBusFrameHandlerWaitCtx(&link.handler) == BUS_HANDLER_BLOCKED_INPUT && wakes == 2,
+            "handler: ended with status %u, wait %u, %u wakes", runStatus, getBusFrameHandlerWaitCtx(&link.handler), wakes);
+
+    //Unregistered, nothing fires
+    registerBusFrameHandlerWakeHookCtx(&link.handler, 0, 0);
+    putBytesForHandlingCtx(&link.handler, &putStatus, &frame[0], 1, &accepted);
+    checkBusTest(wakes == 2, "handler: unregistered hook fired");
+}
+
+void testWriterFrames(void) {
+    tBusFrameWriterWait wait;
+
+    initialiseBusTestLink(&link);
+    wakes = 0;
+    registerBusFrameWriterWakeHookCtx(&link.writer, countWake, &link.writer);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FRAMES && !wait.hasDeadline && wakes == 0, "writer: idle, wait %u, %u wakes",
+            wait.reason, wakes);
+
+    //A closed frame isn't released until sendFramesInBuffer
+    queueWakeFrame(0);
+    getBusFrameWriterWaitCtx(&link.writer, &wait);
+    checkBusTest(wait.reason == BUS_FRAME_WRITER_BLOCKED_FRAMES && wakes == 0, "writer: frame closed, wait %u, %u wakes", wait.reason, wakes);
+    queueWakeFrame(1);
+    getBusFrameWriterWaitCtx(&link.writer, &wait);
+    checkBusTest(wait.reason == BUS_FRAME_WRITER_BLOCKED_NONE && wakes == 1 && ptrWakeArgument == &link.writer, "writer: frames released, wait %u, %u wakes",
+            wait.reason, wakes);
+
+    //Application ack: the send listener is set with a wakeup, and holds the writer until it's cleared
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && !wait.hasDeadline && link.sendListener && wakes == 2,
+            "writer: first frame out, wait %u, listener %u, %u wakes", wait.reason, link.sendListener, wakes);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && wakes == 2, "writer: stepped on the listener, wait %u, %u wakes",
+            wait.reason, wakes);
+    checkBusTest(takeWakeWire(sizeof(wire)) == getEncodedBusFrameSize(WAKE_LENGTH, 0), "writer: first frame the wrong size");
+    link.sendListener = 0;
+    getBusFrameWriterWaitCtx(&link.writer, &wait);
+    checkBusTest(wait.reason == BUS_FRAME_WRITER_BLOCKED_NONE, "writer: wait %u with the listener cleared", wait.reason);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && wakes == 3, "writer: second frame out, wait %u, %u wakes", wait.reason, wakes);
+    takeWakeWire(sizeof(wire));
+    link.sendListener = 0;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FRAMES && wakes == 3, "writer: ended with wait %u, %u wakes", wait.reason, wakes);
+}
+
+void testSendSpace(void) {
+    tBusFrameWriterWait wait;
+    unsigned int marker;
+
+    initialiseBusTestLink(&link);
+    initialiseBuffer(&smallSendBuffer, &smallSendArray[0], WAKE_SMALL_SEND);
+    registerSendFrameBufferCtx(&link.writer, &smallSendBuffer);
+    wakes = 0;
+    registerBusFrameWriterWakeHookCtx(&link.writer, countWake, &link.writer);
+    queueWakeFrame(1);
+
+    //EC1 then EC2 find the buffer full. Nothing in the library sees it drain, so no wakeup, just the wait clearing once it's stepped
+    for(marker = 0; marker < 2; marker++) {
+        checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && !wait.hasDeadline && !link.sendListener && wakes == 1,
+                "send space: end code %u, wait %u, listener %u, %u wakes", marker + 1, wait.reason, link.sendListener, wakes);
+        checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && wakes == 1, "send space: stepped past a full buffer, wait %u", wait.reason);
+        checkBusTest(takeWakeWire(1) == 1, "send space: nothing to take");
+    }
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && link.sendListener && wakes == 2,
+            "send space: frame out, wait %u, listener %u, %u wakes", wait.reason, link.sendListener, wakes);
+}
+
+void testCoalescing(void) {
+    tBusFrameWriterWait wait;
+    unsigned long flushed;
+
+    initialiseBusTestLink(&link);
+    now = 1000;
+    registerBusFrameWriterClockCtx(&link.writer, readWakeClock);
+    setBusFrameCoalescingCtx(&link.writer, 1000, WAKE_COALESCE_DELAY);
+    wakes = 0;
+    registerBusFrameWriterWakeHookCtx(&link.writer, countWake, &link.writer);
+
+    //After a quiet spell the first frame goes straight out
+    queueWakeFrame(1);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && link.sendListener && wakes == 2,
+            "coalescing: first frame, wait %u, listener %u, %u wakes", wait.reason, link.sendListener, wakes);
+    flushed = now;
+    takeWakeWire(sizeof(wire));
+    link.sendListener = 0;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FRAMES, "coalescing: wait %u after the first frame", wait.reason);
+
+    //The next one is held for the rest of the delay, a frame closed meanwhile joins it with a wakeup
+    now += 10;
+    queueWakeFrame(1);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_COALESCING && wait.hasDeadline &&
+            wait.deadline == flushed + WAKE_COALESCE_DELAY && !link.sendListener && wakes == 3,
+            "coalescing: held, wait %u, deadline %u %lu, listener %u, %u wakes", wait.reason, wait.hasDeadline, wait.deadline, link.sendListener, wakes);
+    queueWakeFrame(0);
+    checkBusTest(wakes == 4, "coalescing: %u wakes after a frame joined the batch", wakes);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_COALESCING && wait.deadline == flushed + WAKE_COALESCE_DELAY && wakes == 4,
+            "coalescing: held with two, wait %u, deadline %lu, %u wakes", wait.reason, wait.deadline, wakes);
+
+    //Coalesce deadline
+    now = flushed + WAKE_COALESCE_DELAY - 1;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_COALESCING && !link.sendListener && wakes == 4,
+            "coalescing: a tick early, wait %u, listener %u", wait.reason, link.sendListener);
+    now++;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && link.sendListener && wakes == 5,
+            "coalescing: at the deadline, wait %u, listener %u, %u wakes", wait.reason, link.sendListener, wakes);
+    checkBusTest(takeWakeWire(sizeof(wire)) == 2 * getEncodedBusFrameSize(WAKE_LENGTH, 0), "coalescing: batch wasn't both frames");
+}
+
+void testRepairWait(unsigned char clock) {
+    unsigned char missing[BUS_FRAME_REPAIR_BITMAP_BYTES];
+    const char *ptrName = clock ? "repair ticks" : "repair steps";
+    tBusFrameWriterWait wait;
+    unsigned long sent;
+    unsigned int steps;
+
+    initialiseBusTestLink(&link);
+    now = 5000;
+    if(clock) {
+        registerBusFrameWriterClockCtx(&link.writer, readWakeClock);
+    }
+    setBusFrameRepairModeCtx(&link.writer, 1);
+    wakes = 0;
+    registerBusFrameWriterWakeHookCtx(&link.writer, countWake, &link.writer);
+    queueWakeFrame(1);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && link.sendListener && wakes == 2, "%s: frame out, wait %u, %u wakes",
+            ptrName, wait.reason, wakes);
+    sent = now;
+    takeWakeWire(sizeof(wire));
+    link.sendListener = 0;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FEEDBACK && wait.hasDeadline == clock &&
+            (!clock || wait.deadline == sent + BUS_FRAME_REPAIR_WAIT_TICKS) && wakes == 2,
+            "%s: waiting, wait %u, deadline %u %lu, %u wakes", ptrName, wait.reason, wait.hasDeadline, wait.deadline, wakes);
+
+    if(clock) {
+        //Repair deadline: steps don't count, the clock does
+        steps = 0;
+        while(steps < 4 * BUS_FRAME_REPAIR_WAIT_STEPS && stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FEEDBACK) {
+            steps++;
+        }
+        checkBusTest(steps == 4 * BUS_FRAME_REPAIR_WAIT_STEPS, "%s: gave up after %u steps with the clock still", ptrName, steps);
+        now = sent + BUS_FRAME_REPAIR_WAIT_TICKS - 1;
+        checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FEEDBACK, "%s: a tick early, wait %u", ptrName, wait.reason);
+        now++;
+    } else {
+        steps = 0;
+        while(steps < 4 * BUS_FRAME_REPAIR_WAIT_STEPS && stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FEEDBACK) {
+            steps++;
+        }
+        checkBusTest(steps < BUS_FRAME_REPAIR_WAIT_STEPS, "%s: still waiting after %u steps", ptrName, steps);
+    }
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FRAMES && wakes == 2, "%s: after the deadline, wait %u, %u wakes",
+            ptrName, wait.reason, wakes);
+
+    //Feedback arriving ends the wait with a wakeup
+    queueWakeFrame(1);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_OUTPUT && wakes == 4, "%s: second frame out, wait %u, %u wakes", ptrName, wait.reason, wakes);
+    takeWakeWire(sizeof(wire));
+    link.sendListener = 0;
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FEEDBACK, "%s: second frame, wait %u", ptrName, wait.reason);
+    memset(&missing[0], 0, sizeof(missing));
+    applyBusFrameFeedbackCtx(&link.writer, link.writer.repairSequence, &missing[0]);
+    getBusFrameWriterWaitCtx(&link.writer, &wait);
+    checkBusTest(wait.reason == BUS_FRAME_WRITER_BLOCKED_NONE && wakes == 5 && ptrWakeArgument == &link.writer, "%s: feedback in, wait %u, %u wakes",
+            ptrName, wait.reason, wakes);
+    checkBusTest(stepWriterUntilBlocked(&wait) == BUS_FRAME_WRITER_BLOCKED_FRAMES && wakes == 5, "%s: acknowledged, wait %u, %u wakes", ptrName, wait.reason, wakes);
+}
+
+int main(void) {
+    unsigned int seed = 97;
+
+    fillBusTestPayload(&payload[0], WAKE_LENGTH, &seed);
+    testHandlerWaits();
+    testWriterFrames();
+    testSendSpace();
+    testCoalescing();
+    testRepairWait(1);
+    testRepairWait(0);
+    return finishBusTest("test_wake");
+}
@@ -0,0 +1,175 @@
+/*
+ * File:   test_writer_queue.c
+ * Author: Alex
+ *
+ * Created on 18 October 2026, 05:15
+ *
+ * The writer's frame descriptor queue on its own terms: FRAME_WRITER_MAX_QUEUED_FRAMES
+ * closed frames fill it, the next openBusFrame is refused and nothing can be
+ * written or closed until a frame has gone. Then rounds of frames closed
+ * while earlier ones are still part way out, so the queue wraps many times
+ * over, and every frame has to reach the handler once and in order.
+ *
+ *   test_writer_queue [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../ring-buffer/ring_buffer.h"
+#include "bus_test.h"
+
+#define QUEUE_DEFAULT_ROUNDS    300
+#define QUEUE_MAX_LENGTH        6
+#define QUEUE_MAX_FRAMES        (QUEUE_DEFAULT_ROUNDS * FRAME_WRITER_MAX_QUEUED_FRAMES)
+#define QUEUE_WIRE_PER_FRAME    (4 + 8)
+
+#if FRAME_WRITER_MAX_QUEUED_FRAMES * QUEUE_MAX_LENGTH > FRAME_WRITER_PROCESS_BUFFER_SIZE
+#error test_writer_queue needs FRAME_WRITER_PROCESS_BUFFER_SIZE to hold a full queue of 6 byte frames
+#endif
+
+unsigned char queueFrame(unsigned int sequence, unsigned int length);
+unsigned int stepQueueWriter(unsigned int budget);
+void testQueueFull(void);
+void testQueueOrder(unsigned int rounds);
+
+tBusTestLink link;
+unsigned char wire[QUEUE_MAX_FRAMES * QUEUE_WIRE_PER_FRAME];
+unsigned char decoded[QUEUE_MAX_FRAMES * QUEUE_MAX_LENGTH];
+unsigned int decodedLengths[QUEUE_MAX_FRAMES];
+unsigned int queuedLengths[QUEUE_MAX_FRAMES];
+unsigned int wireLength;
+
+//Payload is the sequence number (low byte, high byte) then its low byte again to fill out length
+unsigned char queueFrame(unsigned int sequence, unsigned int length) {
+    eBusFrameWriterOperationStatus status = BUS_FRAME_WRITER_OPERATION_NONE;
+    unsigned int i;
+
+    openBusFrameCtx(&link.writer, &status);
+    if(status != BUS_FRAME_WRITER_OPERATION_OK) {
+        return 0;
+    }
+    for(i = 0; i < length; i++) {
+        writeToBusFrameCtx(&link.writer, &status, (unsigned char)(i == 1 ? sequence >> 8 : sequence));
+    }
+    closeBusFrameCtx(&link.writer, &status);
+    return status == BUS_FRAME_WRITER_OPERATION_OK;
+}
+
+//Runs the writer for budget steps like a UART that keeps up, taking whatever it sends. Returns the steps taken
+unsigned int stepQueueWriter(unsigned int budget) {
+    eBusFrameWriterRunStatus runStatus;
+    eBufferOperationStatus bufferStatus;
+    unsigned int steps;
+    unsigned char byte;
+
+    steps = runBusFrameWriterBudgetCtx(&link.writer, &runStatus, budget);
+    while(1) {
+        bufferStatus = BUFFER_OPERATION_NONE;
+        getByte(&link.sendBuffer, &bufferStatus, &byte);
+        if(bufferStatus != BUFFER_OPERATION_OK) {
+            break;
+        }
+        if(wireLength < sizeof(wire)) {
+            wire[wireLength] = byte;
+        }
+        wireLength++;
+    }
+    link.sendListener = 0;
+    return steps;
+}
+
+void testQueueFull(void) {
+    eBusFrameWriterOperationStatus status;
+    unsigned int frames;
+    unsigned int frame;
+    unsigned int steps;
+
+    initialiseBusTestLink(&link);
+    wireLength = 0;
+    for(frame = 0; frame < FRAME_WRITER_MAX_QUEUED_FRAMES; frame++) {
+        checkBusTest(queueFrame(frame, QUEUE_MAX_LENGTH), "full queue: frame %u refused", frame);
+        checkBusTest(getQueuedFrameCountCtx(&link.writer) == frame + 1, "full queue: %u frames queued after %u", getQueuedFrameCountCtx(&link.writer), frame + 1);
+    }
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    openBusFrameCtx(&link.writer, &status);
+    checkBusTest(status == BUS_FRAME_WRITER_ERROR_WRITING, "full queue: open allowed with %u frames queued", FRAME_WRITER_MAX_QUEUED_FRAMES);
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    writeToBusFrameCtx(&link.writer, &status, 0x55);
+    checkBusTest(status == BUS_FRAME_WRITER_ERROR_WRITING, "full queue: write allowed after a refused open");
+    status = BUS_FRAME_WRITER_OPERATION_NONE;
+    closeBusFrameCtx(&link.writer, &status);
+    checkBusTest(status == BUS_FRAME_WRITER_ERROR_WRITING, "full queue: close allowed after a refused open");
+    checkBusTest(getQueuedFrameCountCtx(&link.writer) == FRAME_WRITER_MAX_QUEUED_FRAMES, "full queue: %u frames queued after the refusals",
+            getQueuedFrameCountCtx(&link.writer));
+
+    //Nothing goes until sendFramesInBuffer, then the first frame leaving frees a slot
+    stepQueueWriter(100);
+    checkBusTest(wireLength == 0, "full queue: %u bytes sent before sendFramesInBuffer", wireLength);
+    sendFramesInBufferCtx(&link.writer, &status);
+    for(steps = 0; steps < BUS_TEST_WRITER_STEPS && getQueuedFrameCountCtx(&link.writer) == FRAME_WRITER_MAX_QUEUED_FRAMES; steps++) {
+        stepQueueWriter(1);
+    }
+    checkBusTest(queueFrame(FRAME_WRITER_MAX_QUEUED_FRAMES, QUEUE_MAX_LENGTH), "full queue: still refused once a frame has gone");
+    wireLength += collectBusTestWire(&link, &wire[wireLength], sizeof(wire) - wireLength);
+    checkBusTest(getQueuedFrameCountCtx(&link.writer) == 0, "full queue: %u frames left queued", getQueuedFrameCountCtx(&link.writer));
+
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLengths[0], QUEUE_MAX_FRAMES);
+    checkBusTest(frames == FRAME_WRITER_MAX_QUEUED_FRAMES + 1, "full queue: %u frames out, %u in", frames, FRAME_WRITER_MAX_QUEUED_FRAMES + 1);
+    for(frame = 0; frame < frames && frame <= FRAME_WRITER_MAX_QUEUED_FRAMES; frame++) {
+        checkBusTest(decodedLengths[frame] == QUEUE_MAX_LENGTH && decoded[frame * QUEUE_MAX_LENGTH] == frame,
+                "full queue: frame %u came out as %u bytes, sequence %u", frame, decodedLengths[frame], decoded[frame * QUEUE_MAX_LENGTH]);
+    }
+}
+
+void testQueueOrder(unsigned int rounds) {
+    eBusFrameWriterOperationStatus status;
+    unsigned int seed = 61;
+    unsigned int sequence = 0;
+    unsigned int offset = 0;
+    unsigned int frames;
+    unsigned int round;
+    unsigned int burst;
+    unsigned int length;
+    unsigned int frame;
+    unsigned int bad = 0;
+
+    initialiseBusTestLink(&link);
+    wireLength = 0;
+    for(round = 0; round < rounds && sequence < QUEUE_MAX_FRAMES; round++) {
+        //However many fit, then a few steps so the writer is part way through a frame when the next lot is closed
+        burst = getBusTestRandom(&seed) % (FRAME_WRITER_MAX_QUEUED_FRAMES + 1);
+        while(burst > 0 && sequence < QUEUE_MAX_FRAMES) {
+            length = 2 + getBusTestRandom(&seed) % (QUEUE_MAX_LENGTH - 1);
+            if(!queueFrame(sequence, length)) {
+                checkBusTest(getQueuedFrameCountCtx(&link.writer) == FRAME_WRITER_MAX_QUEUED_FRAMES, "round %u: frame %u refused with %u queued",
+                        round, sequence, getQueuedFrameCountCtx(&link.writer));
+                break;
+            }
+            queuedLengths[sequence++] = length;
+            burst--;
+        }
+        sendFramesInBufferCtx(&link.writer, &status);
+        stepQueueWriter(1 + getBusTestRandom(&seed) % 40);
+    }
+    wireLength += collectBusTestWire(&link, &wire[wireLength], sizeof(wire) - wireLength);
+    checkBusTest(getQueuedFrameCountCtx(&link.writer) == 0, "order: %u frames left queued", getQueuedFrameCountCtx(&link.writer));
+
+    frames = readBusTestFrames(&link, &wire[0], wireLength, &decoded[0], sizeof(decoded), &decodedLengths[0], QUEUE_MAX_FRAMES);
+    checkBusTest(frames == sequence, "order: %u frames out, %u in", frames, sequence);
+    for(frame = 0; frame < frames && frame < sequence; frame++) {
+        if((decodedLengths[frame] != QUEUE_MAX_LENGTH || decoded[offset] != (unsigned char)frame || decoded[offset + 1] != (unsigned char)(frame >> 8)) && bad++ < 5) {
+            checkBusTest(0, "order: frame %u (%u bytes) came out as %u bytes, sequence %u", frame, queuedLengths[frame], decodedLengths[frame],
+                    decoded[offset] | (decoded[offset + 1] << 8));
+        }
+        offset += decodedLengths[frame];
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned int rounds = argc > 1 ? (unsigned int)atoi(argv[1]) : QUEUE_DEFAULT_ROUNDS;
+
+    testQueueFull();
+    testQueueOrder(rounds);
+    return finishBusTest("test_writer_queue");
+}